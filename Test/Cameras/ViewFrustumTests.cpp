@@ -0,0 +1,119 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Cameras ViewFrustum tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ViewFrustum class from 3DMagic library
+#include <Cameras/ViewFrustum.h>
+#include <stdlib.h>
+#include <vector>
+using namespace Magic3D;
+
+
+/** Fixture for Cameras ViewFrustum tests
+ */
+class Cameras_ViewFrustumTests : public ::testing::Test
+{
+protected:
+    ViewFrustum frustum;
+    SphereArray spheres;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        frustum.setCamProperties(60.0f, 4.0f / 3.0f, 1.0f, 100.0f);
+        frustum.setPosition(Position(1.0f, 2.0f, 3.0f));
+
+        // random spheres around the frustum, some in and some out. Spheres
+        // almost touching a plane are skipped, as the SIMD paths sum the 
+        // plane distance in a different order and may round the other way
+        srand(1234);
+        while (spheres.size() < 500)
+        {
+            Scalar x = random(-100, 100), y = random(-100, 100), z = random(-100, 100);
+            Scalar radius = random(0, 40);
+            unsigned int smaller = ViewFrustum::ALL_PLANES, larger = ViewFrustum::ALL_PLANES;
+            if ((frustum.sphereTest(x, y, z, radius - 0.01f, smaller) == ViewFrustum::OUTSIDE) ==
+                (frustum.sphereTest(x, y, z, radius + 0.01f, larger) == ViewFrustum::OUTSIDE))
+                spheres.add(x, y, z, radius);
+        }
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// get a random number in a range
+    static Scalar random(Scalar min, Scalar max)
+    {
+        return min + (max - min) * (Scalar)rand() / (Scalar)RAND_MAX;
+    }
+};
+
+
+/// tests that batches of any size match testing each sphere on its own
+TEST_F(Cameras_ViewFrustumTests, SpheresInFrustumMatchesScalar)
+{
+    // a single sphere is always tested by the scalar loop
+    std::vector<bool> expected(spheres.size());
+    int visibleCount = 0, radiusCount = 0;
+    for (unsigned int i = 0; i < spheres.size(); i++)
+    {
+        uint32_t visible;
+        frustum.spheresInFrustum(spheres, i, 1, &visible);
+        expected[i] = visible == 1;
+        visibleCount += expected[i] ? 1 : 0;
+
+        // count spheres that are only visible because of their radius
+        unsigned int planes = ViewFrustum::ALL_PLANES;
+        if (expected[i] && frustum.sphereTest(spheres.x[i], spheres.y[i], spheres.z[i], 0, planes) == 
+            ViewFrustum::OUTSIDE)
+            radiusCount++;
+    }
+    ASSERT_GT(visibleCount, 0);
+    ASSERT_GT(radiusCount, 0);
+    ASSERT_LT(visibleCount, (int)spheres.size());
+
+    // batches that fill neither 4 nor 8 wide registers, starting at odd offsets
+    for (unsigned int count = 1; count <= 75; count++)
+    {
+        for (unsigned int start = 0; start < 3; start++)
+        {
+            std::vector<uint32_t> visible((count + 31) / 32 + 1, 0xFFFFFFFF);
+            frustum.spheresInFrustum(spheres, start, count, &visible[0]);
+
+            for (unsigned int i = 0; i < count; i++)
+                ASSERT_EQ(expected[start + i], ((visible[i >> 5] >> (i & 31)) & 1) != 0) 
+                    << "count " << count << " sphere " << i;
+
+            // bits past the last sphere are cleared and the words after them untouched
+            if (count & 31)
+            {
+                ASSERT_EQ(0u, visible[count >> 5] >> (count & 31));
+            }
+            ASSERT_EQ(0xFFFFFFFF, visible.back());
+        }
+    }
+}
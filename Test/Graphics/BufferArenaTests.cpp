@@ -0,0 +1,195 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Graphics BufferArena tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include BufferArena class from 3DMagic library
+#include <Graphics/BufferArena.h>
+#include <Graphics/GraphicsSystem.h>
+#include <vector>
+using namespace Magic3D;
+
+
+/** Fixture for Graphics BufferArena tests
+ */
+class Graphics_BufferArenaTests : public ::testing::Test
+{
+protected:
+    /// the arena's buffers need a gl context, shared by all the tests
+    static GraphicsSystem* graphics;
+
+    /// setup for all tests
+    static void SetUpTestCase()
+    {
+        graphics = new GraphicsSystem();
+        graphics->init();
+    }
+
+    /// teardown for all tests
+    static void TearDownTestCase()
+    {
+        graphics->deinit();
+        delete graphics;
+        graphics = NULL;
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// fill an allocation with a byte value
+    void fill(BufferArena& arena, BufferArena::Handle handle, unsigned char value)
+    {
+        std::vector<unsigned char> data(arena.getSize(handle), value);
+        arena.write(handle, &data[0], data.size());
+    }
+
+    /// check that an allocation still holds a byte value
+    void ASSERT_FILLED(BufferArena& arena, BufferArena::Handle handle, unsigned char value)
+    {
+        std::vector<unsigned char> data(arena.getSize(handle));
+        arena.getBuffer().bind(Buffer::COPY_READ_BUFFER);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, arena.getOffset(handle), data.size(), &data[0]);
+        arena.getBuffer().unBind();
+        for (unsigned int i = 0; i < data.size(); i++)
+            ASSERT_EQ(value, data[i]);
+    }
+};
+
+GraphicsSystem* Graphics_BufferArenaTests::graphics = NULL;
+
+
+/// tests that allocations are aligned and placed one after another
+TEST_F(Graphics_BufferArenaTests, AllocateAligned)
+{
+    BufferArena arena(256, 16);
+    BufferArena::Handle a = arena.allocate(10);
+    BufferArena::Handle b = arena.allocate(20);
+
+    ASSERT_EQ(0, arena.getOffset(a));
+    ASSERT_EQ(16, arena.getSize(a));
+    ASSERT_EQ(16, arena.getOffset(b));
+    ASSERT_EQ(32, arena.getSize(b));
+    ASSERT_EQ(48, arena.getUsedSize());
+    ASSERT_EQ(2, arena.getAllocationCount());
+    ASSERT_EQ(1, arena.getFreeBlockCount());
+}
+
+/// tests that released ranges merge with free neighbours on both sides
+TEST_F(Graphics_BufferArenaTests, ReleaseCoalesces)
+{
+    BufferArena arena(64, 16);
+    BufferArena::Handle a = arena.allocate(16);
+    BufferArena::Handle b = arena.allocate(16);
+    BufferArena::Handle c = arena.allocate(16);
+    BufferArena::Handle d = arena.allocate(16);
+    ASSERT_EQ(0, arena.getFreeBlockCount());
+
+    // separate holes, neither touches another free range
+    arena.release(a);
+    arena.release(c);
+    ASSERT_EQ(2, arena.getFreeBlockCount());
+
+    // b joins the holes before and after it
+    arena.release(b);
+    ASSERT_EQ(1, arena.getFreeBlockCount());
+
+    // the whole buffer is one free range again, which fits one large allocation
+    arena.release(d);
+    ASSERT_EQ(1, arena.getFreeBlockCount());
+    ASSERT_EQ(0, arena.getUsedSize());
+    BufferArena::Handle all = arena.allocate(64);
+    ASSERT_EQ(0, arena.getOffset(all));
+    ASSERT_EQ(64, arena.getCapacity());
+}
+
+/// tests that freed ranges and handles are reused first fit
+TEST_F(Graphics_BufferArenaTests, ReleaseReusesRangesAndHandles)
+{
+    BufferArena arena(256, 16);
+    BufferArena::Handle a = arena.allocate(32);
+    BufferArena::Handle b = arena.allocate(32);
+    arena.allocate(32);
+    arena.release(b);
+
+    // fits in the hole b left
+    BufferArena::Handle c = arena.allocate(16);
+    ASSERT_EQ(b, c);
+    ASSERT_EQ(32, arena.getOffset(c));
+    ASSERT_EQ(2, arena.getFreeBlockCount());
+
+    // too large for the rest of the hole, goes after the last allocation
+    BufferArena::Handle d = arena.allocate(32);
+    ASSERT_EQ(96, arena.getOffset(d));
+    ASSERT_EQ(0, arena.getOffset(a));
+}
+
+/// tests that growing keeps data and handles valid
+TEST_F(Graphics_BufferArenaTests, GrowKeepsData)
+{
+    BufferArena arena(64, 16);
+    BufferArena::Handle a = arena.allocate(48);
+    fill(arena, a, 0xAB);
+    int generation = arena.getGeneration();
+
+    BufferArena::Handle b = arena.allocate(48);
+    ASSERT_GT(arena.getGeneration(), generation);
+    ASSERT_GE(arena.getCapacity(), 96);
+    ASSERT_EQ(0, arena.getOffset(a));
+    ASSERT_EQ(48, arena.getOffset(b));
+    ASSERT_FILLED(arena, a, 0xAB);
+}
+
+/// tests that compacting moves allocations to the start, keeping their data
+TEST_F(Graphics_BufferArenaTests, CompactKeepsData)
+{
+    BufferArena arena(256, 16);
+    BufferArena::Handle a = arena.allocate(32);
+    BufferArena::Handle b = arena.allocate(32);
+    BufferArena::Handle c = arena.allocate(32);
+    fill(arena, a, 1);
+    fill(arena, c, 3);
+    arena.release(b);
+    int generation = arena.getGeneration();
+
+    arena.compact();
+    ASSERT_GT(arena.getGeneration(), generation);
+    ASSERT_EQ(1, arena.getFreeBlockCount());
+    ASSERT_EQ(0, arena.getOffset(a));
+    ASSERT_EQ(32, arena.getOffset(c));
+    ASSERT_FILLED(arena, a, 1);
+    ASSERT_FILLED(arena, c, 3);
+
+    // already compact, nothing moves
+    generation = arena.getGeneration();
+    arena.compact();
+    ASSERT_EQ(generation, arena.getGeneration());
+}
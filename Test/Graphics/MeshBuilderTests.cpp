@@ -0,0 +1,276 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Graphics MeshBuilder tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include MeshBuilder class from 3DMagic library
+#include <Graphics/MeshBuilder.h>
+using namespace Magic3D;
+
+
+/** Fixture for Graphics MeshBuilder tests
+ */
+class Graphics_MeshBuilderTests: public ::testing::Test
+{
+protected:
+    MeshBuilderPTNT mb;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// add a triangle with normals and tangents left for the builder to calculate
+    void addTriangle(const Vector3& a, const Vector3& b, const Vector3& c,
+        const Vector2& ta, const Vector2& tb, const Vector2& tc)
+    {
+        mb.addVertex(a, ta, Vector3(), Vector3());
+        mb.addVertex(b, tb, Vector3(), Vector3());
+        mb.addVertex(c, tc, Vector3(), Vector3());
+    }
+
+    /** add a unit square from x0 to x1 on the z = 0 plane facing +z, with 
+     * the u texture coordinate running from u0 to u1 along x
+     */
+    void addQuad(Scalar x0, Scalar x1, Scalar u0, Scalar u1)
+    {
+        addTriangle(Vector3(x0, 0, 0), Vector3(x1, 0, 0), Vector3(x1, 1, 0),
+            Vector2(u0, 0), Vector2(u1, 0), Vector2(u1, 1));
+        addTriangle(Vector3(x0, 0, 0), Vector3(x1, 1, 0), Vector3(x0, 1, 0),
+            Vector2(u0, 0), Vector2(u1, 1), Vector2(u0, 1));
+    }
+
+    /// test equality of two vectors
+    void ASSERT_VECTOR_NEAR(const Vector3& expected, const Vector3& actual)
+    {
+        ASSERT_NEAR(expected.x(), actual.x(), 0.0001f);
+        ASSERT_NEAR(expected.y(), actual.y(), 0.0001f);
+        ASSERT_NEAR(expected.z(), actual.z(), 0.0001f);
+    }
+};
+
+
+/// tests that build welds identical vertices into an indexed mesh
+TEST_F(Graphics_MeshBuilderTests, BuildWeldsIdenticalVertices)
+{
+    addQuad(0, 1, 0, 1);
+    mb.calculateNormals();
+    mb.calculateTangents();
+    std::shared_ptr<Mesh> mesh = mb.build();
+
+    // the diagonal's two corners are shared by both triangles
+    ASSERT_TRUE(mesh->isIndexed());
+    ASSERT_EQ(4, mesh->getVertexCount());
+    ASSERT_EQ(6, mesh->getElementCount());
+    ASSERT_EQ(mesh->getIndex(0), mesh->getIndex(3));
+    ASSERT_EQ(mesh->getIndex(2), mesh->getIndex(4));
+}
+
+/// tests that build keeps vertices apart that differ in any attribute
+TEST_F(Graphics_MeshBuilderTests, BuildKeepsDifferentVertices)
+{
+    // same positions, texture coordinates mirrored between the two quads
+    addQuad(0, 1, 0, 1);
+    addQuad(0, 1, 1, 0);
+    std::shared_ptr<Mesh> mesh = mb.build();
+
+    ASSERT_EQ(8, mesh->getVertexCount());
+    ASSERT_EQ(12, mesh->getElementCount());
+}
+
+/// tests that normals of a flat surface face away from its front
+TEST_F(Graphics_MeshBuilderTests, FlatNormals)
+{
+    addQuad(0, 1, 0, 1);
+    mb.calculateNormals();
+
+    for (int i = 0; i < 6; i++)
+        ASSERT_VECTOR_NEAR(Vector3(0, 0, 1), mb.getVertex(i).normal());
+}
+
+/// tests that normals are averaged over positions within the weld epsilon
+TEST_F(Graphics_MeshBuilderTests, NormalsAveragedOverWeldedPositions)
+{
+    // two equal faces folded at a right angle along the y axis, the 
+    // second face's edge nudged by less than the weld epsilon
+    Scalar nudge = 0.00001f;
+    addTriangle(Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(0, 1, 0),
+        Vector2(0, 0), Vector2(1, 0), Vector2(0, 1));
+    addTriangle(Vector3(nudge, 0, 0), Vector3(0, 1, 0), Vector3(0, 0, 1),
+        Vector2(0, 0), Vector2(1, 0), Vector2(0, 1));
+    mb.setWeldEpsilon(0.0001f);
+    mb.calculateNormals();
+
+    // the fold's vertices are shared, the others keep their face's normal
+    Scalar half = sqrt(0.5f);
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(0).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(2).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(3).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(4).normal());
+    ASSERT_VECTOR_NEAR(Vector3(0, 0, 1), mb.getVertex(1).normal());
+    ASSERT_VECTOR_NEAR(Vector3(1, 0, 0), mb.getVertex(5).normal());
+}
+
+/// tests that positions far from the origin are welded like those near it
+TEST_F(Graphics_MeshBuilderTests, NormalsAveragedFarFromOrigin)
+{
+    // the same fold a million units out, well past where coordinates 
+    // divided by the weld epsilon fit in an int
+    Scalar far = 1000000.0f;
+    addTriangle(Vector3(far, 0, 0), Vector3(far + 1, 0, 0), Vector3(far, 1, 0),
+        Vector2(0, 0), Vector2(1, 0), Vector2(0, 1));
+    addTriangle(Vector3(far, 0, 0), Vector3(far, 1, 0), Vector3(far, 0, 1),
+        Vector2(0, 0), Vector2(1, 0), Vector2(0, 1));
+    mb.calculateNormals();
+
+    Scalar half = sqrt(0.5f);
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(0).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(2).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(3).normal());
+    ASSERT_VECTOR_NEAR(Vector3(half, 0, half), mb.getVertex(4).normal());
+    ASSERT_VECTOR_NEAR(Vector3(0, 0, 1), mb.getVertex(1).normal());
+    ASSERT_VECTOR_NEAR(Vector3(1, 0, 0), mb.getVertex(5).normal());
+}
+
+/// tests that tangents follow the direction of increasing u
+TEST_F(Graphics_MeshBuilderTests, TangentsFollowTexCoords)
+{
+    addQuad(0, 1, 1, 0);
+    mb.calculateNormals();
+    mb.calculateTangents();
+
+    for (int i = 0; i < 6; i++)
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mb.getVertex(i).tangent());
+
+    mb.calculateTangents(MeshBuilderPTNT::SPLIT_AT_SEAMS);
+    for (int i = 0; i < 6; i++)
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mb.getVertex(i).tangent());
+
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+    for (int i = 0; i < 6; i++)
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mb.getVertex(i).tangent());
+}
+
+/// tests that split tangents aren't shared across a mirrored texture seam
+TEST_F(Graphics_MeshBuilderTests, SplitTangentsAtMirroredSeam)
+{
+    // two quads side by side sharing the x = 1 edge, the second one's
+    // texture mirrored so u decreases along x
+    addQuad(0, 1, 0, 1);
+    addQuad(1, 2, 1, 0);
+    mb.calculateNormals();
+    mb.calculateTangents(MeshBuilderPTNT::SPLIT_AT_SEAMS);
+
+    for (int i = 0; i < 6; i++)
+        ASSERT_VECTOR_NEAR(Vector3(1, 0, 0), mb.getVertex(i).tangent());
+    for (int i = 6; i < 12; i++)
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mb.getVertex(i).tangent());
+
+    // the mirrored quad's bitangent is flipped
+    for (int i = 0; i < 6; i++)
+        ASSERT_EQ(1.0f, mb.getVertex(i).bitangentSign());
+    for (int i = 6; i < 12; i++)
+        ASSERT_EQ(-1.0f, mb.getVertex(i).bitangentSign());
+}
+
+/// tests that MikkTSpace tangents and bitangent signs follow the texture either side of a mirrored seam
+TEST_F(Graphics_MeshBuilderTests, MikkTSpaceMirroredSeam)
+{
+    addQuad(0, 1, 0, 1);
+    addQuad(1, 2, 1, 0);
+    mb.calculateNormals();
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+
+    for (int i = 0; i < 6; i++)
+    {
+        ASSERT_VECTOR_NEAR(Vector3(1, 0, 0), mb.getVertex(i).tangent());
+        ASSERT_EQ(1.0f, mb.getVertex(i).bitangentSign());
+    }
+    for (int i = 6; i < 12; i++)
+    {
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mb.getVertex(i).tangent());
+        ASSERT_EQ(-1.0f, mb.getVertex(i).bitangentSign());
+    }
+}
+
+/// tests that MikkTSpace only averages tangents of triangles joined by an edge
+TEST_F(Graphics_MeshBuilderTests, MikkTSpaceGroupsByEdges)
+{
+    // two triangles only touching at the origin, where their vertices are
+    // identical, with u running along x on one and along y on the other
+    addTriangle(Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(0, 1, 0),
+        Vector2(0, 0), Vector2(1, 0), Vector2(0, 1));
+    addTriangle(Vector3(0, 0, 0), Vector3(-1, 0, 0), Vector3(0, -1, 0),
+        Vector2(0, 0), Vector2(0, 1), Vector2(-1, 0));
+    mb.calculateNormals();
+
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+    ASSERT_VECTOR_NEAR(Vector3(1, 0, 0), mb.getVertex(0).tangent());
+    ASSERT_VECTOR_NEAR(Vector3(0, 1, 0), mb.getVertex(3).tangent());
+
+    // split tangents share the identical vertices
+    Scalar half = sqrt(0.5f);
+    mb.calculateTangents(MeshBuilderPTNT::SPLIT_AT_SEAMS);
+    ASSERT_VECTOR_NEAR(Vector3(half, half, 0), mb.getVertex(0).tangent());
+    ASSERT_VECTOR_NEAR(Vector3(half, half, 0), mb.getVertex(3).tangent());
+}
+
+/// tests that a degenerate triangle takes MikkTSpace tangents from the triangles sharing its vertices
+TEST_F(Graphics_MeshBuilderTests, MikkTSpaceDegenerateTriangle)
+{
+    // u running along y, and a triangle using the origin twice
+    addTriangle(Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(0, 1, 0),
+        Vector2(0, 0), Vector2(0, -1), Vector2(1, 0));
+    addTriangle(Vector3(0, 0, 0), Vector3(0, 0, 0), Vector3(1, 0, 0),
+        Vector2(0, 0), Vector2(0, 0), Vector2(0, -1));
+    mb.calculateNormals();
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+
+    for (int i = 0; i < 6; i++)
+    {
+        ASSERT_VECTOR_NEAR(Vector3(0, 1, 0), mb.getVertex(i).tangent());
+        ASSERT_EQ(1.0f, mb.getVertex(i).bitangentSign());
+    }
+}
+
+/// tests that the bitangent sign survives packing the tangent
+TEST_F(Graphics_MeshBuilderTests, PackedTangentKeepsBitangentSign)
+{
+    addQuad(0, 1, 1, 0);
+    mb.calculateNormals();
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+    std::shared_ptr<Mesh> mesh = mb.setPacking(Mesh::PACK_NORMALS).build();
+
+    for (int i = 0; i < mesh->getVertexCount(); i++)
+    {
+        ASSERT_EQ(-1.0f, mesh->getVertex(i).bitangentSign());
+        ASSERT_VECTOR_NEAR(Vector3(-1, 0, 0), mesh->getVertex(i).tangent());
+    }
+}
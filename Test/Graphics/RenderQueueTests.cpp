@@ -0,0 +1,179 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Graphics RenderQueue tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include RenderQueue class from 3DMagic library
+#include <Graphics/RenderQueue.h>
+#include <stdlib.h>
+#include <algorithm>
+using namespace Magic3D;
+
+
+/** Fixture for Graphics RenderQueue tests
+ */
+class Graphics_RenderQueueTests : public ::testing::Test
+{
+protected:
+    RenderQueue queue;
+
+    /// stand ins for objects and materials, the queue only uses their addresses
+    char objects[1000];
+    char materials[8];
+
+    /// setup method
+    virtual void SetUp()
+    {
+        queue.setMaxDepth(100.0f);
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// get an item for a stand in object and material
+    RenderQueue::Item item(int object, int material)
+    {
+        return RenderQueue::Item((Object*)&objects[object], (Material*)&materials[material], false);
+    }
+
+    /// add random items, returning their keys and objects in the order they were added
+    void addRandom(int first, int count, std::vector<std::pair<uint64_t, int>>& added)
+    {
+        for (int i = first; i < first + count; i++)
+        {
+            queue.add(item(i, rand() % 8), rand() % 4 == 0, rand() % 3, 
+                (Scalar)(rand() % 1200) / 10.0f);
+            added.push_back(std::make_pair(queue.getKey(queue.size() - 1), i));
+        }
+    }
+
+    /// check that the queue holds the added items sorted by key, equal keys in the order added
+    void ASSERT_SORTED(std::vector<std::pair<uint64_t, int>> added)
+    {
+        std::stable_sort(added.begin(), added.end(), 
+            [](const std::pair<uint64_t, int>& a, const std::pair<uint64_t, int>& b) {
+                return a.first < b.first; 
+            });
+        ASSERT_EQ(added.size(), queue.size());
+        for (unsigned int i = 0; i < queue.size(); i++)
+        {
+            ASSERT_EQ(added[i].first, queue.getKey(i));
+            ASSERT_EQ((Object*)&objects[added[i].second], queue[i].object);
+        }
+    }
+};
+
+
+/// tests the fields of an opaque item's key
+TEST_F(Graphics_RenderQueueTests, OpaqueKeyPacking)
+{
+    queue.add(item(0, 0), false, 7, 10.0f);
+    queue.add(item(1, 1), false, 7, 50.0f);
+    queue.add(item(2, 0), false, 0x12345, 500.0f);
+
+    const uint64_t maxDepth = (1 << RenderQueue::DEPTH_BITS) - 1;
+    uint64_t key = queue.getKey(1);
+    ASSERT_EQ(0u, key >> 63);
+    ASSERT_EQ(7u, (key >> 48) & 0x7FFF);
+    ASSERT_EQ(1u, (key >> 32) & 0xFFFF);
+    ASSERT_EQ(maxDepth / 2, (key >> 8) & 0xFFFFFF);
+    ASSERT_EQ(0u, key & 0xFF);
+
+    // materials keep their ids, program ids are cut to 15 bits and depth is clamped
+    key = queue.getKey(2);
+    ASSERT_EQ(0x2345u, (key >> 48) & 0x7FFF);
+    ASSERT_EQ(0u, (key >> 32) & 0xFFFF);
+    ASSERT_EQ(maxDepth, (key >> 8) & 0xFFFFFF);
+}
+
+/// tests the fields of a transparent item's key
+TEST_F(Graphics_RenderQueueTests, TransparentKeyPacking)
+{
+    queue.add(item(0, 0), true, 7, 25.0f);
+    queue.add(item(1, 1), true, 9, 0.0f);
+
+    const uint64_t maxDepth = (1 << RenderQueue::DEPTH_BITS) - 1;
+    uint64_t key = queue.getKey(1);
+    ASSERT_EQ(1u, key >> 63);
+    ASSERT_EQ(maxDepth, (key >> 39) & 0xFFFFFF);
+    ASSERT_EQ(9u, (key >> 24) & 0x7FFF);
+    ASSERT_EQ(1u, (key >> 8) & 0xFFFF);
+    ASSERT_EQ(0u, key & 0xFF);
+
+    key = queue.getKey(0);
+    ASSERT_EQ(maxDepth - maxDepth / 4, (key >> 39) & 0xFFFFFF);
+}
+
+/// tests the draw order the keys give once sorted
+TEST_F(Graphics_RenderQueueTests, SortOrder)
+{
+    queue.add(item(0, 0), true, 1, 10.0f);  // transparent, near
+    queue.add(item(1, 0), false, 2, 10.0f); // opaque, second program
+    queue.add(item(2, 1), false, 1, 90.0f); // opaque, far
+    queue.add(item(3, 0), true, 1, 90.0f);  // transparent, far
+    queue.add(item(4, 1), false, 1, 10.0f); // opaque, near
+    queue.add(item(5, 0), false, 1, 50.0f); // opaque, first material
+    queue.sort();
+
+    // opaque by program, material then front to back, then transparent back to front
+    int expected[] = { 5, 4, 2, 1, 3, 0 };
+    for (int i = 0; i < 6; i++)
+        ASSERT_EQ((Object*)&objects[expected[i]], queue[i].object);
+}
+
+/// tests that the radix sort matches a stable sort of the keys
+TEST_F(Graphics_RenderQueueTests, RadixSortMatchesStableSort)
+{
+    srand(42);
+    std::vector<std::pair<uint64_t, int>> added;
+    addRandom(0, 1000, added);
+    queue.sort();
+    ASSERT_SORTED(added);
+}
+
+/// tests that retained items are merged with items added later
+TEST_F(Graphics_RenderQueueTests, RetainedMerge)
+{
+    srand(7);
+    std::vector<std::pair<uint64_t, int>> retained;
+    addRandom(0, 300, retained);
+    queue.retain();
+    ASSERT_EQ(300u, queue.getRetainedCount());
+
+    // each frame keeps the retained items and replaces the rest
+    for (int frame = 0; frame < 3; frame++)
+    {
+        queue.clearUnretained();
+        std::vector<std::pair<uint64_t, int>> added = retained;
+        addRandom(300, 200 + frame * 100, added);
+        queue.sort();
+        ASSERT_SORTED(added);
+    }
+
+    queue.clear();
+    ASSERT_EQ(0u, queue.getRetainedCount());
+    ASSERT_EQ(0u, queue.size());
+}
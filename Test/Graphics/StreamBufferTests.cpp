@@ -0,0 +1,223 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Graphics StreamBuffer tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include StreamBuffer class from 3DMagic library
+#include <Graphics/StreamBuffer.h>
+#include <Graphics/GraphicsSystem.h>
+#include <Exceptions/MagicException.h>
+#include <vector>
+using namespace Magic3D;
+
+
+/** Fixture for Graphics StreamBuffer tests. Each test runs once with
+ * persistent mapping allowed and once with orphaning forced.
+ */
+class Graphics_StreamBufferTests : public ::testing::Test
+{
+protected:
+    /// the stream buffer's buffers need a gl context, shared by all the tests
+    static GraphicsSystem* graphics;
+
+    /// setup for all tests
+    static void SetUpTestCase()
+    {
+        graphics = new GraphicsSystem();
+        graphics->init();
+    }
+
+    /// teardown for all tests
+    static void TearDownTestCase()
+    {
+        graphics->deinit();
+        delete graphics;
+        graphics = NULL;
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// build a run of ints starting at a seed value
+    std::vector<int> pattern(int count, int seed)
+    {
+        std::vector<int> data(count);
+        for (int i = 0; i < count; i++)
+            data[i] = seed + i;
+        return data;
+    }
+
+    /// read an allocation's range back from its buffer
+    std::vector<int> readBack(const StreamBuffer::Allocation& allocation)
+    {
+        std::vector<int> data(allocation.size / sizeof(int));
+        allocation.buffer->bind(Buffer::COPY_READ_BUFFER);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, allocation.offset, data.size() * sizeof(int), &data[0]);
+        allocation.buffer->unBind();
+        return data;
+    }
+
+    /// write and read back data over more frames than there are regions
+    void checkFrames(bool persistent)
+    {
+        StreamBuffer stream(4096, persistent);
+        ASSERT_EQ(persistent && GLEW_ARB_buffer_storage, stream.isPersistent());
+
+        for (int frame = 0; frame < StreamBuffer::FRAME_COUNT * 3; frame++)
+        {
+            std::vector<StreamBuffer::Allocation> allocations;
+            for (int i = 0; i < 4; i++)
+            {
+                std::vector<int> data = this->pattern(64, frame * 1000 + i * 100);
+                allocations.push_back(stream.write(&data[0], data.size() * sizeof(int)));
+            }
+
+            for (unsigned int i = 0; i < allocations.size(); i++)
+                ASSERT_EQ(this->pattern(64, frame * 1000 + i * 100), this->readBack(allocations[i]));
+
+            stream.nextFrame();
+        }
+    }
+
+    /// grow the buffer in the middle of a frame
+    void checkGrowth(bool persistent)
+    {
+        StreamBuffer stream(1024, persistent);
+
+        std::vector<int> small = this->pattern(128, 1);
+        StreamBuffer::Allocation first = stream.write(&small[0], small.size() * sizeof(int));
+
+        std::vector<int> large = this->pattern(4096, 2);
+        StreamBuffer::Allocation second = stream.write(&large[0], large.size() * sizeof(int));
+
+        ASSERT_GE(stream.getRegionSize(), (int)(large.size() * sizeof(int)));
+        ASSERT_NE(first.buffer, second.buffer);
+
+        // the first allocation stays readable from the retired buffer until the next frame
+        ASSERT_EQ(small, this->readBack(first));
+        ASSERT_EQ(large, this->readBack(second));
+
+        stream.nextFrame();
+
+        StreamBuffer::Allocation third = stream.write(&large[0], large.size() * sizeof(int));
+        ASSERT_EQ(large, this->readBack(third));
+    }
+
+    /// allocations are aligned as asked and don't overlap
+    void checkAlignment(bool persistent)
+    {
+        StreamBuffer stream(4096, persistent);
+        const int alignments[] = { 1, 4, 16, 64, 256 };
+
+        int end = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            StreamBuffer::Allocation allocation = stream.allocate(13 + i, alignments[i]);
+            stream.commit(allocation);
+
+            ASSERT_EQ(0, allocation.offset % alignments[i]);
+            ASSERT_EQ(13 + i, allocation.size);
+            ASSERT_GE(allocation.offset, end);
+            end = allocation.offset + allocation.size;
+        }
+
+        stream.nextFrame();
+    }
+
+    /// allocating or moving to the next frame with an uncommitted allocation throws
+    void checkThrows(bool persistent)
+    {
+#ifndef MAGIC3D_DISABLE_MAGIC_THROWS
+        StreamBuffer stream(1024, persistent);
+
+        StreamBuffer::Allocation allocation = stream.allocate(64);
+        EXPECT_THROW(stream.allocate(64), MagicException);
+        EXPECT_THROW(stream.nextFrame(), MagicException);
+
+        stream.commit(allocation);
+        stream.nextFrame();
+#else
+        (void)persistent;
+#endif
+    }
+};
+
+GraphicsSystem* Graphics_StreamBufferTests::graphics = NULL;
+
+
+/// tests that data written over many frames reads back, persistently mapped
+TEST_F(Graphics_StreamBufferTests, FramesPersistent)
+{
+    this->checkFrames(true);
+}
+
+/// tests that data written over many frames reads back, orphaned
+TEST_F(Graphics_StreamBufferTests, FramesOrphaned)
+{
+    this->checkFrames(false);
+}
+
+/// tests that growing mid frame keeps earlier allocations readable, persistently mapped
+TEST_F(Graphics_StreamBufferTests, GrowthPersistent)
+{
+    this->checkGrowth(true);
+}
+
+/// tests that growing mid frame keeps earlier allocations readable, orphaned
+TEST_F(Graphics_StreamBufferTests, GrowthOrphaned)
+{
+    this->checkGrowth(false);
+}
+
+/// tests that allocations honour their alignment, persistently mapped
+TEST_F(Graphics_StreamBufferTests, AlignmentPersistent)
+{
+    this->checkAlignment(true);
+}
+
+/// tests that allocations honour their alignment, orphaned
+TEST_F(Graphics_StreamBufferTests, AlignmentOrphaned)
+{
+    this->checkAlignment(false);
+}
+
+/// tests that uncommitted allocations are caught, persistently mapped
+TEST_F(Graphics_StreamBufferTests, PendingThrowsPersistent)
+{
+    this->checkThrows(true);
+}
+
+/// tests that uncommitted allocations are caught, orphaned
+TEST_F(Graphics_StreamBufferTests, PendingThrowsOrphaned)
+{
+    this->checkThrows(false);
+}
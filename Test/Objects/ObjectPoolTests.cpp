@@ -0,0 +1,142 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Objects ObjectPool tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ObjectPool class from 3DMagic library
+#include <Objects/ObjectPool.h>
+#include <vector>
+using namespace Magic3D;
+
+
+/** Fixture for Objects ObjectPool tests
+ */
+class Objects_ObjectPoolTests : public ::testing::Test
+{
+protected:
+    ObjectPool pool;
+
+    /// a model with no meshes or collision shape, so objects need no gl or physics
+    std::shared_ptr<Model> model;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        model = std::make_shared<Model>();
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// tests that created objects can be got from their handles
+TEST_F(Objects_ObjectPoolTests, CreateAndGet)
+{
+    ObjectPool::Handle a = pool.create(model);
+    ObjectPool::Handle b = pool.create(model);
+
+    ASSERT_FALSE(a.isNull());
+    ASSERT_NE(a.index, b.index);
+    ASSERT_TRUE(pool.get(a) != NULL);
+    ASSERT_TRUE(pool.get(b) != NULL);
+    ASSERT_NE(pool.get(a), pool.get(b));
+    ASSERT_EQ(model, pool.get(a)->getModel());
+    ASSERT_EQ(2, pool.getLiveCount());
+
+    // handles that never referred to an object get nothing
+    ASSERT_TRUE(pool.get(ObjectPool::Handle()) == NULL);
+    ASSERT_TRUE(pool.get(ObjectPool::Handle(pool.getCapacity(), 0)) == NULL);
+}
+
+/// tests that handles go stale once their object is destroyed
+TEST_F(Objects_ObjectPoolTests, DestroyedHandlesGoStale)
+{
+    ObjectPool::Handle a = pool.create(model);
+    ObjectPool::Handle b = pool.create(model);
+    pool.destroy(a);
+
+    ASSERT_TRUE(pool.get(a) == NULL);
+    ASSERT_TRUE(pool.get(b) != NULL);
+    ASSERT_EQ(1, pool.getLiveCount());
+
+    // destroying through a stale handle does nothing
+    pool.destroy(a);
+    ASSERT_EQ(1, pool.getLiveCount());
+    ASSERT_TRUE(pool.get(b) != NULL);
+}
+
+/// tests that freed slots are reused without reviving old handles
+TEST_F(Objects_ObjectPoolTests, SlotReuse)
+{
+    ObjectPool::Handle a = pool.create(model);
+    pool.destroy(a);
+    ObjectPool::Handle b = pool.create(model);
+
+    ASSERT_EQ(a.index, b.index);
+    ASSERT_NE(a.generation, b.generation);
+    ASSERT_TRUE(pool.get(a) == NULL);
+    ASSERT_TRUE(pool.get(b) != NULL);
+
+    // the stale handle can't destroy the slot's new object
+    pool.destroy(a);
+    ASSERT_TRUE(pool.get(b) != NULL);
+    ASSERT_EQ(1, pool.getLiveCount());
+}
+
+/// tests that the pool grows by slabs and reuses them instead of allocating
+TEST_F(Objects_ObjectPoolTests, SlabGrowth)
+{
+    std::vector<ObjectPool::Handle> handles;
+    for (int i = 0; i < ObjectPool::SLAB_SIZE + 1; i++)
+        handles.push_back(pool.create(model));
+    ASSERT_EQ(2, pool.getSlabCount());
+    ASSERT_EQ(2 * ObjectPool::SLAB_SIZE, pool.getCapacity());
+
+    for (const ObjectPool::Handle& handle : handles)
+        pool.destroy(handle);
+    ASSERT_EQ(0, pool.getLiveCount());
+
+    for (int i = 0; i < ObjectPool::SLAB_SIZE + 1; i++)
+    {
+        ObjectPool::Handle handle = pool.create(model);
+        ASSERT_TRUE(pool.get(handle) != NULL);
+    }
+    ASSERT_EQ(2, pool.getSlabCount());
+}
+
+/// tests that the pool destroys objects still in it when it is destroyed
+TEST_F(Objects_ObjectPoolTests, DestructorDestroysLiveObjects)
+{
+    {
+        ObjectPool other;
+        other.create(model);
+        other.create(model);
+        other.destroy(other.create(model));
+        ASSERT_EQ(3, model.use_count());
+    }
+    ASSERT_EQ(1, model.use_count());
+}
@@ -0,0 +1,352 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Physics PhysicsQueries tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include PhysicsQueries class from 3DMagic library
+#include <Physics/PhysicsSystem.h>
+#include <Physics/PhysicsQueries.h>
+#include <CollisionShapes/BoxCollisionShape.h>
+#include <CollisionShapes/SphereCollisionShape.h>
+#include <CollisionShapes/TriangleMeshCollisionShape.h>
+#include <Graphics/MeshBuilder.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+using namespace Magic3D;
+
+/// physics system with the bodies of objects added directly, with no world
+class QueryPhysicsSystem : public PhysicsSystem
+{
+public:
+    using PhysicsSystem::addBody;
+    using PhysicsSystem::removeBody;
+};
+
+/** Fixture for Physics PhysicsQueries tests. The scene is a box around the 
+ * origin (group 1), a sphere at x = 10 (group 2), a square made of two 
+ * triangles at y = -10 (group 4) and a box at x = 20 that only collides
+ * with group 8 (group 8)
+ */
+class Physics_PhysicsQueriesTests : public ::testing::Test
+{
+protected:
+    QueryPhysicsSystem physics;
+
+    std::shared_ptr<Object> box;
+    std::shared_ptr<Object> sphere;
+    std::shared_ptr<Object> ground;
+    std::shared_ptr<Object> privateBox;
+
+    /// meshes the ground's triangles are read from
+    std::shared_ptr<Meshes> groundMeshes;
+
+    /// add a static object to the physics system
+    std::shared_ptr<Object> addObject(std::shared_ptr<CollisionShape> shape, const Point3& location,
+        short group, short mask = PhysicsQueries::ALL_GROUPS)
+    {
+        Object::Properties prop;
+        prop.collisionGroup = group;
+        prop.collisionMask = mask;
+        auto model = std::make_shared<Model>(nullptr, nullptr, shape);
+        auto object = std::make_shared<Object>(model, prop);
+        object->setLocation(location);
+        physics.addBody(*object);
+        return object;
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        physics.init();
+
+        // triangle 0 is the half of the square with x >= z, triangle 1 the half with x <= z
+        MeshBuilderPTNT mb;
+        Vector3 a(-5, -10, -5), b(5, -10, -5), c(5, -10, 5), d(-5, -10, 5);
+        mb.addVertex(a, Vector2(), Vector3(), Vector3());
+        mb.addVertex(b, Vector2(), Vector3(), Vector3());
+        mb.addVertex(c, Vector2(), Vector3(), Vector3());
+        mb.addVertex(a, Vector2(), Vector3(), Vector3());
+        mb.addVertex(c, Vector2(), Vector3(), Vector3());
+        mb.addVertex(d, Vector2(), Vector3(), Vector3());
+        groundMeshes = std::make_shared<Meshes>();
+        groundMeshes->push_back(mb.build());
+
+        box = addObject(std::make_shared<BoxCollisionShape>(2.0f, 2.0f, 2.0f), Point3(0, 0, 0), 1);
+        sphere = addObject(std::make_shared<SphereCollisionShape>(1.0f), Point3(10, 0, 0), 2);
+        ground = addObject(std::make_shared<TriangleMeshCollisionShape>(*groundMeshes), Point3(0, 0, 0), 4);
+        privateBox = addObject(std::make_shared<BoxCollisionShape>(2.0f, 2.0f, 2.0f), Point3(20, 0, 0), 8, 8);
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        physics.removeBody(*box);
+        physics.removeBody(*sphere);
+        physics.removeBody(*ground);
+        physics.removeBody(*privateBox);
+        physics.deinit();
+    }
+
+    /// test a hit's normal is close to the expected one
+    void EXPECT_NORMAL_NEAR(const Vector3& expected, const Vector3& actual)
+    {
+        EXPECT_NEAR(expected.x(), actual.x(), 0.05f);
+        EXPECT_NEAR(expected.y(), actual.y(), 0.05f);
+        EXPECT_NEAR(expected.z(), actual.z(), 0.05f);
+    }
+
+    /// test a hit's point is close to the expected one
+    void EXPECT_POINT_NEAR(const Point3& expected, const Point3& actual)
+    {
+        EXPECT_NEAR(expected.x(), actual.x(), 0.05f);
+        EXPECT_NEAR(expected.y(), actual.y(), 0.05f);
+        EXPECT_NEAR(expected.z(), actual.z(), 0.05f);
+    }
+
+    /// random coordinate within the scene
+    static Scalar randomCoordinate()
+    {
+        return (Scalar)(rand() % 6000) / 100.0f - 30.0f;
+    }
+};
+
+
+/// tests that rays report the closest object hit, where and how far along
+TEST_F(Physics_PhysicsQueriesTests, RayHits)
+{
+    PhysicsQueries queries;
+    int toBox = queries.addRay(Point3(-5, 0, 0), Point3(5, 0, 0));
+    int toSphere = queries.addRay(Point3(10, 5, 0), Point3(10, -5, 0));
+    int miss = queries.addRay(Point3(-5, 5, 0), Point3(5, 5, 0));
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(1, queries.getHitCount(toBox));
+    const PhysicsQueries::Hit& boxHit = queries.getHit(toBox);
+    EXPECT_EQ(box.get(), boxHit.object);
+    EXPECT_NEAR(0.4f, boxHit.fraction, 0.01f);
+    EXPECT_NORMAL_NEAR(Vector3(-1, 0, 0), boxHit.normal);
+    EXPECT_POINT_NEAR(Point3(-1, 0, 0), boxHit.point);
+    EXPECT_EQ(-1, boxHit.triangleIndex);
+
+    ASSERT_EQ(1, queries.getHitCount(toSphere));
+    const PhysicsQueries::Hit& sphereHit = queries.getHit(toSphere);
+    EXPECT_EQ(sphere.get(), sphereHit.object);
+    EXPECT_NEAR(0.4f, sphereHit.fraction, 0.01f);
+    EXPECT_NORMAL_NEAR(Vector3(0, 1, 0), sphereHit.normal);
+    EXPECT_EQ(-1, sphereHit.triangleIndex);
+
+    EXPECT_EQ(0, queries.getHitCount(miss));
+}
+
+/// tests that rays hitting a triangle mesh report the triangle hit
+TEST_F(Physics_PhysicsQueriesTests, RayTriangleIndex)
+{
+    PhysicsQueries queries;
+    int first = queries.addRay(Point3(3, 0, -3), Point3(3, -20, -3));
+    int second = queries.addRay(Point3(-3, 0, 3), Point3(-3, -20, 3));
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(1, queries.getHitCount(first));
+    EXPECT_EQ(ground.get(), queries.getHit(first).object);
+    EXPECT_EQ(0, queries.getHit(first).triangleIndex);
+    EXPECT_NEAR(0.5f, queries.getHit(first).fraction, 0.01f);
+    EXPECT_NORMAL_NEAR(Vector3(0, 1, 0), queries.getHit(first).normal);
+
+    ASSERT_EQ(1, queries.getHitCount(second));
+    EXPECT_EQ(ground.get(), queries.getHit(second).object);
+    EXPECT_EQ(1, queries.getHit(second).triangleIndex);
+}
+
+/// tests that sphere sweeps stop where the sphere first touches an object
+TEST_F(Physics_PhysicsQueriesTests, SphereSweepHits)
+{
+    PhysicsQueries queries;
+    int toBox = queries.addSphereSweep(Point3(-5, 0, 0), Point3(5, 0, 0), 0.5f);
+    int toGround = queries.addSphereSweep(Point3(-3, 0, 3), Point3(-3, -20, 3), 0.5f);
+    int miss = queries.addSphereSweep(Point3(-5, 2, 0), Point3(5, 2, 0), 0.5f);
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(1, queries.getHitCount(toBox));
+    const PhysicsQueries::Hit& boxHit = queries.getHit(toBox);
+    EXPECT_EQ(box.get(), boxHit.object);
+    EXPECT_NEAR(0.35f, boxHit.fraction, 0.01f);
+    EXPECT_NORMAL_NEAR(Vector3(-1, 0, 0), boxHit.normal);
+    EXPECT_EQ(-1, boxHit.triangleIndex);
+
+    ASSERT_EQ(1, queries.getHitCount(toGround));
+    const PhysicsQueries::Hit& groundHit = queries.getHit(toGround);
+    EXPECT_EQ(ground.get(), groundHit.object);
+    EXPECT_NEAR(0.475f, groundHit.fraction, 0.01f);
+    EXPECT_NORMAL_NEAR(Vector3(0, 1, 0), groundHit.normal);
+    EXPECT_EQ(1, groundHit.triangleIndex);
+
+    EXPECT_EQ(0, queries.getHitCount(miss));
+}
+
+/// tests that overlap tests report every object overlapped
+TEST_F(Physics_PhysicsQueriesTests, SphereOverlapHits)
+{
+    PhysicsQueries queries;
+    int all = queries.addSphereOverlap(Point3(0, 0, 0), 12.0f);
+    int boxSide = queries.addSphereOverlap(Point3(1.2f, 0, 0), 0.5f);
+    int none = queries.addSphereOverlap(Point3(5, 5, 5), 1.0f);
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(3, queries.getHitCount(all));
+    std::vector<Object*> found;
+    for (int i = 0; i < 3; i++)
+    {
+        found.push_back(queries.getHit(all, i).object);
+        EXPECT_EQ(0.0f, queries.getHit(all, i).fraction);
+    }
+    EXPECT_TRUE(std::find(found.begin(), found.end(), box.get()) != found.end());
+    EXPECT_TRUE(std::find(found.begin(), found.end(), sphere.get()) != found.end());
+    EXPECT_TRUE(std::find(found.begin(), found.end(), ground.get()) != found.end());
+
+    ASSERT_EQ(1, queries.getHitCount(boxSide));
+    EXPECT_EQ(box.get(), queries.getHit(boxSide).object);
+    EXPECT_NORMAL_NEAR(Vector3(1, 0, 0), queries.getHit(boxSide).normal);
+    EXPECT_EQ(-1, queries.getHit(boxSide).triangleIndex);
+
+    EXPECT_EQ(0, queries.getHitCount(none));
+}
+
+/// tests the closest point found on triangle meshes, on faces, edges and corners
+TEST_F(Physics_PhysicsQueriesTests, SphereOverlapClosestPointOnTriangle)
+{
+    PhysicsQueries queries;
+    int face = queries.addSphereOverlap(Point3(-3, -9.5f, 3), 1.0f);
+    int edge = queries.addSphereOverlap(Point3(6, -10, 0), 2.0f);
+    int otherEdge = queries.addSphereOverlap(Point3(-6, -10, 0), 2.0f);
+    int corner = queries.addSphereOverlap(Point3(6, -10, -6), 2.0f);
+    int outside = queries.addSphereOverlap(Point3(7, -10, -7), 2.0f);
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(1, queries.getHitCount(face));
+    EXPECT_EQ(ground.get(), queries.getHit(face).object);
+    EXPECT_POINT_NEAR(Point3(-3, -10, 3), queries.getHit(face).point);
+    EXPECT_NORMAL_NEAR(Vector3(0, 1, 0), queries.getHit(face).normal);
+    EXPECT_EQ(1, queries.getHit(face).triangleIndex);
+
+    ASSERT_EQ(1, queries.getHitCount(edge));
+    EXPECT_POINT_NEAR(Point3(5, -10, 0), queries.getHit(edge).point);
+    EXPECT_NORMAL_NEAR(Vector3(1, 0, 0), queries.getHit(edge).normal);
+    EXPECT_EQ(0, queries.getHit(edge).triangleIndex);
+
+    ASSERT_EQ(1, queries.getHitCount(otherEdge));
+    EXPECT_POINT_NEAR(Point3(-5, -10, 0), queries.getHit(otherEdge).point);
+    EXPECT_EQ(1, queries.getHit(otherEdge).triangleIndex);
+
+    ASSERT_EQ(1, queries.getHitCount(corner));
+    EXPECT_POINT_NEAR(Point3(5, -10, -5), queries.getHit(corner).point);
+    EXPECT_NORMAL_NEAR(Vector3(0.7071f, 0, -0.7071f), queries.getHit(corner).normal);
+    EXPECT_EQ(0, queries.getHit(corner).triangleIndex);
+
+    // the corner is sqrt(8) away, beyond the radius
+    EXPECT_EQ(0, queries.getHitCount(outside));
+}
+
+/// tests that queries skip objects outside their mask and objects whose mask excludes them
+TEST_F(Physics_PhysicsQueriesTests, GroupFiltering)
+{
+    PhysicsQueries queries;
+    int any = queries.addRay(Point3(-5, 0, 0), Point3(15, 0, 0));
+    int spheresOnly = queries.addRay(Point3(-5, 0, 0), Point3(15, 0, 0), 1, 2);
+    int groundOnly = queries.addRay(Point3(-5, 0, 0), Point3(15, 0, 0), 1, 4);
+    int notPrivate = queries.addRay(Point3(15, 0, 0), Point3(25, 0, 0), 1);
+    int isPrivate = queries.addRay(Point3(15, 0, 0), Point3(25, 0, 0), 8);
+    int sweepSpheres = queries.addSphereSweep(Point3(-5, 0, 0), Point3(15, 0, 0), 0.5f, 1, 2);
+    int overlapFiltered = queries.addSphereOverlap(Point3(0, 0, 0), 12.0f, 1, 2 | 4);
+    physics.runQueries(queries, 1);
+
+    ASSERT_EQ(1, queries.getHitCount(any));
+    EXPECT_EQ(box.get(), queries.getHit(any).object);
+    EXPECT_NEAR(0.2f, queries.getHit(any).fraction, 0.01f);
+
+    ASSERT_EQ(1, queries.getHitCount(spheresOnly));
+    EXPECT_EQ(sphere.get(), queries.getHit(spheresOnly).object);
+    EXPECT_NEAR(0.7f, queries.getHit(spheresOnly).fraction, 0.01f);
+
+    EXPECT_EQ(0, queries.getHitCount(groundOnly));
+
+    EXPECT_EQ(0, queries.getHitCount(notPrivate));
+    ASSERT_EQ(1, queries.getHitCount(isPrivate));
+    EXPECT_EQ(privateBox.get(), queries.getHit(isPrivate).object);
+
+    ASSERT_EQ(1, queries.getHitCount(sweepSpheres));
+    EXPECT_EQ(sphere.get(), queries.getHit(sweepSpheres).object);
+
+    ASSERT_EQ(2, queries.getHitCount(overlapFiltered));
+    EXPECT_NE(box.get(), queries.getHit(overlapFiltered, 0).object);
+    EXPECT_NE(box.get(), queries.getHit(overlapFiltered, 1).object);
+}
+
+/// tests that splitting a batch over threads gives the same hits, in the same order
+TEST_F(Physics_PhysicsQueriesTests, ThreadsMatchSingleThread)
+{
+    srand(7);
+    PhysicsQueries queries;
+    for (int i = 0; i < 1000; i++)
+    {
+        Point3 start(randomCoordinate(), randomCoordinate(), randomCoordinate());
+        Point3 end(randomCoordinate(), randomCoordinate(), randomCoordinate());
+        if (i % 3 == 0)
+            queries.addRay(start, end);
+        else if (i % 3 == 1)
+            queries.addSphereSweep(start, end, 1.0f);
+        else
+            queries.addSphereOverlap(start, 8.0f);
+    }
+
+    physics.runQueries(queries, 1);
+    std::vector<PhysicsQueries::Hit> expected;
+    std::vector<int> expectedCounts;
+    int hitCount = 0;
+    for (int i = 0; i < queries.getQueryCount(); i++)
+    {
+        expectedCounts.push_back(queries.getHitCount(i));
+        for (int h = 0; h < queries.getHitCount(i); h++)
+            expected.push_back(queries.getHit(i, h));
+        hitCount += queries.getHitCount(i);
+    }
+    ASSERT_GT(hitCount, 0);
+
+    physics.runQueries(queries, 4);
+    int next = 0;
+    for (int i = 0; i < queries.getQueryCount(); i++)
+    {
+        ASSERT_EQ(expectedCounts[i], queries.getHitCount(i));
+        for (int h = 0; h < queries.getHitCount(i); h++, next++)
+        {
+            const PhysicsQueries::Hit& hit = queries.getHit(i, h);
+            EXPECT_EQ(expected[next].object, hit.object);
+            EXPECT_EQ(expected[next].fraction, hit.fraction);
+            EXPECT_EQ(expected[next].triangleIndex, hit.triangleIndex);
+        }
+    }
+
+    // the helper threads are kept for the next batch
+    physics.runQueries(queries, 4);
+    EXPECT_EQ(expectedCounts[0], queries.getHitCount(0));
+}
@@ -0,0 +1,202 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ResourceIndex tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ResourceIndex class from 3DMagic library
+#include <Resources/ResourceIndex.h>
+
+#include <fstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#	include <direct.h>
+#else
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace Magic3D;
+
+/// directory the test files are written to
+#define TEST_DIR "ResourceIndexTests.tmp"
+
+/// copy of ResourceIndex::INVALID_PATH that can be bound to references
+static const ResourceIndex::PathId INVALID = ResourceIndex::INVALID_PATH;
+
+class Resources_ResourceIndexTests : public ::testing::Test
+{
+protected:
+	static void makeDir(const std::string& dir)
+	{
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0755);
+#endif
+	}
+
+	static void removeDir(const std::string& dir)
+	{
+#ifdef _WIN32
+		_rmdir(dir.c_str());
+#else
+		rmdir(dir.c_str());
+#endif
+	}
+
+	static void writeFile(const std::string& path)
+	{
+		std::ofstream file(path.c_str(), std::ios::binary);
+		file << path;
+	}
+
+	static void SetUpTestCase()
+	{
+		makeDir(TEST_DIR);
+		makeDir(TEST_DIR "/first");
+		makeDir(TEST_DIR "/first/a");
+		makeDir(TEST_DIR "/second");
+		writeFile(TEST_DIR "/outside.txt");
+		writeFile(TEST_DIR "/first/a/b.txt");
+		writeFile(TEST_DIR "/first/shared.txt");
+		writeFile(TEST_DIR "/second/shared.txt");
+		writeFile(TEST_DIR "/second/c.txt");
+	}
+
+	static void TearDownTestCase()
+	{
+		remove(TEST_DIR "/outside.txt");
+		remove(TEST_DIR "/first/a/b.txt");
+		remove(TEST_DIR "/first/shared.txt");
+		remove(TEST_DIR "/second/shared.txt");
+		remove(TEST_DIR "/second/c.txt");
+		removeDir(TEST_DIR "/first/a");
+		removeDir(TEST_DIR "/first");
+		removeDir(TEST_DIR "/second");
+		removeDir(TEST_DIR);
+	}
+
+	ResourceIndex index;
+
+	virtual void SetUp()
+	{
+		this->index.addDirectory(TEST_DIR "/first/");
+		this->index.addDirectory(TEST_DIR "/second");
+	}
+
+	virtual void TearDown()
+	{
+		// no teardown
+	}
+};
+
+/// tests that every file under the directories is indexed
+TEST_F(Resources_ResourceIndexTests, IndexesFiles)
+{
+	EXPECT_EQ(3, index.getFileCount());
+	EXPECT_TRUE(index.exists(index.find("a/b.txt")));
+	EXPECT_TRUE(index.exists(index.find("c.txt")));
+	EXPECT_EQ(INVALID, index.find("missing.txt"));
+	EXPECT_EQ(INVALID, index.find("a"));
+}
+
+/// tests that separators, empty and "." parts don't change the path found
+TEST_F(Resources_ResourceIndexTests, NormalizesSeparators)
+{
+	ResourceIndex::PathId id = index.find("a/b.txt");
+	ASSERT_NE(INVALID, id);
+	EXPECT_EQ(id, index.find("a\\b.txt"));
+	EXPECT_EQ(id, index.find("a//b.txt"));
+	EXPECT_EQ(id, index.find("/a/b.txt"));
+	EXPECT_EQ(id, index.find("./a/./b.txt"));
+	EXPECT_EQ(id, index.find(".\\a\\\\b.txt"));
+}
+
+/// tests that ".." removes the part before it
+TEST_F(Resources_ResourceIndexTests, DotDotRemovesPart)
+{
+	ResourceIndex::PathId id = index.find("a/b.txt");
+	EXPECT_EQ(id, index.find("a/x/../b.txt"));
+	EXPECT_EQ(id, index.find("x/../a/b.txt"));
+	EXPECT_EQ(id, index.find("x/y/../../a/b.txt"));
+	EXPECT_EQ(index.find("c.txt"), index.find("a/../c.txt"));
+}
+
+/// tests that ".." can't lead out of the resource directories
+TEST_F(Resources_ResourceIndexTests, DotDotStaysInDirectories)
+{
+	EXPECT_EQ(INVALID, index.find("../a/b.txt"));
+	EXPECT_EQ(INVALID, index.find("../../a/b.txt"));
+	EXPECT_EQ(INVALID, index.find("a/../../a/b.txt"));
+	EXPECT_EQ(INVALID, index.find("../first/a/b.txt"));
+	EXPECT_EQ(INVALID, index.probe("../outside.txt"));
+	EXPECT_EQ(INVALID, index.probe("x/../../outside.txt"));
+}
+
+/// tests that directories added first take precedence
+TEST_F(Resources_ResourceIndexTests, FullPathPrecedence)
+{
+	EXPECT_EQ(TEST_DIR "/first/a/b.txt", index.getFullPath(index.find("a/b.txt")));
+	EXPECT_EQ(TEST_DIR "/first/shared.txt", index.getFullPath(index.find("shared.txt")));
+	EXPECT_EQ(TEST_DIR "/second/c.txt", index.getFullPath(index.find("c.txt")));
+	EXPECT_EQ("", index.getFullPath(ResourceIndex::INVALID_PATH));
+}
+
+/// tests that files added after indexing are found by probing
+TEST_F(Resources_ResourceIndexTests, ProbeFindsNewFiles)
+{
+	writeFile(TEST_DIR "/second/new.txt");
+
+	ResourceIndex::PathId id = index.probe("./new.txt");
+	remove(TEST_DIR "/second/new.txt");
+
+	ASSERT_NE(INVALID, id);
+	EXPECT_EQ(id, index.find("new.txt"));
+	EXPECT_EQ(TEST_DIR "/second/new.txt", index.getFullPath(id));
+	EXPECT_EQ(4, index.getFileCount());
+
+	EXPECT_EQ(INVALID, index.probe("missing.txt"));
+	EXPECT_EQ(INVALID, index.probe("a"));
+}
+
+/// tests that ids stay the same across rescans
+TEST_F(Resources_ResourceIndexTests, RescanKeepsIds)
+{
+	ResourceIndex::PathId id = index.find("a/b.txt");
+	int paths = index.getPathCount();
+	index.rescan();
+	EXPECT_EQ(id, index.find("a/b.txt"));
+	EXPECT_EQ(paths, index.getPathCount());
+	EXPECT_EQ(3, index.getFileCount());
+}
+
+#ifdef _WIN32
+/// tests that paths are case insensitive, like the file names
+TEST_F(Resources_ResourceIndexTests, FoldsCase)
+{
+	ResourceIndex::PathId id = index.find("a/b.txt");
+	EXPECT_EQ(id, index.find("A/B.TXT"));
+	EXPECT_EQ(id, index.find("a\\B.txt"));
+}
+#endif
@@ -0,0 +1,261 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ResourceManager cache tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ResourceManager class from 3DMagic library
+#include <Resources/ResourceManager.h>
+
+#include <fstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#	include <direct.h>
+#else
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace Magic3D;
+
+/// directory the test resources are written to
+#define TEST_DIR "ResourceManagerTests.tmp"
+
+/// number of test resources
+#define TEST_FILE_COUNT 4
+
+/// length of the text in each test resource
+#define TEST_TEXT_LENGTH 99
+
+class Resources_ResourceManagerTests : public ::testing::Test
+{
+protected:
+	typedef ResourceManager::CacheStats CacheStats;
+
+	/// memory each test resource is counted as
+	static const size_t SIZE;
+
+	static std::string fileName(int i)
+	{
+		return std::string(1, (char)('a' + i)) + ".txt";
+	}
+
+	static void SetUpTestCase()
+	{
+#ifdef _WIN32
+		_mkdir(TEST_DIR);
+#else
+		mkdir(TEST_DIR, 0755);
+#endif
+		for (int i = 0; i < TEST_FILE_COUNT; i++)
+		{
+			std::ofstream file(std::string(TEST_DIR "/") + fileName(i), std::ios::binary);
+			file << std::string(TEST_TEXT_LENGTH, (char)('a' + i));
+		}
+	}
+
+	static void TearDownTestCase()
+	{
+		for (int i = 0; i < TEST_FILE_COUNT; i++)
+			remove((std::string(TEST_DIR "/") + fileName(i)).c_str());
+#ifdef _WIN32
+		_rmdir(TEST_DIR);
+#else
+		rmdir(TEST_DIR);
+#endif
+	}
+
+	ResourceManager rm;
+
+	virtual void SetUp()
+	{
+		this->rm.addResourceDir(TEST_DIR);
+	}
+
+	virtual void TearDown()
+	{
+		// no teardown
+	}
+
+	/// load a resource without keeping it
+	void load(const char* path)
+	{
+		this->rm.get<TextResource>(path);
+	}
+};
+
+const size_t Resources_ResourceManagerTests::SIZE = sizeof(TextResource) + TEST_TEXT_LENGTH + 1;
+
+/// tests that a resource is counted as its text plus the resource itself
+TEST_F(Resources_ResourceManagerTests, TextSize)
+{
+	std::shared_ptr<TextResource> text = rm.get<TextResource>("a.txt");
+	EXPECT_EQ(std::string(TEST_TEXT_LENGTH, 'a'), text->getText());
+
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(1, stats.misses);
+	EXPECT_EQ(0, stats.hits);
+	EXPECT_EQ(1, stats.entries);
+	EXPECT_EQ(SIZE, stats.bytes);
+}
+
+/// tests that the least recently used resources are evicted once over budget
+TEST_F(Resources_ResourceManagerTests, BudgetEvictsLeastRecentlyUsed)
+{
+	rm.setCacheBudget<TextResource>(2 * SIZE);
+	load("a.txt");
+	load("b.txt");
+	load("c.txt");
+
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(3, stats.misses);
+	EXPECT_EQ(1, stats.evictions);
+	EXPECT_EQ(2, stats.entries);
+	EXPECT_EQ(2 * SIZE, stats.bytes);
+
+	// b is kept and becomes the most recently used, a has to be loaded again
+	load("b.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+	load("a.txt");
+	EXPECT_EQ(4, rm.getCacheStats<TextResource>().misses);
+
+	// loading a evicted c, not b
+	load("b.txt");
+	EXPECT_EQ(2, rm.getCacheStats<TextResource>().hits);
+	load("c.txt");
+	stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(5, stats.misses);
+	EXPECT_EQ(3, stats.evictions);
+	EXPECT_LE(stats.bytes, stats.budget);
+}
+
+/// tests that resources in use are shared even when the cache can't hold them
+TEST_F(Resources_ResourceManagerTests, ZeroBudgetSharesResourcesInUse)
+{
+	rm.setCacheBudget<TextResource>(0);
+	std::shared_ptr<TextResource> text = rm.get<TextResource>("a.txt");
+	EXPECT_EQ(0, rm.getCacheStats<TextResource>().entries);
+
+	EXPECT_EQ(text, rm.get<TextResource>("a.txt"));
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+
+	text = nullptr;
+	load("a.txt");
+	EXPECT_EQ(2, rm.getCacheStats<TextResource>().misses);
+}
+
+/// tests that pinned resources stay loaded and don't count towards the budget
+TEST_F(Resources_ResourceManagerTests, PinnedResourcesAreNotEvicted)
+{
+	rm.setCacheBudget<TextResource>(SIZE);
+	rm.pin<TextResource>("a.txt");
+	load("b.txt");
+	load("c.txt");
+
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(1, stats.pinned);
+	EXPECT_EQ(2, stats.entries);
+	EXPECT_EQ(2 * SIZE, stats.bytes);
+	EXPECT_EQ(1, stats.evictions);
+
+	load("a.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+
+	// pinning again doesn't count the resource twice
+	rm.pin<TextResource>("a.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().pinned);
+	EXPECT_EQ(2 * SIZE, rm.getCacheStats<TextResource>().bytes);
+}
+
+/// tests that an unpinned resource becomes the most recently used and evictable again
+TEST_F(Resources_ResourceManagerTests, UnpinMakesEvictable)
+{
+	rm.setCacheBudget<TextResource>(SIZE);
+	rm.pin<TextResource>("a.txt");
+	load("b.txt");
+
+	// a is now the most recently used, so b is evicted
+	rm.unpin<TextResource>("a.txt");
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(0, stats.pinned);
+	EXPECT_EQ(1, stats.entries);
+	EXPECT_EQ(SIZE, stats.bytes);
+	EXPECT_EQ(1, stats.evictions);
+
+	load("a.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+	load("c.txt");
+	load("a.txt");
+	EXPECT_EQ(4, rm.getCacheStats<TextResource>().misses);
+}
+
+/// tests that lowering the budget evicts right away
+TEST_F(Resources_ResourceManagerTests, LoweringBudgetEvicts)
+{
+	load("a.txt");
+	load("b.txt");
+	load("c.txt");
+	EXPECT_EQ(3, rm.getCacheStats<TextResource>().entries);
+
+	rm.setCacheBudget<TextResource>(SIZE);
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(1, stats.entries);
+	EXPECT_EQ(2, stats.evictions);
+	EXPECT_EQ(SIZE, stats.budget);
+
+	load("c.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+}
+
+/// tests that clearing the cache keeps only the pinned resources
+TEST_F(Resources_ResourceManagerTests, ClearCacheKeepsPinned)
+{
+	rm.pin<TextResource>("a.txt");
+	load("b.txt");
+	load("c.txt");
+
+	rm.clearCache();
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(1, stats.entries);
+	EXPECT_EQ(1, stats.pinned);
+	EXPECT_EQ(SIZE, stats.bytes);
+
+	load("a.txt");
+	EXPECT_EQ(1, rm.getCacheStats<TextResource>().hits);
+	load("b.txt");
+	EXPECT_EQ(4, rm.getCacheStats<TextResource>().misses);
+}
+
+/// tests that getting a resource that's being loaded asynchronously waits for that load
+TEST_F(Resources_ResourceManagerTests, GetJoinsPendingLoad)
+{
+	std::shared_future<std::shared_ptr<TextResource>> future = rm.getAsync<TextResource>("a.txt");
+	std::shared_ptr<TextResource> text = rm.get<TextResource>("a.txt");
+
+	EXPECT_EQ(text, future.get());
+	EXPECT_EQ(0, rm.getPendingLoadCount());
+	CacheStats stats = rm.getCacheStats<TextResource>();
+	EXPECT_EQ(1, stats.misses);
+	EXPECT_EQ(1, stats.hits);
+	EXPECT_EQ(1, stats.entries);
+}
@@ -0,0 +1,291 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Shaders ProgramCache tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ProgramCache class from 3DMagic library
+#include <Shaders/ProgramCache.h>
+#include <Shaders/GpuProgram.h>
+#include <Exceptions/ShaderCompileException.h>
+#include <Graphics/GraphicsSystem.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#ifdef _WIN32
+#	include <direct.h>
+#else
+#	include <unistd.h>
+#endif
+
+using namespace Magic3D;
+
+/// directory the test binaries are cached in
+#define TEST_DIR "ProgramCacheTests.tmp"
+
+/// skip the rest of a test when the driver can't save and load program binaries
+#ifdef GTEST_SKIP
+#	define SKIP_UNLESS_SUPPORTED() if (!this->cache->isSupported()) GTEST_SKIP() << "program binaries not supported"
+#else
+#	define SKIP_UNLESS_SUPPORTED() if (!this->cache->isSupported()) return
+#endif
+
+static const char* VERTEX_SOURCE =
+    "#version 140\n"
+    "in vec4 inputPosition;\n"
+    "void main() { gl_Position = inputPosition; }\n";
+
+static const char* FRAGMENT_SOURCE =
+    "#version 140\n"
+    "uniform vec4 color;\n"
+    "out vec4 outputColor;\n"
+    "void main() { outputColor = color; }\n";
+
+
+/** Fixture for Shaders ProgramCache tests
+ */
+class Shaders_ProgramCacheTests : public ::testing::Test
+{
+protected:
+    /// programs need a gl context, shared by all the tests
+    static GraphicsSystem* graphics;
+
+    /// setup for all tests
+    static void SetUpTestCase()
+    {
+        graphics = new GraphicsSystem();
+        graphics->init();
+    }
+
+    /// teardown for all tests
+    static void TearDownTestCase()
+    {
+        graphics->deinit();
+        delete graphics;
+        graphics = NULL;
+    }
+
+    std::shared_ptr<ProgramCache> cache;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        this->cache = std::make_shared<ProgramCache>(TEST_DIR);
+    }
+    
+    /// teardown method, clearing out the binary the tests cache
+    virtual void TearDown()
+    {
+        remove(this->cachePath().c_str());
+#ifdef _WIN32
+        _rmdir(TEST_DIR);
+#else
+        rmdir(TEST_DIR);
+#endif
+    }
+
+    /// get the attribute bindings the test program is linked with
+    static std::vector<std::pair<std::string, int>> bindings()
+    {
+        std::vector<std::pair<std::string, int>> attributes;
+        attributes.push_back(std::make_pair(std::string("inputPosition"), 
+            GpuProgram::getAttributeLocation(GpuProgram::VERTEX)));
+        return attributes;
+    }
+
+    /// get the file the test program's binary is cached in
+    std::string cachePath()
+    {
+        char name[32];
+        sprintf(name, "%016llx.bin", (unsigned long long)this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, bindings()));
+        return std::string(TEST_DIR "/") + name;
+    }
+
+    /// make a program from the given sources, with its attributes bound
+    static std::shared_ptr<GpuProgram> makeProgram(const char* vertexSource = VERTEX_SOURCE, 
+        const char* fragmentSource = FRAGMENT_SOURCE)
+    {
+        auto program = std::make_shared<GpuProgram>(
+            std::make_shared<Shader>(vertexSource, Shader::Type::VERTEX),
+            std::make_shared<Shader>(fragmentSource, Shader::Type::FRAGMENT));
+        program->bindAttrib("inputPosition", GpuProgram::VERTEX);
+        return program;
+    }
+
+    /// overwrite part of a cached binary
+    void writeAt(long offset, const std::string& bytes)
+    {
+        FILE* file = fopen(this->cachePath().c_str(), "r+b");
+        ASSERT_TRUE(file != NULL);
+        fseek(file, offset, SEEK_SET);
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+    }
+
+    /// get the size (in bytes) of the cached binary, -1 if there is none
+    long cacheFileSize()
+    {
+        FILE* file = fopen(this->cachePath().c_str(), "rb");
+        if (file == NULL)
+            return -1;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fclose(file);
+        return size;
+    }
+};
+
+GraphicsSystem* Shaders_ProgramCacheTests::graphics = NULL;
+
+
+/// tests that the key changes with either source or any attribute binding
+TEST_F(Shaders_ProgramCacheTests, KeyChanges)
+{
+    std::vector<std::pair<std::string, int>> attributes = bindings();
+    ProgramCache::Key key = this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, attributes);
+
+    EXPECT_EQ(key, this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, attributes));
+    EXPECT_NE(key, this->cache->getKey(std::string(VERTEX_SOURCE) + " ", FRAGMENT_SOURCE, attributes));
+    EXPECT_NE(key, this->cache->getKey(VERTEX_SOURCE, std::string(FRAGMENT_SOURCE) + " ", attributes));
+
+    // the sources can't run into each other
+    std::string both = std::string(VERTEX_SOURCE) + FRAGMENT_SOURCE;
+    EXPECT_NE(this->cache->getKey(both, "", attributes), this->cache->getKey("", both, attributes));
+
+    std::vector<std::pair<std::string, int>> moved = attributes;
+    moved[0].second = GpuProgram::getAttributeLocation(GpuProgram::NORMAL);
+    EXPECT_NE(key, this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, moved));
+
+    std::vector<std::pair<std::string, int>> renamed = attributes;
+    renamed[0].first = "inputNormal";
+    EXPECT_NE(key, this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, renamed));
+
+    std::vector<std::pair<std::string, int>> added = attributes;
+    added.push_back(std::make_pair(std::string("inputNormal"), GpuProgram::getAttributeLocation(GpuProgram::NORMAL)));
+    EXPECT_NE(key, this->cache->getKey(VERTEX_SOURCE, FRAGMENT_SOURCE, added));
+}
+
+/// tests that a cold link saves the binary and the next link loads it
+TEST_F(Shaders_ProgramCacheTests, ColdLinkSavesWarmLinkLoads)
+{
+    SKIP_UNLESS_SUPPORTED();
+
+    auto cold = makeProgram();
+    cold->link(this->cache);
+    EXPECT_FALSE(cold->isFromCache());
+    EXPECT_EQ(1, this->cache->getStats().misses);
+    EXPECT_EQ(1, this->cache->getStats().saved);
+    EXPECT_EQ(0, this->cache->getStats().hits);
+
+    auto warm = makeProgram();
+    warm->link(this->cache);
+    EXPECT_TRUE(warm->isFromCache());
+    EXPECT_EQ(1, this->cache->getStats().hits);
+    EXPECT_EQ(1, this->cache->getStats().saved);
+    EXPECT_EQ(0, this->cache->getStats().rejected);
+
+    // the loaded program is usable
+    EXPECT_NE(-1, (int)warm->getUniformHandle("color"));
+    warm->use();
+    EXPECT_EQ((GLenum)GL_NO_ERROR, glGetError());
+}
+
+/// tests that a cut short binary is a miss, and is relinked and saved again
+TEST_F(Shaders_ProgramCacheTests, TruncatedBinaryRelinked)
+{
+    SKIP_UNLESS_SUPPORTED();
+
+    makeProgram()->link(this->cache);
+    long size = this->cacheFileSize();
+    ASSERT_GT(size, 0);
+
+    // keep just the start of the header
+    FILE* file = fopen(this->cachePath().c_str(), "wb");
+    ASSERT_TRUE(file != NULL);
+    fwrite("M3DP", 1, 4, file);
+    fclose(file);
+
+    auto relinked = makeProgram();
+    relinked->link(this->cache);
+    EXPECT_FALSE(relinked->isFromCache());
+    EXPECT_EQ(2, this->cache->getStats().misses);
+    EXPECT_EQ(2, this->cache->getStats().saved);
+    EXPECT_EQ(size, this->cacheFileSize());
+
+    auto warm = makeProgram();
+    warm->link(this->cache);
+    EXPECT_TRUE(warm->isFromCache());
+    EXPECT_EQ(1, this->cache->getStats().hits);
+}
+
+/// tests that a garbled binary is a miss or rejected, and is relinked and saved again
+TEST_F(Shaders_ProgramCacheTests, GarbageBinaryRelinked)
+{
+    SKIP_UNLESS_SUPPORTED();
+
+    makeProgram()->link(this->cache);
+    long size = this->cacheFileSize();
+    ASSERT_GT(size, 64);
+
+    // garble everything after the first 32 bytes, header and binary alike
+    this->writeAt(32, std::string(size - 32, '\x5a'));
+
+    auto relinked = makeProgram();
+    relinked->link(this->cache);
+    EXPECT_FALSE(relinked->isFromCache());
+    EXPECT_EQ(0, this->cache->getStats().hits);
+    EXPECT_EQ(2, this->cache->getStats().misses + this->cache->getStats().rejected);
+    EXPECT_EQ(2, this->cache->getStats().saved);
+    EXPECT_NE(-1, (int)relinked->getUniformHandle("color"));
+
+    auto warm = makeProgram();
+    warm->link(this->cache);
+    EXPECT_TRUE(warm->isFromCache());
+    EXPECT_EQ(1, this->cache->getStats().hits);
+}
+
+/// tests that a shader that fails to compile reports its log when the link finishes, and isn't cached
+TEST_F(Shaders_ProgramCacheTests, BrokenShaderReportsCompileLog)
+{
+    auto broken = makeProgram(
+        "#version 140\n"
+        "in vec4 inputPosition;\n"
+        "void main() { gl_Position = undefinedThing; }\n");
+
+    broken->startLink(this->cache);
+    try
+    {
+        broken->finishLink();
+        FAIL() << "finishLink should have thrown";
+    }
+    catch (ShaderCompileException& e)
+    {
+        std::string message = e.what();
+        EXPECT_NE(std::string::npos, message.find("failed to compile")) << message;
+        EXPECT_NE(std::string::npos, message.find("undefinedThing")) << message;
+    }
+    EXPECT_EQ(0, this->cache->getStats().saved);
+    EXPECT_EQ(0, this->cache->getStats().hits);
+}
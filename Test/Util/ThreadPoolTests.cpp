@@ -0,0 +1,126 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ThreadPool tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ThreadPool class from 3DMagic library
+#include <Util/ThreadPool.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+using namespace Magic3D;
+
+
+/** Fixture for Util ThreadPool tests
+ */
+class Util_ThreadPoolTests : public ::testing::Test
+{
+protected:
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// wait for a flag to be set, giving up after a few seconds
+    static bool waitFor(const std::atomic<bool>& flag)
+    {
+        for (int i = 0; i < 5000 && !flag; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return flag;
+    }
+};
+
+
+/// tests that the pool always has at least one worker
+TEST_F(Util_ThreadPoolTests, ThreadCount)
+{
+    ThreadPool pool;
+    ASSERT_GE(pool.getThreadCount(), 1);
+
+    ThreadPool three(3);
+    ASSERT_EQ(3, three.getThreadCount());
+}
+
+/// tests that every submitted task runs, in order on a single worker
+TEST_F(Util_ThreadPoolTests, RunsTasksInOrder)
+{
+    std::vector<int> order;
+    std::atomic<bool> done(false);
+    {
+        ThreadPool pool(1);
+        for (int i = 0; i < 100; i++)
+            pool.submit([&order, i]() { order.push_back(i); });
+        pool.submit([&done]() { done = true; });
+        ASSERT_TRUE(waitFor(done));
+    }
+
+    ASSERT_EQ(100u, order.size());
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(i, order[i]);
+}
+
+/// tests that an idle pool shuts down without waiting for work
+TEST_F(Util_ThreadPoolTests, IdleShutdown)
+{
+    ThreadPool* pool = new ThreadPool(4);
+    delete pool;
+}
+
+/// tests that shutting down waits for running tasks and drops queued ones
+TEST_F(Util_ThreadPoolTests, ShutdownDropsQueuedTasks)
+{
+    std::atomic<bool> started(false), release(false), finished(false), destroyed(false);
+    std::atomic<int> queuedRan(0);
+
+    ThreadPool* pool = new ThreadPool(1);
+    pool->submit([&]() {
+        started = true;
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        finished = true;
+    });
+    for (int i = 0; i < 10; i++)
+        pool->submit([&queuedRan]() { queuedRan++; });
+    ASSERT_TRUE(waitFor(started));
+    ASSERT_EQ(10, pool->getQueuedCount());
+
+    // the destructor blocks on the running task
+    std::thread shutdown([&]() {
+        delete pool;
+        destroyed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(destroyed);
+
+    release = true;
+    shutdown.join();
+    ASSERT_TRUE(finished);
+    ASSERT_EQ(0, queuedRan);
+}
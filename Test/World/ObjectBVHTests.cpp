@@ -0,0 +1,187 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains World ObjectBVH tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+// include ObjectBVH class from 3DMagic library
+#include <World/ObjectBVH.h>
+#include <stdlib.h>
+#include <algorithm>
+using namespace Magic3D;
+
+
+/** Fixture for World ObjectBVH tests
+ */
+class World_ObjectBVHTests : public ::testing::Test
+{
+protected:
+    ObjectBVH bvh;
+    ViewFrustum frustum;
+
+    /// stand ins for objects, the hierarchy only uses their addresses
+    static const int OBJECT_COUNT = 1000;
+    char objects[OBJECT_COUNT];
+
+    /// bounds of each object, to cull by brute force
+    SphereArray spheres;
+
+    /// whether each object is in the hierarchy
+    std::vector<bool> present;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        frustum.setCamProperties(60.0f, 4.0f / 3.0f, 1.0f, 100.0f);
+        frustum.setPosition(Position(1.0f, 2.0f, 3.0f));
+
+        srand(99);
+        for (int i = 0; i < OBJECT_COUNT; i++)
+        {
+            Scalar x, y, z, radius;
+            randomSphere(x, y, z, radius);
+            spheres.add(x, y, z, radius);
+            bvh.add(object(i), NULL, Point3(x, y, z), radius);
+        }
+        present.assign(OBJECT_COUNT, true);
+    }
+    
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// get a random number in a range
+    static Scalar random(Scalar min, Scalar max)
+    {
+        return min + (max - min) * (Scalar)rand() / (Scalar)RAND_MAX;
+    }
+
+    /** get a random sphere around the frustum. Spheres almost touching a plane
+     * are skipped, as batch culling sums the plane distance in a different
+     * order and may round the other way
+     */
+    void randomSphere(Scalar& x, Scalar& y, Scalar& z, Scalar& radius)
+    {
+        for (;;)
+        {
+            x = random(-150, 150);
+            y = random(-150, 150);
+            z = random(-150, 150);
+            radius = random(0, 8);
+            unsigned int smaller = ViewFrustum::ALL_PLANES, larger = ViewFrustum::ALL_PLANES;
+            if ((frustum.sphereTest(x, y, z, radius - 0.01f, smaller) == ViewFrustum::OUTSIDE) ==
+                (frustum.sphereTest(x, y, z, radius + 0.01f, larger) == ViewFrustum::OUTSIDE))
+                return;
+        }
+    }
+
+    /// get the stand in for an object
+    Object* object(int i)
+    {
+        return (Object*)&objects[i];
+    }
+
+    /// check that culling the hierarchy finds the same objects as testing every one
+    void ASSERT_CULL_MATCHES()
+    {
+        std::vector<const ObjectBVH::Item*> visible;
+        bvh.cull(frustum, visible);
+
+        std::vector<Object*> actual, expected;
+        for (const ObjectBVH::Item* item : visible)
+            actual.push_back(item->object);
+        for (int i = 0; i < OBJECT_COUNT; i++)
+        {
+            unsigned int planes = ViewFrustum::ALL_PLANES;
+            if (present[i] && frustum.sphereTest(spheres.x[i], spheres.y[i], spheres.z[i], 
+                spheres.radius[i], planes) != ViewFrustum::OUTSIDE)
+                expected.push_back(object(i));
+        }
+        std::sort(actual.begin(), actual.end());
+        std::sort(expected.begin(), expected.end());
+
+        ASSERT_FALSE(expected.empty());
+        ASSERT_EQ(expected, actual);
+    }
+};
+
+
+/// tests that culling matches brute force, without testing every node
+TEST_F(World_ObjectBVHTests, CullMatchesBruteForce)
+{
+    ASSERT_CULL_MATCHES();
+    ASSERT_EQ((unsigned int)OBJECT_COUNT, bvh.size());
+    ASSERT_LT(bvh.getNodesTested(), (int)bvh.getNodeCount());
+
+    // leaves hold at most MAX_LEAF_ITEMS, so there are at least this many leaves
+    ASSERT_GE(bvh.getNodeCount(), (unsigned int)(OBJECT_COUNT / ObjectBVH::MAX_LEAF_ITEMS));
+}
+
+/// tests that culling matches brute force after objects move and the tree is refit
+TEST_F(World_ObjectBVHTests, RefitMatchesBruteForce)
+{
+    ASSERT_CULL_MATCHES();
+    unsigned int nodeCount = bvh.getNodeCount();
+
+    for (int i = 0; i < OBJECT_COUNT; i += 3)
+    {
+        Scalar x, y, z, radius;
+        randomSphere(x, y, z, radius);
+        spheres.set(i, x, y, z, radius);
+        bvh.updateBounds(object(i), Point3(x, y, z), radius);
+    }
+    ASSERT_CULL_MATCHES();
+
+    // an explicit refit keeps the same tree
+    bvh.refit();
+    ASSERT_EQ(nodeCount, bvh.getNodeCount());
+    ASSERT_CULL_MATCHES();
+}
+
+/// tests that culling matches brute force after objects are removed and added
+TEST_F(World_ObjectBVHTests, RebuildMatchesBruteForce)
+{
+    ASSERT_CULL_MATCHES();
+
+    for (int i = 0; i < OBJECT_COUNT; i += 2)
+    {
+        ASSERT_TRUE(bvh.remove(object(i)));
+        present[i] = false;
+    }
+    ASSERT_FALSE(bvh.remove(object(0)));
+    ASSERT_EQ((unsigned int)OBJECT_COUNT / 2, bvh.size());
+    ASSERT_CULL_MATCHES();
+
+    for (int i = 0; i < OBJECT_COUNT; i += 4)
+    {
+        bvh.add(object(i), NULL, Point3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]);
+        present[i] = true;
+    }
+    ASSERT_CULL_MATCHES();
+
+    bvh.clear();
+    std::vector<const ObjectBVH::Item*> visible;
+    bvh.cull(frustum, visible);
+    ASSERT_TRUE(visible.empty());
+}
@@ -0,0 +1,129 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times normal and tangent generation on a synthetic 1M triangle mesh,
+ * comparing the old string keyed position lookup against the spatial hash
+ */
+
+#include <Graphics/MeshBuilder.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+
+/// quads along each side of the grid, two triangles each
+#define GRID_WIDTH 1000
+#define GRID_HEIGHT 500
+
+/// build a rolling terrain grid with unindexed triangles
+static void buildGrid(MeshBuilderPTNT& mb)
+{
+    mb.reset(GRID_WIDTH * GRID_HEIGHT * 6);
+    for (int x = 0; x < GRID_WIDTH; x++)
+    {
+        for (int y = 0; y < GRID_HEIGHT; y++)
+        {
+            Vector3 corners[4];
+            Vector2 texCoords[4];
+            for (int i = 0; i < 4; i++)
+            {
+                float px = float(x + (i & 1));
+                float py = float(y + (i >> 1));
+                corners[i] = Vector3(px, sin(px * 0.1f) * cos(py * 0.1f) * 4.0f, py);
+                texCoords[i] = Vector2(px / 16.0f, py / 16.0f);
+            }
+
+            static const int order[] = { 0, 2, 1, 1, 2, 3 };
+            for (int i : order)
+                mb.addVertex(corners[i], texCoords[i], Vector3(), Vector3());
+        }
+    }
+}
+
+/// the string keyed normal generation MeshBuilder used before the spatial hash
+static void stringKeyedNormals(MeshBuilderPTNT& mb)
+{
+    std::unordered_map<std::string, Vector3> map;
+
+    std::stringstream ss;
+    ss << std::setprecision(2);
+
+    for (unsigned int i = 0; i < mb.vertexCount(); i += 3)
+    {
+        Vector4 points[] = {
+            mb.getVertex(i).position(),
+            mb.getVertex(i + 1).position(),
+            mb.getVertex(i + 2).position()
+        };
+        Vector3 faceNormal = Triangle(points[0], points[1], points[2]).normal;
+
+        for (Vector4 point : points)
+        {
+            ss.str("");
+            ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
+            map[ss.str()] = map[ss.str()] + faceNormal;
+        }
+    }
+
+    for (unsigned int i = 0; i < mb.vertexCount(); i++)
+    {
+        Vector4 point = mb.getVertex(i).position();
+        ss.str("");
+        ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
+        mb.getVertex(i).normal(map[ss.str()].normalize());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    MeshBuilderPTNT mb;
+    buildGrid(mb);
+    printf("%d triangles, %d vertices\n", mb.vertexCount() / 3, mb.vertexCount());
+
+    StopWatch timer;
+    stringKeyedNormals(mb);
+    printf("string keyed normals:      %8.3f s\n", timer.getElapsedTime());
+
+    timer.reset();
+    mb.calculateNormals();
+    printf("area weighted normals:     %8.3f s\n", timer.getElapsedTime());
+
+    timer.reset();
+    mb.calculateNormals(MeshBuilderPTNT::ANGLE_WEIGHTED);
+    printf("angle weighted normals:    %8.3f s\n", timer.getElapsedTime());
+
+    timer.reset();
+    mb.calculateTangents();
+    printf("position averaged tangents:%8.3f s\n", timer.getElapsedTime());
+
+    timer.reset();
+    mb.calculateTangents(MeshBuilderPTNT::SPLIT_AT_SEAMS);
+    printf("seam split tangents:       %8.3f s\n", timer.getElapsedTime());
+
+    timer.reset();
+    mb.calculateTangents(MeshBuilderPTNT::MIKKTSPACE);
+    printf("MikkTSpace tangents:       %8.3f s\n", timer.getElapsedTime());
+
+    return 0;
+}
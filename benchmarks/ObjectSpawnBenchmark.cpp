@@ -0,0 +1,211 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times ticks that spawn 1000 physical objects per second, keeping the
+ * newest 2000, comparing objects created with new and tracked in a set 
+ * against objects recycled through an ObjectPool and tracked in a dense
+ * array, and counts the heap allocations each makes
+ */
+
+#include <Objects/ObjectPool.h>
+#include <Physics/PhysicsSystem.h>
+#include <CollisionShapes/SphereCollisionShape.h>
+#include <CollisionShapes/PlaneCollisionShape.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <set>
+#include <deque>
+
+/// objects spawned per second
+#define SPAWN_RATE 1000
+
+/// most objects alive at once, the oldest are destroyed past this
+#define MAX_OBJECTS 2000
+
+/// ticks run, ten seconds at 60 ticks a second
+#define TICKS 600
+
+/// fixed tick length
+#define TICK_TIME (1.0f / 60.0f)
+
+/// heap allocations made since the program started
+static unsigned long long allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+/// Bullet allocates bodies through its own allocator, count those too
+void* countedAlignedAlloc(size_t size, int alignment)
+{
+    allocations++;
+    void* p = NULL;
+    if (posix_memalign(&p, alignment, size) != 0)
+        return NULL;
+    return p;
+}
+
+void countedAlignedFree(void* p)
+{
+    free(p);
+}
+
+/// exposes the parts of the physics system normally driven by World
+class BenchmarkPhysics : public PhysicsSystem
+{
+public:
+    using PhysicsSystem::addBody;
+    using PhysicsSystem::removeBody;
+    using PhysicsSystem::stepSimulation;
+};
+
+std::shared_ptr<CollisionShape> sphereShape;
+
+/// spawn with new, as the sandbox did
+void runUnpooled(BenchmarkPhysics& physics, float& tickTime, unsigned long long& allocs)
+{
+    std::set<Object*> objects;
+    std::deque<Object*> order;
+    Object::Properties prop;
+    prop.mass = 0.1f;
+
+    StopWatch timer;
+    unsigned long long start = allocations;
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+        for (int i = tick * SPAWN_RATE / 60; i < (tick + 1) * SPAWN_RATE / 60; i++)
+        {
+            if (order.size() == MAX_OBJECTS)
+            {
+                Object* old = order.front();
+                order.pop_front();
+                objects.erase(old);
+                physics.removeBody(*old);
+                delete old;
+            }
+            Object* object = new Object(std::make_shared<Model>(nullptr, nullptr, sphereShape), prop);
+            object->setLocation(Point3((Scalar)(i % 20), 10.0f, (Scalar)(i % 17)));
+            objects.insert(object);
+            order.push_back(object);
+            physics.addBody(*object);
+        }
+        physics.stepSimulation(TICK_TIME, 1, TICK_TIME);
+    }
+    allocs = allocations - start;
+    tickTime = timer.getElapsedTime() / TICKS;
+
+    for (Object* object : objects)
+    {
+        physics.removeBody(*object);
+        delete object;
+    }
+}
+
+/// spawn through a pool sharing one model, tracked in a dense array
+void runPooled(BenchmarkPhysics& physics, float& tickTime, unsigned long long& allocs)
+{
+    ObjectPool pool;
+    std::vector<Object*> objects;
+    std::vector<ObjectPool::Handle> order(MAX_OBJECTS);
+    objects.reserve(MAX_OBJECTS);
+    auto model = std::make_shared<Model>(nullptr, nullptr, sphereShape);
+    Object::Properties prop;
+    prop.mass = 0.1f;
+
+    StopWatch timer;
+    unsigned long long start = allocations;
+    int spawned = 0;
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+        for (int i = tick * SPAWN_RATE / 60; i < (tick + 1) * SPAWN_RATE / 60; i++, spawned++)
+        {
+            // the new object takes the dense array entry of the one it replaces
+            ObjectPool::Handle& slot = order[spawned % MAX_OBJECTS];
+            Object* old = pool.get(slot);
+            if (old != NULL)
+            {
+                physics.removeBody(*old);
+                pool.destroy(slot);
+            }
+            slot = pool.create(model, prop);
+            Object* object = pool.get(slot);
+            object->setLocation(Point3((Scalar)(i % 20), 10.0f, (Scalar)(i % 17)));
+            if (old != NULL)
+                objects[spawned % MAX_OBJECTS] = object;
+            else
+                objects.push_back(object);
+            physics.addBody(*object);
+        }
+        physics.stepSimulation(TICK_TIME, 1, TICK_TIME);
+    }
+    allocs = allocations - start;
+    tickTime = timer.getElapsedTime() / TICKS;
+    printf("pool: %d slabs of %d objects\n", pool.getSlabCount(), ObjectPool::SLAB_SIZE);
+
+    for (Object* object : objects)
+        physics.removeBody(*object);
+}
+
+int main(int argc, char** argv)
+{
+    btAlignedAllocSetCustomAligned(countedAlignedAlloc, countedAlignedFree);
+    sphereShape = std::make_shared<SphereCollisionShape>(0.3f);
+    auto floorShape = std::make_shared<PlaneCollisionShape>(Vector3(0, 1, 0));
+    float tickTime[2];
+    unsigned long long allocs[2];
+
+    for (int pooled = 0; pooled < 2; pooled++)
+    {
+        BenchmarkPhysics physics;
+        physics.init();
+        physics.setGravity(0, -9.8f, 0);
+        Object floor(std::make_shared<Model>(nullptr, nullptr, floorShape));
+        physics.addBody(floor);
+
+        if (pooled)
+            runPooled(physics, tickTime[1], allocs[1]);
+        else
+            runUnpooled(physics, tickTime[0], allocs[0]);
+
+        physics.removeBody(floor);
+        physics.deinit();
+    }
+
+    float seconds = TICKS * TICK_TIME;
+    printf("new and set:  %8.3f ms/tick, %8.0f allocations/s\n", tickTime[0] * 1000, 
+        allocs[0] / seconds);
+    printf("pooled:       %8.3f ms/tick, %8.0f allocations/s\n", tickTime[1] * 1000, 
+        allocs[1] / seconds);
+
+    return 0;
+}
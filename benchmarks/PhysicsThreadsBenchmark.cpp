@@ -0,0 +1,122 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times stepping 10k spheres falling onto a floor, like the sandbox's 
+ * released water, with the single threaded world and the multithreaded 
+ * one at increasing thread counts
+ */
+
+#include <Physics/PhysicsSystem.h>
+#include <CollisionShapes/SphereCollisionShape.h>
+#include <CollisionShapes/PlaneCollisionShape.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+/// number of falling spheres
+#define SPHERE_COUNT 10000
+
+/// number of steps timed, long enough for the spheres to land and pile up
+#define STEPS 300
+
+/// fixed physics step
+#define STEP_TIME (1.0f / 60.0f)
+
+/// exposes the parts of the physics system normally driven by World
+class BenchmarkPhysics : public PhysicsSystem
+{
+public:
+    using PhysicsSystem::addBody;
+    using PhysicsSystem::removeBody;
+    using PhysicsSystem::stepSimulation;
+};
+
+/** step the scene with the given configuration
+ * @return average time per step in seconds
+ */
+float run(const PhysicsSystem::Config& config, int& threadsUsed)
+{
+    BenchmarkPhysics physics;
+    physics.init(config);
+    physics.setGravity(0, -9.8f, 0);
+    threadsUsed = physics.getThreadCount();
+
+    auto floorShape = std::make_shared<PlaneCollisionShape>(Vector3(0, 1, 0));
+    auto sphereShape = std::make_shared<SphereCollisionShape>(0.3f);
+    std::vector<Object*> objects;
+
+    Object* floor = new Object(std::make_shared<Model>(nullptr, nullptr, floorShape));
+    objects.push_back(floor);
+
+    // drop the spheres from a loose column, the same for every run
+    Object::Properties prop;
+    prop.mass = 0.1f;
+    srand(1);
+    for (int i = 0; i < SPHERE_COUNT; i++)
+    {
+        Object* sphere = new Object(std::make_shared<Model>(nullptr, nullptr, sphereShape), prop);
+        sphere->setLocation(Point3((Scalar)(rand() % 400) * 0.1f - 20.0f, 
+            5.0f + (Scalar)i * 0.01f, (Scalar)(rand() % 400) * 0.1f - 20.0f));
+        objects.push_back(sphere);
+    }
+    for (Object* object : objects)
+        physics.addBody(*object);
+
+    StopWatch timer;
+    for (int i = 0; i < STEPS; i++)
+        physics.stepSimulation(STEP_TIME, 1, STEP_TIME);
+    float elapsed = timer.getElapsedTime();
+
+    for (Object* object : objects)
+    {
+        physics.removeBody(*object);
+        delete object;
+    }
+    physics.deinit();
+    return elapsed / STEPS;
+}
+
+int main(int argc, char** argv)
+{
+    PhysicsSystem::Config config;
+    int threads = 0;
+    float sequential = run(config, threads);
+    printf("single threaded world:  %8.3f ms/step\n", sequential * 1000);
+
+    // without a multithreaded Bullet the option is ignored, nothing more to compare
+    config.multithreaded = true;
+    int hardwareThreads = (int)std::thread::hardware_concurrency();
+    for (int count = 1; count <= hardwareThreads; count *= 2)
+    {
+        config.threadCount = count;
+        float time = run(config, threads);
+        if (threads == 1 && count > 1)
+        {
+            printf("multithreaded world not available, build with PHYSICS_MULTITHREADED\n");
+            break;
+        }
+        printf("%2d thread(s):           %8.3f ms/step, %.2fx\n", threads, time * 1000, 
+            sequential / time);
+    }
+
+    return 0;
+}
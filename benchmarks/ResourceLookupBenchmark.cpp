@@ -0,0 +1,116 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times finding resource files, comparing probing each resource directory
+ * with an ifstream (as ResourceManager used to) against looking them up in
+ * a ResourceIndex. Takes the resource directory as its argument, the 
+ * repository's resources directory by default
+ */
+
+#include <Resources/ResourceIndex.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <stdio.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// number of times every path is looked up
+#define ROUNDS 2000
+
+/// resources the sandbox loads, and a few that don't exist
+static const char* paths[] = 
+{
+    "textures/bareConcrete.tex.xml",
+    "textures/marble.tex.xml",
+    "textures/singleBrick.tex.xml",
+    "textures/bricks.normals.tex.xml",
+    "images/bareConcrete.tga",
+    "images/marble.png",
+    "images/logo.tga",
+    "shaders/Full/Full.gpu.xml",
+    "shaders/Full/Full.vp",
+    "shaders/Full/Full.fp",
+    "materials/Brick.xml",
+    "models/chainLink.3ds",
+    "images/missing.png",
+    "textures/missing.tex.xml",
+};
+
+#define PATH_COUNT (sizeof(paths) / sizeof(paths[0]))
+
+/// find a file the way ResourceManager used to, opening it in each directory in turn
+static std::string probe(const std::vector<std::string>& dirs, const std::string& path)
+{
+    for (const std::string& basePath : dirs)
+    {
+        std::ifstream test;
+        std::string fullPath = basePath + "/" + path;
+        test.open(fullPath.c_str());
+        if (test.is_open() && test.good())
+            return fullPath;
+    }
+    return "";
+}
+
+int main(int argc, char** argv)
+{
+    // like the sandbox, the first directory doesn't exist when run from the build directory
+    std::vector<std::string> dirs;
+    dirs.push_back("../../../../resources");
+    dirs.push_back(argc > 1 ? argv[1] : "../resources");
+
+    StopWatch timer;
+    ResourceIndex index;
+    for (const std::string& dir : dirs)
+        index.addDirectory(dir);
+    printf("indexed %d files in %.3f ms\n", index.getFileCount(), timer.getElapsedTime() * 1000);
+
+    int found = 0;
+    timer.reset();
+    for (int round = 0; round < ROUNDS; round++)
+        for (unsigned int i = 0; i < PATH_COUNT; i++)
+            found += probe(dirs, paths[i]) != "";
+    float probeTime = timer.getElapsedTime();
+
+    // paths are kept as strings, as they are passed to ResourceManager
+    std::vector<std::string> pathStrings(paths, paths + PATH_COUNT);
+    int indexed = 0;
+    timer.reset();
+    for (int round = 0; round < ROUNDS; round++)
+        for (unsigned int i = 0; i < PATH_COUNT; i++)
+            indexed += index.find(pathStrings[i]) != ResourceIndex::INVALID_PATH;
+    float findTime = timer.getElapsedTime();
+
+    int resolved = 0;
+    timer.reset();
+    for (int round = 0; round < ROUNDS; round++)
+        for (unsigned int i = 0; i < PATH_COUNT; i++)
+            resolved += index.getFullPath(index.find(pathStrings[i])) != "";
+    float fullPathTime = timer.getElapsedTime();
+
+    int lookups = ROUNDS * PATH_COUNT;
+    printf("%d lookups, %d found by probing, %d by the index\n", lookups, found / ROUNDS, resolved / ROUNDS);
+    printf("probing:          %8.3f us per lookup\n", probeTime * 1000000 / lookups);
+    printf("index id:         %8.3f us per lookup\n", findTime * 1000000 / lookups);
+    printf("index full path:  %8.3f us per lookup\n", fullPathTime * 1000000 / lookups);
+
+    return (found == resolved && indexed >= resolved) ? 0 : 1;
+}
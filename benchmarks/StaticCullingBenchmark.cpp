@@ -0,0 +1,124 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times frustum culling 100k static objects, comparing testing every
+ * bounding sphere one at a time, testing them all in a SIMD batch, and 
+ * culling them through the ObjectBVH
+ */
+
+#include <World/ObjectBVH.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// number of static objects
+#define OBJECT_COUNT 100000
+
+/// number of camera positions culled from
+#define FRAMES 200
+
+int main(int argc, char** argv)
+{
+    // scatter trees over a square kilometer, as the sandbox does
+    std::vector<Point3> centers;
+    std::vector<Scalar> radii;
+    SphereArray spheres;
+    ObjectBVH tree;
+    srand(1);
+    for (int i = 0; i < OBJECT_COUNT; i++)
+    {
+        centers.push_back(Point3((Scalar)(rand() % 10000) * 0.1f - 500.0f, 
+            (Scalar)(rand() % 100) * 0.1f, (Scalar)(rand() % 10000) * 0.1f - 500.0f));
+        radii.push_back(1.0f + (Scalar)(rand() % 40) * 0.1f);
+        spheres.add(centers[i].x(), centers[i].y(), centers[i].z(), radii[i]);
+        tree.add((Object*)(size_t)(i + 1), NULL, centers[i], radii[i]);
+    }
+
+    StopWatch timer;
+    tree.rebuild();
+    printf("%d objects, %d nodes, built in %.3f ms\n", OBJECT_COUNT, tree.getNodeCount(), 
+        timer.getElapsedTime() * 1000);
+
+    ViewFrustum frustum;
+    frustum.setCamProperties(35.0f, 4.0f / 3.0f, 1.0f, 300.0f);
+
+    // walk the camera in a circle looking outward
+    std::vector<Position> cameras;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        Position camera(0.0f, 6.0f, 0.0f);
+        camera.rotate((Scalar)f * 0.0314f, Vector3(0.0f, 1.0f, 0.0f));
+        camera.translateLocal(0.0f, 0.0f, 200.0f);
+        cameras.push_back(camera);
+    }
+
+    int linearVisible = 0;
+    timer.reset();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        frustum.setPosition(cameras[f]);
+        for (int i = 0; i < OBJECT_COUNT; i++)
+        {
+            Vector3 center(centers[i].x(), centers[i].y(), centers[i].z());
+            if (frustum.sphereInFrustum(center, radii[i]))
+                linearVisible++;
+        }
+    }
+    float linearTime = timer.getElapsedTime();
+
+    int batchVisible = 0;
+    std::vector<uint32_t> mask((OBJECT_COUNT + 31) / 32);
+    timer.reset();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        frustum.setPosition(cameras[f]);
+        frustum.spheresInFrustum(spheres, 0, OBJECT_COUNT, &mask[0]);
+        for (unsigned int i = 0; i < mask.size(); i++)
+        {
+            for (uint32_t bits = mask[i]; bits; bits &= bits - 1)
+                batchVisible++;
+        }
+    }
+    float batchTime = timer.getElapsedTime();
+
+    int treeVisible = 0;
+    int nodesTested = 0;
+    std::vector<const ObjectBVH::Item*> visible;
+    timer.reset();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        frustum.setPosition(cameras[f]);
+        visible.clear();
+        tree.cull(frustum, visible);
+        treeVisible += visible.size();
+        nodesTested += tree.getNodesTested();
+    }
+    float treeTime = timer.getElapsedTime();
+
+    printf("linear: %8.3f ms/frame, %d visible/frame\n", linearTime * 1000 / FRAMES,
+        linearVisible / FRAMES);
+    printf("batch:  %8.3f ms/frame, %d visible/frame\n", batchTime * 1000 / FRAMES,
+        batchVisible / FRAMES);
+    printf("bvh:    %8.3f ms/frame, %d visible/frame, %d nodes tested/frame\n", 
+        treeTime * 1000 / FRAMES, treeVisible / FRAMES, nodesTested / FRAMES);
+
+    return 0;
+}
@@ -117,6 +117,13 @@ bool moveLeft = false;
 bool moveRight = false;
 bool releaseWater = false;
 
+// released water, pooled and recycled oldest first once there is enough of it
+#define MAX_WATER 2000
+ObjectPool waterPool;
+std::vector<ObjectPool::Handle> water;
+unsigned int nextWater = 0;
+std::shared_ptr<Model> waterModel;
+
 // builders
 MaterialBuilder materialBuilder;
 
@@ -253,6 +260,8 @@ void keyPressed(int key, FPCamera& camera, GraphicsSystem& graphics, World& worl
 			break;
 			
 		case 'z':
+			world.setPhysicsThreaded(!world.isPhysicsThreaded());
+			cout << "physics thread " << (world.isPhysicsThreaded() ? "on" : "off") << endl;
 			break;
 			
 		case 'u':
@@ -453,6 +462,17 @@ public:
 		resourceManager.addResourceDir("../../../../resources/");
 		resourceManager.addResourceDir("../../../../../resources/");
 
+		// keep linked programs between runs, so only the first run compiles shaders
+		resourceManager.setProgramCacheDir("programcache");
+
+		// start the slowest loads first, so they decode on the loader threads during the rest of setup
+		auto stoneTexLoad = resourceManager.getAsync<Texture>("textures/bareConcrete.tex.xml");
+		auto marbleTexLoad = resourceManager.getAsync<Texture>("textures/marble.tex.xml");
+		auto brickTexLoad = resourceManager.getAsync<Texture>("textures/singleBrick.tex.xml");
+		auto shaderLoad = resourceManager.getAsync<GpuProgram>("shaders/Full/Full.gpu.xml");
+		auto program2DLoad = resourceManager.getAsync<GpuProgram>("shaders/GpuProgram2D.xml");
+		auto chainLoad = resourceManager.getAsync<Meshes>("models/chainLink.3ds");
+
 		// bullet setup
 		physics.setGravity(0,-9.8f*METER,0);
 
@@ -462,9 +482,9 @@ public:
 		graphics.setClearColor(Color(0,0,0));
 
 		// init textures
-		auto stoneTex = resourceManager.get<Texture>("textures/bareConcrete.tex.xml");
-		auto marbleTex = resourceManager.get<Texture>("textures/marble.tex.xml");
-		auto brickTex = resourceManager.get<Texture>("textures/singleBrick.tex.xml");
+		auto stoneTex = resourceManager.wait(stoneTexLoad);
+		auto marbleTex = resourceManager.wait(marbleTexLoad);
+		auto brickTex = resourceManager.wait(brickTexLoad);
 
 		Image blueImage( 1, 1, 4, Color(31, 97, 240, 255) );
 		auto blueTex = std::make_shared<Texture>(blueImage);
@@ -491,7 +511,7 @@ public:
 		//shader = resourceManager.get<GpuProgram>("shaders/HemisphereTex.gpu.xml");
         //shader = resourceManager.get<GpuProgram>("shaders/Phong/Phong.gpu.xml");
         //shader = resourceManager.get<GpuProgram>("shaders/BlinnPhong/BlinnPhong.gpu.xml");
-        shader = resourceManager.get<GpuProgram>("shaders/Full/Full.gpu.xml");
+        shader = resourceManager.wait(shaderLoad);
 
 		// init batches
         MeshBuilderPTNT mb;
@@ -518,6 +538,9 @@ public:
         materialBuilder.setNormalMap(resourceManager.get<Texture>("textures/bricks.normals.tex.xml"));
 		materialBuilder.end();
 
+		waterModel = std::make_shared<Model>(std::make_shared<Meshes>(tinySphereBatch), 
+			tinySphereMaterial, tinySphereShape);
+
 		bigSphereMaterial = std::make_shared<Material>();
 		materialBuilder.expand(bigSphereMaterial.get(), *sphereMaterial);
 		materialBuilder.setTexture(charTex);
@@ -534,7 +557,7 @@ public:
 		auto brickMaterial = resourceManager.get<Material>("materials/Brick.xml");
 
 		// 2D shader
-		auto program2D = resourceManager.get<GpuProgram>("shaders/GpuProgram2D.xml");
+		auto program2D = resourceManager.wait(program2DLoad);
 
 		// circle in middle of screen
 		//batchBuilder.build2DCircle(circle2D, 150, 150, 300, 5);
@@ -643,7 +666,19 @@ public:
             brickMaterial)));*/
 
 		// 3ds model
-		std::shared_ptr<Meshes> chainBatches = resourceManager.get<Meshes>("models/chainLink.3ds");
+		std::shared_ptr<Meshes> chainBatches = resourceManager.wait(chainLoad);
+
+		// report how much indexing saved on the chain link
+		int drawnVertices = 0, uniqueVertices = 0, indexedBytes = 0, unindexedBytes = 0;
+		for (auto mesh : *chainBatches)
+		{
+			drawnVertices += mesh->getElementCount();
+			uniqueVertices += mesh->getVertexCount();
+			indexedBytes += mesh->getDataSize();
+			unindexedBytes += mesh->getElementCount() * mesh->getVertexSize();
+		}
+		cout << "chainLink.3ds: " << drawnVertices << " vertices drawn, " << uniqueVertices << " unique, " 
+			<< indexedBytes << " bytes indexed vs " << unindexedBytes << " bytes unindexed\n";
 		Matrix4 scaleMatrix;
 		scaleMatrix.createScaleMatrix(0.1f, 0.1f, 0.1f);
         chainBatches = chainBatches->applyTransform(scaleMatrix);
@@ -690,12 +725,23 @@ public:
 		{
 			for (int i = 0; i < 20; i++)
 			{
-				Object::Properties prop;
-				prop.mass = 0.1f;
-				Object* t = new Object(std::make_shared<Model>(std::make_shared<Meshes>(tinySphereBatch), 
-					tinySphereMaterial, tinySphereShape), prop);
-				t->setLocation(Point3(0, 10.0f, 0));
-				world->addObject(t);
+				Object* t;
+				if (water.size() < MAX_WATER)
+				{
+					Object::Properties prop;
+					prop.mass = 0.1f;
+					water.push_back(waterPool.create(waterModel, prop));
+					t = waterPool.get(water.back());
+					t->setLocation(Point3(0, 10.0f, 0));
+					world->addObject(t);
+				}
+				else
+				{
+					t = waterPool.get(water[nextWater]);
+					nextWater = (nextWater + 1) % MAX_WATER;
+					t->resetMotion();
+					t->setLocation(Point3(0, 10.0f, 0));
+				}
             
 				t->applyForce(Vector3(((float)(rand()%100))*0.01f, 0.0f, 
 					((float)(rand()%100))*0.01f) );
@@ -728,21 +774,35 @@ public:
 		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 50, Color::WHITE);
 
 		ss.str("");
-		ss << "Fps: " << world->getActualFPS();
+		ss << "Fps: " << world->getActualFPS() << " (" 
+			<< (int) (world->getFrameStats().budgetUsed * 100) << "% busy)";
 		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 80, Color::WHITE);
 
 		ss.str("");
-		ss << "Objects: " << world->getObjectCount();
+		ss << "Objects: " << world->getObjectCount() << " (" << world->getRestingObjectCount() << " resting)";
 		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 110, Color::WHITE);
 
 		ss.str("");
-		ss << "Vertices: " << world->getVertexCount();
+		ss << "Vertices: " << world->getVertexCount() << " in " << world->getDrawCallCount() << " draws";
 		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 140, Color::WHITE);
 
 		ss.str("");
-		ss << "Render Time: " << (world->getRenderTimeElapsed() * 1000) << " ms";
+		ss << "Render Time: " << (world->getRenderTimeElapsed() * 1000) << " ms, physics " 
+			<< (world->getFrameStats().physicsTime * 1000) << " ms";
 		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 170, Color::WHITE);
 
+		ss.str("");
+		ss << "Buffers: " << world->getBufferCount();
+		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 200, Color::WHITE);
+
+		ss.str("");
+		ss << "VAO Binds: " << world->getVertexArrayBindCount();
+		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 230, Color::WHITE);
+
+		ss.str("");
+		ss << "GL Calls: " << world->getGLCallsIssued() << " (" << world->getGLCallsSkipped() << " skipped)";
+		screenImage.drawAsciiText(*font, ss.str().c_str(), 50, 260, Color::WHITE);
+
 		screenTex->set(screenImage);
     
 	}
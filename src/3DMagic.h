@@ -37,6 +37,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 // objects
 #include "Objects/Object.h"
+#include "Objects/ObjectPool.h"
 
 // graphics
 #include "Graphics/Texture.h"
@@ -0,0 +1,184 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ViewFrustum class
+ *
+ * @file ViewFrustum.cpp
+ * @author Andrew Keating
+ */
+
+#include <Cameras/ViewFrustum.h>
+
+// use SSE for batch culling when the compiler targets it, and AVX on top when 
+// the cpu running it has it. The AVX path is compiled for AVX on its own, so the
+// rest of the library doesn't need AVX to run
+#if !defined(M3D_MATH_DOUBLE_PERCISION) && (defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define MAGIC3D_SSE_CULLING
+#include <xmmintrin.h>
+#if defined(__AVX__) || defined(_MSC_VER) || defined(__GNUC__)
+#define MAGIC3D_AVX_CULLING
+#include <immintrin.h>
+#if !defined(__AVX__) && defined(__GNUC__)
+#define MAGIC3D_AVX_TARGET __attribute__((target("avx")))
+#else
+#define MAGIC3D_AVX_TARGET
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#endif
+
+namespace Magic3D
+{
+
+#ifdef MAGIC3D_AVX_CULLING
+/// check whether the cpu and os support AVX, so the AVX path can run
+static bool hasAvx()
+{
+#if defined(__AVX__)
+    return true;
+#elif defined(_MSC_VER)
+    // the cpu has AVX and the os saves the AVX registers on context switches
+    static int supported = -1;
+    if (supported < 0)
+    {
+        int info[4];
+        __cpuid(info, 1);
+        bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        supported = osSaves && (info[2] & (1 << 28)) != 0 ? 1 : 0;
+    }
+    return supported != 0;
+#else
+    static int supported = -1;
+    if (supported < 0)
+    {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx") ? 1 : 0;
+    }
+    return supported != 0;
+#endif
+}
+
+/** test spheres against the planes 8 at a time with AVX
+ * @return the number of spheres tested, a multiple of 8
+ */
+MAGIC3D_AVX_TARGET static unsigned int spheresInFrustumAvx(const Scalar* nx, const Scalar* ny, 
+    const Scalar* nz, const Scalar* d, const Scalar* x, const Scalar* y, const Scalar* z, 
+    const Scalar* radius, unsigned int count, uint32_t* visible)
+{
+    unsigned int i = 0;
+    __m256 anx[6], any[6], anz[6], ad[6];
+    for (int p = 0; p < 6; p++)
+    {
+        anx[p] = _mm256_set1_ps(nx[p]);
+        any[p] = _mm256_set1_ps(ny[p]);
+        anz[p] = _mm256_set1_ps(nz[p]);
+        ad[p] = _mm256_set1_ps(d[p]);
+    }
+    __m256 azero = _mm256_setzero_ps();
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 sx = _mm256_loadu_ps(x + i);
+        __m256 sy = _mm256_loadu_ps(y + i);
+        __m256 sz = _mm256_loadu_ps(z + i);
+        __m256 sr = _mm256_loadu_ps(radius + i);
+
+        // a sphere is visible if it is not entirely behind any of the planes
+        __m256 in = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(anx[p], sx), 
+                _mm256_mul_ps(any[p], sy)), _mm256_add_ps(_mm256_mul_ps(anz[p], sz), ad[p]));
+            in = _mm256_and_ps(in, _mm256_cmp_ps(_mm256_add_ps(dist, sr), azero, _CMP_GE_OQ));
+        }
+        visible[i >> 5] |= (uint32_t)_mm256_movemask_ps(in) << (i & 31);
+    }
+    return i;
+}
+#endif
+
+void ViewFrustum::spheresInFrustum(const Scalar* x, const Scalar* y, const Scalar* z,
+    const Scalar* radius, unsigned int count, uint32_t* visible) const
+{
+    for (unsigned int i = 0; i < (count + 31) / 32; i++)
+        visible[i] = 0;
+
+    // pull the planes out of their vectors once for the whole batch
+    Scalar nx[6], ny[6], nz[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        nx[p] = pl[p].getNormal().x();
+        ny[p] = pl[p].getNormal().y();
+        nz[p] = pl[p].getNormal().z();
+        d[p] = pl[p].distance(0, 0, 0);
+    }
+
+    unsigned int i = 0;
+
+#ifdef MAGIC3D_AVX_CULLING
+    if (hasAvx())
+        i = spheresInFrustumAvx(nx, ny, nz, d, x, y, z, radius, count, visible);
+#endif
+
+#ifdef MAGIC3D_SSE_CULLING
+    __m128 snx[6], sny[6], snz[6], sd[6];
+    for (int p = 0; p < 6; p++)
+    {
+        snx[p] = _mm_set1_ps(nx[p]);
+        sny[p] = _mm_set1_ps(ny[p]);
+        snz[p] = _mm_set1_ps(nz[p]);
+        sd[p] = _mm_set1_ps(d[p]);
+    }
+    __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sx = _mm_loadu_ps(x + i);
+        __m128 sy = _mm_loadu_ps(y + i);
+        __m128 sz = _mm_loadu_ps(z + i);
+        __m128 sr = _mm_loadu_ps(radius + i);
+
+        // a sphere is visible if it is not entirely behind any of the planes
+        __m128 in = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(snx[p], sx), _mm_mul_ps(sny[p], sy)),
+                _mm_add_ps(_mm_mul_ps(snz[p], sz), sd[p]));
+            in = _mm_and_ps(in, _mm_cmpge_ps(_mm_add_ps(dist, sr), zero));
+        }
+        visible[i >> 5] |= (uint32_t)_mm_movemask_ps(in) << (i & 31);
+    }
+#endif
+
+    // whatever is left over, or everything without SIMD
+    for (; i < count; i++)
+    {
+        bool in = true;
+        for (int p = 0; p < 6 && in; p++)
+            in = nx[p] * x[i] + ny[p] * y[i] + nz[p] * z[i] + d[p] + radius[i] >= 0;
+        if (in)
+            visible[i >> 5] |= 1u << (i & 31);
+    }
+}
+
+
+};
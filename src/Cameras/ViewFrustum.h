@@ -4,6 +4,8 @@
 #include <Math\Point.h>
 #include <Math\Matrix4.h>
 #include <memory>
+#include <vector>
+#include <stdint.h>
 #include <Graphics\Mesh.h>
 #include <Graphics\MeshBuilder.h>
 
@@ -40,6 +42,64 @@ public:
     {
         return (d + normal.dotProduct(p));
     }
+
+    inline Scalar distance(Scalar x, Scalar y, Scalar z) const
+    {
+        return d + normal.x() * x + normal.y() * y + normal.z() * z;
+    }
+
+    inline const Vector3& getNormal() const
+    {
+        return normal;
+    }
+};
+
+/** Bounding spheres stored as separate arrays for each component, so 
+ * many can be tested against a frustum at once
+ */
+struct SphereArray
+{
+    std::vector<Scalar> x;
+    std::vector<Scalar> y;
+    std::vector<Scalar> z;
+    std::vector<Scalar> radius;
+
+    inline void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius.clear();
+    }
+
+    inline void reserve(unsigned int count)
+    {
+        x.reserve(count);
+        y.reserve(count);
+        z.reserve(count);
+        radius.reserve(count);
+    }
+
+    inline void add(Scalar cx, Scalar cy, Scalar cz, Scalar r)
+    {
+        x.push_back(cx);
+        y.push_back(cy);
+        z.push_back(cz);
+        radius.push_back(r);
+    }
+
+    inline void set(unsigned int i, Scalar cx, Scalar cy, Scalar cz, Scalar r)
+    {
+        x[i] = cx;
+        y[i] = cy;
+        z[i] = cz;
+        radius[i] = r;
+    }
+
+    inline unsigned int size() const
+    {
+        return x.size();
+    }
 };
 
 class Rectangle
@@ -95,6 +155,23 @@ class ViewFrustum
     };
 
 public:
+    /// result of testing a volume against the frustum
+    enum Result
+    {
+        OUTSIDE = 0,
+        INTERSECTS,
+        INSIDE
+    };
+
+    /// plane mask with every plane of the frustum set
+    static const unsigned int ALL_PLANES = 0x3F;
+
+    /// get the distance from the camera to the far plane
+    inline Scalar getFarDistance() const
+    {
+        return zFar;
+    }
+
     void setCamProperties(float angle, float ratio, float zNear, float zFar) 
     {
         this->ratio = ratio;
@@ -157,6 +234,99 @@ public:
         }
         return true;
     }
+
+    /** test many spheres against the frustum at once, using SSE or AVX when 
+     * available
+     * @param x the x coordinates of the centers of the spheres
+     * @param y the y coordinates of the centers of the spheres
+     * @param z the z coordinates of the centers of the spheres
+     * @param radius the radii of the spheres
+     * @param count the number of spheres
+     * @param visible bitmask of (count + 31) / 32 words, bit i of word j set 
+     * if sphere j * 32 + i intersects the frustum
+     */
+    void spheresInFrustum(const Scalar* x, const Scalar* y, const Scalar* z,
+        const Scalar* radius, unsigned int count, uint32_t* visible) const;
+
+    /** test a range of spheres in a sphere array against the frustum at once
+     * @param spheres the spheres
+     * @param start the first sphere to test
+     * @param count the number of spheres to test
+     * @param visible bitmask of (count + 31) / 32 words, bit i of word j set 
+     * if sphere start + j * 32 + i intersects the frustum
+     */
+    inline void spheresInFrustum(const SphereArray& spheres, unsigned int start, 
+        unsigned int count, uint32_t* visible) const
+    {
+        if (count == 0)
+            return;
+        this->spheresInFrustum(&spheres.x[start], &spheres.y[start], &spheres.z[start],
+            &spheres.radius[start], count, visible);
+    }
+
+    /** test a sphere against the planes set in a plane mask. Planes the sphere
+     * is entirely inside of are cleared from the mask
+     * @param x the x coordinate of the center of the sphere
+     * @param y the y coordinate of the center of the sphere
+     * @param z the z coordinate of the center of the sphere
+     * @param radius the radius of the sphere
+     * @param planeMask bit i set to test plane i, updated with the planes still straddled
+     * @return where the sphere is relative to the frustum
+     */
+    inline Result sphereTest(Scalar x, Scalar y, Scalar z, Scalar radius, 
+        unsigned int& planeMask) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (!(planeMask & (1 << i)))
+                continue;
+
+            Scalar distance = pl[i].distance(x, y, z);
+            if (distance < -radius)
+                return OUTSIDE;
+            if (distance >= radius)
+                planeMask &= ~(1 << i);
+        }
+        return planeMask ? INTERSECTS : INSIDE;
+    }
+
+    /** test an axis aligned box against the planes set in a plane mask. Planes
+     * the box is entirely inside of are cleared from the mask
+     * @param min the minimum corner of the box
+     * @param max the maximum corner of the box
+     * @param planeMask bit i set to test plane i, updated with the planes still straddled
+     * @param firstPlane plane to test first, set to the plane that rejected the
+     * box so the next test of a box in the same place rejects quickly
+     * @return where the box is relative to the frustum
+     */
+    inline Result boxTest(const Scalar* min, const Scalar* max, unsigned int& planeMask,
+        int& firstPlane) const
+    {
+        for (int j = 0; j < 6; j++)
+        {
+            int i = (j + firstPlane) % 6;
+            if (!(planeMask & (1 << i)))
+                continue;
+
+            // the corners farthest along and against the plane normal
+            const Vector3& n = pl[i].getNormal();
+            Scalar px = n.x() >= 0 ? max[0] : min[0];
+            Scalar py = n.y() >= 0 ? max[1] : min[1];
+            Scalar pz = n.z() >= 0 ? max[2] : min[2];
+            if (pl[i].distance(px, py, pz) < 0)
+            {
+                firstPlane = i;
+                return OUTSIDE;
+            }
+
+            Scalar nx = n.x() >= 0 ? min[0] : max[0];
+            Scalar ny = n.y() >= 0 ? min[1] : max[1];
+            Scalar nz = n.z() >= 0 ? min[2] : max[2];
+            if (pl[i].distance(nx, ny, nz) >= 0)
+                planeMask &= ~(1 << i);
+        }
+        return planeMask ? INTERSECTS : INSIDE;
+    }
 };
 
 
@@ -37,12 +37,12 @@ TriangleMeshCollisionShape::TriangleMeshCollisionShape(Meshes& batches):
     // and add triangles to physics mesh
     for(auto mesh : batches)
     {
-        for(int j=0; j < mesh->getVertexCount(); j+=3)
+        for(int j=0; j < mesh->getElementCount(); j+=3)
         {
             // get three vertices for triangle
-            auto a = mesh->getVertex(j).position();
-            auto b = mesh->getVertex(j+1).position();
-            auto c = mesh->getVertex(j+2).position();
+            auto a = mesh->getVertex(mesh->getIndex(j)).position();
+            auto b = mesh->getVertex(mesh->getIndex(j+1)).position();
+            auto c = mesh->getVertex(mesh->getIndex(j+2)).position();
             
             // add triangle to mesh
             this->mesh.addTriangle( btVector3(a.x(), a.y(), a.z()),
@@ -52,8 +52,19 @@ TriangleMeshCollisionShape::TriangleMeshCollisionShape(Meshes& batches):
         }
     }
     
-    // build physics shape from mesh data
-    this->shape = new btBvhTriangleMeshShape(&mesh, true);
+    // use the BVH baked with the meshes if it was built over these triangles,
+    // otherwise build physics shape from mesh data
+    if (batches.getCollisionBvh() != nullptr && 
+        batches.getCollisionBvhTriangleCount() == this->mesh.getNumTriangles())
+    {
+        this->shape = new btBvhTriangleMeshShape(&mesh, true, false);
+        this->shape->setOptimizedBvh(batches.getCollisionBvh());
+        this->bvhData = batches.getCollisionBvhData();
+    }
+    else
+    {
+        this->shape = new btBvhTriangleMeshShape(&mesh, true);
+    }
 }
   
 /// destructor
@@ -46,6 +46,9 @@ protected:
     btBvhTriangleMeshShape* shape;
 
     btTriangleMesh mesh;
+
+    /// owner of the memory a prebuilt BVH is in
+    std::shared_ptr<void> bvhData;
     
     /// get the bullet physics collison shape
     virtual btCollisionShape* getShape();
@@ -57,6 +60,18 @@ public:
     /// destructor
     virtual ~TriangleMeshCollisionShape();
 
+    /// get the BVH over the triangles, either built by the shape or prebuilt with the meshes
+    inline btOptimizedBvh* getOptimizedBvh()
+    {
+        return this->shape->getOptimizedBvh();
+    }
+
+    /// get the number of triangles in the shape
+    inline int getTriangleCount()
+    {
+        return this->mesh.getNumTriangles();
+    }
+
 
 
 };
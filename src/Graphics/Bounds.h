@@ -0,0 +1,229 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for Bounds class
+ *
+ * @file Bounds.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_BOUNDS_H
+#define MAGIC3D_BOUNDS_H
+
+#include "../Math/Point.h"
+#include "../Math/Matrix4.h"
+
+#include <math.h>
+#include <float.h>
+
+namespace Magic3D
+{
+
+/** An axis aligned bounding box and a bounding sphere around the same 
+ * points, cheap enough to recompute whenever an object moves
+ */
+class Bounds
+{
+private:
+    Scalar min[3];
+
+    Scalar max[3];
+
+    Scalar center[3];
+
+    Scalar radius;
+
+public:
+    /// standard constructor, creates empty bounds
+    inline Bounds(): radius(-1.0f)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = center[i] = 0.0f;
+            max[i] = 0.0f;
+        }
+    }
+
+    /** compute the bounds of a set of points. The sphere is centered on
+     * the box, with the radius of the farthest point from the center
+     * @param points the x, y and z of each point
+     * @param stride the number of bytes between points
+     * @param count the number of points
+     */
+    inline Bounds(const char* points, int stride, int count): radius(-1.0f)
+    {
+        if (count <= 0)
+        {
+            *this = Bounds();
+            return;
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = FLT_MAX;
+            max[i] = -FLT_MAX;
+        }
+        for (int p = 0; p < count; p++)
+        {
+            const Scalar* point = (const Scalar*)(points + p * stride);
+            for (int i = 0; i < 3; i++)
+            {
+                min[i] = point[i] < min[i] ? point[i] : min[i];
+                max[i] = point[i] > max[i] ? point[i] : max[i];
+            }
+        }
+
+        Scalar radiusSquared = 0.0f;
+        for (int i = 0; i < 3; i++)
+            center[i] = (min[i] + max[i]) * 0.5f;
+        for (int p = 0; p < count; p++)
+        {
+            const Scalar* point = (const Scalar*)(points + p * stride);
+            Scalar dx = point[0] - center[0];
+            Scalar dy = point[1] - center[1];
+            Scalar dz = point[2] - center[2];
+            Scalar d = dx * dx + dy * dy + dz * dz;
+            radiusSquared = d > radiusSquared ? d : radiusSquared;
+        }
+        radius = sqrt(radiusSquared);
+    }
+
+    /** create bounds computed before, such as when loading baked data
+     * @param min the corner of the box with the smallest coordinates
+     * @param max the corner of the box with the largest coordinates
+     * @param center the center of the sphere
+     * @param radius the radius of the sphere, negative for empty bounds
+     */
+    inline Bounds(const Scalar* min, const Scalar* max, const Scalar* center, Scalar radius): radius(radius)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            this->min[i] = min[i];
+            this->max[i] = max[i];
+            this->center[i] = center[i];
+        }
+    }
+
+    /// check if the bounds contain nothing
+    inline bool isEmpty() const
+    {
+        return radius < 0.0f;
+    }
+
+    inline Point3 getMin() const
+    {
+        return Point3(min[0], min[1], min[2]);
+    }
+
+    inline Point3 getMax() const
+    {
+        return Point3(max[0], max[1], max[2]);
+    }
+
+    /// get the center of the bounding sphere
+    inline Point3 getCenter() const
+    {
+        return Point3(center[0], center[1], center[2]);
+    }
+
+    /// get the radius of the bounding sphere
+    inline Scalar getRadius() const
+    {
+        return radius < 0.0f ? 0.0f : radius;
+    }
+
+    /** grow these bounds to enclose other bounds as well
+     * @param other the bounds to enclose
+     */
+    inline void merge(const Bounds& other)
+    {
+        if (other.isEmpty())
+            return;
+        if (this->isEmpty())
+        {
+            *this = other;
+            return;
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = other.min[i] < min[i] ? other.min[i] : min[i];
+            max[i] = other.max[i] > max[i] ? other.max[i] : max[i];
+        }
+
+        // smallest sphere around both spheres
+        Scalar d[3] = { other.center[0] - center[0], other.center[1] - center[1],
+            other.center[2] - center[2] };
+        Scalar distance = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        if (distance + other.radius <= radius)
+            return;
+        if (distance + radius <= other.radius)
+        {
+            for (int i = 0; i < 3; i++)
+                center[i] = other.center[i];
+            radius = other.radius;
+            return;
+        }
+        Scalar newRadius = (distance + radius + other.radius) * 0.5f;
+        Scalar t = (newRadius - radius) / distance;
+        for (int i = 0; i < 3; i++)
+            center[i] += d[i] * t;
+        radius = newRadius;
+    }
+
+    /** get these bounds after a transform. The box is the box around the 
+     * transformed box, and the sphere is scaled by the largest axis scale
+     * @param matrix the transform, such as a model matrix
+     * @return the transformed bounds
+     */
+    inline Bounds transform(const Matrix4& matrix) const
+    {
+        if (this->isEmpty())
+            return *this;
+
+        const Scalar* m = matrix.getArray(); // column major
+        Bounds result;
+        Scalar maxScaleSquared = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            result.min[i] = result.max[i] = m[12 + i];
+            result.center[i] = m[12 + i];
+            for (int j = 0; j < 3; j++)
+            {
+                Scalar e = m[j * 4 + i];
+                Scalar a = e * min[j];
+                Scalar b = e * max[j];
+                result.min[i] += a < b ? a : b;
+                result.max[i] += a < b ? b : a;
+                result.center[i] += e * center[j];
+            }
+
+            Scalar scaleSquared = m[i * 4] * m[i * 4] + m[i * 4 + 1] * m[i * 4 + 1] +
+                m[i * 4 + 2] * m[i * 4 + 2];
+            maxScaleSquared = scaleSquared > maxScaleSquared ? scaleSquared : maxScaleSquared;
+        }
+        result.radius = radius * sqrt(maxScaleSquared);
+        return result;
+    }
+};
+
+
+};
+
+
+#endif
@@ -29,6 +29,8 @@ namespace Magic3D
 {
 
 GLuint Buffer::bufferBindings[] = {0,0,0,0,0,0,0,0,0};	
+
+int Buffer::bufferCount = 0;
 	
 	
 	
@@ -66,6 +66,7 @@ public:
 	};
 	
 	friend class VertexArray;
+	friend class StreamBuffer;
 	
 private: // all static stuff to maintain buffer bindings go here
 	// we maintain out own buffer bindings, cause openGL currently
@@ -150,6 +151,9 @@ private: // all static stuff to maintain buffer bindings go here
 private:
 	/// openGL id for buffer
 	GLuint bufferId;
+
+	/// number of buffers currently in existence
+	static int bufferCount;
 	
 public:
 	/// the possible usage types for a buffer
@@ -179,12 +183,14 @@ public:
 	inline Buffer()
 	{
 		glGenBuffers(1, &bufferId);
+		bufferCount++;
 	}
 	
 	/// constructor for specifying buffer size, but not contents
 	inline Buffer(int size, UsageTypes usage)
 	{
 		glGenBuffers(1, &bufferId);
+		bufferCount++;
 		allocate(size, NULL, usage);
 	}
 	
@@ -192,6 +198,7 @@ public:
 	inline Buffer(int size, const void* data, UsageTypes usage)
 	{
 		glGenBuffers(1, &bufferId);
+		bufferCount++;
 		allocate(size, data, usage);
 	}
 
@@ -200,6 +207,7 @@ public:
 	{
 		Buffer::unBindBuffer(bufferId);
 		glDeleteBuffers(1, &bufferId);
+		bufferCount--;
 	}
 	
 	/** bind the buffer to a binding point to allow for
@@ -217,6 +225,25 @@ public:
 		Buffer::unBindBuffer(bufferId);
 	}
 	
+	/** bind a range of the buffer to an indexed binding point, such as a
+	 * uniform block binding, also binding it to the general binding point
+	 * @param point the indexed binding point, UNIFORM_BUFFER or TRANSFORM_FEEDBACK_BUFFER
+	 * @param index the index of the binding
+	 * @param offset the offset (in bytes) of the range
+	 * @param size the size (in bytes) of the range
+	 */
+	inline void bindRange(BindingPoints point, unsigned int index, int offset, int size) const
+	{
+		Buffer::bindBuffer(point, bufferId);
+		glBindBufferRange(point, index, bufferId, offset, size);
+	}
+
+	/// get the openGL id of the buffer
+	inline GLuint getId() const
+	{
+		return bufferId;
+	}
+
 	/// get the current buffer binding
 	inline BindingPoints getBinding() const
 	{
@@ -257,6 +284,31 @@ public:
 		if (glGetError() != GL_NO_ERROR)
 			throw_MagicException("Failed to copy data");
 	}
+	
+	/** copy data from another buffer into this buffer on graphics memory
+	 * @param source the buffer to copy from
+	 * @param readOffset the offset into the source buffer to copy from
+	 * @param writeOffset the offset into this buffer to copy to
+	 * @param size the size of the data to copy
+	 */
+	inline void copy(const Buffer& source, int readOffset, int writeOffset, int size)
+	{
+		// we bypass static functions becuase we restore previous buffers ourselves
+		glBindBuffer(COPY_READ_BUFFER, source.bufferId);
+		glBindBuffer(COPY_WRITE_BUFFER, bufferId);
+		glCopyBufferSubData(COPY_READ_BUFFER, COPY_WRITE_BUFFER, readOffset, writeOffset, size);
+		glBindBuffer(COPY_READ_BUFFER, Buffer::getBufferFromPoint(COPY_READ_BUFFER));
+		glBindBuffer(COPY_WRITE_BUFFER, Buffer::getBufferFromPoint(COPY_WRITE_BUFFER));
+		
+		if (glGetError() != GL_NO_ERROR)
+			throw_MagicException("Failed to copy buffer data");
+	}
+	
+	/// get the number of buffers currently in existence
+	static inline int getBufferCount()
+	{
+		return bufferCount;
+	}
 
 
 
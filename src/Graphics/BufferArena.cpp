@@ -0,0 +1,187 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for BufferArena class
+ *
+ * @file BufferArena.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/BufferArena.h>
+
+#include <algorithm>
+
+namespace Magic3D
+{
+
+BufferArena::BufferArena(int capacity, int alignment, Buffer::UsageTypes usage) :
+	usage(usage), alignment(alignment), usedSize(0), generation(0)
+{
+	MAGIC_THROW(alignment <= 0, "Buffer arena alignment must be positive.");
+	this->capacity = this->align(capacity);
+	this->buffer = new Buffer(this->capacity, usage);
+	this->freeBlocks[0] = this->capacity;
+}
+
+BufferArena::~BufferArena()
+{
+	delete this->buffer;
+}
+
+void BufferArena::addFreeBlock(int offset, int size)
+{
+	auto next = this->freeBlocks.lower_bound(offset);
+
+	// merge with the free range after this one
+	if (next != this->freeBlocks.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = this->freeBlocks.erase(next);
+	}
+
+	// merge with the free range before this one
+	if (next != this->freeBlocks.begin())
+	{
+		auto prev = next;
+		prev--;
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	this->freeBlocks[offset] = size;
+}
+
+void BufferArena::grow(int minCapacity)
+{
+	int newCapacity = this->align(std::max(this->capacity * 2, minCapacity));
+
+	Buffer* newBuffer = new Buffer(newCapacity, this->usage);
+	newBuffer->copy(*this->buffer, 0, 0, this->capacity);
+	delete this->buffer;
+	this->buffer = newBuffer;
+
+	this->addFreeBlock(this->capacity, newCapacity - this->capacity);
+	this->capacity = newCapacity;
+	this->generation++;
+}
+
+BufferArena::Handle BufferArena::allocate(int size)
+{
+	size = this->align(size > 0 ? size : 1);
+
+	// first fit
+	auto block = this->freeBlocks.begin();
+	for (; block != this->freeBlocks.end(); block++)
+	{
+		if (block->second >= size)
+			break;
+	}
+
+	// nothing large enough, grow into a free range at the end
+	if (block == this->freeBlocks.end())
+	{
+		this->grow(this->capacity + size);
+		block = this->freeBlocks.end();
+		block--;
+	}
+
+	Allocation allocation;
+	allocation.offset = block->first;
+	allocation.size = size;
+
+	// shrink the free range
+	int remaining = block->second - size;
+	int remainingOffset = block->first + size;
+	this->freeBlocks.erase(block);
+	if (remaining > 0)
+		this->freeBlocks[remainingOffset] = remaining;
+
+	this->usedSize += size;
+
+	// reuse a handle if possible
+	Handle handle;
+	if (!this->freeHandles.empty())
+	{
+		handle = this->freeHandles.back();
+		this->freeHandles.pop_back();
+		this->allocations[handle] = allocation;
+	}
+	else
+	{
+		handle = this->allocations.size();
+		this->allocations.push_back(allocation);
+	}
+	return handle;
+}
+
+void BufferArena::release(Handle handle)
+{
+	MAGIC_THROW(handle < 0 || handle >= (int)this->allocations.size() || 
+		this->allocations[handle].size < 0, "Tried to release an invalid buffer arena handle.");
+
+	Allocation& allocation = this->allocations[handle];
+	this->addFreeBlock(allocation.offset, allocation.size);
+	this->usedSize -= allocation.size;
+
+	allocation.size = -1;
+	this->freeHandles.push_back(handle);
+}
+
+void BufferArena::compact()
+{
+	// already compact if the only free range is at the end
+	if (this->freeBlocks.empty() || (this->freeBlocks.size() == 1 && 
+		this->freeBlocks.begin()->first == this->usedSize))
+		return;
+
+	// live allocations in order of their offset
+	std::vector<Handle> live;
+	for (unsigned int i = 0; i < this->allocations.size(); i++)
+	{
+		if (this->allocations[i].size >= 0)
+			live.push_back(i);
+	}
+	std::sort(live.begin(), live.end(), [&](Handle a, Handle b) -> bool {
+		return this->allocations[a].offset < this->allocations[b].offset;
+	});
+
+	// copy into a new buffer, as ranges of the same buffer can't overlap in a copy
+	Buffer* newBuffer = new Buffer(this->capacity, this->usage);
+	int offset = 0;
+	for (Handle handle : live)
+	{
+		Allocation& allocation = this->allocations[handle];
+		newBuffer->copy(*this->buffer, allocation.offset, offset, allocation.size);
+		allocation.offset = offset;
+		offset += allocation.size;
+	}
+	delete this->buffer;
+	this->buffer = newBuffer;
+
+	this->freeBlocks.clear();
+	if (offset < this->capacity)
+		this->freeBlocks[offset] = this->capacity - offset;
+	this->generation++;
+}
+
+
+};
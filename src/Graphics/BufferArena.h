@@ -0,0 +1,183 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for BufferArena class 
+ * 
+ * @file BufferArena.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_BUFFER_ARENA_H
+#define MAGIC3D_BUFFER_ARENA_H
+
+#include "Buffer.h"
+#include "../Util/magic_throw.h"
+
+#include <vector>
+#include <map>
+
+namespace Magic3D
+{
+
+/** Sub-allocates ranges of one large buffer, so that many small
+ * pieces of data (such as the vertices of static meshes) can share
+ * a single buffer. Allocations are referred to by handles, which stay
+ * valid when the arena grows or is compacted and the data moves.
+ */
+class BufferArena
+{
+public:
+	/// handle to an allocation within the arena
+	typedef int Handle;
+
+	/// handle that refers to no allocation
+	static const Handle NULL_HANDLE = -1;
+
+private:
+	/// a range of the buffer in use
+	struct Allocation
+	{
+		int offset;
+		int size;
+	};
+
+	/// the buffer being sub-allocated, replaced when growing or compacting
+	Buffer* buffer;
+
+	/// usage of the buffer
+	Buffer::UsageTypes usage;
+
+	/// size (in bytes) of the buffer
+	int capacity;
+
+	/// all offsets and sizes are multiples of this
+	int alignment;
+
+	/// number of bytes in use by allocations
+	int usedSize;
+
+	/// allocations, indexed by handle, unused handles have a negative size
+	std::vector<Allocation> allocations;
+
+	/// handles that can be reused
+	std::vector<Handle> freeHandles;
+
+	/// free ranges of the buffer, offset to size
+	std::map<int, int> freeBlocks;
+
+	/// incremented every time the data moves to a different buffer
+	int generation;
+
+	/// round a size up to the alignment
+	inline int align(int size) const
+	{
+		return ((size + alignment - 1) / alignment) * alignment;
+	}
+
+	/// return a range to the free list, merging it with its neighbours
+	void addFreeBlock(int offset, int size);
+
+	/// grow the buffer to at least the given capacity, keeping all data
+	void grow(int minCapacity);
+
+public:
+	/** Standard Constructor
+	 * @param capacity the initial size (in bytes) of the buffer
+	 * @param alignment all offsets into the buffer will be a multiple of this
+	 * @param usage the planned usage of the buffer
+	 */
+	BufferArena(int capacity, int alignment = 4, Buffer::UsageTypes usage = Buffer::STATIC_DRAW);
+
+	/// destructor
+	~BufferArena();
+
+	/** allocate a range of the buffer, growing the buffer if there is no
+	 * free range large enough
+	 * @param size the size (in bytes) needed
+	 * @return handle to the allocation
+	 */
+	Handle allocate(int size);
+
+	/// release an allocation, making its range available again
+	void release(Handle handle);
+
+	/** fill an allocation with data
+	 * @param handle the allocation to fill
+	 * @param data the data to copy, at most the size of the allocation
+	 * @param size the size of the data
+	 */
+	inline void write(Handle handle, const void* data, int size)
+	{
+		MAGIC_THROW(size > this->getSize(handle), "Tried to write past the end of a buffer arena allocation.");
+		this->buffer->fill(this->getOffset(handle), size, data);
+	}
+
+	/// move all allocations to the start of the buffer, leaving one free range at the end
+	void compact();
+
+	/// get the offset (in bytes) of an allocation in the buffer
+	inline int getOffset(Handle handle) const
+	{
+		return this->allocations[handle].offset;
+	}
+
+	/// get the size (in bytes) of an allocation
+	inline int getSize(Handle handle) const
+	{
+		return this->allocations[handle].size;
+	}
+
+	/// get the buffer that is sub-allocated, changes when the generation changes
+	inline const Buffer& getBuffer() const
+	{
+		return *this->buffer;
+	}
+
+	/// get the generation of the buffer, changes when data moves to a new buffer
+	inline int getGeneration() const
+	{
+		return this->generation;
+	}
+
+	inline int getCapacity() const
+	{
+		return this->capacity;
+	}
+
+	inline int getUsedSize() const
+	{
+		return this->usedSize;
+	}
+
+	/// get the number of free ranges, a measure of fragmentation
+	inline int getFreeBlockCount() const
+	{
+		return this->freeBlocks.size();
+	}
+
+	inline int getAllocationCount() const
+	{
+		return this->allocations.size() - this->freeHandles.size();
+	}
+};
+
+
+};
+
+
+#endif
@@ -0,0 +1,63 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for GLStateCache class
+ *
+ * @file GLStateCache.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/GLStateCache.h>
+
+namespace Magic3D
+{
+
+const GLenum GLStateCache::capabilityEnums[ MAX_CAPABILITIES ] =
+{
+    GL_BLEND,
+    GL_CULL_FACE,
+    GL_DEPTH_TEST,
+    GL_LINE_SMOOTH,
+    GL_POLYGON_OFFSET_FILL
+};
+
+void GLStateCache::invalidate()
+{
+    this->program = UNKNOWN;
+    this->activeTextureUnit = UNKNOWN;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        this->textures[i] = UNKNOWN;
+    for (int i = 0; i < MAX_UNIFORM_BUFFERS; i++)
+    {
+        this->uniformBuffers[i] = UNKNOWN;
+        this->uniformBufferOffsets[i] = UNKNOWN;
+    }
+    for (int i = 0; i < MAX_CAPABILITIES; i++)
+        this->capabilities[i] = UNKNOWN;
+    this->depthMask = UNKNOWN;
+    this->blendSrc = UNKNOWN;
+    this->blendDst = UNKNOWN;
+    this->polygonMode = UNKNOWN;
+    this->polygonOffsetFactor = 0.0f;
+    this->polygonOffsetUnits = 0.0f;
+    this->polygonOffsetKnown = false;
+}
+
+
+};
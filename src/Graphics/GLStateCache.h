@@ -0,0 +1,283 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for GLStateCache class
+ *
+ * @file GLStateCache.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_GL_STATE_CACHE_H
+#define MAGIC3D_GL_STATE_CACHE_H
+
+#ifdef _WIN32
+#include <gl/glew.h>
+#include <gl/gl.h>
+#else
+#include <glew.h>
+#include <gl.h>
+#endif
+
+#include "Texture.h"
+#include "Buffer.h"
+#include "../Util/magic_assert.h"
+
+namespace Magic3D
+{
+
+/** Shadows the parts of the openGL state that change between materials,
+ * so that setting state to the value it already has costs no driver call.
+ * All state set through the cache must only be set through the cache; if
+ * anything else changes it, call invalidate() before using the cache again.
+ */
+class GLStateCache
+{
+public:
+    /// the capabilities shadowed by the cache
+    enum Capability
+    {
+        BLEND = 0,
+        CULL_FACE,
+        DEPTH_TEST,
+        LINE_SMOOTH,
+        POLYGON_OFFSET_FILL,
+        MAX_CAPABILITIES
+    };
+
+    /// number of texture units shadowed by the cache
+    static const int MAX_TEXTURE_UNITS = 16;
+
+    /// number of uniform buffer bindings shadowed by the cache
+    static const int MAX_UNIFORM_BUFFERS = 8;
+
+private:
+    /// value of shadowed state that has not been set through the cache yet
+    static const int UNKNOWN = -1;
+
+    /// the gl enum for each of the capabilities
+    static const GLenum capabilityEnums[ MAX_CAPABILITIES ];
+
+    int program;
+
+    int activeTextureUnit;
+
+    int textures[ MAX_TEXTURE_UNITS ];
+
+    int uniformBuffers[ MAX_UNIFORM_BUFFERS ];
+
+    int uniformBufferOffsets[ MAX_UNIFORM_BUFFERS ];
+
+    int capabilities[ MAX_CAPABILITIES ];
+
+    int depthMask;
+
+    int blendSrc;
+
+    int blendDst;
+
+    int polygonMode;
+
+    float polygonOffsetFactor;
+
+    float polygonOffsetUnits;
+
+    bool polygonOffsetKnown;
+
+    /// number of gl calls made through the cache
+    int issuedCalls;
+
+    /// number of gl calls the cache found redundant and skipped
+    int skippedCalls;
+
+    /** check if a shadowed value needs changing, updating the shadow and
+     * call counters
+     * @param shadow the shadowed value
+     * @param value the value to set
+     * @return true if the value differs and the gl call must be made
+     */
+    inline bool change(int& shadow, int value)
+    {
+        if (shadow == value)
+        {
+            this->skippedCalls++;
+            return false;
+        }
+        shadow = value;
+        this->issuedCalls++;
+        return true;
+    }
+
+public:
+    /// standard constructor
+    inline GLStateCache(): issuedCalls(0), skippedCalls(0)
+    {
+        this->invalidate();
+    }
+
+    /// forget all shadowed state, so the next set of each state is always made
+    void invalidate();
+
+    /** use a gpu program
+     * @param programId the id of the program to use
+     */
+    inline void useProgram(GLuint programId)
+    {
+        if (this->change(this->program, (int)programId))
+            glUseProgram(programId);
+    }
+
+    /** make a texture unit the active unit
+     * @param unit the index of the unit
+     */
+    inline void setActiveTextureUnit(int unit)
+    {
+        if (this->change(this->activeTextureUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    /** bind a texture to a texture unit
+     * @param unit the index of the unit
+     * @param texture the texture to bind
+     */
+    inline void bindTexture(int unit, const Texture& texture)
+    {
+        MAGIC_ASSERT(unit >= 0 && unit < MAX_TEXTURE_UNITS);
+        if (this->textures[unit] == (int)texture.getID())
+        {
+            this->skippedCalls++;
+            return;
+        }
+        this->setActiveTextureUnit(unit);
+        this->change(this->textures[unit], (int)texture.getID());
+        glBindTexture(GL_TEXTURE_2D, texture.getID());
+    }
+
+    /** bind a range of a buffer to a uniform block binding
+     * @param index the index of the binding
+     * @param buffer the buffer holding the uniform data
+     * @param offset the offset (in bytes) of the block's data
+     * @param size the size (in bytes) of the block's data
+     */
+    inline void bindUniformBuffer(int index, const Buffer& buffer, int offset, int size)
+    {
+        MAGIC_ASSERT(index >= 0 && index < MAX_UNIFORM_BUFFERS);
+        if (this->uniformBuffers[index] == (int)buffer.getId() && this->uniformBufferOffsets[index] == offset)
+        {
+            this->skippedCalls++;
+            return;
+        }
+        this->uniformBuffers[index] = buffer.getId();
+        this->uniformBufferOffsets[index] = offset;
+        this->issuedCalls++;
+        buffer.bindRange(Buffer::UNIFORM_BUFFER, index, offset, size);
+    }
+
+    /** enable or disable a capability
+     * @param capability the capability to set
+     * @param enable whether to enable or disable it
+     */
+    inline void setCapability(Capability capability, bool enable)
+    {
+        if (this->change(this->capabilities[capability], enable ? 1 : 0))
+        {
+            if (enable)
+                glEnable(capabilityEnums[capability]);
+            else
+                glDisable(capabilityEnums[capability]);
+        }
+    }
+
+    /** set whether depth buffer writes are enabled
+     * @param write true to write to the depth buffer
+     */
+    inline void setDepthMask(bool write)
+    {
+        if (this->change(this->depthMask, write ? 1 : 0))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    /** set the blend function
+     * @param src the source factor
+     * @param dst the destination factor
+     */
+    inline void setBlendFunc(GLenum src, GLenum dst)
+    {
+        if (this->blendSrc == (int)src && this->blendDst == (int)dst)
+        {
+            this->skippedCalls++;
+            return;
+        }
+        this->blendSrc = src;
+        this->blendDst = dst;
+        this->issuedCalls++;
+        glBlendFunc(src, dst);
+    }
+
+    /** set the polygon rasterization mode for front and back faces
+     * @param mode GL_FILL, GL_LINE or GL_POINT
+     */
+    inline void setPolygonMode(GLenum mode)
+    {
+        if (this->change(this->polygonMode, (int)mode))
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+
+    /** set the polygon depth offset
+     * @param factor the depth slope factor
+     * @param units the constant offset in depth units
+     */
+    inline void setPolygonOffset(float factor, float units)
+    {
+        if (this->polygonOffsetKnown && this->polygonOffsetFactor == factor &&
+            this->polygonOffsetUnits == units)
+        {
+            this->skippedCalls++;
+            return;
+        }
+        this->polygonOffsetKnown = true;
+        this->polygonOffsetFactor = factor;
+        this->polygonOffsetUnits = units;
+        this->issuedCalls++;
+        glPolygonOffset(factor, units);
+    }
+
+    /// get the number of gl calls made through the cache since the last reset
+    inline int getIssuedCallCount() const
+    {
+        return this->issuedCalls;
+    }
+
+    /// get the number of redundant gl calls skipped since the last reset
+    inline int getSkippedCallCount() const
+    {
+        return this->skippedCalls;
+    }
+
+    /// reset the issued and skipped call counters
+    inline void resetCallCounts()
+    {
+        this->issuedCalls = 0;
+        this->skippedCalls = 0;
+    }
+};
+
+
+};
+
+
+#endif
@@ -95,6 +95,9 @@ void GraphicsSystem::createScreen()
     if ( screen == NULL )
         throw_MagicException( "Failed to create display screen" );
     glViewport(0, 0, displayWidth, displayHeight);
+
+    // the screen may come with a new context, so nothing shadowed can be trusted
+    stateCache.invalidate();
 }
     
     
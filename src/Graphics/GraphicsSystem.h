@@ -39,6 +39,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../Exceptions/MagicException.h"
 #include "../Util/Color.h"
+#include "GLStateCache.h"
 
 namespace Magic3D
 {
@@ -60,6 +61,9 @@ private:
     
     int displayHeight;
 
+    /// shadow of the gl state, to skip redundant state changes
+    GLStateCache stateCache;
+
 public:
     /// standard constructor
     inline GraphicsSystem(): initialized(false), screen(NULL), displayWidth(640),
@@ -126,30 +130,36 @@ public:
     
     inline void enableBlending()
     {
-        glEnable (GL_BLEND); 
-        glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        stateCache.setCapability(GLStateCache::BLEND, true);
+        stateCache.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
 
     inline void setDepthOffset(float offset )
     {
-        glPolygonOffset(offset, offset);   
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        stateCache.setPolygonOffset(offset, offset);
+        stateCache.setCapability(GLStateCache::POLYGON_OFFSET_FILL, true);
     }
     
     inline void disableDepthOffset()
     {
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        stateCache.setCapability(GLStateCache::POLYGON_OFFSET_FILL, false);
     }
     
     inline void enableDepthTest()
     {
-        glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
+        stateCache.setCapability(GLStateCache::DEPTH_TEST, true);
+        stateCache.setCapability(GLStateCache::CULL_FACE, true);
     }
     
     inline void disableDepthTest()
     {
-        glDisable(GL_DEPTH_TEST);
+        stateCache.setCapability(GLStateCache::DEPTH_TEST, false);
+    }
+
+    /// get the cache all gl state changes made for rendering go through
+    inline GLStateCache& getStateCache()
+    {
+        return this->stateCache;
     }
     
     inline void setClearColor( const Color& color )
@@ -19,7 +19,6 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <Graphics/Mesh.h>
-#include <CollisionShapes\TriangleMeshCollisionShape.h>
 #include <Graphics\MeshBuilder.h>
 
 namespace Magic3D
@@ -28,7 +27,11 @@ namespace Magic3D
 Mesh::~Mesh()
 {
 	delete[] attributeData;
+	if (externalData == nullptr)
+		delete[] vertexData;
 	delete vertexArray;
+	delete vertexBuffer;
+	delete indexData;
 }
 
 const VertexArray& Mesh::getVertexArray()
@@ -38,30 +41,97 @@ const VertexArray& Mesh::getVertexArray()
 
 	this->vertexArray = new VertexArray();
     
-    // go through all attributes in batch and copy data into video
-    // memory buffer
+    // copy the interleaved data into a single video memory buffer and
+    // point each attribute at its offset within a vertex
+    this->vertexBuffer = new Buffer( this->vertexCount * this->vertexStride, this->vertexData, Buffer::STATIC_DRAW );
     for (int i=0; i < this->attributeCount; i++)
     {
         Mesh::AttributeData& d = this->attributeData[i];
-        d.buffer.allocate( d.dataLen, d.data, Buffer::STATIC_DRAW ); // TODO: determine if this should be static draw
 		this->vertexArray->setAttributeArray(
 			(int)d.type,
-			GpuProgram::attributeTypeCompCount[(int)d.type],
-			VertexArray::FLOAT, // make this dynamic per each attribute
-			d.buffer
+			d.components,
+			d.dataType,
+			*this->vertexBuffer,
+			this->vertexStride,
+			d.offset,
+			d.normalized
 		);
     }
 
+    // indexed meshes also get their indices into an element array
+    if (this->indexData != nullptr)
+    {
+        this->indexData->buffer = new Buffer( this->indexData->dataLen, this->indexData->data, Buffer::STATIC_DRAW );
+        this->vertexArray->setIndexArray(*this->indexData->buffer);
+    }
+
 	return *this->vertexArray;
 }
+
+void Mesh::releaseVertexArray()
+{
+	delete this->vertexArray;
+	this->vertexArray = nullptr;
+	delete this->vertexBuffer;
+	this->vertexBuffer = nullptr;
+	if (this->indexData != nullptr)
+	{
+		delete this->indexData->buffer;
+		this->indexData->buffer = nullptr;
+	}
+}
 	
+void Mesh::drawInstanced(const Buffer& instanceBuffer, int firstInstance, int instanceCount)
+{
+	this->getVertexArray();
+
+	// the instance matrices are only attached to the vertex array for this draw
+	this->vertexArray->setInstanceMatrixArray(GpuProgram::INSTANCE_MATRIX_LOCATION, instanceBuffer,
+		firstInstance * sizeof(GLfloat) * 16);
+	if (this->indexData != nullptr)
+		this->vertexArray->drawElementsInstanced(this->primitive, this->indexData->count, 
+			this->indexData->type, instanceCount);
+	else
+		this->vertexArray->drawInstanced(this->primitive, this->vertexCount, instanceCount);
+	this->vertexArray->disableInstanceMatrixArray(GpuProgram::INSTANCE_MATRIX_LOCATION);
+}
+
+void Mesh::calculateBounds()
+{
+    for (int i = 0; i < this->attributeCount; i++)
+    {
+        // positions are never packed, so they can be read straight from the vertex data
+        const AttributeData& attr = this->attributeData[i];
+        if (attr.type == GpuProgram::VERTEX)
+        {
+            this->bounds = Bounds(this->vertexData + attr.offset, this->vertexStride, this->vertexCount);
+            return;
+        }
+    }
+    this->bounds = Bounds();
+}
+
+const Bounds& Meshes::getBounds()
+{
+    // lazy init, redone if meshes were added since
+    if (this->boundsMeshCount != this->size())
+    {
+        this->bounds = Bounds();
+        for (auto mesh : *this)
+            this->bounds.merge(mesh->getBounds());
+        this->boundsMeshCount = this->size();
+    }
+
+    return this->bounds;
+}
+
 const SphereCollisionShape& Meshes::getBoundingSphere()
 {
     // lazy init
     if (this->boundingSphere == nullptr)
     {
-        TriangleMeshCollisionShape realShape(*this);
-        this->boundingSphere = realShape.getBoundingSphere();
+        const Bounds& bounds = this->getBounds();
+        this->boundingSphere = std::make_shared<SphereCollisionShape>(bounds.getRadius(), bounds.getCenter());
     }
 
     return (*this->boundingSphere);
@@ -123,7 +193,7 @@ Mesh& Mesh::getVisibleNormals()
                 vertex.position().z() + vertex.tangent().z()
             ));
 
-            Vector3 biTangent = vertex.normal() * vertex.tangent();
+            Vector3 biTangent = vertex.normal() * vertex.tangent() * vertex.bitangentSign();
 
             mb.addVertex(vertex.position());
             mb.addVertex(Vector3(
@@ -142,14 +212,86 @@ Mesh& Mesh::getVisibleNormals()
 
 std::shared_ptr<Mesh> Mesh::applyTransform(const Matrix4& matrix) const
 {
-    MeshBuilderPTNT mb(this->vertexCount, this->primitive);
-    for (int j = 0; j < this->getVertexCount(); j++)
+    // copy the mesh as is, keeping any indices and packing, and transform the positions in place
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(*this);
+    for (int i = 0; i < mesh->attributeCount; i++)
+    {
+        const AttributeData& attr = mesh->attributeData[i];
+        if (attr.type != GpuProgram::VERTEX)
+            continue;
+
+        for (int j = 0; j < mesh->vertexCount; j++)
+        {
+            char* data = &mesh->vertexData[j * mesh->vertexStride + attr.offset];
+            Scalar position[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            unpackAttr(attr, data, position);
+            Vector3 transformed = Vector3(position).transform(matrix);
+            position[0] = transformed.x();
+            position[1] = transformed.y();
+            position[2] = transformed.z();
+            packAttr(attr, data, position);
+        }
+    }
+    mesh->calculateBounds();
+    return mesh;
+}
+
+bool Mesh::hasSameLayout(const Mesh& mesh) const
+{
+    if (mesh.vertexStride != this->vertexStride || mesh.attributeCount != this->attributeCount ||
+        mesh.primitive != this->primitive)
+        return false;
+
+    for (int i = 0; i < this->attributeCount; i++)
+    {
+        const AttributeData& a = this->attributeData[i];
+        const AttributeData& b = mesh.attributeData[i];
+        if (a.type != b.type || a.dataType != b.dataType || a.components != b.components ||
+            a.offset != b.offset || a.normalized != b.normalized)
+            return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Mesh> Mesh::merge(const std::vector<const Mesh*>& meshes)
+{
+    MAGIC_THROW(meshes.empty(), "Tried to merge an empty list of meshes.");
+    const Mesh& first = *meshes[0];
+    MAGIC_THROW(!isListPrimitive(first.primitive), "Tried to merge meshes of strips, loops or fans.");
+
+    int vertexCount = 0;
+    int indexCount = 0;
+    for (const Mesh* mesh : meshes)
     {
-        auto vertex = this->getVertex(j);
-        vertex.position(Vector3(vertex.position().getData()).transform(matrix));
-        mb.addVertex(vertex);
+        MAGIC_THROW(!first.hasSameLayout(*mesh), "Tried to merge meshes with different vertex layouts.");
+        vertexCount += mesh->vertexCount;
+        indexCount += mesh->getElementCount();
     }
-    return mb.build();
+
+    std::shared_ptr<Mesh> merged = std::make_shared<Mesh>();
+    merged->allocate(vertexCount, first.attributeCount);
+    memcpy(merged->attributeData, first.attributeData, sizeof(AttributeData) * first.attributeCount);
+    merged->vertexStride = first.vertexStride;
+    merged->primitive = first.primitive;
+    merged->vertexData = new char[vertexCount * first.vertexStride];
+    merged->indexData = new IndexData();
+    merged->indexData->allocate(indexCount, vertexCount);
+
+    // copy the vertices after each other, offsetting each mesh's indices by its first vertex
+    int vertex = 0;
+    int index = 0;
+    for (const Mesh* mesh : meshes)
+    {
+        memcpy(&merged->vertexData[vertex * first.vertexStride], mesh->vertexData, 
+            mesh->vertexCount * first.vertexStride);
+        int elementCount = mesh->getElementCount();
+        for (int i = 0; i < elementCount; i++)
+            merged->indexData->set(index++, vertex + mesh->getIndex(i));
+        vertex += mesh->vertexCount;
+    }
+
+    merged->calculateBounds();
+    return merged;
 }
 
 	
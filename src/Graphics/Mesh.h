@@ -26,9 +26,11 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #define MAGIC3D_MESH_H
 
 #include "../Exceptions/MagicException.h"
+#include "../Util/magic_throw.h"
 #include "Buffer.h"
 #include "VertexArray.h"
 #include "Texture.h"
+#include "Bounds.h"
 #include <Shaders/GpuProgram.h>
 #include <CollisionShapes\SphereCollisionShape.h>
 #include <Shapes\Vertex.h>
@@ -36,6 +38,9 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <memory>
 #include <string.h>
+#include <math.h>
+
+class btOptimizedBvh;
 
 namespace Magic3D
 {
@@ -49,41 +54,130 @@ class MeshBuilder;
 class Mesh
 {
 public:
-	/// data for a attribute, ready to be bound to a shader
+	/// packed formats that vertex attributes can be stored in
+	enum Packing
+	{
+		PACK_NONE = 0,
+		PACK_HALF_TEX_COORDS = 1,	// texture coordinates as half floats
+		PACK_NORMALS = 2,			// normals and tangents as normalized INT_2_10_10_10_REV, the bitangent sign in w
+		PACK_ALL = PACK_HALF_TEX_COORDS | PACK_NORMALS
+	};
+
+	/// get the packed formats the current OpenGL implementation can read as vertex attributes
+	static inline int getSupportedPacking()
+	{
+		int packing = PACK_NONE;
+		if (GLEW_VERSION_3_0 || GLEW_ARB_half_float_vertex)
+			packing |= PACK_HALF_TEX_COORDS;
+		if (GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev)
+			packing |= PACK_NORMALS;
+		return packing;
+	}
+
+	/// layout of an attribute within the interleaved vertex data, ready to be bound to a shader
 	struct AttributeData
 	{
-	    /// attribute data in a buffer on graphics memory
-		Buffer buffer;
 		/// auto-bound attribute type for data
 		GpuProgram::AttributeType type;
-		/// current data in batch
-		float* data;
+		/// data type each component is stored as
+		VertexArray::DataTypes dataType;
+		/// number of components stored per vertex
+		int components;
+		/// offset (in bytes) of the attribute from the start of a vertex
+		int offset;
+		/// whether the shader reads fixed point data as normalized floats
+		bool normalized;
+
+		/// get the size (in bytes) of the attribute for a single vertex
+		inline int getSize() const
+		{
+			if (this->dataType == VertexArray::INT_2_10_10_10_REV)
+				return 4; // all components packed into one int
+			return VertexArray::getDataTypeSize(this->dataType) * this->components;
+		}
+	};
+
+	/// index data for a indexed mesh, ready to be bound as an element array
+	struct IndexData
+	{
+		/// index data in a buffer on graphics memory, created on first use on the GL thread
+		Buffer* buffer;
+		/// size of each index, either UNSIGNED_SHORT or UNSIGNED_INT
+		VertexArray::DataTypes type;
+		/// current index data
+		void* data;
+		/// number of indices
+		int count;
 		/// current length of data (in bytes)
 		int dataLen;
+		/// false if data points into memory owned by someone else, such as a mapped file
+		bool ownsData;
 
-		inline AttributeData() : data(NULL), dataLen(0) {}
+		inline IndexData() : buffer(nullptr), data(NULL), count(0), dataLen(0), ownsData(true) {}
 
-		inline ~AttributeData()
+		inline ~IndexData()
 		{
-			delete[] data;
+			delete buffer;
+			if (ownsData)
+				delete[] (char*)data;
 		}
-		inline void allocate(int vertexCount, GpuProgram::AttributeType type)
+
+		/// allocate space for indices, using 16-bit indices when the vertex count allows it
+		inline void allocate(int indexCount, int vertexCount)
 		{
-			delete[] data;
-			this->type = type;
-			this->dataLen = vertexCount * GpuProgram::attributeTypeCompCount[(int)type] * sizeof(float);
-			this->data = new float[vertexCount * GpuProgram::attributeTypeCompCount[(int)type]];
+			if (ownsData)
+				delete[] (char*)data;
+			this->ownsData = true;
+			this->type = vertexCount <= 0xFFFF ? VertexArray::UNSIGNED_SHORT : VertexArray::UNSIGNED_INT;
+			this->count = indexCount;
+			this->dataLen = indexCount * VertexArray::getDataTypeSize(this->type);
+			this->data = new char[this->dataLen];
+		}
+
+		inline void set(int index, unsigned int value)
+		{
+			if (this->type == VertexArray::UNSIGNED_SHORT)
+				((unsigned short*)this->data)[index] = (unsigned short)value;
+			else
+				((unsigned int*)this->data)[index] = value;
+		}
+
+		inline unsigned int get(int index) const
+		{
+			if (this->type == VertexArray::UNSIGNED_SHORT)
+				return ((unsigned short*)this->data)[index];
+			return ((unsigned int*)this->data)[index];
 		}
 	};
 
 private:	
     template<typename... AttrTypes>
 	friend class MeshBuilder;
+	friend class MeshLoaderBaked;
 
-	/// list of attribute data
+	/// layout of each attribute
 	AttributeData* attributeData;
+
+	/// interleaved data of all vertices
+	char* vertexData;
+
+	/** owner of the memory the vertex and index data are in, when the
+	 * mesh doesn't own them, such as a mapped baked mesh file
+	 */
+	std::shared_ptr<void> externalData;
+
+	/// size (in bytes) of a single vertex in the interleaved data
+	int vertexStride;
+
+	/** interleaved vertex data in a buffer on graphics memory, created on first 
+	 * use so meshes can be built on threads without a GL context
+	 */
+	Buffer* vertexBuffer;
+
+	/// index data, null if the mesh is not indexed
+	IndexData* indexData;
 	
-	/// number of verticies in mesh
+	/// number of (unique) verticies in mesh
 	int vertexCount;
 	
 	/// number of attributes
@@ -93,32 +187,61 @@ private:
 
 	VertexArray* vertexArray;
 
+	/// bounds of the vertex positions
+	Bounds bounds;
+
+	/// compute the bounds from the vertex positions
+	void calculateBounds();
+
 	inline void allocate(int vertexCount, int attributeCount)
 	{
-		// free any previous data in batch
+		// free any previous data in batch, unless it is owned by someone else
 		delete[] this->attributeData;
+		if (this->externalData == nullptr)
+			delete[] this->vertexData;
+		this->externalData = nullptr;
 
-		// setup mesh
+		// setup mesh, vertex data is allocated once the layout is known
 		this->vertexCount = vertexCount;
 		this->attributeCount = attributeCount;
 		this->attributeData = new AttributeData[attributeCount];
+		this->vertexData = nullptr;
+		this->vertexStride = 0;
 	}
 
 	void copyBatchIn();
 
     std::shared_ptr<Mesh> visibleNormals;
 
-    inline void allocateAttrs(int index)
+    inline void setupAttrs(int /*index*/, int /*packing*/)
     {
         return; // on purpose
     }
 
     template<typename... AttrTypeIds>
-    inline void allocateAttrs(int index, GpuProgram::AttributeType id, AttrTypeIds... ids)
+    inline void setupAttrs(int index, int packing, GpuProgram::AttributeType id, AttrTypeIds... ids)
     {
-        this->attributeData[index].allocate(this->vertexCount, id);
+        AttributeData& attr = this->attributeData[index];
+        attr.type = id;
+        attr.dataType = VertexArray::FLOAT;
+        attr.components = GpuProgram::attributeTypeCompCount[(int)id];
+        attr.normalized = false;
+        attr.offset = this->vertexStride;
+
+        if ((packing & PACK_HALF_TEX_COORDS) && id >= GpuProgram::TEX_COORD_0 && id <= GpuProgram::TEX_COORD_7)
+        {
+            attr.dataType = VertexArray::HALF_FLOAT;
+        }
+        else if ((packing & PACK_NORMALS) && (id == GpuProgram::NORMAL || id == GpuProgram::TANGENT))
+        {
+            attr.dataType = VertexArray::INT_2_10_10_10_REV;
+            attr.components = 4;
+            attr.normalized = true;
+        }
+
+        this->vertexStride += attr.getSize();
 
-        allocateAttrs(++index, ids...);
+        setupAttrs(++index, packing, ids...);
     }
 
     inline void fillInAttr(int attributeIndex, int vertexIndex)
@@ -130,45 +253,160 @@ private:
     inline void fillInAttr(int attributeIndex, int vertexIndex, VectorType vector,
         VectorTypes... vectors)
     {
-        int compCount = GpuProgram::attributeTypeCompCount[
-            (int)this->attributeData[attributeIndex].type
-        ];
-        memcpy(
-            &this->attributeData[attributeIndex].data[compCount*vertexIndex],
-            vector,
-            sizeof(Scalar)*compCount
-            );
+        const AttributeData& attr = this->attributeData[attributeIndex];
+        packAttr(attr, &this->vertexData[vertexIndex * this->vertexStride + attr.offset], vector);
 
         fillInAttr(++attributeIndex, vertexIndex, vectors...);
     }
+
+    /// convert a float to a half float, rounding to nearest
+    static inline unsigned short floatToHalf(Scalar value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        unsigned int sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+        unsigned int mantissa = bits & 0x7FFFFF;
+
+        if (exponent <= 0)
+        {
+            // too small for a normal half, use a denormal or zero
+            if (exponent < -10)
+                return (unsigned short)sign;
+            mantissa |= 0x800000;
+            return (unsigned short)(sign | (mantissa >> (14 - exponent)));
+        }
+        if (exponent >= 31)
+            return (unsigned short)(sign | 0x7C00); // too large, use infinity
+
+        // rounding may carry into the exponent, which is still correct
+        return (unsigned short)(sign | ((exponent << 10) + ((mantissa + 0x1000) >> 13)));
+    }
+
+    /// convert a half float to a float
+    static inline Scalar halfToFloat(unsigned short half)
+    {
+        unsigned int sign = (half & 0x8000) << 16;
+        unsigned int exponent = (half >> 10) & 0x1F;
+        unsigned int mantissa = half & 0x3FF;
+
+        if (exponent == 0)
+            return (sign ? -1.0f : 1.0f) * ldexp((float)mantissa, -24);
+
+        unsigned int bits = exponent == 31 ? 
+            (sign | 0x7F800000 | (mantissa << 13)) :
+            (sign | ((exponent + 112) << 23) | (mantissa << 13));
+        Scalar value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /// convert a float in [-1, 1] to a 10 bit signed normalized value
+    static inline unsigned int floatToSnorm10(Scalar value)
+    {
+        value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+        int snorm = (int)floor(value * 511.0f + 0.5f);
+        return (unsigned int)snorm & 0x3FF;
+    }
+
+    /// convert a 10 bit signed normalized value to a float in [-1, 1]
+    static inline Scalar snorm10ToFloat(unsigned int bits)
+    {
+        int snorm = (int)(bits << 22) >> 22; // sign extend
+        Scalar value = snorm / 511.0f;
+        return value < -1.0f ? -1.0f : value;
+    }
+
+    /// store an attribute's components in its packed format
+    static inline void packAttr(const AttributeData& attr, char* dest, const Scalar* src)
+    {
+        if (attr.dataType == VertexArray::HALF_FLOAT)
+        {
+            for (int i = 0; i < attr.components; i++)
+                ((unsigned short*)dest)[i] = floatToHalf(src[i]);
+        }
+        else if (attr.dataType == VertexArray::INT_2_10_10_10_REV)
+        {
+            // x, y and z only, w is left as 0 except for the tangent's bitangent sign
+            unsigned int packed = floatToSnorm10(src[0]) | (floatToSnorm10(src[1]) << 10) |
+                (floatToSnorm10(src[2]) << 20);
+            if (attr.type == GpuProgram::TANGENT)
+                packed |= (src[3] < 0.0f ? 3u : 1u) << 30; // 2 bit -1 or 1
+            memcpy(dest, &packed, sizeof(packed));
+        }
+        else
+        {
+            memcpy(dest, src, sizeof(Scalar) * attr.components);
+        }
+    }
+
+    /// read an attribute's components back from its packed format
+    static inline void unpackAttr(const AttributeData& attr, const char* src, Scalar* dest)
+    {
+        if (attr.dataType == VertexArray::HALF_FLOAT)
+        {
+            for (int i = 0; i < attr.components; i++)
+                dest[i] = halfToFloat(((const unsigned short*)src)[i]);
+        }
+        else if (attr.dataType == VertexArray::INT_2_10_10_10_REV)
+        {
+            unsigned int packed;
+            memcpy(&packed, src, sizeof(packed));
+            dest[0] = snorm10ToFloat(packed & 0x3FF);
+            dest[1] = snorm10ToFloat((packed >> 10) & 0x3FF);
+            dest[2] = snorm10ToFloat((packed >> 20) & 0x3FF);
+            if (attr.type == GpuProgram::TANGENT)
+                dest[3] = (packed >> 30) == 3 ? -1.0f : 1.0f;
+        }
+        else
+        {
+            memcpy(dest, src, sizeof(Scalar) * attr.components);
+        }
+    }
 	
 public:
     /// Standard Constructor
-	inline Mesh(): attributeData(nullptr), vertexCount(0), 
-		attributeCount(0), vertexArray(nullptr), visibleNormals(nullptr) {}
+	inline Mesh(): attributeData(nullptr), vertexData(nullptr), vertexStride(0), vertexBuffer(nullptr), indexData(nullptr), 
+		vertexCount(0), attributeCount(0), vertexArray(nullptr), visibleNormals(nullptr) {}
 
     inline Mesh(const Mesh& mesh) :
+        attributeData(nullptr), vertexData(nullptr), vertexStride(0), vertexBuffer(nullptr), indexData(nullptr),
         vertexCount(mesh.vertexCount),
         attributeCount(mesh.attributeCount),
         primitive(mesh.primitive),
-        vertexArray(nullptr), attributeData(nullptr)
+        vertexArray(nullptr)
     {
         this->allocate(vertexCount, attributeCount);
-        for (int i = 0; i < attributeCount; i++)
+        memcpy(this->attributeData, mesh.attributeData, sizeof(AttributeData) * attributeCount);
+        this->vertexStride = mesh.vertexStride;
+        this->vertexData = new char[vertexCount * vertexStride];
+        memcpy(this->vertexData, mesh.vertexData, vertexCount * vertexStride);
+
+        if (mesh.indexData != nullptr)
         {
-            this->attributeData[i].allocate(vertexCount, mesh.attributeData[i].type);
-            memcpy(this->attributeData[i].data, mesh.attributeData[i].data,
-                mesh.attributeData[i].dataLen);
+            this->indexData = new IndexData();
+            this->indexData->allocate(mesh.indexData->count, vertexCount);
+            memcpy(this->indexData->data, mesh.indexData->data, mesh.indexData->dataLen);
         }
+        this->bounds = mesh.bounds;
     }
 
+    /** Constructor
+     * @param vertices the vertices of the mesh
+     * @param primitive the primitive the vertices describe
+     * @param packing the Packing flags for the vertex data
+     */
     template<typename... AttrTypes>
-    inline Mesh(const std::vector<Vertex<AttrTypes...>>& vertices, VertexArray::Primitives primitive) : 
-        vertexArray(nullptr), attributeData(nullptr), primitive(primitive)
+    inline Mesh(const std::vector<Vertex<AttrTypes...>>& vertices, VertexArray::Primitives primitive,
+        int packing = PACK_NONE) : 
+        attributeData(nullptr), vertexData(nullptr), vertexStride(0), vertexBuffer(nullptr), indexData(nullptr), 
+        vertexCount(0), attributeCount(0), primitive(primitive), vertexArray(nullptr)
     {
         this->allocate(vertices.size(), Vertex<AttrTypes...>::attributeCount);
         
-        this->allocateAttrs(0, AttrTypes::type...);
+        // lay out the attributes of the vertex type one after the other
+        this->setupAttrs(0, packing, AttrTypes::type...);
+        this->vertexData = new char[this->vertexCount * this->vertexStride];
 
         for (unsigned int i = 0; i < vertices.size(); i++)
         {
@@ -178,6 +416,25 @@ public:
                 vertices[i].AttrTypes::getData()...
             );
         }
+        this->calculateBounds();
+    }
+
+    /** Constructor for an indexed mesh
+     * @param vertices the unique vertices of the mesh
+     * @param indices indices into vertices, one per vertex drawn
+     * @param primitive the primitive the indices describe
+     * @param packing the Packing flags for the vertex data
+     */
+    template<typename... AttrTypes>
+    inline Mesh(const std::vector<Vertex<AttrTypes...>>& vertices, 
+        const std::vector<unsigned int>& indices, VertexArray::Primitives primitive,
+        int packing = PACK_NONE) :
+        Mesh(vertices, primitive, packing)
+    {
+        this->indexData = new IndexData();
+        this->indexData->allocate(indices.size(), this->vertexCount);
+        for (unsigned int i = 0; i < indices.size(); i++)
+            this->indexData->set(i, indices[i]);
     }
 
 	/// destructor
@@ -188,38 +445,95 @@ public:
 	    return attributeCount;
 	}
 	
+	/// get the number of vertices stored in the mesh
 	inline int getVertexCount() const
 	{
 	    return vertexCount;
 	}
 
-    // TODO: change to work for all vertex types
+	inline bool isIndexed() const
+	{
+		return this->indexData != nullptr;
+	}
+
+	/// get the number of vertices drawn for the mesh, the index count for indexed meshes
+	inline int getElementCount() const
+	{
+		return this->indexData != nullptr ? this->indexData->count : this->vertexCount;
+	}
+
+	/// get the vertex index used for a drawn element
+	inline int getIndex(int element) const
+	{
+		return this->indexData != nullptr ? (int)this->indexData->get(element) : element;
+	}
+
+	inline VertexArray::DataTypes getIndexType() const
+	{
+		MAGIC_THROW(this->indexData == nullptr, "Tried to get index type of a mesh that is not indexed.");
+		return this->indexData->type;
+	}
+
+	/// get the layout of an attribute within the interleaved vertex data
+	inline const AttributeData& getAttribute(int index) const
+	{
+		return this->attributeData[index];
+	}
+
+	/// get the interleaved data of all vertices
+	inline const char* getVertexData() const
+	{
+		return this->vertexData;
+	}
+
+	/// get the index data, null if the mesh is not indexed
+	inline const void* getIndexData() const
+	{
+		return this->indexData != nullptr ? this->indexData->data : nullptr;
+	}
+
+	/// get the size (in bytes) of the index data
+	inline int getIndexDataSize() const
+	{
+		return this->indexData != nullptr ? this->indexData->dataLen : 0;
+	}
+
+	/// get the size (in bytes) of the data for a single vertex
+	inline int getVertexSize() const
+	{
+		return this->vertexStride;
+	}
+
+	/// get the size (in bytes) of the vertex and index data of the mesh
+	inline int getDataSize() const
+	{
+		int size = this->getVertexSize() * this->vertexCount;
+		if (this->indexData != nullptr)
+			size += this->indexData->dataLen;
+		return size;
+	}
+
+    /// get a vertex of the mesh, attributes the mesh doesn't have are left zeroed
     inline const VertexPTNT getVertex(int index) const
     {
-        if (this->attributeCount == 2)
+        VertexPTNT vertex;
+        Scalar data[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const char* src = &this->vertexData[index * this->vertexStride];
+        for (int i = 0; i < this->attributeCount; i++)
         {
-            return VertexPTN(
-                PositionAttr(&this->attributeData[0].data[index * 4]),
-                TexCoordAttr(&this->attributeData[1].data[index * 2])
-            );
-        }
-        else if (this->attributeCount == 3)
-        {
-            return VertexPTN(
-                PositionAttr(&this->attributeData[0].data[index * 4]),
-                TexCoordAttr(&this->attributeData[1].data[index * 2]),
-                NormalAttr(&this->attributeData[2].data[index * 3])
-            );
-        }
-        else
-        {
-            return VertexPTNT(
-                PositionAttr(&this->attributeData[0].data[index * 4]),
-                TexCoordAttr(&this->attributeData[1].data[index * 2]),
-                NormalAttr(&this->attributeData[2].data[index * 3]),
-                TangentAttr(&this->attributeData[3].data[index * 3])
-                );
+            const AttributeData& attr = this->attributeData[i];
+            data[3] = 1.0f; // for attributes stored without w
+            unpackAttr(attr, src + attr.offset, data);
+            switch (attr.type)
+            {
+                case GpuProgram::VERTEX:      vertex.position(data[0], data[1], data[2], data[3]); break;
+                case GpuProgram::TEX_COORD_0: vertex.texCoord(Vector2(data)); break;
+                case GpuProgram::NORMAL:      vertex.normal(Vector3(data)); break;
+                case GpuProgram::TANGENT:     vertex.tangent(Vector3(data), data[3]); break;
+                default: break;
+            }
         }
+        return vertex;
     }
 
 	inline VertexArray::Primitives getPrimitive() const
@@ -227,11 +541,45 @@ public:
 		return this->primitive;
 	}
 
+	/// get the bounds of the vertex positions, in the mesh's local space
+	inline const Bounds& getBounds() const
+	{
+		return this->bounds;
+	}
+
     Mesh& getVisibleNormals();
 
 	const VertexArray& getVertexArray();
 
+	/** free the mesh's own graphics memory copy of its data, such as when the
+	 * data is drawn from somewhere else. It is uploaded again if drawn
+	 */
+	void releaseVertexArray();
+
+	/** draw many instances of the mesh, each with its own model matrix
+	 * @param instanceBuffer buffer of 4x4 model matrices, one per instance
+	 * @param firstInstance index of the first instance's matrix in the buffer
+	 * @param instanceCount the number of instances to draw
+	 */
+	void drawInstanced(const Buffer& instanceBuffer, int firstInstance, int instanceCount);
+
     std::shared_ptr<Mesh> applyTransform(const Matrix4& matrix) const;
+
+	/// check if a mesh stores its vertices the same way and draws the same primitive
+	bool hasSameLayout(const Mesh& mesh) const;
+
+	/// check if a primitive is a plain list of points, lines or triangles, so lists can be joined
+	static inline bool isListPrimitive(VertexArray::Primitives primitive)
+	{
+		return primitive == VertexArray::POINTS || primitive == VertexArray::LINES || 
+			primitive == VertexArray::TRIANGLES;
+	}
+
+	/** join meshes with the same layout into a single indexed mesh
+	 * @param meshes the meshes to join, all drawing the same list primitive
+	 * @return the joined mesh
+	 */
+	static std::shared_ptr<Mesh> merge(const std::vector<const Mesh*>& meshes);
 	
 };
 
@@ -243,14 +591,64 @@ private:
 
     std::shared_ptr<Mesh> boundingSphereMesh;
 
+    Bounds bounds;
+
+    /// number of meshes the bounds were computed for
+    unsigned int boundsMeshCount;
+
+    /// collision BVH baked along with the meshes, null if there is none
+    btOptimizedBvh* collisionBvh;
+
+    /// owner of the memory the collision BVH is in
+    std::shared_ptr<void> collisionBvhData;
+
+    /// number of triangles the collision BVH was built over
+    int collisionBvhTriangles;
+
 public:
-	inline Meshes(): boundingSphere(nullptr), boundingSphereMesh(nullptr) {}
+	inline Meshes(): boundingSphere(nullptr), boundingSphereMesh(nullptr), boundsMeshCount(0), 
+		collisionBvh(nullptr), collisionBvhTriangles(0) {}
 
-	inline Meshes(std::shared_ptr<Mesh> mesh)
+	inline Meshes(std::shared_ptr<Mesh> mesh): boundsMeshCount(0), collisionBvh(nullptr), 
+		collisionBvhTriangles(0)
 	{
 		this->push_back(mesh);
 	}
 
+    /** set a prebuilt collision BVH over the triangles of the meshes, used by
+     * TriangleMeshCollisionShape instead of building its own
+     * @param bvh the BVH, built over the triangles in the order TriangleMeshCollisionShape adds them
+     * @param data owner of the memory the BVH is in, kept alive as long as the meshes
+     * @param triangleCount the number of triangles the BVH was built over
+     */
+    inline void setCollisionBvh(btOptimizedBvh* bvh, std::shared_ptr<void> data, int triangleCount)
+    {
+        this->collisionBvh = bvh;
+        this->collisionBvhData = data;
+        this->collisionBvhTriangles = triangleCount;
+    }
+
+    /// get the prebuilt collision BVH, null if there is none
+    inline btOptimizedBvh* getCollisionBvh() const
+    {
+        return this->collisionBvh;
+    }
+
+    /// get the number of triangles the prebuilt collision BVH was built over
+    inline int getCollisionBvhTriangleCount() const
+    {
+        return this->collisionBvhTriangles;
+    }
+
+    /// get the owner of the memory the collision BVH is in
+    inline const std::shared_ptr<void>& getCollisionBvhData() const
+    {
+        return this->collisionBvhData;
+    }
+
+    /// get the bounds around all meshes, in local space
+    const Bounds& getBounds();
+
     const SphereCollisionShape& getBoundingSphere();
 
     // used for debugging and developer tools
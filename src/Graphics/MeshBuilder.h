@@ -20,8 +20,10 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MAGIC3D_MESH_BUILDER_H
 #define MAGIC3D_MESH_BUILDER_H
 
-#include <sstream>
-#include <iomanip>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
 
 #include "../Exceptions/MagicException.h"
 #include <Shaders\GpuProgram.h>
@@ -46,20 +48,398 @@ private:
     // TODO: change to directly set data in mesh and not require it to be copied
     std::vector<Vertex<AttrTypes...>> vertices;
     VertexArray::Primitives primitive;
+    /// whether build() welds identical vertices into an indexed mesh
+    bool indexed;
+    /// distance within which positions are welded when generating normals and tangents
+    Scalar weldEpsilon;
+    /// Mesh::Packing flags for the built mesh's vertex data
+    int packing;
+
+    /// FNV-1a hash over a run of attribute components
+    static inline void hashData(unsigned int& hash, const Scalar* data, int compCount)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (unsigned int i = 0; i < compCount * sizeof(Scalar); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    }
+
+    /// hash all the attribute data of a vertex
+    static inline unsigned int hashVertex(const Vertex<AttrTypes...>& vertex)
+    {
+        unsigned int hash = 2166136261u;
+        int expand[] = { (hashData(hash, vertex.AttrTypes::getData(), 
+            GpuProgram::attributeTypeCompCount[(int)AttrTypes::type]), 0)... };
+        (void)expand;
+        return hash;
+    }
+
+    /// check if all the attribute data of two vertices is identical
+    static inline bool equalVertex(const Vertex<AttrTypes...>& a, const Vertex<AttrTypes...>& b)
+    {
+        bool equal = true;
+        int expand[] = { (equal = equal && memcmp(a.AttrTypes::getData(), b.AttrTypes::getData(),
+            GpuProgram::attributeTypeCompCount[(int)AttrTypes::type] * sizeof(Scalar)) == 0, 0)... };
+        (void)expand;
+        return equal;
+    }
+
+    /** weld vertex positions that lie within the weld epsilon of each
+     * other on every axis, using a spatial hash of epsilon sized cells
+     * @param ids set to the welded position id of every vertex
+     * @return the number of unique welded positions
+     */
+    inline unsigned int weldPositions(std::vector<unsigned int>& ids) const
+    {
+        const unsigned int none = 0xFFFFFFFF;
+        const unsigned int vertexCount = this->vertices.size();
+
+        // hash table of chains of welded positions, kept at most half full
+        unsigned int tableSize = 16;
+        while (tableSize < vertexCount * 2)
+            tableSize <<= 1;
+        std::vector<unsigned int> heads(tableSize, none);
+        std::vector<unsigned int> next;
+        std::vector<Scalar> positions;
+        next.reserve(vertexCount);
+        positions.reserve(vertexCount * 3);
+        ids.resize(vertexCount);
+
+        // with no epsilon, positions are only welded when identical, so the
+        // cell of a position is its bit pattern and no neighbours are searched
+        const Scalar epsilon = this->weldEpsilon;
+        const int range = epsilon > 0.0f ? 1 : 0;
+
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const Scalar* p = this->vertices[i].PositionAttr::getData();
+            int64_t cell[3];
+            for (int k = 0; k < 3; k++)
+            {
+                if (epsilon > 0.0f)
+                    cell[k] = weldCell(p[k], epsilon);
+                else
+                {
+                    cell[k] = 0;
+                    memcpy(&cell[k], &p[k], sizeof(Scalar));
+                }
+            }
+
+            // search this cell and its neighbours for a position to weld to
+            unsigned int id = none;
+            for (int dx = -range; dx <= range && id == none; dx++)
+            for (int dy = -range; dy <= range && id == none; dy++)
+            for (int dz = -range; dz <= range && id == none; dz++)
+            {
+                unsigned int slot = hashCell(cell[0] + dx, cell[1] + dy, cell[2] + dz) & (tableSize - 1);
+                for (unsigned int j = heads[slot]; j != none; j = next[j])
+                {
+                    const Scalar* q = &positions[j * 3];
+                    if (fabs(q[0] - p[0]) <= epsilon && fabs(q[1] - p[1]) <= epsilon && 
+                        fabs(q[2] - p[2]) <= epsilon)
+                    {
+                        id = j;
+                        break;
+                    }
+                }
+            }
+
+            // no position close enough, start a new one
+            if (id == none)
+            {
+                id = next.size();
+                unsigned int slot = hashCell(cell[0], cell[1], cell[2]) & (tableSize - 1);
+                next.push_back(heads[slot]);
+                heads[slot] = id;
+                positions.push_back(p[0]);
+                positions.push_back(p[1]);
+                positions.push_back(p[2]);
+            }
+            ids[i] = id;
+        }
+
+        return next.size();
+    }
+
+    /** get the weld cell a coordinate is in. Cells are 64-bit, world space coordinates
+     * divided by a small epsilon overflow an int. Coordinates too far out for that
+     * (or NaN) are clamped, they only share cells, positions are still compared
+     */
+    static inline int64_t weldCell(Scalar coordinate, Scalar epsilon)
+    {
+        const double limit = 4611686018427387904.0; // 2^62, room for the neighbour search
+        double cell = floor((double)coordinate / epsilon);
+        if (!(cell > -limit))
+            cell = -limit;
+        else if (cell > limit)
+            cell = limit;
+        return (int64_t)cell;
+    }
+
+    /// spatial hash of a weld cell
+    static inline unsigned int hashCell(int64_t x, int64_t y, int64_t z)
+    {
+        uint64_t hash = ((uint64_t)x * 73856093u) ^ ((uint64_t)y * 19349663u) ^ ((uint64_t)z * 83492791u);
+        return (unsigned int)(hash ^ (hash >> 32));
+    }
+
+    /// get the angle of a triangle's corner at point a
+    static inline Scalar cornerAngle(const Vector3& a, const Vector3& b, const Vector3& c)
+    {
+        Scalar lengths = (b - a).getLength() * (c - a).getLength();
+        if (lengths == 0.0f)
+            return 0.0f;
+        Scalar cosine = (b - a).dotProduct(c - a) / lengths;
+        return acos(cosine < -1.0f ? -1.0f : (cosine > 1.0f ? 1.0f : cosine));
+    }
+
+    /// get the tangent of a triangle from its positions and texture coordinates
+    static inline Vector3 faceTangent(const Vector3 pos[3], const Vector2 tex[3], Scalar& area)
+    {
+        Vector3 BA = pos[1] - pos[0];
+        Vector3 CA = pos[2] - pos[0];
+
+        Vector2 tBA = tex[1] - tex[0];
+        Vector2 tCA = tex[2] - tex[0];
+        area = (tBA.x() * tCA.y()) - (tBA.y() * tCA.x());
+
+        if (area == 0.0f)
+            return Vector3();
+
+        Scalar delta = 1.0f / area;
+        return Vector3(
+            delta * ((BA.x() * tCA.y()) + (CA.x() * -tBA.y())),
+            delta * ((BA.y() * tCA.y()) + (CA.y() * -tBA.y())),
+            delta * ((BA.z() * tCA.y()) + (CA.z() * -tBA.y()))
+        );
+    }
+
+    /// normalize a vector, leaving zero length vectors as they are
+    static inline Vector3 safeNormalize(const Vector3& vec)
+    {
+        Scalar length = vec.getLength();
+        return length > 0.0f ? vec * (1.0f / length) : vec;
+    }
+
+    /** calculate tangents as MikkTSpace (mikktspace.c by Morten Mikkelsen) does,
+     * so normal maps baked against MikkTSpace tangents match. Vertices are shared
+     * only when their position, normal and texture coordinate are identical, and
+     * the corners around each shared vertex are grouped by walking the triangles
+     * joined to each other by edges and mirrored the same way. Each group's 
+     * tangent is the corner angle weighted average of its triangles' tangents
+     * projected onto the normal. MikkTSpace's default 180 degree angular 
+     * threshold never splits a group, so groups aren't split further
+     */
+    inline void calculateMikkTSpaceTangents()
+    {
+        const unsigned int none = 0xFFFFFFFF;
+        const unsigned int triangleCount = this->vertices.size() / 3;
+        const unsigned int cornerCount = triangleCount * 3;
+        unsigned int tableSize = 16;
+        while (tableSize < cornerCount * 2)
+            tableSize <<= 1;
+
+        // share vertices with identical position, normal and texture coordinate
+        std::vector<unsigned int> shared(cornerCount);
+        std::vector<unsigned int> table(tableSize, none);
+        for (unsigned int i = 0; i < cornerCount; i++)
+        {
+            const Vertex<AttrTypes...>& v = this->vertices[i];
+            unsigned int hash = 2166136261u;
+            hashData(hash, v.PositionAttr::getData(), 3);
+            hashData(hash, v.NormalAttr::getData(), 3);
+            hashData(hash, v.TexCoordAttr::getData(), 2);
+
+            unsigned int slot = hash & (tableSize - 1);
+            for (;; slot = (slot + 1) & (tableSize - 1))
+            {
+                if (table[slot] == none)
+                {
+                    table[slot] = i;
+                    break;
+                }
+                const Vertex<AttrTypes...>& other = this->vertices[table[slot]];
+                if (memcmp(other.PositionAttr::getData(), v.PositionAttr::getData(), 3 * sizeof(Scalar)) == 0 &&
+                    memcmp(other.NormalAttr::getData(), v.NormalAttr::getData(), 3 * sizeof(Scalar)) == 0 &&
+                    memcmp(other.TexCoordAttr::getData(), v.TexCoordAttr::getData(), 2 * sizeof(Scalar)) == 0)
+                    break;
+            }
+            shared[i] = table[slot];
+        }
+
+        // triangles using a shared vertex twice are degenerate, and left out of the groups.
+        // Triangles with no usable tangent still join groups, but don't add to them
+        std::vector<bool> degenerate(triangleCount);
+        std::vector<bool> groupWithAny(triangleCount);
+        std::vector<bool> preserving(triangleCount);
+        std::vector<Vector3> faceTangents(triangleCount);
+        for (unsigned int f = 0; f < triangleCount; f++)
+        {
+            const unsigned int* s = &shared[f * 3];
+            degenerate[f] = s[0] == s[1] || s[1] == s[2] || s[2] == s[0];
+
+            Vector3 pos[] = { this->vertices[f * 3].position(), this->vertices[f * 3 + 1].position(), this->vertices[f * 3 + 2].position() };
+            Vector2 tex[] = { this->vertices[f * 3].texCoord(), this->vertices[f * 3 + 1].texCoord(), this->vertices[f * 3 + 2].texCoord() };
+            Scalar area;
+            Vector3 tangent = faceTangent(pos, tex, area);
+            Vector3 bitangent = (pos[2] - pos[0]) * (tex[1] - tex[0]).x() - (pos[1] - pos[0]) * (tex[2] - tex[0]).x();
+
+            preserving[f] = area > 0.0f;
+            groupWithAny[f] = !(fabs(area) > FLT_MIN && tangent.getLength() > FLT_MIN && bitangent.getLength() > FLT_MIN);
+            faceTangents[f] = safeNormalize(tangent);
+        }
+
+        // find the triangle across each edge. Only edges running the other way
+        // are shared, so neighbouring triangles are wound the same way
+        std::vector<unsigned int> neighbors(cornerCount, none);
+        std::vector<unsigned int> heads(tableSize, none);
+        std::vector<unsigned int> next(cornerCount, none);
+        for (unsigned int i = 0; i < cornerCount; i++)
+        {
+            if (degenerate[i / 3])
+                continue;
+            unsigned int a = shared[i];
+            unsigned int b = shared[i - i % 3 + (i + 1) % 3];
+
+            unsigned int j = heads[hashCell(b, a, 0) & (tableSize - 1)];
+            for (; j != none; j = next[j])
+            {
+                if (neighbors[j] == none && shared[j] == b && shared[j - j % 3 + (j + 1) % 3] == a)
+                    break;
+            }
+            if (j != none)
+            {
+                neighbors[j] = i / 3;
+                neighbors[i] = j / 3;
+            }
+            else
+            {
+                unsigned int slot = hashCell(a, b, 0) & (tableSize - 1);
+                next[i] = heads[slot];
+                heads[slot] = i;
+            }
+        }
+
+        // group the corners around each shared vertex, walking from a triangle 
+        // with a usable tangent across the edges meeting at the vertex to
+        // triangles mirrored the same way. A triangle with no usable tangent 
+        // takes the mirroring of the first group to reach it
+        std::vector<unsigned int> cornerGroups(cornerCount, none);
+        std::vector<Vector3> groupTangents;
+        std::vector<bool> groupPreserving;
+        std::vector<unsigned int> stack;
+        for (unsigned int i = 0; i < cornerCount; i++)
+        {
+            if (degenerate[i / 3] || groupWithAny[i / 3] || cornerGroups[i] != none)
+                continue;
+
+            const unsigned int group = groupTangents.size();
+            const unsigned int vertex = shared[i];
+            groupTangents.push_back(Vector3());
+            groupPreserving.push_back(preserving[i / 3]);
+
+            stack.push_back(i / 3);
+            while (!stack.empty())
+            {
+                unsigned int f = stack.back();
+                stack.pop_back();
+
+                int k = shared[f * 3] == vertex ? 0 : (shared[f * 3 + 1] == vertex ? 1 : 2);
+                unsigned int corner = f * 3 + k;
+                if (cornerGroups[corner] != none)
+                    continue;
+                if (groupWithAny[f] && cornerGroups[f * 3] == none && cornerGroups[f * 3 + 1] == none &&
+                    cornerGroups[f * 3 + 2] == none)
+                    preserving[f] = groupPreserving[group];
+                if (preserving[f] != groupPreserving[group])
+                    continue;
+                cornerGroups[corner] = group;
+
+                // add the triangle's tangent, projected onto the normal and weighted
+                // by the corner's angle in the tangent plane
+                if (!groupWithAny[f])
+                {
+                    Vector3 normal(this->vertices[corner].NormalAttr::getData());
+                    Vector3 tangent = faceTangents[f];
+                    tangent = safeNormalize(tangent - normal * normal.dotProduct(tangent));
+
+                    Vector3 p(this->vertices[corner].position());
+                    Vector3 e1 = Vector3(this->vertices[f * 3 + (k + 2) % 3].position()) - p;
+                    Vector3 e2 = Vector3(this->vertices[f * 3 + (k + 1) % 3].position()) - p;
+                    e1 = safeNormalize(e1 - normal * normal.dotProduct(e1));
+                    e2 = safeNormalize(e2 - normal * normal.dotProduct(e2));
+                    Scalar cosine = e1.dotProduct(e2);
+                    Scalar angle = acos(cosine < -1.0f ? -1.0f : (cosine > 1.0f ? 1.0f : cosine));
+                    groupTangents[group] = groupTangents[group] + tangent * angle;
+                }
+
+                // walk the edges on either side of the corner, the one after it first
+                if (neighbors[f * 3 + (k + 2) % 3] != none)
+                    stack.push_back(neighbors[f * 3 + (k + 2) % 3]);
+                if (neighbors[corner] != none)
+                    stack.push_back(neighbors[corner]);
+            }
+        }
+
+        // set the tangents of grouped corners, corners in no group are left with MikkTSpace's default
+        std::vector<unsigned int> sharedCorners(cornerCount, none);
+        for (unsigned int i = 0; i < cornerCount; i++)
+        {
+            if (degenerate[i / 3])
+                continue;
+            if (sharedCorners[shared[i]] == none)
+                sharedCorners[shared[i]] = i;
+
+            unsigned int group = cornerGroups[i];
+            if (group == none)
+                this->vertices[i].tangent(Vector3(1.0f, 0.0f, 0.0f));
+            else
+                this->vertices[i].tangent(safeNormalize(groupTangents[group]), groupPreserving[group] ? 1.0f : -1.0f);
+        }
+
+        // degenerate triangles copy the tangent of the first good corner sharing their vertex
+        for (unsigned int i = 0; i < cornerCount; i++)
+        {
+            if (!degenerate[i / 3])
+                continue;
+            unsigned int corner = sharedCorners[shared[i]];
+            if (corner == none)
+                this->vertices[i].tangent(Vector3(1.0f, 0.0f, 0.0f));
+            else
+                this->vertices[i].tangent(this->vertices[corner].tangent(), this->vertices[corner].bitangentSign());
+        }
+    }
 
 public:
+    /// how face normals are weighted when averaged into vertex normals
+    enum NormalWeighting
+    {
+        AREA_WEIGHTED,  // larger faces contribute more
+        ANGLE_WEIGHTED  // faces contribute by their corner angle at the vertex
+    };
+
+    /// how vertex tangents are generated
+    enum TangentMode
+    {
+        POSITION_AVERAGED, // face tangents averaged over all vertices sharing a position
+        SPLIT_AT_SEAMS,    // corner weighted tangents, not shared across texture seams or mirrored faces
+        MIKKTSPACE         // tangents matching MikkTSpace, as used to bake most normal maps
+    };
+
 	/** Standard Constructor
 	 */
     inline MeshBuilder(int vertexCount, 
         VertexArray::Primitives primitive = VertexArray::Primitives::TRIANGLES) :
-        primitive(primitive)
+        primitive(primitive), indexed(true), weldEpsilon(0.0001f), packing(Mesh::PACK_NONE)
     {
         this->vertices.reserve(vertexCount);
     }
 	
     // less efficient constructor
     inline MeshBuilder(VertexArray::Primitives primitive = VertexArray::Primitives::TRIANGLES) :
-        primitive(primitive)
+        primitive(primitive), indexed(true), weldEpsilon(0.0001f), packing(Mesh::PACK_NONE)
     {}
 
     inline MeshBuilder<AttrTypes...>& reset(VertexArray::Primitives primitive = VertexArray::Primitives::TRIANGLES)
@@ -81,7 +461,15 @@ public:
 	
     inline unsigned int vertexCount()
     {
-        return vertexCount;
+        return vertices.size();
+    }
+
+    /// set whether build() creates an indexed mesh of unique vertices (default) or not
+    inline MeshBuilder<AttrTypes...>& setIndexed(bool indexed)
+    {
+        this->indexed = indexed;
+
+        return *this;
     }
 
     inline void addVertex(const Vertex<AttrTypes...>& vertex)
@@ -105,103 +493,187 @@ public:
         return *this;
     }
 
-    // TODO: make this more efficient
+    /// set the Mesh::Packing flags used to store the built mesh's vertex data
+    inline MeshBuilder<AttrTypes...>& setPacking(int packing)
+    {
+        this->packing = packing;
+
+        return *this;
+    }
+
+    /// set how far apart positions can be and still be treated as the same when generating normals and tangents
+    inline MeshBuilder<AttrTypes...>& setWeldEpsilon(Scalar epsilon)
+    {
+        this->weldEpsilon = epsilon;
+
+        return *this;
+    }
+
     // TODO: make this only accessible when a normal and a position attribute is included
     // TODO: limit this to triangle primitive
-    // TODO: switch mesh storage to indexed list to avoid comparison precision
-    inline void calculateNormals()
+    /** calculate smooth vertex normals, averaging the normals of all faces
+     * sharing a (welded) position
+     * @param weighting how much each face contributes to the average
+     */
+    inline void calculateNormals(NormalWeighting weighting = AREA_WEIGHTED)
     {
-        std::unordered_map<std::string, Vector3> map;
-
-        std::stringstream ss;
-        ss << std::setprecision(2);
+        std::vector<unsigned int> ids;
+        std::vector<Vector3> normals(this->weldPositions(ids));
 
-        // calculate normals for unique positions
-        for (unsigned int i = 0; i < this->vertices.size(); i += 3)
+        // sum face normals for unique positions
+        for (unsigned int i = 0; i + 2 < this->vertices.size(); i += 3)
         {
-            Vector4 points[] = {
+            Vector3 points[] = {
                 this->vertices[i].position(),
                 this->vertices[i + 1].position(),
                 this->vertices[i + 2].position()
             };
             Vector3 faceNormal = Triangle(points[0], points[1], points[2]).normal;
 
-            for (Vector4 point : points)
+            if (weighting == ANGLE_WEIGHTED)
             {
-                ss.str("");
-                ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
-                map[ss.str()] = map[ss.str()] + faceNormal;
+                faceNormal = safeNormalize(faceNormal);
+                for (int k = 0; k < 3; k++)
+                {
+                    Scalar angle = cornerAngle(points[k], points[(k + 1) % 3], points[(k + 2) % 3]);
+                    normals[ids[i + k]] = normals[ids[i + k]] + faceNormal * angle;
+                }
+            }
+            else
+            {
+                // cross product length is twice the face area
+                for (int k = 0; k < 3; k++)
+                    normals[ids[i + k]] = normals[ids[i + k]] + faceNormal;
             }
         }
 
+        for (Vector3& normal : normals)
+            normal = normal.normalize();
+
         // set calculated normals on vertices
-        for (Vertex<AttrTypes...>& vertex : this->vertices)
-        {
-            Vector4 point = vertex.position();
-            ss.str("");
-            ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
-            vertex.normal(map[ss.str()].normalize());
-        }
+        for (unsigned int i = 0; i < this->vertices.size(); i++)
+            this->vertices[i].normal(normals[ids[i]]);
     }
 
-    inline void calculateTangents()
+    // TODO: make this only accessible when a tangent, normal, texcoord and a position attribute is included
+    /** calculate vertex tangents, and the sign of their bitangents
+     * @param mode POSITION_AVERAGED averages face tangents over all faces sharing
+     *      a position. SPLIT_AT_SEAMS averages corner angle weighted tangents projected 
+     *      onto the vertex normal, only shared by vertices with the same position, 
+     *      normal, texture coordinate and texture orientation. MIKKTSPACE matches
+     *      MikkTSpace, for normal maps baked with it; normals should be calculated
+     *      first, since it only shares tangents between identical normals
+     */
+    inline void calculateTangents(TangentMode mode = POSITION_AVERAGED)
     {
-        std::unordered_map<std::string, Vector3> map;
-
-        std::stringstream ss;
-        ss << std::setprecision(2);
-
-        // calculate normals for unique positions
-        for (unsigned int i = 0; i < this->vertices.size(); i += 3)
+        if (mode == MIKKTSPACE)
         {
-            Vector2 points[] = {
-                this->vertices[i].texCoord(),
-                this->vertices[i + 1].texCoord(),
-                this->vertices[i + 2].texCoord()
-            };
-
-            Vector4 pointsPos[] = {
-                this->vertices[i].position(),
-                this->vertices[i + 1].position(),
-                this->vertices[i + 2].position()
-            };
+            this->calculateMikkTSpaceTangents();
+            return;
+        }
 
-            Vector4 BA = pointsPos[1] - pointsPos[0];
-            Vector4 CA = pointsPos[2] - pointsPos[0];
+        std::vector<unsigned int> ids;
+        unsigned int positionCount = this->weldPositions(ids);
 
-            Vector2 tBA = points[1] - points[0];
-            Vector2 tCA = points[2] - points[0];
-            Scalar area = (tBA.x() * tCA.y()) - (tBA.y() * tCA.x());
+        if (mode == SPLIT_AT_SEAMS)
+        {
+            // split the welded positions by normal, texture coordinate and
+            // texture orientation, so tangents aren't shared across UV seams 
+            // or mirrored faces
+            const unsigned int none = 0xFFFFFFFF;
+            unsigned int tableSize = 16;
+            while (tableSize < this->vertices.size() * 2)
+                tableSize <<= 1;
+            std::vector<unsigned int> table(tableSize, none);
+            std::vector<bool> flipped(this->vertices.size());
+            std::vector<unsigned int> groups(this->vertices.size());
+            std::vector<unsigned int> groupVertex;
+            groupVertex.reserve(this->vertices.size());
+
+            for (unsigned int i = 0; i + 2 < this->vertices.size(); i += 3)
+            {
+                Vector3 pos[] = { this->vertices[i].position(), this->vertices[i + 1].position(), this->vertices[i + 2].position() };
+                Vector2 tex[] = { this->vertices[i].texCoord(), this->vertices[i + 1].texCoord(), this->vertices[i + 2].texCoord() };
+                Scalar area;
+                faceTangent(pos, tex, area);
+                flipped[i] = flipped[i + 1] = flipped[i + 2] = area < 0.0f;
+            }
 
-            Vector3 faceTangent;
+            for (unsigned int i = 0; i < this->vertices.size(); i++)
+            {
+                const Vertex<AttrTypes...>& v = this->vertices[i];
+                unsigned int hash = hashCell(ids[i], flipped[i] ? 1 : 0, 0);
+                hashData(hash, v.NormalAttr::getData(), 3);
+                hashData(hash, v.TexCoordAttr::getData(), 2);
+
+                unsigned int slot = hash & (tableSize - 1);
+                for (;; slot = (slot + 1) & (tableSize - 1))
+                {
+                    if (table[slot] == none)
+                    {
+                        table[slot] = groupVertex.size();
+                        groupVertex.push_back(i);
+                        break;
+                    }
+                    const Vertex<AttrTypes...>& g = this->vertices[groupVertex[table[slot]]];
+                    unsigned int gi = groupVertex[table[slot]];
+                    if (ids[gi] == ids[i] && flipped[gi] == flipped[i] &&
+                        memcmp(g.NormalAttr::getData(), v.NormalAttr::getData(), 3 * sizeof(Scalar)) == 0 &&
+                        memcmp(g.TexCoordAttr::getData(), v.TexCoordAttr::getData(), 2 * sizeof(Scalar)) == 0)
+                        break;
+                }
+                groups[i] = table[slot];
+            }
 
-            if (area != 0.0f)
+            // sum corner tangents, projected into the tangent plane of each corner's normal
+            std::vector<Vector3> tangents(groupVertex.size());
+            for (unsigned int i = 0; i + 2 < this->vertices.size(); i += 3)
             {
-                Scalar delta = 1.0f / area;
-                faceTangent = Vector3(
-                    delta * ((BA.x() * tCA.y()) + (CA.x() * -tBA.y())),
-                    delta * ((BA.y() * tCA.y()) + (CA.y() * -tBA.y())),
-                    delta * ((BA.z() * tCA.y()) + (CA.z() * -tBA.y()))
-                );
+                Vector3 pos[] = { this->vertices[i].position(), this->vertices[i + 1].position(), this->vertices[i + 2].position() };
+                Vector2 tex[] = { this->vertices[i].texCoord(), this->vertices[i + 1].texCoord(), this->vertices[i + 2].texCoord() };
+                Scalar area;
+                Vector3 tangent = faceTangent(pos, tex, area);
+
+                for (int k = 0; k < 3; k++)
+                {
+                    Vector3 normal(this->vertices[i + k].NormalAttr::getData());
+                    Vector3 projected = safeNormalize(tangent - normal * normal.dotProduct(tangent));
+                    Scalar angle = cornerAngle(pos[k], pos[(k + 1) % 3], pos[(k + 2) % 3]);
+                    tangents[groups[i + k]] = tangents[groups[i + k]] + projected * angle;
+                }
             }
 
-            for (Vector4 point : pointsPos)
+            // set calculated tangents on vertices, orthogonal to their normals, 
+            // with the bitangent flipped on mirrored faces
+            for (unsigned int i = 0; i < this->vertices.size(); i++)
             {
-                ss.str("");
-                ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
-                map[ss.str()] = map[ss.str()] + faceTangent;
+                Vector3 normal(this->vertices[i].NormalAttr::getData());
+                Vector3 tangent = tangents[groups[i]];
+                this->vertices[i].tangent(safeNormalize(tangent - normal * normal.dotProduct(tangent)),
+                    flipped[i] ? -1.0f : 1.0f);
             }
+            return;
         }
 
-        // set calculated normals on vertices
-        for (Vertex<AttrTypes...>& vertex : this->vertices)
+        // sum face tangents for unique positions
+        std::vector<Vector3> tangents(positionCount);
+        for (unsigned int i = 0; i + 2 < this->vertices.size(); i += 3)
         {
-            Vector4 point = vertex.position();
-            ss.str("");
-            ss << point.x() << "-" << point.y() << "-" << point.z() << "-" << point.w();
-            vertex.tangent(map[ss.str()].normalize());
+            Vector3 pos[] = { this->vertices[i].position(), this->vertices[i + 1].position(), this->vertices[i + 2].position() };
+            Vector2 tex[] = { this->vertices[i].texCoord(), this->vertices[i + 1].texCoord(), this->vertices[i + 2].texCoord() };
+            Scalar area;
+            Vector3 tangent = faceTangent(pos, tex, area);
+
+            for (int k = 0; k < 3; k++)
+                tangents[ids[i + k]] = tangents[ids[i + k]] + tangent;
         }
 
+        for (Vector3& tangent : tangents)
+            tangent = tangent.normalize();
+
+        // set calculated tangents on vertices
+        for (unsigned int i = 0; i < this->vertices.size(); i++)
+            this->vertices[i].tangent(tangents[ids[i]]);
     }
 
     inline Vertex<AttrTypes...>& getVertex(int index)
@@ -209,9 +681,42 @@ public:
         return this->vertices[index];
     }
 	
+    /** Build the mesh from the added vertices. Unless indexing has been
+     * disabled, identical vertices are welded into a unique vertex set
+     * and an index list
+     */
     inline std::shared_ptr<Mesh> build()
     {
-        return std::make_shared<Mesh>(vertices, primitive);
+        if (!this->indexed)
+            return std::make_shared<Mesh>(vertices, primitive, packing);
+
+        std::vector<Vertex<AttrTypes...>> unique;
+        std::vector<unsigned int> indices;
+        unique.reserve(this->vertices.size());
+        indices.reserve(this->vertices.size());
+
+        // open addressing table of unique vertex indices, kept at most half full
+        unsigned int tableSize = 16;
+        while (tableSize < this->vertices.size() * 2)
+            tableSize <<= 1;
+        const unsigned int empty = 0xFFFFFFFF;
+        std::vector<unsigned int> table(tableSize, empty);
+
+        for (const Vertex<AttrTypes...>& vertex : this->vertices)
+        {
+            unsigned int slot = hashVertex(vertex) & (tableSize - 1);
+            while (table[slot] != empty && !equalVertex(unique[table[slot]], vertex))
+                slot = (slot + 1) & (tableSize - 1);
+
+            if (table[slot] == empty)
+            {
+                table[slot] = unique.size();
+                unique.push_back(vertex);
+            }
+            indices.push_back(table[slot]);
+        }
+
+        return std::make_shared<Mesh>(unique, indices, primitive, packing);
     }
 	
 	/** Build a box mesh
@@ -0,0 +1,190 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for MeshPool class
+ *
+ * @file MeshPool.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/MeshPool.h>
+
+namespace Magic3D
+{
+
+MeshPool::Layout::Layout(const Mesh& mesh, int vertexCapacity, int indexCapacity) :
+	stride(mesh.getVertexSize()),
+	vertices(vertexCapacity, mesh.getVertexSize()),
+	indices(indexCapacity, 4),
+	vertexGeneration(-1), indexGeneration(-1)
+{
+	for (int i = 0; i < mesh.getAttributeCount(); i++)
+		this->attributes.push_back(mesh.getAttribute(i));
+}
+
+bool MeshPool::Layout::matches(const Mesh& mesh) const
+{
+	if (mesh.getVertexSize() != this->stride || mesh.getAttributeCount() != (int)this->attributes.size())
+		return false;
+
+	for (int i = 0; i < mesh.getAttributeCount(); i++)
+	{
+		const Mesh::AttributeData& a = mesh.getAttribute(i);
+		const Mesh::AttributeData& b = this->attributes[i];
+		if (a.type != b.type || a.dataType != b.dataType || a.components != b.components ||
+			a.offset != b.offset || a.normalized != b.normalized)
+			return false;
+	}
+	return true;
+}
+
+MeshPool::~MeshPool()
+{
+	for (Layout* layout : this->layouts)
+		delete layout;
+}
+
+void MeshPool::add(const std::shared_ptr<Mesh>& meshPtr)
+{
+	const Mesh& mesh = *meshPtr;
+	auto it = this->entries.find(&mesh);
+	if (it != this->entries.end())
+	{
+		it->second.references++;
+		return;
+	}
+
+	// find a layout the mesh fits in, or start a new one
+	Layout* layout = nullptr;
+	for (Layout* l : this->layouts)
+	{
+		if (l->matches(mesh))
+		{
+			layout = l;
+			break;
+		}
+	}
+	if (layout == nullptr)
+	{
+		layout = new Layout(mesh, this->vertexCapacity, this->indexCapacity);
+		this->layouts.push_back(layout);
+	}
+
+	// copy the mesh's data into the shared buffers
+	Entry entry;
+	entry.mesh = meshPtr;
+	entry.layout = layout;
+	entry.references = 1;
+
+	int vertexDataSize = mesh.getVertexCount() * mesh.getVertexSize();
+	entry.vertexHandle = layout->vertices.allocate(vertexDataSize);
+	layout->vertices.write(entry.vertexHandle, mesh.getVertexData(), vertexDataSize);
+
+	entry.indexHandle = BufferArena::NULL_HANDLE;
+	if (mesh.isIndexed())
+	{
+		entry.indexHandle = layout->indices.allocate(mesh.getIndexDataSize());
+		layout->indices.write(entry.indexHandle, mesh.getIndexData(), mesh.getIndexDataSize());
+	}
+
+	this->entries.insert(std::make_pair(&mesh, entry));
+
+	// the pool's copy is the one drawn, so the mesh's own one is only wasted memory
+	meshPtr->releaseVertexArray();
+}
+
+void MeshPool::remove(const Mesh& mesh)
+{
+	auto it = this->entries.find(&mesh);
+	MAGIC_THROW(it == this->entries.end(), "Tried to remove a mesh that is not in the mesh pool.");
+
+	Entry& entry = it->second;
+	if (--entry.references > 0)
+		return;
+
+	entry.layout->vertices.release(entry.vertexHandle);
+	if (entry.indexHandle != BufferArena::NULL_HANDLE)
+		entry.layout->indices.release(entry.indexHandle);
+	this->entries.erase(it);
+}
+
+void MeshPool::updateVertexArray(Layout& layout)
+{
+	if (layout.vertexGeneration != layout.vertices.getGeneration())
+	{
+		for (const Mesh::AttributeData& d : layout.attributes)
+		{
+			layout.vertexArray.setAttributeArray(
+				(int)d.type,
+				d.components,
+				d.dataType,
+				layout.vertices.getBuffer(),
+				layout.stride,
+				d.offset,
+				d.normalized
+			);
+		}
+		layout.vertexGeneration = layout.vertices.getGeneration();
+	}
+
+	if (layout.indexGeneration != layout.indices.getGeneration())
+	{
+		layout.vertexArray.setIndexArray(layout.indices.getBuffer());
+		layout.indexGeneration = layout.indices.getGeneration();
+	}
+}
+
+void MeshPool::draw(const Mesh& mesh)
+{
+	auto it = this->entries.find(&mesh);
+	MAGIC_THROW(it == this->entries.end(), "Tried to draw a mesh that is not in the mesh pool.");
+
+	const Entry& entry = it->second;
+	Layout& layout = *entry.layout;
+	this->updateVertexArray(layout);
+
+	int baseVertex = layout.vertices.getOffset(entry.vertexHandle) / layout.stride;
+	if (entry.indexHandle != BufferArena::NULL_HANDLE)
+	{
+		layout.vertexArray.drawElementsBaseVertex(mesh.getPrimitive(), mesh.getElementCount(),
+			mesh.getIndexType(), layout.indices.getOffset(entry.indexHandle), baseVertex);
+	}
+	else
+	{
+		layout.vertexArray.drawRange(mesh.getPrimitive(), mesh.getVertexCount(), baseVertex);
+	}
+}
+
+void MeshPool::finishDraws()
+{
+	for (Layout* layout : this->layouts)
+		layout->vertexArray.unBind();
+}
+
+void MeshPool::compact()
+{
+	for (Layout* layout : this->layouts)
+	{
+		layout->vertices.compact();
+		layout->indices.compact();
+	}
+}
+
+
+};
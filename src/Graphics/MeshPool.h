@@ -0,0 +1,157 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MeshPool class 
+ * 
+ * @file MeshPool.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MESH_POOL_H
+#define MAGIC3D_MESH_POOL_H
+
+#include "Mesh.h"
+#include "BufferArena.h"
+#include "VertexArray.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+/** Packs the vertex and index data of many meshes into a few shared
+ * buffers, one vertex buffer and one index buffer per vertex layout.
+ * Meshes added to the pool free their own buffers, so the pool's are
+ * the only graphics memory copy of their data.
+ * Meshes in the pool are drawn with base vertex offsets from a single
+ * vertex array per layout, so drawing many pooled meshes in a row
+ * doesn't rebind buffers or vertex arrays. Meant for static meshes,
+ * whose data doesn't change once added.
+ */
+class MeshPool
+{
+private:
+	/// meshes sharing a vertex layout, and so sharing buffers and a vertex array
+	struct Layout
+	{
+		/// layout of each attribute
+		std::vector<Mesh::AttributeData> attributes;
+		/// size (in bytes) of a vertex
+		int stride;
+		/// interleaved vertex data of all meshes, aligned to whole vertices
+		BufferArena vertices;
+		/// index data of all meshes
+		BufferArena indices;
+		/// vertex array reading from the shared buffers
+		VertexArray vertexArray;
+		/// arena generations the vertex array was last set up for
+		int vertexGeneration;
+		int indexGeneration;
+
+		Layout(const Mesh& mesh, int vertexCapacity, int indexCapacity);
+
+		/// check if a mesh's vertices are laid out the same as this layout
+		bool matches(const Mesh& mesh) const;
+	};
+
+	/// where a mesh is placed in the pool
+	struct Entry
+	{
+		/// the mesh, kept alive so its address can't be reused by another mesh while pooled
+		std::shared_ptr<Mesh> mesh;
+		Layout* layout;
+		BufferArena::Handle vertexHandle;
+		BufferArena::Handle indexHandle;
+		/// number of times the mesh has been added
+		int references;
+	};
+
+	std::vector<Layout*> layouts;
+
+	std::unordered_map<const Mesh*, Entry> entries;
+
+	/// initial size (in bytes) of each new layout's vertex buffer
+	int vertexCapacity;
+
+	/// initial size (in bytes) of each new layout's index buffer
+	int indexCapacity;
+
+	/// point a layout's vertex array at its buffers, if they have changed
+	void updateVertexArray(Layout& layout);
+
+public:
+	/** Standard Constructor
+	 * @param vertexCapacity initial size (in bytes) of the vertex buffer of each layout
+	 * @param indexCapacity initial size (in bytes) of the index buffer of each layout
+	 */
+	inline MeshPool(int vertexCapacity = 1024 * 1024, int indexCapacity = 256 * 1024) :
+		vertexCapacity(vertexCapacity), indexCapacity(indexCapacity) {}
+
+	/// destructor
+	~MeshPool();
+
+	/** add a mesh to the pool, copying its data into the shared buffers. 
+	 * Adding the same mesh again only counts another reference to it. The
+	 * pool keeps the mesh alive until its last reference is removed
+	 */
+	void add(const std::shared_ptr<Mesh>& mesh);
+
+	/// remove a reference to a mesh, freeing its space once no references remain
+	void remove(const Mesh& mesh);
+
+	inline bool contains(const Mesh& mesh) const
+	{
+		return this->entries.find(&mesh) != this->entries.end();
+	}
+
+	/** draw a mesh in the pool. The layout's vertex array is left
+	 * bound, call finishDraws() once done drawing pooled meshes
+	 */
+	void draw(const Mesh& mesh);
+
+	/// unbind any vertex array left bound by draw()
+	void finishDraws();
+
+	/// move all meshes to the start of the shared buffers, removing gaps left by removed meshes
+	void compact();
+
+	/// get the number of shared buffers used by the pool, pooled meshes have none of their own
+	inline int getBufferCount() const
+	{
+		return this->layouts.size() * 2;
+	}
+
+	/// get the number of different vertex layouts in the pool
+	inline int getLayoutCount() const
+	{
+		return this->layouts.size();
+	}
+
+	/// get the number of different meshes in the pool
+	inline int getMeshCount() const
+	{
+		return this->entries.size();
+	}
+};
+
+
+};
+
+
+#endif
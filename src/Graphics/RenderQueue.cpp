@@ -0,0 +1,144 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for RenderQueue class
+ *
+ * @file RenderQueue.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/RenderQueue.h>
+
+#include <algorithm>
+
+namespace Magic3D
+{
+
+uint32_t RenderQueue::getMaterialId(Material* material)
+{
+    auto it = this->materialIds.find(material);
+    if (it != this->materialIds.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)this->materialIds.size();
+    this->materialIds.insert(std::make_pair(material, id));
+    return id;
+}
+
+void RenderQueue::add(const Item& item, bool transparent, unsigned int programId, Scalar depth)
+{
+    // quantize depth to DEPTH_BITS
+    const uint64_t maxQuantized = (1 << DEPTH_BITS) - 1;
+    uint64_t quantized;
+    if (depth <= 0.0f)
+        quantized = 0;
+    else if (depth >= this->maxDepth)
+        quantized = maxQuantized;
+    else
+        quantized = (uint64_t)(depth / this->maxDepth * (Scalar)maxQuantized);
+
+    uint64_t program = programId & 0x7FFF;
+    uint64_t material = this->getMaterialId(item.material) & 0xFFFF;
+
+    SortEntry entry;
+    if (transparent)
+    {
+        // depth comes first and is inverted, so the farthest items sort first
+        entry.key = (uint64_t(1) << 63) | ((maxQuantized - quantized) << 39) | 
+            (program << 24) | (material << 8);
+    }
+    else
+        entry.key = (program << 48) | (material << 32) | (quantized << 8);
+    entry.index = this->items.size();
+
+    this->items.push_back(item);
+    this->entries.push_back(entry);
+}
+
+void RenderQueue::retain()
+{
+    MAGIC_ASSERT(this->retained.empty());
+    this->sortEntries();
+    this->retained.swap(this->entries);
+    this->entries.clear();
+}
+
+void RenderQueue::sort()
+{
+    this->sortEntries();
+    if (this->retained.empty())
+        return;
+    if (this->entries.empty())
+    {
+        this->entries = this->retained;
+        return;
+    }
+
+    // both runs are sorted, so a merge puts them in order
+    this->scratch.resize(this->entries.size() + this->retained.size());
+    std::merge(this->retained.begin(), this->retained.end(), this->entries.begin(), this->entries.end(), 
+        this->scratch.begin(), [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+    this->entries.swap(this->scratch);
+}
+
+void RenderQueue::sortEntries()
+{
+    const unsigned int count = this->entries.size();
+    if (count < 2)
+        return;
+    this->scratch.resize(count);
+
+    SortEntry* src = &this->entries[0];
+    SortEntry* dst = &this->scratch[0];
+
+    // least significant digit radix sort, a byte at a time, skipping the low 
+    // byte which is always zero. Bytes that are the same for every key don't 
+    // change the order, so their passes are skipped as well
+    for (int shift = 8; shift < 64; shift += 8)
+    {
+        unsigned int histogram[256] = {0};
+        for (unsigned int i = 0; i < count; i++)
+            histogram[(src[i].key >> shift) & 0xFF]++;
+
+        if (histogram[(src[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        unsigned int offset = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            unsigned int c = histogram[i];
+            histogram[i] = offset;
+            offset += c;
+        }
+
+        for (unsigned int i = 0; i < count; i++)
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+        SortEntry* temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    // an odd number of passes leaves the result in the scratch space
+    if (src != &this->entries[0])
+        this->entries.swap(this->scratch);
+}
+
+
+};
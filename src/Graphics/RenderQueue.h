@@ -0,0 +1,184 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for RenderQueue class
+ *
+ * @file RenderQueue.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RENDER_QUEUE_H
+#define MAGIC3D_RENDER_QUEUE_H
+
+#include "../Math/MathTypes.h"
+#include "../Util/magic_assert.h"
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+class Object;
+class Material;
+
+/** Orders the items drawn in a frame by a 64 bit sort key, so that items
+ * are grouped by program and material, opaque items draw front to back 
+ * and transparent items draw back to front. 
+ * 
+ * Opaque keys are laid out as:
+ *     [63] 0 | [62..48] program | [47..32] material | [31..8] depth
+ * Transparent keys are laid out as:
+ *     [63] 1 | [62..39] inverted depth | [38..24] program | [23..8] material
+ */
+class RenderQueue
+{
+public:
+    /// an item to be drawn
+    struct Item
+    {
+        /// the object to draw
+        Object* object;
+        /// the material to draw the object with
+        Material* material;
+        /// whether the object is static scenery
+        bool isStatic;
+
+        inline Item(): object(nullptr), material(nullptr), isStatic(false) {}
+
+        inline Item(Object* object, Material* material, bool isStatic):
+            object(object), material(material), isStatic(isStatic) {}
+    };
+
+    /// number of bits of depth in a sort key
+    static const int DEPTH_BITS = 24;
+
+private:
+    /// key and index of an item, the unit the radix sort moves around
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<Item> items;
+
+    std::vector<SortEntry> entries;
+
+    /// scratch space for the radix sort
+    std::vector<SortEntry> scratch;
+
+    /// sorted entries of the items kept across clears, the first items in the queue
+    std::vector<SortEntry> retained;
+
+    /// small ids for materials, so they fit in a sort key
+    std::unordered_map<Material*, uint32_t> materialIds;
+
+    /// depth that maps to the largest quantized depth
+    Scalar maxDepth;
+
+    /// get the id of a material, assigning one the first time it is seen
+    uint32_t getMaterialId(Material* material);
+
+    /// radix sort the entries not yet sorted
+    void sortEntries();
+
+public:
+    /// standard constructor
+    inline RenderQueue(): maxDepth(1000.0f) {}
+
+    /** set the range of depths that are quantized, usually the far plane
+     * distance of the camera. Deeper items all get the same depth
+     * @param maxDepth the maximum depth
+     */
+    inline void setMaxDepth(Scalar maxDepth)
+    {
+        MAGIC_ASSERT(maxDepth > 0.0f);
+        this->maxDepth = maxDepth;
+    }
+
+    /// remove all items from the queue, including retained ones
+    inline void clear()
+    {
+        this->items.clear();
+        this->entries.clear();
+        this->retained.clear();
+    }
+
+    /// remove all items from the queue except the retained ones
+    inline void clearUnretained()
+    {
+        this->items.resize(this->retained.size());
+        this->entries.clear();
+    }
+
+    /** sort the items in the queue and keep them across clearUnretained, 
+     * for items that are drawn the same way frame after frame. Items 
+     * added afterwards are merged with them when the queue is sorted
+     */
+    void retain();
+
+    /// get the number of retained items
+    inline unsigned int getRetainedCount() const
+    {
+        return this->retained.size();
+    }
+
+    /** add an item to the queue
+     * @param item the item to draw
+     * @param transparent whether the item is transparent
+     * @param programId the id of the gpu program the item is drawn with
+     * @param depth distance of the item along the view direction
+     */
+    void add(const Item& item, bool transparent, unsigned int programId, Scalar depth);
+
+    /// sort the items by their keys, merging in any retained items, after 
+    /// which they can be read in order. Call once after adding items
+    void sort();
+
+    /// get the number of items in the queue
+    inline unsigned int size() const
+    {
+        return this->entries.size();
+    }
+
+    /// get an item, in sorted order once the queue is sorted
+    inline const Item& operator[](unsigned int i) const
+    {
+        return this->items[this->entries[i].index];
+    }
+
+    /// get the sort key of an item, in sorted order once the queue is sorted
+    inline uint64_t getKey(unsigned int i) const
+    {
+        return this->entries[i].key;
+    }
+
+    /// forget the ids given to materials, for when materials are deleted
+    inline void resetMaterialIds()
+    {
+        this->materialIds.clear();
+    }
+};
+
+
+};
+
+
+#endif
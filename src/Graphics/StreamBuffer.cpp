@@ -0,0 +1,202 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for StreamBuffer class
+ *
+ * @file StreamBuffer.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/StreamBuffer.h>
+
+namespace Magic3D
+{
+
+StreamBuffer::StreamBuffer(int regionSize, bool allowPersistent) :
+	buffer(nullptr), mapped(nullptr), region(0), head(0), pending(false), stallCount(0)
+{
+	MAGIC_THROW(regionSize <= 0, "Stream buffer size must be positive.");
+	for (int i = 0; i < FRAME_COUNT; i++)
+		this->fences[i] = 0;
+
+	// persistent mapping needs immutable buffer storage, openGL 4.4
+	this->persistent = allowPersistent && GLEW_ARB_buffer_storage;
+	this->create(regionSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	this->retire();
+	for (Buffer* buffer : this->retired)
+		delete buffer;
+}
+
+void StreamBuffer::create(int regionSize)
+{
+	this->regionSize = regionSize;
+	this->buffer = new Buffer();
+
+	if (this->persistent)
+	{
+		// we bypass static functions becuase we restore previous buffer ourselves
+		int size = regionSize * FRAME_COUNT;
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer->bufferId);
+		glBufferStorage(GL_ARRAY_BUFFER, size, NULL, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+		this->mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, 
+			GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		glBindBuffer(GL_ARRAY_BUFFER, Buffer::getBufferFromPoint(Buffer::ARRAY_BUFFER));
+
+		MAGIC_THROW(this->mapped == nullptr, "Failed to map stream buffer.");
+	}
+	else
+		this->buffer->allocate(regionSize, NULL, Buffer::STREAM_DRAW);
+}
+
+void StreamBuffer::retire()
+{
+	if (this->mapped != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer->bufferId);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, Buffer::getBufferFromPoint(Buffer::ARRAY_BUFFER));
+		this->mapped = nullptr;
+	}
+
+	// draws already made from the buffer keep its storage alive, so it can
+	// be deleted once no more draws will be made from it this frame
+	this->retired.push_back(this->buffer);
+	this->buffer = nullptr;
+
+	for (int i = 0; i < FRAME_COUNT; i++)
+	{
+		if (this->fences[i] != 0)
+			glDeleteSync(this->fences[i]);
+		this->fences[i] = 0;
+	}
+}
+
+void StreamBuffer::waitForRegion()
+{
+	GLsync fence = this->fences[this->region];
+	if (fence == 0)
+		return;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		// the gpu is still reading the region, flush so the fence is sure to signal
+		this->stallCount++;
+		do
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		while (result == GL_TIMEOUT_EXPIRED);
+	}
+	MAGIC_THROW(result == GL_WAIT_FAILED, "Failed to wait for stream buffer fence.");
+
+	glDeleteSync(fence);
+	this->fences[this->region] = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(int size, int alignment)
+{
+	MAGIC_THROW(this->pending, "Tried to allocate from a stream buffer before committing the last allocation.");
+	MAGIC_THROW(size <= 0 || alignment <= 0, "Stream buffer allocations must have a positive size and alignment.");
+
+	int offset = (this->head + alignment - 1) / alignment * alignment;
+	if (offset + size > this->regionSize)
+	{
+		// move on to a larger buffer, earlier allocations this frame stay in the old one
+		int regionSize = this->regionSize * 2;
+		while (regionSize < size)
+			regionSize *= 2;
+		this->retire();
+		this->create(regionSize);
+		this->head = 0;
+		offset = 0;
+	}
+
+	// the first allocation of a frame claims the region
+	if (this->head == 0)
+	{
+		if (this->persistent)
+			this->waitForRegion();
+		else
+			this->buffer->allocate(this->regionSize, NULL, Buffer::STREAM_DRAW);
+	}
+
+	Allocation allocation;
+	allocation.buffer = this->buffer;
+	allocation.size = size;
+	if (this->persistent)
+	{
+		allocation.offset = this->region * this->regionSize + offset;
+		allocation.data = this->mapped + allocation.offset;
+	}
+	else
+	{
+		// the region was orphaned this frame, so nothing can be reading the range
+		allocation.offset = offset;
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer->bufferId);
+		allocation.data = (char*)glMapBufferRange(GL_ARRAY_BUFFER, offset, size, 
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(GL_ARRAY_BUFFER, Buffer::getBufferFromPoint(Buffer::ARRAY_BUFFER));
+		MAGIC_THROW(allocation.data == nullptr, "Failed to map stream buffer range.");
+	}
+
+	this->head = offset + size;
+	this->pending = true;
+	return allocation;
+}
+
+void StreamBuffer::commit(Allocation& allocation)
+{
+	MAGIC_THROW(!this->pending || allocation.buffer != this->buffer, 
+		"Tried to commit a stream buffer allocation that is not the last one made.");
+
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer->bufferId);
+	if (this->persistent)
+		glFlushMappedBufferRange(GL_ARRAY_BUFFER, allocation.offset, allocation.size);
+	else
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, Buffer::getBufferFromPoint(Buffer::ARRAY_BUFFER));
+
+	allocation.data = nullptr;
+	this->pending = false;
+}
+
+void StreamBuffer::nextFrame()
+{
+	MAGIC_THROW(this->pending, "Tried to end a stream buffer frame with an allocation not committed.");
+
+	if (this->persistent)
+	{
+		// guard the region until the gpu has finished this frame's draws
+		if (this->fences[this->region] != 0)
+			glDeleteSync(this->fences[this->region]);
+		this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->region = (this->region + 1) % FRAME_COUNT;
+	}
+	this->head = 0;
+
+	for (Buffer* buffer : this->retired)
+		delete buffer;
+	this->retired.clear();
+}
+
+
+};
@@ -0,0 +1,178 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for StreamBuffer class 
+ * 
+ * @file StreamBuffer.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_STREAM_BUFFER_H
+#define MAGIC3D_STREAM_BUFFER_H
+
+#include "Buffer.h"
+#include "../Util/magic_throw.h"
+
+#include <vector>
+#include <string.h>
+
+namespace Magic3D
+{
+
+/** Streams data that is rewritten every frame, such as instance matrices 
+ * and per draw uniforms, without stalling on draws still reading earlier 
+ * frames' data. The buffer is split into one region per frame in flight;
+ * each frame writes into its own region, and a fence placed at the end 
+ * of the frame guards the region until the gpu is done with it.
+ *
+ * Where buffer storage is available the whole buffer stays mapped, so data 
+ * is written straight into it. Otherwise a single region is orphaned at the
+ * start of each frame and allocations are mapped one at a time.
+ *
+ * Each frame, allocate() a range, write the data into it, then commit() it
+ * before allocating the next range. Call nextFrame() once all draws reading
+ * the frame's data have been issued.
+ */
+class StreamBuffer
+{
+public:
+	/// number of frames that can be in flight at once
+	static const int FRAME_COUNT = 3;
+
+	/// a range of the buffer to write a frame's data into
+	struct Allocation
+	{
+		/// the buffer to bind to read the data, stays valid until the next frame
+		const Buffer* buffer;
+		/// offset (in bytes) of the range in the buffer
+		int offset;
+		/// size (in bytes) of the range
+		int size;
+		/// where to write the data, valid until committed
+		char* data;
+	};
+
+private:
+	/// buffer holding all regions, replaced when growing
+	Buffer* buffer;
+
+	/// buffers replaced this frame, deleted at the next frame
+	std::vector<Buffer*> retired;
+
+	/// size (in bytes) of each region
+	int regionSize;
+
+	/// whether the buffer is persistently mapped
+	bool persistent;
+
+	/// start of the persistently mapped buffer
+	char* mapped;
+
+	/// region of the current frame
+	int region;
+
+	/// offset (in bytes) of the next allocation within the region
+	int head;
+
+	/// fence guarding each region, 0 once signaled
+	GLsync fences[FRAME_COUNT];
+
+	/// whether an allocation has been made and not yet committed
+	bool pending;
+
+	/// number of times a region was still in use when needed
+	int stallCount;
+
+	/// create the buffer, and map it if persistent
+	void create(int regionSize);
+
+	/// unmap and retire the buffer, keeping it alive until the next frame
+	void retire();
+
+	/// wait for the gpu to finish with the current region
+	void waitForRegion();
+
+public:
+	/** Standard Constructor
+	 * @param regionSize the initial size (in bytes) of each frame's region, grows as needed
+	 * @param allowPersistent use persistent mapping when the driver supports it
+	 */
+	StreamBuffer(int regionSize, bool allowPersistent = true);
+
+	/// destructor
+	~StreamBuffer();
+
+	/** allocate a range of the current frame's region, growing the buffer
+	 * if the region is full
+	 * @param size the size (in bytes) needed
+	 * @param alignment the offset of the range will be a multiple of this
+	 * @return the allocation to write to
+	 */
+	Allocation allocate(int size, int alignment = 16);
+
+	/** copy data into an allocation
+	 * @param allocation the allocation to write to
+	 * @param offset the offset (in bytes) within the allocation
+	 * @param data the data to copy
+	 * @param size the size of the data
+	 */
+	inline void write(Allocation& allocation, int offset, const void* data, int size)
+	{
+		MAGIC_THROW(offset + size > allocation.size, "Tried to write past the end of a stream buffer allocation.");
+		memcpy(allocation.data + offset, data, size);
+	}
+
+	/// make the data written to an allocation visible to the gpu
+	void commit(Allocation& allocation);
+
+	/// allocate, write and commit data in one go
+	inline Allocation write(const void* data, int size, int alignment = 16)
+	{
+		Allocation allocation = this->allocate(size, alignment);
+		this->write(allocation, 0, data, size);
+		this->commit(allocation);
+		return allocation;
+	}
+
+	/// fence the current frame's region and move on to the next region
+	void nextFrame();
+
+	/// check if the buffer is persistently mapped, rather than orphaned each frame
+	inline bool isPersistent() const
+	{
+		return this->persistent;
+	}
+
+	/// get the size (in bytes) of each frame's region
+	inline int getRegionSize() const
+	{
+		return this->regionSize;
+	}
+
+	/// get the number of times writing had to wait on the gpu
+	inline int getStallCount() const
+	{
+		return this->stallCount;
+	}
+};
+
+
+};
+
+
+#endif
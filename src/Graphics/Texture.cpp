@@ -94,9 +94,14 @@ void Texture::set(const Image& image, bool generateMipmaps)
 				 GL_UNSIGNED_BYTE,      // image data type (size per channel)
 				 image.getRawData());           // actual data
 				 
-	// generate mipmaps if instructed to
+	this->dataSize = image.getWidth() * image.getHeight() * image.getChannelCount();
+
+	// generate mipmaps if instructed to, which add another third to the data
 	if (generateMipmaps)
-		 glGenerateMipmap(GL_TEXTURE_2D);
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		this->dataSize += this->dataSize / 3;
+	}
 	else
 	{
 		// if there is no mipmap, then set the min filter to something that
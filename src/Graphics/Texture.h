@@ -71,9 +71,12 @@ public:
 private:
 	/// id of texture on graphics memory
 	GLuint tid;
+
+	/// size (in bytes) of the image data, before any compression
+	int dataSize;
 	
 	/// default constructor
-	inline Texture(): tid(0) {}
+	inline Texture(): tid(0), dataSize(0) {}
 	
 public:
 	
@@ -103,6 +106,10 @@ public:
 	inline GLuint getID() const
 	{ return this->tid; }
 
+	/// get the size (in bytes) of the image data, before any compression
+	inline int getDataSize() const
+	{ return this->dataSize; }
+
 	/** Set a texture parameter, basically a link to glTexParameter
 	 * @param parameter the parameter to set
 	 * @param value the value to set the parameter to
@@ -30,6 +30,8 @@ namespace Magic3D
 	
 	
 GLuint VertexArray::boundArrayId = 0;
+
+int VertexArray::bindCount = 0;
 	
 	
 	
@@ -33,8 +33,11 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <gl.h>
 #endif
 
+#include <stdint.h>
+
 #include "Buffer.h"
 #include "../Exceptions/MagicException.h"
+#include "../Util/magic_gl_check.h"
 
 namespace Magic3D
 {
@@ -53,6 +56,12 @@ private:
 	/// used to ensure we don't unbind someone else's vertex array
 	static GLuint boundArrayId;
 
+	/// number of times a vertex array has been bound or unbound since the last reset
+	static int bindCount;
+
+	/// opengl id of the buffer used as the element array, 0 if none
+	GLuint elementBufferId;
+
 
 public:
 	/// acceptable data types for attribute arrays
@@ -112,7 +121,7 @@ public:
 	};
 	
 	/// default constructor
-	inline VertexArray()
+	inline VertexArray(): elementBufferId(0)
 	{
 #ifndef MAGIC3D_NO_VERTEX_ARRAYS
 		glGenVertexArrays(1, &arrayId); //openGL 3
@@ -135,6 +144,7 @@ public:
 		if (VertexArray::boundArrayId == arrayId)
 			return; // already bound
 		VertexArray::boundArrayId = arrayId;
+		VertexArray::bindCount++;
 		glBindVertexArray(arrayId); //openGL 3
 #endif
 	}
@@ -147,6 +157,7 @@ public:
 			return; // TODO: should throw exception here
 		glBindVertexArray(0); // openGL 3
 		VertexArray::boundArrayId = 0;
+		VertexArray::bindCount++;
 #endif
 	}
 	
@@ -155,19 +166,23 @@ public:
 	 * @param components the number of components per vertex (vector size in shader)
 	 * @param type data type/size for each component
 	 * @param buffer the buffer to be used as the attribute array
+	 * @param stride the number of bytes between each vertex, 0 for tightly packed
+	 * @param offset the offset (in bytes) of the first component in the buffer
+	 * @param normalized whether fixed point data is normalized when read
 	 */
 	inline void setAttributeArray(unsigned int index, int components, DataTypes type, 
-								  const Buffer& buffer)
+								  const Buffer& buffer, int stride = 0, int offset = 0,
+								  bool normalized = false)
 	{
 		this->bind();
 		glEnableVertexAttribArray(index);
 		buffer.bind(Buffer::ARRAY_BUFFER);
-		glVertexAttribPointer(index, 		// attribute index
-							  components,   // number of components per vertex
-							  type, 		// the data type of each component
-							  GL_FALSE, 	// no normalizing
-							  0, 			// no padding
-							  0				// no offset to start at
+		glVertexAttribPointer(index, 					// attribute index
+							  components,   			// number of components per vertex
+							  type, 					// the data type of each component
+							  normalized ? GL_TRUE : GL_FALSE,
+							  stride, 					// bytes between each vertex
+							  (const GLvoid*)(intptr_t)offset	// offset to start at
 							 );
 		buffer.unBind();
 		this->unBind();
@@ -176,6 +191,23 @@ public:
 			throw_MagicException("Failed to set attribute array");
 	}
 	
+	/** set the buffer of indices used for indexed drawing
+	 * @param buffer the buffer to be used as the element array
+	 */
+	inline void setIndexArray(const Buffer& buffer)
+	{
+		this->elementBufferId = buffer.bufferId;
+		
+		// the element array binding is part of the vertex array state, so 
+		// it is left bound rather than tracked with the other buffer bindings
+		this->bind();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->elementBufferId);
+		this->unBind();
+		
+		if (glGetError() != GL_NO_ERROR)
+			throw_MagicException("Failed to set index array");
+	}
+	
 	/// disable an attribute array from being used
 	inline void disableAttributeArray(unsigned int index)
 	{
@@ -183,6 +215,63 @@ public:
 		glDisableVertexAttribArray(index);
 		this->unBind();
 	}
+
+	/** check whether attributes can be read once per instance and instanced 
+	 * draws are available, either from openGL 3.3 or ARB_instanced_arrays on 3.1
+	 */
+	static inline bool isInstancingSupported()
+	{
+		return GLEW_VERSION_3_3 || (GLEW_VERSION_3_1 && GLEW_ARB_instanced_arrays);
+	}
+
+	/** set a buffer of 4x4 float matrices to be read once per instance, 
+	 * each column taking its own attribute index
+	 * @param index the attribute index of the first column
+	 * @param buffer the buffer of matrices
+	 * @param offset the offset (in bytes) of the first instance's matrix
+	 */
+	inline void setInstanceMatrixArray(unsigned int index, const Buffer& buffer, int offset)
+	{
+		this->bind();
+		buffer.bind(Buffer::ARRAY_BUFFER);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(index + column);
+			glVertexAttribPointer(index + column, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 16,
+				(const GLvoid*)(offset + sizeof(GLfloat) * 4 * column));
+			if (GLEW_VERSION_3_3)
+				glVertexAttribDivisor(index + column, 1); // openGL 3.3
+			else
+				glVertexAttribDivisorARB(index + column, 1);
+		}
+		buffer.unBind();
+		this->unBind();
+
+		MAGIC_GL_CHECK("Failed to set instance matrix array");
+	}
+
+	/** set the value of a 4x4 float matrix attribute for draws that 
+	 * don't read it from a buffer
+	 * @param index the attribute index of the first column
+	 * @param matrix the column major matrix
+	 */
+	static inline void setConstantMatrix(unsigned int index, const GLfloat* matrix)
+	{
+		for (unsigned int column = 0; column < 4; column++)
+			glVertexAttrib4fv(index + column, matrix + 4 * column);
+	}
+
+	/** stop reading instance matrices, so later draws don't read past the 
+	 * end of the instance buffer
+	 * @param index the attribute index of the first column
+	 */
+	inline void disableInstanceMatrixArray(unsigned int index)
+	{
+		this->bind();
+		for (unsigned int column = 0; column < 4; column++)
+			glDisableVertexAttribArray(index + column);
+		this->unBind();
+	}
 	 
 	/** render a number of verticies using this vertex array as the 
 	 * data for each vertex
@@ -195,8 +284,104 @@ public:
 		this->bind();
 		glDrawArrays(primitive, startingVertex, vertexCount);
 		this->unBind();
-		if (glGetError() != GL_NO_ERROR)
-			throw_MagicException("Failed to draw");
+		MAGIC_GL_CHECK("Failed to draw");
+	}
+	
+	/** render a number of indexed verticies using the element array
+	 * of this vertex array
+	 * @param primitive the type of the primitives to draw
+	 * @param indexCount the number of indices to render
+	 * @param indexType data type of the indices
+	 * @param startingIndex the index to start at
+	 */
+	inline void drawElements(Primitives primitive, unsigned int indexCount, DataTypes indexType,
+							 unsigned int startingIndex = 0) const
+	{
+		this->bind();
+#ifdef MAGIC3D_NO_VERTEX_ARRAYS
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->elementBufferId);
+#endif
+		glDrawElements(primitive, indexCount, indexType, 
+			(const GLvoid*)(size_t)(startingIndex * getDataTypeSize(indexType)));
+		this->unBind();
+		MAGIC_GL_CHECK("Failed to draw elements");
+	}
+	
+	/** render a number of instances of verticies using this vertex array
+	 * @param primitive the type of the primitives to draw
+	 * @param vertexCount the number of verticies to render per instance
+	 * @param instanceCount the number of instances to render
+	 */
+	inline void drawInstanced(Primitives primitive, unsigned int vertexCount, unsigned int instanceCount) const
+	{
+		this->bind();
+		glDrawArraysInstanced(primitive, 0, vertexCount, instanceCount); // openGL 3.1
+		this->unBind();
+		MAGIC_GL_CHECK("Failed to draw instanced");
+	}
+
+	/** render a number of instances of indexed verticies using the element 
+	 * array of this vertex array
+	 * @param primitive the type of the primitives to draw
+	 * @param indexCount the number of indices to render per instance
+	 * @param indexType data type of the indices
+	 * @param instanceCount the number of instances to render
+	 */
+	inline void drawElementsInstanced(Primitives primitive, unsigned int indexCount, DataTypes indexType,
+									  unsigned int instanceCount) const
+	{
+		this->bind();
+#ifdef MAGIC3D_NO_VERTEX_ARRAYS
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->elementBufferId);
+#endif
+		glDrawElementsInstanced(primitive, indexCount, indexType, (const GLvoid*)0, instanceCount); // openGL 3.1
+		this->unBind();
+		MAGIC_GL_CHECK("Failed to draw elements instanced");
+	}
+
+	/** render a range of verticies from a vertex array shared by many meshes. The
+	 * vertex array is left bound, so consecutive draws from it don't rebind it
+	 * @param primitive the type of the primitives to draw
+	 * @param vertexCount the number of verticies to render
+	 * @param startingVertex the vertex to start at
+	 */
+	inline void drawRange(Primitives primitive, unsigned int vertexCount, int startingVertex) const
+	{
+		this->bind();
+		glDrawArrays(primitive, startingVertex, vertexCount);
+		MAGIC_GL_CHECK("Failed to draw");
+	}
+	
+	/** render indexed verticies from a vertex array shared by many meshes, the indices
+	 * being relative to a base vertex. The vertex array is left bound, so
+	 * consecutive draws from it don't rebind it
+	 * @param primitive the type of the primitives to draw
+	 * @param indexCount the number of indices to render
+	 * @param indexType data type of the indices
+	 * @param indexOffset the offset (in bytes) of the first index in the element array
+	 * @param baseVertex the vertex added to every index
+	 */
+	inline void drawElementsBaseVertex(Primitives primitive, unsigned int indexCount, DataTypes indexType,
+									   int indexOffset, int baseVertex) const
+	{
+		this->bind();
+#ifdef MAGIC3D_NO_VERTEX_ARRAYS
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->elementBufferId);
+#endif
+		glDrawElementsBaseVertex(primitive, indexCount, indexType, (const GLvoid*)(intptr_t)indexOffset, baseVertex); // openGL 3.2
+		MAGIC_GL_CHECK("Failed to draw elements");
+	}
+	
+	/// get the number of times a vertex array has been bound or unbound since the last reset
+	static inline int getBindCount()
+	{
+		return bindCount;
+	}
+	
+	/// reset the count of vertex array binds
+	static inline void resetBindCount()
+	{
+		bindCount = 0;
 	}
 
 
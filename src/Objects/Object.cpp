@@ -27,7 +27,11 @@ namespace Magic3D
 /// destructor
 Object::~Object()
 {
-    delete body;
+    // pooled bodies live in the pool's storage, only destroy them
+    if (pooledBody)
+        body->~btRigidBody();
+    else
+        delete body;
 }	
 	
 	
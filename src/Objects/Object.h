@@ -45,6 +45,7 @@ namespace Magic3D
 
 class World;
 class PhysicsSystem;
+class ObjectPool;
     
 /** Base class for all objects 
  */
@@ -60,21 +61,77 @@ public:
         Scalar friction;
         /// bouncyness of object, defaults to 0
         Scalar bouncyness;
+        /// collision group bits of the object, 0 uses Bullet's default 
+        /// for static or dynamic objects
+        short collisionGroup;
+        /// collision groups the object collides with, used when the group is set
+        short collisionMask;
         
-        inline Properties(): mass(0.0f), friction(0.5f), bouncyness(0) {}
+        inline Properties(): mass(0.0f), friction(0.5f), bouncyness(0), collisionGroup(0),
+            collisionMask(-1) {}
     };
 
 protected:
     friend class World;
 	friend class PhysicsSystem;
+	friend class MotionState;
+	friend class ObjectPool;
     
 	Position position;
+
+	/// position at the start of the last physics step, blended with
+	/// the current one when drawing between steps
+	Position previousPosition;
 	
 	std::shared_ptr<Model> model;
 
 	MotionState motionState;
 	btRigidBody* body;
 
+	/// whether the rigid body was built in storage owned by an ObjectPool
+	bool pooledBody;
+
+	/// collision filtering of the body, group 0 for Bullet's default
+	short collisionGroup;
+	short collisionMask;
+
+	/// index of the object in its world's object array, -1 when not in a world
+	int worldIndex;
+
+	/// bounds of the model's meshes at the object's current position
+	Bounds worldBounds;
+
+	/// model matrix of the object's current position
+	Matrix4 transform;
+
+	/// whether physics moved the object in its last step, objects that 
+	/// did not are drawn from their cached transform
+	bool moving;
+
+	/// set when the transform changes, cleared by the world once it has 
+	/// cached how the object is drawn
+	bool renderDirty;
+
+	/// whether the world has the object in its retained queue of resting objects
+	bool renderRetained;
+
+	/// update the cached transform and bounds after the position changes
+	inline void updateWorldBounds()
+	{
+		this->position.getTransformMatrix(this->transform);
+		this->renderDirty = true;
+		if (model->getMeshes() == nullptr)
+			return;
+		this->worldBounds = model->getMeshes()->getBounds().transform(this->transform);
+	}
+
+	/// called by the motion state when physics moves the object
+	inline void movedByPhysics()
+	{
+		this->moving = true;
+		this->updateWorldBounds();
+	}
+
 
 	/** sync the graphical position with the physical
 	 * position.
@@ -102,29 +159,63 @@ protected:
 		body->activate();
 	}
 	
+	/** construct the rigid body for the model's collision shape, if it has one
+	 * @param prop physical properties of the body
+	 * @param storage memory to build the body in, or null to allocate it
+	 */
+	inline void createBody(const Properties& prop, void* storage)
+	{
+		if (model->getCollisionShape() == nullptr)
+			return;
+
+		// calc inertia
+		btVector3 fallInertia(0,0,0);
+		if (prop.mass != 0.0f)
+			model->getCollisionShape()->getShape()->calculateLocalInertia(prop.mass,fallInertia);
+	
+		// construct rigid body
+		btRigidBody::btRigidBodyConstructionInfo fallRigidBodyCI(
+			prop.mass, 
+			&motionState, 
+			model->getCollisionShape()->getShape(), 
+			fallInertia);
+		fallRigidBodyCI.m_friction = prop.friction;
+		fallRigidBodyCI.m_restitution = prop.bouncyness;
+		if (storage != nullptr)
+		{
+			body = new (storage) btRigidBody(fallRigidBodyCI);
+			pooledBody = true;
+		}
+		else
+			body = new btRigidBody(fallRigidBodyCI);
+
+		// queries find the object through its body
+		body->setUserPointer(this);
+		collisionGroup = prop.collisionGroup;
+		collisionMask = prop.collisionMask;
+	}
+
+	/// pooled constructor, builds the rigid body in storage owned by the pool
+	inline Object(
+		std::shared_ptr<Model> model, 
+		const Properties& prop,
+		void* bodyStorage
+		): model(model), motionState(position, this), body(nullptr), pooledBody(false), 
+		collisionGroup(0), collisionMask(-1), worldIndex(-1), moving(false), renderDirty(true), renderRetained(false)
+	{
+		this->updateWorldBounds();
+		this->createBody(prop, bodyStorage);
+	}
+	
 public:
 	inline Object(
 		std::shared_ptr<Model> model, 
 		const Properties& prop = Properties() 
-		): model(model), motionState(position), body(nullptr)
+		): model(model), motionState(position, this), body(nullptr), pooledBody(false), 
+		collisionGroup(0), collisionMask(-1), worldIndex(-1), moving(false), renderDirty(true), renderRetained(false)
 	{
-		if (model->getCollisionShape() != nullptr)
-		{
-			// calc inertia
-			btVector3 fallInertia(0,0,0);
-			if (prop.mass != 0.0f)
-				model->getCollisionShape()->getShape()->calculateLocalInertia(prop.mass,fallInertia);
-		
-			// construct rigid body
-			btRigidBody::btRigidBodyConstructionInfo fallRigidBodyCI(
-				prop.mass, 
-				&motionState, 
-				model->getCollisionShape()->getShape(), 
-				fallInertia);
-			fallRigidBodyCI.m_friction = prop.friction;
-			fallRigidBodyCI.m_restitution = prop.bouncyness;
-			body = new btRigidBody(fallRigidBodyCI);
-		}
+		this->updateWorldBounds();
+		this->createBody(prop, nullptr);
 	}
 	    
 	/// destructor
@@ -134,6 +225,10 @@ public:
 	inline void setLocation(const Point3& location)
 	{
 		this->position.setLocation(location);
+		this->updateWorldBounds();
+		this->previousPosition.set(this->position);
+		this->moving = false;
+		this->motionState.syncBuffer();
 		this->syncPositionToPhysics();
 	}
 
@@ -141,6 +236,10 @@ public:
 	inline void setPosition(const Position& position)
 	{
 	    this->position.set(position);
+		this->previousPosition.set(position);
+		this->moving = false;
+		this->motionState.syncBuffer();
+		this->updateWorldBounds();
 		this->syncPositionToPhysics();
 	}
 	
@@ -150,11 +249,86 @@ public:
 		return this->position;
 	}
 
+	/** take the position physics left in the motion state's back buffer
+	 * @note only call while physics is not stepping
+	 */
+	inline void swapPhysicsBuffers()
+	{
+		if (this->motionState.swap(this->position, this->previousPosition))
+			this->movedByPhysics();
+		else if (this->moving)
+		{
+			this->previousPosition.set(this->position);
+			this->moving = false;
+		}
+	}
+
+	/// remember the current position as the start of the next physics step
+	inline void savePreviousPosition()
+	{
+		if (!this->moving)
+			return;
+		this->previousPosition.set(this->position);
+		this->moving = false;
+	}
+
+	/** get the transform of the object part way between the start
+	 * and end of the last physics step
+	 * @param alpha fraction of a step since the last one, 0 gives the 
+	 * previous position and 1 the current one
+	 * @param out the model matrix
+	 */
+	inline void getInterpolatedTransform(Scalar alpha, Matrix4& out) const
+	{
+		if (alpha >= 1.0f || !this->moving)
+		{
+			out = this->transform;
+			return;
+		}
+
+		// lerp the location and nlerp the orientation vectors, steps
+		// are short enough that the rotation between them is small
+		const Point3& l0 = this->previousPosition.getLocation();
+		const Point3& l1 = this->position.getLocation();
+		const Vector3& f0 = this->previousPosition.getForwardVector();
+		const Vector3& f1 = this->position.getForwardVector();
+		const Vector3& u0 = this->previousPosition.getUpVector();
+		const Vector3& u1 = this->position.getUpVector();
+		Scalar beta = 1.0f - alpha;
+
+		Position blended;
+		blended.setLocation(Point3(l0.x() * beta + l1.x() * alpha, 
+			l0.y() * beta + l1.y() * alpha, l0.z() * beta + l1.z() * alpha));
+		blended.getForwardVector() = Vector3(f0.x() * beta + f1.x() * alpha,
+			f0.y() * beta + f1.y() * alpha, f0.z() * beta + f1.z() * alpha);
+		blended.getUpVector() = Vector3(u0.x() * beta + u1.x() * alpha,
+			u0.y() * beta + u1.y() * alpha, u0.z() * beta + u1.z() * alpha);
+		blended.normalize();
+		blended.getTransformMatrix(out);
+	}
+
+	/// get the bounds of the object in world space, kept up to date as it moves
+	inline const Bounds& getWorldBounds() const
+	{
+		return this->worldBounds;
+	}
+
 	inline std::shared_ptr<Model> getModel()
 	{
 	     return model;
 	}
 
+	/// stop all motion of the object's body, for reusing it somewhere else
+	inline void resetMotion()
+	{
+		if (body == nullptr)
+			return;
+		body->setLinearVelocity(btVector3(0, 0, 0));
+		body->setAngularVelocity(btVector3(0, 0, 0));
+		body->clearForces();
+		body->activate();
+	}
+
 	inline void applyForce(Vector3 force, Vector3 origin = Vector3(0.0f,0.0f,0.0f))
     {
         body->applyForce(
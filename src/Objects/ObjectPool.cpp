@@ -0,0 +1,89 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ObjectPool class
+ *
+ * @file ObjectPool.cpp
+ * @author Andrew Keating
+ */
+
+#include <Objects/ObjectPool.h>
+#include <Util/magic_assert.h>
+
+namespace Magic3D
+{
+
+/// destructor
+ObjectPool::~ObjectPool()
+{
+    for (unsigned int i = 0; i < this->slabs.size() * SLAB_SIZE; i++)
+    {
+        Slot& slot = this->getSlot(i);
+        if (slot.live)
+            reinterpret_cast<Object*>(&slot.object)->~Object();
+    }
+}
+
+void ObjectPool::addSlab()
+{
+    unsigned int first = this->slabs.size() * SLAB_SIZE;
+    this->slabs.push_back(std::unique_ptr<Slot[]>(new Slot[SLAB_SIZE]));
+
+    // chain the new slots in front of the free list, lowest index first
+    Slot* slab = this->slabs.back().get();
+    for (int i = SLAB_SIZE - 1; i >= 0; i--)
+    {
+        slab[i].generation = 0;
+        slab[i].live = false;
+        slab[i].nextFree = this->freeList;
+        this->freeList = first + i;
+    }
+}
+
+ObjectPool::Handle ObjectPool::create(std::shared_ptr<Model> model, const Object::Properties& prop)
+{
+    if (this->freeList == 0xFFFFFFFF)
+        this->addSlab();
+
+    unsigned int index = this->freeList;
+    Slot& slot = this->getSlot(index);
+    new (&slot.object) Object(model, prop, &slot.body);
+    this->freeList = slot.nextFree;
+    slot.live = true;
+    this->liveCount++;
+    return Handle(index, slot.generation);
+}
+
+void ObjectPool::destroy(const Handle& handle)
+{
+    Object* object = this->get(handle);
+    if (object == nullptr)
+        return;
+    MAGIC_ASSERT(object->worldIndex < 0);
+
+    object->~Object();
+    Slot& slot = this->getSlot(handle.index);
+    slot.live = false;
+    slot.generation++;
+    slot.nextFree = this->freeList;
+    this->freeList = handle.index;
+    this->liveCount--;
+}
+
+};
@@ -0,0 +1,144 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ObjectPool class
+ *
+ * @file ObjectPool.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_OBJECT_POOL_H
+#define MAGIC3D_OBJECT_POOL_H
+
+#include "Object.h"
+
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+namespace Magic3D
+{
+
+/** Creates objects in slabs of reused storage, so objects spawned and 
+ * destroyed continuously do not touch the heap once the pool has grown
+ * to fit them. Each slot holds an object together with its rigid body. 
+ * Objects are referred to by handles, which go stale when their object
+ * is destroyed and its slot is reused.
+ */
+class ObjectPool
+{
+public:
+    /// refers to an object in the pool, can be checked for staleness
+    struct Handle
+    {
+        unsigned int index;
+        unsigned int generation;
+
+        inline Handle(): index(0xFFFFFFFF), generation(0) {}
+        inline Handle(unsigned int index, unsigned int generation): index(index), 
+            generation(generation) {}
+
+        inline bool isNull() const
+        {
+            return index == 0xFFFFFFFF;
+        }
+    };
+
+    /// number of slots in each slab
+    static const int SLAB_SIZE = 256;
+
+private:
+    /// storage for one object and its body
+    struct Slot
+    {
+        std::aligned_storage<sizeof(Object), 16>::type object;
+        std::aligned_storage<sizeof(btRigidBody), 16>::type body;
+        /// incremented each time the slot is freed, so old handles go stale
+        unsigned int generation;
+        /// next free slot when this one is free
+        unsigned int nextFree;
+        bool live;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+
+    /// head of the list of free slots
+    unsigned int freeList;
+
+    int liveCount;
+
+    inline Slot& getSlot(unsigned int index)
+    {
+        return this->slabs[index / SLAB_SIZE][index % SLAB_SIZE];
+    }
+
+    void addSlab();
+
+public:
+    inline ObjectPool(): freeList(0xFFFFFFFF), liveCount(0) {}
+
+    /// destructor, destroys any objects still in the pool
+    ~ObjectPool();
+
+    /** create an object in the pool
+     * @param model the model of the object
+     * @param prop physical properties of the object
+     * @return handle to the new object
+     */
+    Handle create(std::shared_ptr<Model> model, const Object::Properties& prop = Object::Properties());
+
+    /** destroy an object and free its slot for reuse
+     * @param handle handle to the object, stale handles are ignored
+     * @note remove the object from its world first. When physics is 
+     * threaded, removal completes at the end of the frame
+     */
+    void destroy(const Handle& handle);
+
+    /// get an object from its handle, null if the handle is stale
+    inline Object* get(const Handle& handle)
+    {
+        if (handle.index >= this->slabs.size() * SLAB_SIZE)
+            return nullptr;
+        Slot& slot = this->getSlot(handle.index);
+        if (!slot.live || slot.generation != handle.generation)
+            return nullptr;
+        return reinterpret_cast<Object*>(&slot.object);
+    }
+
+    /// get the number of objects in the pool
+    inline int getLiveCount() const
+    {
+        return this->liveCount;
+    }
+
+    /// get the number of slots the pool has room for
+    inline int getCapacity() const
+    {
+        return this->slabs.size() * SLAB_SIZE;
+    }
+
+    /// get the number of slabs allocated, the only heap allocations the pool makes
+    inline int getSlabCount() const
+    {
+        return this->slabs.size();
+    }
+};
+
+};
+
+#endif
@@ -24,6 +24,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <Physics/MotionState.h>
+#include <Objects/Object.h>
 
 namespace Magic3D
 {
@@ -87,12 +88,28 @@ void MotionState::setWorldTransform (const btTransform &worldTrans)
 	btVector3 upV = matrix.getColumn(1);
     btVector3 forwardV = matrix.getColumn(2);                           
 
+	// the owner picks up buffered positions when the buffers are swapped
+	if (this->buffered)
+	{
+		this->back = Position(
+			Point3(location.getX(), location.getY(), location.getZ()),
+			Vector3(forwardV.getX(), forwardV.getY(), forwardV.getZ()),
+			Vector3(upV.getX(), upV.getY(), upV.getZ())
+		);
+		this->moved = true;
+		return;
+	}
+
 	// TODO: clean this up, no need to use 
 	(*this->position) = Position(
 		Point3(location.getX(), location.getY(), location.getZ()),
 		Vector3(forwardV.getX(), forwardV.getY(), forwardV.getZ()),
 		Vector3(upV.getX(), upV.getY(), upV.getZ())
 	);
+
+	// world bounds only change when the object moves
+	if (this->owner != NULL)
+		this->owner->movedByPhysics();
 }
 	
 	
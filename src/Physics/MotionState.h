@@ -33,6 +33,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 namespace Magic3D
 {
 
+class Object;
 	
 /** Used in listener callback pattern with
  * physics library to automatically keep the
@@ -44,15 +45,71 @@ class MotionState : public ::btMotionState
 private:
 	/// reference to position to sync with
 	Position* position;
+
+	/// object told when physics moves the position, may be null
+	Object* owner;
+
+	/** when buffered, physics writes here instead of to the linked 
+	 * position, so the simulation can run on another thread while the
+	 * position is drawn. Only the physics thread touches these until
+	 * the buffers are swapped
+	 */
+	bool buffered;
+	Position back;
+	Position backPrevious;
+	bool moved;
 	
 	/// default constructor
-	inline MotionState(): position(NULL) {}
+	inline MotionState(): position(NULL), owner(NULL), buffered(false), moved(false) {}
 	
 public:
 	/** Standard constructor
 	 * @param position the position to keep in sync
+	 * @param owner object to update when physics moves the position
+	 */
+	inline MotionState(Position& position, Object* owner = NULL): position(&position), 
+		owner(owner), buffered(false), moved(false) {}
+
+	/// set whether physics writes to the back buffer instead of the position
+	inline void setBuffered(bool buffered)
+	{
+		this->buffered = buffered;
+		this->syncBuffer();
+	}
+
+	inline bool isBuffered() const
+	{
+		return this->buffered;
+	}
+
+	/// make the back buffer match the linked position, after it was set directly
+	inline void syncBuffer()
+	{
+		this->back.set(*this->position);
+		this->backPrevious.set(*this->position);
+		this->moved = false;
+	}
+
+	/// remember the back buffer as the start of the next step, on the physics thread
+	inline void beginStep()
+	{
+		this->backPrevious.set(this->back);
+	}
+
+	/** copy the back buffer out if physics moved it since the last swap
+	 * @param current set to the position at the end of the last step
+	 * @param previous set to the position at the start of the last step
+	 * @return true if physics moved the position
 	 */
-	inline MotionState(Position& position): position(&position) {}
+	inline bool swap(Position& current, Position& previous)
+	{
+		if (!this->moved)
+			return false;
+		current.set(this->back);
+		previous.set(this->backPrevious);
+		this->moved = false;
+		return true;
+	}
 	
 	/// destructor
 	virtual ~MotionState();
@@ -0,0 +1,309 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for PhysicsQueries class
+ *
+ * @file PhysicsQueries.cpp
+ * @author Andrew Keating
+ */
+
+#include <Physics/PhysicsQueries.h>
+#include <Objects/Object.h>
+
+#include <BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h>
+#include <BulletCollision/NarrowPhaseCollision/btPointCollector.h>
+#include <BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
+#include <BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h>
+
+namespace Magic3D
+{
+
+/// gathers the broadphase proxies a query could touch
+struct ProxyCollector : public btDbvt::ICollide
+{
+    std::vector<btBroadphaseProxy*>& proxies;
+    short group;
+    short mask;
+
+    inline ProxyCollector(std::vector<btBroadphaseProxy*>& proxies, short group, short mask):
+        proxies(proxies), group(group), mask(mask) {}
+
+    virtual void Process(const btDbvtNode* leaf)
+    {
+        btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+        if ((proxy->m_collisionFilterGroup & mask) != 0 && (group & proxy->m_collisionFilterMask) != 0)
+            proxies.push_back(proxy);
+    }
+};
+
+/// index of the triangle a ray or sweep hit, -1 if the shape hit isn't made of triangles
+inline int getTriangleIndex(const btCollisionWorld::LocalShapeInfo* info)
+{
+    // compound shapes report the index of their child hit, with no part
+    if (info == nullptr || info->m_shapePart < 0)
+        return -1;
+    return info->m_triangleIndex;
+}
+
+/// closest ray hit, remembering the triangle hit
+struct ClosestRayCallback : public btCollisionWorld::ClosestRayResultCallback
+{
+    int triangleIndex;
+
+    inline ClosestRayCallback(const btVector3& from, const btVector3& to): 
+        btCollisionWorld::ClosestRayResultCallback(from, to), triangleIndex(-1) {}
+
+    virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& result, bool normalInWorldSpace)
+    {
+        triangleIndex = getTriangleIndex(result.m_localShapeInfo);
+        return btCollisionWorld::ClosestRayResultCallback::addSingleResult(result, normalInWorldSpace);
+    }
+};
+
+/// closest sweep hit, remembering the triangle hit
+struct ClosestSweepCallback : public btCollisionWorld::ClosestConvexResultCallback
+{
+    int triangleIndex;
+
+    inline ClosestSweepCallback(const btVector3& from, const btVector3& to): 
+        btCollisionWorld::ClosestConvexResultCallback(from, to), triangleIndex(-1) {}
+
+    virtual btScalar addSingleResult(btCollisionWorld::LocalConvexResult& result, bool normalInWorldSpace)
+    {
+        triangleIndex = getTriangleIndex(result.m_localShapeInfo);
+        return btCollisionWorld::ClosestConvexResultCallback::addSingleResult(result, normalInWorldSpace);
+    }
+};
+
+/// finds the triangle of a concave shape closest to a sphere overlapping it
+struct SphereTriangleCallback : public btTriangleCallback
+{
+    btVector3 center;
+    btScalar radius;
+    btScalar closestDistance2;
+    btVector3 closestPoint;
+    int triangleIndex;
+
+    inline SphereTriangleCallback(const btVector3& center, btScalar radius): center(center), 
+        radius(radius), closestDistance2(radius * radius), triangleIndex(-1) {}
+
+    virtual void processTriangle(btVector3* triangle, int /*partId*/, int index)
+    {
+        btVector3 point = closestPointOnTriangle(triangle[0], triangle[1], triangle[2]);
+        btScalar distance2 = (point - center).length2();
+        if (distance2 <= closestDistance2)
+        {
+            closestDistance2 = distance2;
+            closestPoint = point;
+            triangleIndex = index;
+        }
+    }
+
+    /// closest point to the center on a triangle, by the region of the triangle it falls in
+    btVector3 closestPointOnTriangle(const btVector3& a, const btVector3& b, const btVector3& c)
+    {
+        btVector3 ab = b - a, ac = c - a, ap = center - a;
+        btScalar d1 = ab.dot(ap), d2 = ac.dot(ap);
+        if (d1 <= 0 && d2 <= 0)
+            return a;
+
+        btVector3 bp = center - b;
+        btScalar d3 = ab.dot(bp), d4 = ac.dot(bp);
+        if (d3 >= 0 && d4 <= d3)
+            return b;
+
+        btScalar vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0)
+            return a + ab * (d1 / (d1 - d3));
+
+        btVector3 cp = center - c;
+        btScalar d5 = ab.dot(cp), d6 = ac.dot(cp);
+        if (d6 >= 0 && d5 <= d6)
+            return c;
+
+        btScalar vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0)
+            return a + ac * (d2 / (d2 - d6));
+
+        btScalar va = d3 * d6 - d5 * d4;
+        if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        btScalar denom = 1 / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+};
+
+inline Point3 toPoint(const btVector3& v)
+{
+    return Point3(v.getX(), v.getY(), v.getZ());
+}
+
+inline Vector3 toVector(const btVector3& v)
+{
+    return Vector3(v.getX(), v.getY(), v.getZ());
+}
+
+/** test whether a sphere overlaps a collision object
+ * @return true and fills in the hit if it does
+ */
+bool sphereOverlap(const btSphereShape& sphere, const btTransform& sphereTransform, 
+    btCollisionObject* object, PhysicsQueries::Hit& hit)
+{
+    const btCollisionShape* shape = object->getCollisionShape();
+    const btTransform& transform = object->getWorldTransform();
+    const btVector3& center = sphereTransform.getOrigin();
+
+    if (shape->isConvex())
+    {
+        btVoronoiSimplexSolver simplex;
+        btGjkEpaPenetrationDepthSolver penetration;
+        btGjkPairDetector gjk(&sphere, (const btConvexShape*)shape, &simplex, &penetration);
+        btGjkPairDetector::ClosestPointInput input;
+        input.m_transformA = sphereTransform;
+        input.m_transformB = transform;
+        btPointCollector result;
+        gjk.getClosestPoints(input, result, nullptr);
+        if (!result.m_hasResult || result.m_distance > 0)
+            return false;
+        hit.point = toPoint(result.m_pointInWorld);
+        hit.normal = toVector(result.m_normalOnBInWorld);
+        return true;
+    }
+
+    if (shape->isConcave())
+    {
+        // find the closest triangle in the shape's space
+        btVector3 localCenter = transform.inverse() * center;
+        btVector3 extent(sphere.getRadius(), sphere.getRadius(), sphere.getRadius());
+        SphereTriangleCallback callback(localCenter, sphere.getRadius());
+        ((const btConcaveShape*)shape)->processAllTriangles(&callback, localCenter - extent, 
+            localCenter + extent);
+        if (callback.triangleIndex < 0)
+            return false;
+        btVector3 point = transform * callback.closestPoint;
+        btVector3 normal = center - point;
+        if (normal.length2() > SIMD_EPSILON)
+            normal.normalize();
+        hit.point = toPoint(point);
+        hit.normal = toVector(normal);
+        hit.triangleIndex = callback.triangleIndex;
+        return true;
+    }
+
+    // other shapes are taken to overlap wherever their bounds do
+    hit.point = toPoint(transform.getOrigin());
+    hit.normal = toVector(center - transform.getOrigin());
+    return true;
+}
+
+void PhysicsQueries::run(btDbvtBroadphase& broadphase, Query* begin, Query* end, std::vector<Hit>& hits)
+{
+    std::vector<btBroadphaseProxy*> proxies;
+    for (Query* query = begin; query != end; query++)
+    {
+        query->firstHit = hits.size();
+        query->hitCount = 0;
+
+        // gather candidates from the dynamic and static trees of the broadphase
+        proxies.clear();
+        ProxyCollector collector(proxies, query->group, query->mask);
+        btVector3 extent(query->radius, query->radius, query->radius);
+        btVector3 boundsMin = query->start, boundsMax = query->start;
+        boundsMin.setMin(query->end);
+        boundsMax.setMax(query->end);
+        btDbvtVolume volume = btDbvtVolume::FromMM(boundsMin - extent, boundsMax + extent);
+        for (int i = 0; i < 2; i++)
+        {
+            if (query->type == RAY)
+                btDbvt::rayTest(broadphase.m_sets[i].m_root, query->start, query->end, collector);
+            else
+                broadphase.m_sets[i].collideTV(broadphase.m_sets[i].m_root, volume, collector);
+        }
+        if (proxies.empty())
+            continue;
+
+        btTransform from, to;
+        from.setIdentity();
+        from.setOrigin(query->start);
+        to.setIdentity();
+        to.setOrigin(query->end);
+
+        if (query->type == RAY)
+        {
+            ClosestRayCallback callback(query->start, query->end);
+            for (btBroadphaseProxy* proxy : proxies)
+            {
+                btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+                btCollisionWorld::rayTestSingle(from, to, object, object->getCollisionShape(), 
+                    object->getWorldTransform(), callback);
+            }
+            if (!callback.hasHit())
+                continue;
+
+            Hit hit;
+            hit.object = (Object*)callback.m_collisionObject->getUserPointer();
+            hit.point = toPoint(callback.m_hitPointWorld);
+            hit.normal = toVector(callback.m_hitNormalWorld);
+            hit.fraction = callback.m_closestHitFraction;
+            hit.triangleIndex = callback.triangleIndex;
+            hits.push_back(hit);
+            query->hitCount = 1;
+        }
+        else if (query->type == SPHERE_SWEEP)
+        {
+            btSphereShape sphere(query->radius);
+            ClosestSweepCallback callback(query->start, query->end);
+            for (btBroadphaseProxy* proxy : proxies)
+            {
+                btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+                btCollisionWorld::objectQuerySingle(&sphere, from, to, object, object->getCollisionShape(), 
+                    object->getWorldTransform(), callback, 0.0f);
+            }
+            if (!callback.hasHit())
+                continue;
+
+            Hit hit;
+            hit.object = (Object*)callback.m_hitCollisionObject->getUserPointer();
+            hit.point = toPoint(callback.m_hitPointWorld);
+            hit.normal = toVector(callback.m_hitNormalWorld);
+            hit.fraction = callback.m_closestHitFraction;
+            hit.triangleIndex = callback.triangleIndex;
+            hits.push_back(hit);
+            query->hitCount = 1;
+        }
+        else
+        {
+            btSphereShape sphere(query->radius);
+            for (btBroadphaseProxy* proxy : proxies)
+            {
+                btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+                Hit hit;
+                if (!sphereOverlap(sphere, from, object, hit))
+                    continue;
+                hit.object = (Object*)object->getUserPointer();
+                hit.fraction = 0.0f;
+                hits.push_back(hit);
+                query->hitCount++;
+            }
+        }
+    }
+}
+
+};
@@ -0,0 +1,194 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for PhysicsQueries class
+ *
+ * @file PhysicsQueries.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_PHYSICS_QUERIES_H
+#define MAGIC3D_PHYSICS_QUERIES_H
+
+#include <btBulletDynamicsCommon.h>
+#include <btBulletCollisionCommon.h>
+
+#include "../Math/Math.h"
+#include "../Util/magic_assert.h"
+
+#include <vector>
+
+namespace Magic3D
+{
+
+class Object;
+class PhysicsSystem;
+
+/** A batch of ray casts, sphere sweeps and sphere overlap tests, run 
+ * together against the physics world by PhysicsSystem::runQueries. 
+ * Queries only see objects whose collision group is in the query's mask 
+ * and whose mask includes the query's group. Ray casts and sweeps report
+ * the closest hit, overlap tests every object overlapped.
+ */
+class PhysicsQueries
+{
+public:
+    /// what a query hit
+    struct Hit
+    {
+        /// the object hit, null for bodies without an object
+        Object* object;
+        /// point of contact in world space
+        Point3 point;
+        /// surface normal at the point of contact, in world space
+        Vector3 normal;
+        /// fraction of the way from start to end of the hit, 0 for overlaps
+        Scalar fraction;
+        /// index of the triangle hit in triangle mesh shapes, -1 for other shapes
+        int triangleIndex;
+
+        inline Hit(): object(nullptr), fraction(1.0f), triangleIndex(-1) {}
+    };
+
+    /// the group and mask that match everything
+    static const short ALL_GROUPS = -1;
+
+private:
+    friend class PhysicsSystem;
+
+    enum QueryType
+    {
+        RAY,
+        SPHERE_SWEEP,
+        SPHERE_OVERLAP
+    };
+
+    struct Query
+    {
+        QueryType type;
+        btVector3 start;
+        btVector3 end;
+        Scalar radius;
+        short group;
+        short mask;
+        /// range of the query's hits in the hit list
+        int firstHit;
+        int hitCount;
+    };
+
+    std::vector<Query> queries;
+
+    /// hits of all queries, in query order
+    std::vector<Hit> hits;
+
+    /// add a query, returning its index
+    inline int add(QueryType type, const Point3& start, const Point3& end, Scalar radius, 
+        short group, short mask)
+    {
+        Query query;
+        query.type = type;
+        query.start = btVector3(start.x(), start.y(), start.z());
+        query.end = btVector3(end.x(), end.y(), end.z());
+        query.radius = radius;
+        query.group = group;
+        query.mask = mask;
+        query.firstHit = 0;
+        query.hitCount = 0;
+        this->queries.push_back(query);
+        return this->queries.size() - 1;
+    }
+
+    /** run a range of queries against the broadphase of a world
+     * @param broadphase the broadphase of the world
+     * @param begin first query to run
+     * @param end one past the last query to run
+     * @param hits list to append the hits to, query hit ranges index into it
+     */
+    static void run(btDbvtBroadphase& broadphase, Query* begin, Query* end, std::vector<Hit>& hits);
+
+public:
+    /** add a ray cast
+     * @param start start of the ray
+     * @param end end of the ray
+     * @param group collision group of the ray
+     * @param mask collision groups the ray can hit
+     * @return index of the query
+     */
+    inline int addRay(const Point3& start, const Point3& end, short group = ALL_GROUPS, 
+        short mask = ALL_GROUPS)
+    {
+        return this->add(RAY, start, end, 0.0f, group, mask);
+    }
+
+    /** add a sweep of a sphere along a line
+     * @param start center of the sphere at the start
+     * @param end center of the sphere at the end
+     * @param radius radius of the sphere
+     * @param group collision group of the sphere
+     * @param mask collision groups the sphere can hit
+     * @return index of the query
+     */
+    inline int addSphereSweep(const Point3& start, const Point3& end, Scalar radius, 
+        short group = ALL_GROUPS, short mask = ALL_GROUPS)
+    {
+        return this->add(SPHERE_SWEEP, start, end, radius, group, mask);
+    }
+
+    /** add a test for the objects overlapping a sphere
+     * @param center center of the sphere
+     * @param radius radius of the sphere
+     * @param group collision group of the sphere
+     * @param mask collision groups the sphere can overlap
+     * @return index of the query
+     */
+    inline int addSphereOverlap(const Point3& center, Scalar radius, short group = ALL_GROUPS, 
+        short mask = ALL_GROUPS)
+    {
+        return this->add(SPHERE_OVERLAP, center, center, radius, group, mask);
+    }
+
+    /// remove all queries and their results
+    inline void clear()
+    {
+        this->queries.clear();
+        this->hits.clear();
+    }
+
+    /// get the number of queries in the batch
+    inline int getQueryCount() const
+    {
+        return this->queries.size();
+    }
+
+    /// get the number of hits of a query after the batch is run
+    inline int getHitCount(int query) const
+    {
+        return this->queries[query].hitCount;
+    }
+
+    /// get a hit of a query after the batch is run, the closest for rays and sweeps
+    inline const Hit& getHit(int query, int hit = 0) const
+    {
+        MAGIC_ASSERT(hit < this->queries[query].hitCount);
+        return this->hits[this->queries[query].firstHit + hit];
+    }
+};
+
+};
+
+#endif
@@ -25,44 +25,261 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
  
 #include <Physics/PhysicsSystem.h>
 
+#include <algorithm>
+
+#ifdef MAGIC3D_BULLET_MULTITHREADED
+#include <LinearMath/btThreads.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
+
 
 namespace Magic3D
 {
     
     
-void PhysicsSystem::init()
+void PhysicsSystem::init(const Config& config)
 {
-     broadphase = new btDbvtBroadphase();
-    collisionConfiguration = new btDefaultCollisionConfiguration();
-    dispatcher = new btCollisionDispatcher(collisionConfiguration);
-    solver = new btSequentialImpulseConstraintSolver;
-
-    dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+    this->config = config;
+    this->threadCount = 1;
+    broadphase = new btDbvtBroadphase();
+
+#ifdef MAGIC3D_BULLET_MULTITHREADED
+    btITaskScheduler* scheduler = NULL;
+    if (config.multithreaded)
+    {
+        switch (config.scheduler)
+        {
+            case OPENMP_SCHEDULER:
+                scheduler = btGetOpenMPTaskScheduler();
+                break;
+            case TBB_SCHEDULER:
+                scheduler = btGetTBBTaskScheduler();
+                break;
+            case PPL_SCHEDULER:
+                scheduler = btGetPPLTaskScheduler();
+                break;
+            default:
+                scheduler = ownedScheduler = btCreateDefaultTaskScheduler();
+                break;
+        }
+        MAGIC_THROW(scheduler == NULL, "Requested physics task scheduler is not available "
+            "in this build of Bullet." );
+    }
+
+    if (scheduler != NULL)
+    {
+        this->threadCount = scheduler->getMaxNumThreads();
+        if (config.threadCount > 0 && config.threadCount < this->threadCount)
+            this->threadCount = config.threadCount;
+        scheduler->setNumThreadsToUse(this->threadCount);
+        btSetTaskScheduler(scheduler);
+
+        // many threads creating contacts at once need larger pools than the defaults
+        btDefaultCollisionConstructionInfo info;
+        info.m_defaultMaxPersistentManifoldPoolSize = 80000;
+        info.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+        collisionConfiguration = new btDefaultCollisionConfiguration(info);
+        dispatcher = new btCollisionDispatcherMt(collisionConfiguration, 40);
+        solverPool = new btConstraintSolverPoolMt(this->threadCount);
+        solver = new btSequentialImpulseConstraintSolverMt();
+        dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, 
+            (btConstraintSolverPoolMt*)solverPool, solver, collisionConfiguration);
+    }
+    else
+#endif
+    {
+        collisionConfiguration = new btDefaultCollisionConfiguration();
+        dispatcher = new btCollisionDispatcher(collisionConfiguration);
+        solver = new btSequentialImpulseConstraintSolver;
+        dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+    }
+
+    if (config.simdSolver)
+        dynamicsWorld->getSolverInfo().m_solverMode |= SOLVER_SIMD;
+    dynamicsWorld->getSolverInfo().m_numIterations = config.solverIterations;
     //dynamicsWorld->getSolverInfo().m_splitImpulse = true;
     //dynamicsWorld->getSolverInfo().m_splitImpulsePenetrationThreshold =0.0f;
     //dynamicsWorld->getSolverInfo().m_restitution = 0.8f;
     //dynamicsWorld->getSolverInfo().m_damping = 1.5f;
     //dynamicsWorld->getSolverInfo().m_tau = 0;
     //dynamicsWorld->getSolverInfo().m_friction = 0.01f;
-    //dynamicsWorld->getSolverInfo().m_solverMode = SOLVER_SIMD;
     //dynamicsWorld->getSolverInfo().m_linearSlop = -0.1f;
     //dynamicsWorld->getSolverInfo().m_sor = 0;
-    
-        
 }
     
 /// destructor
 void PhysicsSystem::deinit()
 {
-    delete broadphase;
-    delete collisionConfiguration;
-    delete dispatcher;
-    delete solver;
+    // stop the threads before the world they use goes away
+    stopWorker();
+    stopQueryThreads();
 
+    // the world uses everything else, so it goes first
     delete dynamicsWorld;
+    delete solver;
+    delete solverPool;
+    delete dispatcher;
+    delete collisionConfiguration;
+    delete broadphase;
+    dynamicsWorld = NULL;
+    solver = solverPool = NULL;
+    dispatcher = NULL;
+    collisionConfiguration = NULL;
+    broadphase = NULL;
+
+#ifdef MAGIC3D_BULLET_MULTITHREADED
+    if (ownedScheduler != NULL)
+    {
+        btSetTaskScheduler(btGetSequentialTaskScheduler());
+        delete ownedScheduler;
+        ownedScheduler = NULL;
+    }
+#endif
 }
     
 
+void PhysicsSystem::stepSimulationAsync( float stepTime, int steps, std::function<void()> beforeStep )
+{
+    // the worker is started with the first asynchronous step
+    if (!worker.joinable())
+        worker = std::thread(&PhysicsSystem::runWorker, this);
+
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        MAGIC_THROW(workerBusy, "Tried to step physics while it is already stepping." );
+        workerSteps = steps;
+        workerStepTime = stepTime;
+        workerBeforeStep = beforeStep;
+        workerBusy = true;
+    }
+    workerWake.notify_one();
+}
+
+void PhysicsSystem::waitForSimulation()
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    workerDone.wait(lock, [this]{ return !workerBusy; });
+}
+
+void PhysicsSystem::stopWorker()
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        workerExit = true;
+    }
+    workerWake.notify_one();
+    worker.join();
+    workerExit = false;
+}
+
+void PhysicsSystem::stopQueryThreads()
+{
+    delete queryThreads;
+    queryThreads = NULL;
+}
+
+void PhysicsSystem::runWorker()
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    while (true)
+    {
+        workerWake.wait(lock, [this]{ return workerBusy || workerExit; });
+        if (workerExit)
+            return;
+
+        // the main thread leaves the simulation alone until we report back,
+        // so it is stepped without holding the lock
+        int steps = workerSteps;
+        float stepTime = workerStepTime;
+        lock.unlock();
+
+        StopWatch timer;
+        for (int i = 0; i < steps; i++)
+        {
+            if (workerBeforeStep)
+                workerBeforeStep();
+            dynamicsWorld->stepSimulation(stepTime, 1, stepTime);
+        }
+        float elapsed = timer.getElapsedTime();
+
+        lock.lock();
+        workerTime = elapsed;
+        workerBusy = false;
+        workerDone.notify_all();
+    }
+}
+
+
+void PhysicsSystem::runQueries(PhysicsQueries& queries, int threadCount)
+{
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        MAGIC_THROW(workerBusy, "Tried to query physics while it is stepping." );
+    }
+
+    // small batches are not worth starting threads for
+    static const int MIN_QUERIES_PER_THREAD = 64;
+    int count = queries.queries.size();
+    if (threadCount <= 0)
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    threadCount = std::max(1, std::min(threadCount, count / MIN_QUERIES_PER_THREAD));
+
+    // the helper threads are kept from one batch to the next, starting threads every tick costs too much
+    if (threadCount > 1 && queryThreads == NULL)
+        queryThreads = new ThreadPool();
+    if (queryThreads != NULL)
+        threadCount = std::min(threadCount, queryThreads->getThreadCount() + 1);
+
+    btDbvtBroadphase& tree = *(btDbvtBroadphase*)broadphase;
+    queries.hits.clear();
+    if (threadCount == 1)
+    {
+        if (count > 0)
+            PhysicsQueries::run(tree, &queries.queries[0], &queries.queries[0] + count, queries.hits);
+        return;
+    }
+
+    // each thread takes a contiguous range of queries and collects its own hits
+    std::vector<std::vector<PhysicsQueries::Hit>> threadHits(threadCount);
+    std::mutex doneMutex;
+    std::condition_variable done;
+    int running = threadCount - 1;
+    PhysicsQueries::Query* first = &queries.queries[0];
+    for (int i = 1; i < threadCount; i++)
+    {
+        PhysicsQueries::Query* begin = first + count * i / threadCount;
+        PhysicsQueries::Query* end = first + count * (i + 1) / threadCount;
+        std::vector<PhysicsQueries::Hit>* hits = &threadHits[i];
+        queryThreads->submit([&tree, begin, end, hits, &doneMutex, &done, &running]()
+        {
+            PhysicsQueries::run(tree, begin, end, *hits);
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--running == 0)
+                done.notify_one();
+        });
+    }
+    PhysicsQueries::run(tree, first, first + count / threadCount, queries.hits);
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&running]{ return running == 0; });
+    }
+
+    // append the hits in query order, moving the ranges along with them
+    for (int i = 1; i < threadCount; i++)
+    {
+        int offset = queries.hits.size();
+        for (int q = count * i / threadCount; q < count * (i + 1) / threadCount; q++)
+            queries.queries[q].firstHit += offset;
+        queries.hits.insert(queries.hits.end(), threadHits[i].begin(), threadHits[i].end());
+    }
+}
+
+
 btVector3 createBtVector(const Point3& inputPoint)
 {
 	return btVector3(inputPoint.x(), inputPoint.y(), inputPoint.z());
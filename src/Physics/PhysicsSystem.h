@@ -30,6 +30,16 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <btBulletCollisionCommon.h>
 
 #include <Objects\Object.h>
+#include <Physics\PhysicsQueries.h>
+#include <Time\StopWatch.h>
+#include <Util\ThreadPool.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class btITaskScheduler;
 
 namespace Magic3D
 {
@@ -40,20 +50,93 @@ class World;
  */
 class PhysicsSystem
 {
+public:
+    /// task schedulers Bullet can run its multithreaded world on
+    enum TaskScheduler
+    {
+        /// Bullet's own thread pool
+        DEFAULT_SCHEDULER,
+        OPENMP_SCHEDULER,
+        TBB_SCHEDULER,
+        PPL_SCHEDULER
+    };
+
+    /// options the simulation is created with
+    struct Config
+    {
+        /** use btDiscreteDynamicsWorldMt, with collision dispatch and constraint 
+         * solving spread over threads. Needs Bullet built with BT_THREADSAFE and
+         * 3DMagic built with PHYSICS_MULTITHREADED, otherwise it is ignored
+         */
+        bool multithreaded;
+        /// scheduler running the threads, when multithreaded
+        TaskScheduler scheduler;
+        /// number of threads to use when multithreaded, 0 uses all the scheduler has
+        int threadCount;
+        /// use the SIMD constraint solver
+        bool simdSolver;
+        /// constraint solver iterations per step
+        int solverIterations;
+
+        inline Config(): multithreaded(false), scheduler(DEFAULT_SCHEDULER), threadCount(0), 
+            simdSolver(true), solverIterations(10) {}
+    };
+
 private:
     btBroadphaseInterface* broadphase;
 	btDefaultCollisionConfiguration* collisionConfiguration;
 	btCollisionDispatcher* dispatcher;
 	btConstraintSolver* solver;
+
+    /// per thread solvers of the multithreaded world
+    btConstraintSolver* solverPool;
+
+    /// scheduler created for the multithreaded world, null when one of Bullet's is used
+    btITaskScheduler* ownedScheduler;
+
+    /// options the simulation was created with
+    Config config;
+
+    /// number of threads the simulation steps with
+    int threadCount;
     
 	btDiscreteDynamicsWorld* dynamicsWorld;
+
+    /// thread stepping the simulation in the background, when threaded
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerWake;
+    std::condition_variable workerDone;
+
+    /// work handed to the worker, guarded by workerMutex
+    int workerSteps;
+    float workerStepTime;
+    std::function<void()> workerBeforeStep;
+    bool workerBusy;
+    bool workerExit;
+
+    /// time the worker spent on its last batch of steps
+    float workerTime;
+
+    void runWorker();
+
+    /// stop and join the worker, if it was started
+    void stopWorker();
+
+    /// threads helping runQueries, started on the first batch split over threads
+    ThreadPool* queryThreads;
+
+    /// destroy the query threads
+    void stopQueryThreads();
 	
 protected:
     friend class World;
     
     inline void addBody( Object& ob )
     {
-        if (ob.body)
+        if (ob.body && ob.collisionGroup != 0)
+            dynamicsWorld->addRigidBody(ob.body, ob.collisionGroup, ob.collisionMask);
+        else if (ob.body)
             dynamicsWorld->addRigidBody(ob.body);
     }
     
@@ -63,22 +146,58 @@ protected:
             dynamicsWorld->removeRigidBody(ob.body);
     }
 
-    inline void stepSimulation( float secs, int substeps )
+    inline void stepSimulation( float secs, int substeps, float fixedStep = 1.0f/60.0f )
+    {
+        dynamicsWorld->stepSimulation(secs,substeps,fixedStep);
+    }
+
+    /** start taking fixed steps on the worker thread and return immediately
+     * @param stepTime length of each step
+     * @param steps number of steps to take
+     * @param beforeStep called on the worker before each step
+     * @note nothing may touch the simulation until waitForSimulation returns
+     */
+    void stepSimulationAsync( float stepTime, int steps, std::function<void()> beforeStep );
+
+    /// block until the steps started by stepSimulationAsync are done
+    void waitForSimulation();
+
+    /// get the time the worker spent on the last steps it finished
+    inline float getAsyncStepTime()
     {
-        dynamicsWorld->stepSimulation(secs,substeps);
+        return this->workerTime;
     }
 
 public:
     /// standard constructor
     inline PhysicsSystem(): broadphase(NULL), collisionConfiguration(NULL),
-        dispatcher(NULL), solver(NULL), dynamicsWorld( NULL ) {}
+        dispatcher(NULL), solver(NULL), solverPool(NULL), ownedScheduler(NULL), threadCount(1),
+        dynamicsWorld( NULL ), workerSteps(0), 
+        workerStepTime(0.0f), workerBusy(false), workerExit(false), workerTime(0.0f), queryThreads(NULL) {}
     
-    /// destructor
+    /// destructor, stops the threads even if deinit wasn't called
     inline ~PhysicsSystem()
     {   
+        this->stopWorker();
+        this->stopQueryThreads();
     }
 
-    void init();
+    /** create the simulation
+     * @param config options to create it with
+     */
+    void init(const Config& config = Config());
+
+    /// get the options the simulation was created with
+    inline const Config& getConfig()
+    {
+        return this->config;
+    }
+
+    /// get the number of threads the simulation steps with, 1 unless multithreaded
+    inline int getThreadCount()
+    {
+        return this->threadCount;
+    }
     
     void deinit();
     
@@ -94,6 +213,15 @@ public:
 
 	Point3 createRay(const Point3& start, const Vector3& direction, Scalar maxLength) const;
 
+    /** run a batch of queries, split over threads
+     * @param queries the queries, their hits are filled in
+     * @param threadCount most threads to run on, 0 for one per hardware thread.
+     * The calling thread takes part, helped by threads kept between calls
+     * @note the simulation must not be stepping, run queries between 
+     * endFrame and stepPhysics when physics is threaded
+     */
+    void runQueries(PhysicsQueries& queries, int threadCount = 0);
+
 };
 
 
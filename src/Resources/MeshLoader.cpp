@@ -1,6 +1,7 @@
 
 #include "MeshLoader.h"
 #include "models\MeshLoader3DS.h"
+#include "models\MeshLoaderBaked.h"
 
 namespace Magic3D
 {
@@ -12,6 +13,7 @@ MeshLoaders& MeshLoaders::getSingleton()
 	{
 		loaders = new MeshLoaders();
 		loaders->registerLoader("3ds", std::make_shared<MeshLoader3DS>());
+		loaders->registerLoader("mesh", std::make_shared<MeshLoaderBaked>());
 	}
 	return *loaders;
 }
@@ -0,0 +1,439 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ResourceIndex class
+ *
+ * @file ResourceIndex.cpp
+ * @author Andrew Keating
+ */
+
+#include "ResourceIndex.h"
+#include "../Util/magic_throw.h"
+
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <errno.h>
+#endif
+
+namespace Magic3D
+{
+
+/// initial number of hash table slots, always a power of two
+#define INITIAL_SLOTS 1024
+
+#ifdef __linux__
+/// changes watched in each directory
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+#endif
+
+ResourceIndex::ResourceIndex() : slots(INITIAL_SLOTS, 0), fileCount(0)
+{
+#ifdef __linux__
+	this->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+ResourceIndex::~ResourceIndex()
+{
+#ifdef __linux__
+	if (this->inotify >= 0)
+		close(this->inotify);
+#endif
+}
+
+unsigned int ResourceIndex::normalize(const std::string& path, std::string& normalized)
+{
+	normalized.clear();
+	normalized.reserve(path.size());
+
+	// copy part by part, dropping empty and "." parts and letting ".." remove the part before it.
+	// A ".." with nothing left to remove is kept, so the path can't match a file in the directories
+	size_t i = 0;
+	while (i < path.size())
+	{
+		size_t end = i;
+		while (end < path.size() && path[end] != '/' && path[end] != '\\')
+			end++;
+
+		size_t length = end - i;
+		size_t slash = normalized.find_last_of('/');
+		size_t last = (slash == std::string::npos) ? 0 : slash + 1;
+		if (length == 2 && path[i] == '.' && path[i + 1] == '.' && 
+			normalized.size() > last && normalized.compare(last, std::string::npos, "..") != 0)
+		{
+			normalized.resize(slash == std::string::npos ? 0 : slash);
+		}
+		else if (length > 0 && !(length == 1 && path[i] == '.'))
+		{
+			if (!normalized.empty())
+				normalized += '/';
+			normalized.append(path, i, length);
+		}
+		i = end + 1;
+	}
+
+#ifdef _WIN32
+	// file names are case insensitive here, any casing has to find the same path
+	for (size_t j = 0; j < normalized.size(); j++)
+		normalized[j] = (char)tolower((unsigned char)normalized[j]);
+#endif
+
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (size_t j = 0; j < normalized.size(); j++)
+	{
+		hash ^= (unsigned char)normalized[j];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+ResourceIndex::PathId ResourceIndex::lookup(const std::string& normalized, unsigned int hash) const
+{
+	size_t mask = this->slots.size() - 1;
+	for (size_t slot = hash & mask; this->slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const Entry& entry = this->entries[this->slots[slot] - 1];
+		if (entry.hash == hash && entry.path == normalized)
+			return this->slots[slot] - 1;
+	}
+	return INVALID_PATH;
+}
+
+ResourceIndex::PathId ResourceIndex::intern(const std::string& normalized, unsigned int hash)
+{
+	PathId id = this->lookup(normalized, hash);
+	if (id != INVALID_PATH)
+		return id;
+
+	// keep the table at most half full, so probe sequences stay short
+	if ((this->entries.size() + 1) * 2 > this->slots.size())
+		this->grow();
+
+	Entry entry;
+	entry.path = normalized;
+	entry.hash = hash;
+	entry.directories = 0;
+	this->entries.push_back(entry);
+	id = (PathId)this->entries.size() - 1;
+
+	size_t mask = this->slots.size() - 1;
+	size_t slot = hash & mask;
+	while (this->slots[slot] != 0)
+		slot = (slot + 1) & mask;
+	this->slots[slot] = id + 1;
+	return id;
+}
+
+void ResourceIndex::grow()
+{
+	this->slots.assign(this->slots.size() * 2, 0);
+	size_t mask = this->slots.size() - 1;
+	for (unsigned int i = 0; i < this->entries.size(); i++)
+	{
+		size_t slot = this->entries[i].hash & mask;
+		while (this->slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		this->slots[slot] = i + 1;
+	}
+}
+
+void ResourceIndex::setFile(int directory, const std::string& relative, bool present)
+{
+	std::string normalized;
+	unsigned int hash = normalize(relative, normalized);
+	PathId id = present ? this->intern(normalized, hash) : this->lookup(normalized, hash);
+	if (id == INVALID_PATH)
+		return;
+
+	Entry& entry = this->entries[id];
+	unsigned int bit = 1u << directory;
+	bool wasIndexed = entry.directories != 0;
+	if (present)
+		entry.directories |= bit;
+	else
+		entry.directories &= ~bit;
+
+	if (!wasIndexed && entry.directories != 0)
+		this->fileCount++;
+	else if (wasIndexed && entry.directories == 0)
+		this->fileCount--;
+}
+
+void ResourceIndex::removeTree(int directory, const std::string& relative)
+{
+	for (auto& entry : this->entries)
+	{
+		if (entry.path.compare(0, relative.size(), relative) == 0)
+		{
+			bool wasIndexed = entry.directories != 0;
+			entry.directories &= ~(1u << directory);
+			if (wasIndexed && entry.directories == 0)
+				this->fileCount--;
+		}
+	}
+
+#ifdef __linux__
+	// a directory moved elsewhere is still watched, stop following it and everything in it
+	for (auto it = this->watches.begin(); it != this->watches.end(); )
+	{
+		if (it->second.directory == directory && 
+			it->second.relative.compare(0, relative.size(), relative) == 0)
+		{
+			inotify_rm_watch(this->inotify, it->first);
+			it = this->watches.erase(it);
+		}
+		else
+			++it;
+	}
+#endif
+}
+
+void ResourceIndex::rebuild()
+{
+#ifdef __linux__
+	this->removeWatches();
+#endif
+	for (auto& entry : this->entries)
+		entry.directories = 0;
+	this->fileCount = 0;
+
+	for (unsigned int i = 0; i < this->directories.size(); i++)
+		this->scan(i, "");
+}
+
+void ResourceIndex::scan(int directory, const std::string& relative)
+{
+	std::string dirPath = this->directories[directory] + "/" + relative;
+
+#ifdef __linux__
+	// watch before listing, so files created in between aren't missed
+	if (this->inotify >= 0)
+	{
+		int wd = inotify_add_watch(this->inotify, dirPath.c_str(), WATCH_MASK);
+		if (wd >= 0)
+		{
+			Watch& watch = this->watches[wd];
+			watch.directory = directory;
+			watch.relative = relative;
+		}
+	}
+#endif
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((dirPath + "*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			this->scan(directory, relative + name + "/");
+		else
+			this->setFile(directory, relative + name, true);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR* dir = opendir(dirPath.c_str());
+	if (dir == NULL)
+		return;
+
+	struct dirent* item;
+	while ((item = readdir(dir)) != NULL)
+	{
+		std::string name = item->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		// some file systems don't report the type while listing
+		bool isDir = item->d_type == DT_DIR;
+		if (item->d_type == DT_UNKNOWN || item->d_type == DT_LNK)
+		{
+			struct stat info;
+			isDir = stat((dirPath + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+		}
+
+		if (isDir)
+			this->scan(directory, relative + name + "/");
+		else
+			this->setFile(directory, relative + name, true);
+	}
+	closedir(dir);
+#endif
+}
+
+void ResourceIndex::addDirectory(const std::string& dir)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	MAGIC_THROW(this->directories.size() >= MAX_DIRECTORIES, "Too many resource directories.");
+
+	// full paths are made by adding a separator, don't end up with two
+	std::string trimmed = dir;
+	while (trimmed.size() > 1 && (trimmed.back() == '/' || trimmed.back() == '\\'))
+		trimmed.pop_back();
+
+	this->directories.push_back(trimmed);
+	this->scan((int)this->directories.size() - 1, "");
+}
+
+ResourceIndex::PathId ResourceIndex::find(const std::string& path)
+{
+	std::string normalized;
+	unsigned int hash = normalize(path, normalized);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->lookup(normalized, hash);
+}
+
+ResourceIndex::PathId ResourceIndex::probe(const std::string& path)
+{
+	std::string normalized;
+	unsigned int hash = normalize(path, normalized);
+	if (normalized.empty() || normalized.compare(0, 2, "..") == 0)
+		return INVALID_PATH;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (unsigned int i = 0; i < this->directories.size(); i++)
+	{
+		std::string fullPath = this->directories[i] + "/" + normalized;
+#ifdef _WIN32
+		DWORD attributes = GetFileAttributesA(fullPath.c_str());
+		bool isFile = attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+		struct stat info;
+		bool isFile = stat(fullPath.c_str(), &info) == 0 && !S_ISDIR(info.st_mode);
+#endif
+		if (isFile)
+			this->setFile(i, normalized, true);
+	}
+	return this->lookup(normalized, hash);
+}
+
+bool ResourceIndex::exists(PathId id)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return id >= 0 && id < (PathId)this->entries.size() && this->entries[id].directories != 0;
+}
+
+std::string ResourceIndex::getFullPath(PathId id)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (id < 0 || id >= (PathId)this->entries.size())
+		return "";
+
+	const Entry& entry = this->entries[id];
+	for (unsigned int i = 0; i < this->directories.size(); i++)
+	{
+		if (entry.directories & (1u << i))
+			return this->directories[i] + "/" + entry.path;
+	}
+	return "";
+}
+
+#ifdef __linux__
+void ResourceIndex::removeWatches()
+{
+	for (auto& watch : this->watches)
+		inotify_rm_watch(this->inotify, watch.first);
+	this->watches.clear();
+}
+#endif
+
+bool ResourceIndex::update()
+{
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->inotify < 0)
+		return false;
+
+	bool changed = false;
+	bool overflowed = false;
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (true)
+	{
+		ssize_t length = read(this->inotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (char* p = buffer; p < buffer + length; )
+		{
+			struct inotify_event* event = (struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + event->len;
+			changed = true;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				overflowed = true;
+				continue;
+			}
+
+			auto it = this->watches.find(event->wd);
+			if (it == this->watches.end())
+				continue;
+			if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+			{
+				this->watches.erase(it);
+				continue;
+			}
+
+			// copy, scanning a new directory can rehash the watches
+			Watch watch = it->second;
+			std::string relative = watch.relative + event->name;
+			bool created = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+			if (event->mask & IN_ISDIR)
+			{
+				if (created)
+					this->scan(watch.directory, relative + "/");
+				else
+					this->removeTree(watch.directory, relative + "/");
+			}
+			else
+				this->setFile(watch.directory, relative, created);
+		}
+	}
+
+	// too many changes were missed to follow them, start over
+	if (overflowed)
+		this->rebuild();
+	return changed;
+#else
+	return false;
+#endif
+}
+
+void ResourceIndex::rescan()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->rebuild();
+}
+
+};
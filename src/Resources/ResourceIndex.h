@@ -0,0 +1,187 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ResourceIndex class
+ *
+ * @file ResourceIndex.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RESOURCE_INDEX_H
+#define MAGIC3D_RESOURCE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+/** Index of every file under a set of resource directories, so finding
+ * a resource doesn't have to probe each directory for it. Paths relative
+ * to the resource directories are interned, each gets an id that stays
+ * the same for the life of the index. On Linux the index follows changes
+ * to the directories through inotify. Elsewhere new files are only
+ * found by probe(), and rescan() has to be called to drop removed ones.
+ * Where file names are case insensitive (Windows) paths are too.
+ */
+class ResourceIndex
+{
+public:
+	/// id of an interned path
+	typedef int PathId;
+
+	/// id of a path that was never indexed
+	static const PathId INVALID_PATH = -1;
+
+	/// most resource directories an index can hold
+	static const int MAX_DIRECTORIES = 32;
+
+private:
+	/// an interned path
+	struct Entry
+	{
+		/// path relative to the resource directories, normalized
+		std::string path;
+		unsigned int hash;
+		/// bit for each resource directory the file is in
+		unsigned int directories;
+	};
+
+	/// interned paths, by id
+	std::vector<Entry> entries;
+
+	/// open addressed hash table of path ids plus one, 0 for empty slots
+	std::vector<PathId> slots;
+
+	/// resource directories, in the order they are searched
+	std::vector<std::string> directories;
+
+	/// number of paths found in at least one directory
+	int fileCount;
+
+	/// guards everything, lookups happen from loader threads
+	std::mutex mutex;
+
+#ifdef __linux__
+	/// a directory being watched for changes
+	struct Watch
+	{
+		int directory;
+		/// path of the watched directory relative to the resource directory, empty or ending with '/'
+		std::string relative;
+	};
+
+	/// inotify instance, -1 if it couldn't be created
+	int inotify;
+
+	/// watched directories, by watch descriptor
+	std::unordered_map<int, Watch> watches;
+
+	/// stop watching every directory
+	void removeWatches();
+#endif
+
+	/** hash a path, normalizing it on the way
+	 * @param path the path to normalize
+	 * @param normalized set to the path with '/' separators and no empty, "." or ".." parts,
+	 * except for leading ".." parts that lead out of the directories
+	 * @return hash of the normalized path
+	 */
+	static unsigned int normalize(const std::string& path, std::string& normalized);
+
+	/// find the id of a normalized path, INVALID_PATH if not interned
+	PathId lookup(const std::string& normalized, unsigned int hash) const;
+
+	/// intern a normalized path, if not already
+	PathId intern(const std::string& normalized, unsigned int hash);
+
+	/// double the hash table
+	void grow();
+
+	/// set whether a file is in a resource directory
+	void setFile(int directory, const std::string& relative, bool present);
+
+	/// mark every file under a directory as gone
+	void removeTree(int directory, const std::string& relative);
+
+	/// add every file under a directory (and watch it for changes)
+	void scan(int directory, const std::string& relative);
+
+	/// forget which files are where and scan every resource directory again
+	void rebuild();
+
+public:
+	/// standard constructor
+	ResourceIndex();
+
+	/// destructor
+	~ResourceIndex();
+
+	/** add a resource directory, indexing every file under it. Directories
+	 * added earlier take precedence when several contain the same path
+	 * @param dir the directory to add
+	 */
+	void addDirectory(const std::string& dir);
+
+	/** find the id of a path, with any separators and "." or ".." parts
+	 * @return the path's id, INVALID_PATH if no file was ever found at the path
+	 */
+	PathId find(const std::string& path);
+
+	/** look for a file in the resource directories directly, indexing it 
+	 * if found. Finds files added where changes aren't watched
+	 * @return the path's id, INVALID_PATH if the file isn't in any resource directory
+	 */
+	PathId probe(const std::string& path);
+
+	/// check if the file with a path id is currently in any resource directory
+	bool exists(PathId id);
+
+	/** get the full path of the file with a path id, in the first 
+	 * resource directory containing it
+	 * @return the full path, "" if not in any resource directory
+	 */
+	std::string getFullPath(PathId id);
+
+	/** apply the changes to the resource directories reported since
+	 * the last call. Does nothing where changes aren't watched
+	 * @return true if any change was applied
+	 */
+	bool update();
+
+	/// forget which files are where and scan every resource directory again
+	void rescan();
+
+	/// get the number of files in the index
+	inline int getFileCount() const
+	{
+		return this->fileCount;
+	}
+
+	/// get the number of interned paths, including those of files that are gone
+	inline int getPathCount() const
+	{
+		return (int)this->entries.size();
+	}
+};
+
+};
+
+#endif
@@ -26,6 +26,8 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <Resources/ResourceManager.h>
 #include <fstream>
 #include <Exceptions/ResourceNotFoundException.h>
+#include <Time/StopWatch.h>
+#include <string.h>
 
 namespace Magic3D
 {
@@ -34,6 +36,200 @@ namespace Magic3D
 /// destructor
 ResourceManager::~ResourceManager()
 {
+	// stop the loader threads before anything they use goes away
+	delete this->loaders;
+}
+
+ResourceManager::TypeCache& ResourceManager::getCache(const std::type_index& type)
+{
+	auto it = this->caches.find(type);
+	if (it != this->caches.end())
+		return it->second;
+
+	TypeCache& typeCache = this->caches[type];
+	typeCache.pinnedBytes = 0;
+	memset(&typeCache.stats, 0, sizeof(CacheStats));
+	typeCache.stats.budget = DEFAULT_CACHE_BUDGET;
+	return typeCache;
+}
+
+void ResourceManager::retain(const Key& key, const std::shared_ptr<void>& resource, size_t size, bool pin)
+{
+	TypeCache& typeCache = this->getCache(key.second);
+	auto it = typeCache.entries.find(key.first);
+	if (it == typeCache.entries.end())
+	{
+		// nothing unpinned is kept without a budget
+		if (typeCache.stats.budget == 0 && !pin)
+			return;
+
+		CacheEntry entry;
+		entry.resource = resource;
+		entry.size = size;
+		entry.pinned = false;
+		entry.lruPosition = typeCache.lru.end();
+		it = typeCache.entries.insert(std::make_pair(key.first, entry)).first;
+		typeCache.stats.entries++;
+		typeCache.stats.bytes += size;
+	}
+
+	CacheEntry& entry = it->second;
+	if (entry.pinned)
+		return;
+
+	if (entry.lruPosition != typeCache.lru.end())
+		typeCache.lru.erase(entry.lruPosition);
+
+	if (pin)
+	{
+		entry.pinned = true;
+		entry.lruPosition = typeCache.lru.end();
+		typeCache.pinnedBytes += entry.size;
+		typeCache.stats.pinned++;
+	}
+	else
+	{
+		typeCache.lru.push_front(key.first);
+		entry.lruPosition = typeCache.lru.begin();
+		this->evict(typeCache);
+	}
+}
+
+void ResourceManager::unpin(ResourceIndex::PathId id, const std::type_index& type)
+{
+	TypeCache& typeCache = this->getCache(type);
+	auto it = typeCache.entries.find(id);
+	if (it == typeCache.entries.end() || !it->second.pinned)
+		return;
+
+	CacheEntry& entry = it->second;
+	entry.pinned = false;
+	typeCache.pinnedBytes -= entry.size;
+	typeCache.stats.pinned--;
+	typeCache.lru.push_front(id);
+	entry.lruPosition = typeCache.lru.begin();
+	this->evict(typeCache);
+}
+
+void ResourceManager::evict(TypeCache& typeCache)
+{
+	while (!typeCache.lru.empty() && typeCache.stats.bytes - typeCache.pinnedBytes > typeCache.stats.budget)
+	{
+		auto it = typeCache.entries.find(typeCache.lru.back());
+		this->evicted.push_back(it->second.resource);
+		typeCache.stats.bytes -= it->second.size;
+		typeCache.stats.entries--;
+		typeCache.stats.evictions++;
+		typeCache.entries.erase(it);
+		typeCache.lru.pop_back();
+	}
+}
+
+void ResourceManager::pruneExpired()
+{
+	for (auto it = this->resources.begin(); it != this->resources.end(); )
+	{
+		if (it->second.expired())
+			it = this->resources.erase(it);
+		else
+			++it;
+	}
+	this->prunedSize = this->resources.size();
+}
+
+void ResourceManager::releaseEvicted()
+{
+	if (std::this_thread::get_id() != this->mainThread)
+		return;
+
+	// the resources are destroyed when this goes out of scope, after unlocking
+	std::vector<std::shared_ptr<void>> released;
+	std::lock_guard<std::mutex> lock(this->loadMutex);
+	released.swap(this->evicted);
+}
+
+void ResourceManager::clearCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		for (auto& type : this->caches)
+		{
+			TypeCache& typeCache = type.second;
+			for (auto id : typeCache.lru)
+			{
+				auto it = typeCache.entries.find(id);
+				this->evicted.push_back(it->second.resource);
+				typeCache.entries.erase(it);
+			}
+			typeCache.lru.clear();
+			typeCache.stats.bytes = typeCache.pinnedBytes;
+			typeCache.stats.entries = typeCache.stats.pinned;
+		}
+		this->pruneExpired();
+	}
+	this->releaseEvicted();
+}
+
+void ResourceManager::startLoaders()
+{
+	if (this->loaders != nullptr)
+		return;
+
+	// the loader and parser singletons are created on first use, make 
+	// sure that doesn't happen on several loader threads at once
+	ImageLoaders::getSingleton();
+	MeshLoaders::getSingleton();
+	ColorParser::getSingleton();
+	GpuProgramParser::getSingleton();
+
+	this->loaders = new ThreadPool(this->loaderThreadCount);
+}
+
+void ResourceManager::queueFinalize(const std::function<bool()>& step)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		this->finalizeQueue.push_back(step);
+		this->finalizeQueued++;
+	}
+	this->finalizeAdded.notify_all();
+}
+
+int ResourceManager::finishLoads(float maxTime)
+{
+	std::vector<std::function<bool()>> steps;
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		steps.swap(this->finalizeQueue);
+	}
+
+	StopWatch timer;
+	std::vector<std::function<bool()>> waiting;
+	int finished = 0;
+	unsigned int i = 0;
+	for (; i < steps.size(); i++)
+	{
+		if (maxTime > 0.0f && finished > 0 && timer.getElapsedTime() >= maxTime)
+			break;
+
+		// steps still waiting on other loads are tried again next time
+		if (steps[i]())
+			finished++;
+		else
+			waiting.push_back(steps[i]);
+	}
+
+	// put back what wasn't finished ahead of anything queued since
+	waiting.insert(waiting.end(), steps.begin() + i, steps.end());
+	if (!waiting.empty())
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		waiting.insert(waiting.end(), this->finalizeQueue.begin(), this->finalizeQueue.end());
+		this->finalizeQueue.swap(waiting);
+	}
+
+	this->releaseEvicted();
+	return finished;
 }
 
 
@@ -27,6 +27,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Resource.h"
 #include "TextResource.h"
+#include "ResourceIndex.h"
 #include "../Exceptions/MagicException.h"
 #include "../Exceptions/ResourceNotFoundException.h"
 #include "ImageLoaders.h"
@@ -34,6 +35,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "fonts\TTFontResource.h"
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <fstream>
 #include "MeshLoader.h"
@@ -45,6 +47,19 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <Graphics\MaterialBuilder.h>
 #include <CollisionShapes\CollisionShape.h>
 #include <CollisionShapes\BoxCollisionShape.h>
+#include <Util/ThreadPool.h>
+#include <Shaders/ProgramCache.h>
+#include <Util/magic_assert.h>
+#include <Util/magic_throw.h>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <typeindex>
+#include <list>
+#include <algorithm>
+#include <cstring>
+#include <thread>
 
 
 namespace Magic3D
@@ -55,42 +70,384 @@ namespace Magic3D
  */
 class ResourceManager
 {
+public:
+	/// counters and sizes of the cache kept for one type of resource
+	struct CacheStats
+	{
+		/// requests served by a resource that was already loaded or loading
+		int hits;
+		/// requests that had to load the resource
+		int misses;
+		/// resources dropped from the cache to stay within its budget
+		int evictions;
+		/// number of resources held by the cache, and how many of those are pinned
+		int entries;
+		int pinned;
+		/// size (in bytes) of the resources held by the cache, pinned ones included
+		size_t bytes;
+		/// size (in bytes) the unpinned resources are kept within
+		size_t budget;
+	};
+
+	/// default budget of the cache of each type of resource
+	static const size_t DEFAULT_CACHE_BUDGET = 64 * 1024 * 1024;
+
 private:
-	/// mapping of resource names and resources
-	std::map<std::string, std::weak_ptr<Resource>> resources;
+	/// resources are looked up by the interned id of their path and their type
+	typedef std::pair<ResourceIndex::PathId, std::type_index> Key;
+
+	struct KeyHash
+	{
+		inline size_t operator()(const Key& key) const
+		{
+			return key.second.hash_code() ^ ((size_t)key.first * 2654435761u);
+		}
+	};
+
+	/// a resource the cache keeps loaded after its last user lets go of it
+	struct CacheEntry
+	{
+		std::shared_ptr<void> resource;
+		size_t size;
+		bool pinned;
+		/// place in the least recently used list, unless pinned
+		std::list<ResourceIndex::PathId>::iterator lruPosition;
+	};
+
+	/// cache of one type of resource
+	struct TypeCache
+	{
+		std::unordered_map<ResourceIndex::PathId, CacheEntry> entries;
+		/// paths of the unpinned entries, most recently used first
+		std::list<ResourceIndex::PathId> lru;
+		size_t pinnedBytes;
+		CacheStats stats;
+	};
+
+	/** Last step of a load, run on the main thread to do the work that
+	 * needs the GL context. Returns false without producing the resource
+	 * if it is still waiting on other loads, to be retried later
+	 */
+	template<class T>
+	struct Finalizer
+	{
+		typedef std::function<bool(std::shared_ptr<T>&)> Step;
+	};
+
+	/// a load started by getAsync that hasn't finished yet
+	struct PendingLoadBase
+	{
+		virtual ~PendingLoadBase() {}
+	};
+
+	template<class T>
+	struct PendingLoad : public PendingLoadBase
+	{
+		std::promise<std::shared_ptr<T>> promise;
+		std::shared_future<std::shared_ptr<T>> future;
+	};
+
+	/// every loaded resource that's still in use somewhere
+	std::unordered_map<Key, std::weak_ptr<void>, KeyHash> resources;
+
+	/// size of the resource map after it was last pruned of expired resources
+	size_t prunedSize;
+
+	/// resources kept loaded whether in use or not, by type
+	std::map<std::type_index, TypeCache> caches;
+
+	/** resources evicted from the caches, destroyed by releaseEvicted() so
+	 * GL resources aren't destroyed on loader threads
+	 */
+	std::vector<std::shared_ptr<void>> evicted;
+
+	/// thread the manager was created on, assumed to be the one owning the GL context
+	std::thread::id mainThread;
+
+	/// loads started by getAsync that haven't finished yet
+	std::unordered_map<Key, std::shared_ptr<PendingLoadBase>, KeyHash> pendingLoads;
 	
-	/// directory where resources are contained
-	std::vector<std::string> resourceDirs;
+	/// index of the files in the resource directories
+	ResourceIndex index;
+
+	/// guards the resource maps and the finalize queue, which loader threads also use
+	std::mutex loadMutex;
+
+	/// last steps of asynchronous loads, waiting to be run on the main thread
+	std::vector<std::function<bool()>> finalizeQueue;
+
+	/// number of steps ever added to the finalize queue
+	int finalizeQueued;
 
+	/// signaled when a step is added to the finalize queue
+	std::condition_variable finalizeAdded;
+
+	/// threads decoding resources for getAsync, started on the first asynchronous load
+	ThreadPool* loaders;
+
+	/// number of loader threads to start, 0 for the pool's default
+	int loaderThreadCount;
+
+	/** cache of program binaries programs are linked with, null if disabled. Shared 
+	 * with programs still linking, so changing it doesn't free it from under them
+	 */
+	std::shared_ptr<ProgramCache> programCache;
+
+	/** load a resource in one go, specialized for resources that
+	 * need no GL calls to load
+	 */
 	template<class T>
 	inline std::shared_ptr<T> _get(const std::string& fullPath)
 	{
 		/* intentionally left blank, always need a specialization */
 	}
 
-	inline std::string getFullPath(const std::string& path)
+	/** estimate the memory used by a resource, specialized for 
+	 * resources holding large amounts of data
+	 */
+	template<class T>
+	inline size_t _size(const T& /*resource*/)
+	{
+		return sizeof(T);
+	}
+
+	/** do the part of a load that can run on any thread. Resources that 
+	 * need GL calls specialize this to leave those to the returned step
+	 * @param fullPath full path of the resource file
+	 * @param async true if loaded for getAsync, so resources this one
+	 * depends on should be loaded asynchronously too
+	 * @return step finishing the load on the main thread
+	 */
+	template<class T>
+	inline typename Finalizer<T>::Step _decode(const std::string& fullPath, bool /*async*/)
+	{
+		std::shared_ptr<T> resource = this->_get<T>(fullPath);
+		return [resource](std::shared_ptr<T>& out) -> bool
+		{
+			out = resource;
+			return true;
+		};
+	}
+
+	/** find the file of a resource in the resource directories
+	 * @param path the name of the resource
+	 * @param id set to the id of the resource's path
+	 * @return full path of the file, "" if there is none
+	 */
+	inline std::string getFullPath(const std::string& path, ResourceIndex::PathId& id)
+	{
+		id = this->index.find(path);
+		std::string fullPath = this->index.getFullPath(id);
+
+		// the file may be new, catch up on changes to the directories before giving up
+		if (fullPath == "" && this->index.update())
+		{
+			id = this->index.find(path);
+			fullPath = this->index.getFullPath(id);
+		}
+
+		// changes aren't watched on every platform, look for the file itself
+		if (fullPath == "")
+		{
+			id = this->index.probe(path);
+			fullPath = this->index.getFullPath(id);
+		}
+		return fullPath;
+	}
+
+	/// get the cache of a type of resource, creating it if needed. Call with loadMutex held
+	TypeCache& getCache(const std::type_index& type);
+
+	/** keep a resource in its type's cache and mark it most recently used,
+	 * evicting the least recently used resources if over budget. Call with loadMutex held
+	 */
+	void retain(const Key& key, const std::shared_ptr<void>& resource, size_t size, bool pin = false);
+
+	/// drop the least recently used resources until the cache is within budget
+	void evict(TypeCache& cache);
+
+	/// remove the expired resources from the resource map. Call with loadMutex held
+	void pruneExpired();
+
+	/// destroy the evicted resources, if called from the main thread. Call without loadMutex held
+	void releaseEvicted();
+
+	/// remember a loaded resource so later requests for it share it. Call with loadMutex held
+	template <class T>
+	inline void cache(ResourceIndex::PathId id, const std::shared_ptr<T>& resource)
+	{
+		// expired resources are pruned whenever the map has doubled, 
+		// so the map can't grow without bound
+		if (this->resources.size() >= std::max<size_t>(this->prunedSize * 2, 64))
+			this->pruneExpired();
+
+		Key key(id, std::type_index(typeid(T)));
+		this->resources[key] = resource;
+		if (resource != nullptr)
+			this->retain(key, resource, this->_size<T>(*resource));
+	}
+
+	/// find a resource that's already loaded, counting a hit or miss. Call with loadMutex held
+	template <class T>
+	inline std::shared_ptr<T> findLoaded(ResourceIndex::PathId id)
 	{
-		for (const std::string& basePath : resourceDirs)
+		Key key(id, std::type_index(typeid(T)));
+		auto it = resources.find(key);
+		if (it != resources.end())
 		{
-			std::ifstream test;
-			std::string fullPath = basePath + "/" + path;
-			test.open(fullPath.c_str());
-			if (test.is_open() && test.good())
-				return fullPath;
+			std::shared_ptr<T> resource = std::static_pointer_cast<T>(it->second.lock());
+			if (resource != nullptr)
+			{
+				this->getCache(key.second).stats.hits++;
+				this->retain(key, resource, this->_size<T>(*resource));
+				return resource;
+			}
 		}
-		return "";
+		return nullptr;
+	}
+
+	template <class T>
+	inline static std::shared_future<std::shared_ptr<T>> makeReady(const std::shared_ptr<T>& resource)
+	{
+		std::promise<std::shared_ptr<T>> promise;
+		promise.set_value(resource);
+		return promise.get_future().share();
+	}
+
+	template <class T>
+	inline static bool isReady(const std::shared_future<std::shared_ptr<T>>& future)
+	{
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	/** get a resource another one depends on, asynchronously if 
+	 * the one depending on it is being loaded asynchronously
+	 */
+	template <class T>
+	inline std::shared_future<std::shared_ptr<T>> request(const std::string& path, bool async)
+	{
+		if (async)
+			return this->getAsync<T>(path);
+		return makeReady(this->get<T>(path));
+	}
+
+	/// unpin a resource of the given type. Call with loadMutex held
+	void unpin(ResourceIndex::PathId id, const std::type_index& type);
+
+	/// start the loader threads, if not already started
+	void startLoaders();
+
+	/// add a step to the finalize queue
+	void queueFinalize(const std::function<bool()>& step);
+
+	/// run on a loader thread to do the thread-safe part of an asynchronous load
+	template <class T>
+	inline void decode(ResourceIndex::PathId id, const std::string& fullPath, std::shared_ptr<PendingLoad<T>> pending)
+	{
+		typename Finalizer<T>::Step finalize;
+		try
+		{
+			finalize = this->_decode<T>(fullPath, true);
+		}
+		catch (...)
+		{
+			this->finishLoad<T>(id, *pending, nullptr, std::current_exception());
+			return;
+		}
+
+		this->queueFinalize([this, id, pending, finalize]() -> bool
+		{
+			std::shared_ptr<T> resource;
+			try
+			{
+				if (!finalize(resource))
+					return false;
+			}
+			catch (...)
+			{
+				this->finishLoad<T>(id, *pending, nullptr, std::current_exception());
+				return true;
+			}
+			this->finishLoad<T>(id, *pending, resource, nullptr);
+			return true;
+		});
+	}
+
+	/// hand the result of an asynchronous load to anyone waiting on it
+	template <class T>
+	inline void finishLoad(ResourceIndex::PathId id, PendingLoad<T>& pending, 
+		const std::shared_ptr<T>& resource, std::exception_ptr error)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			if (!error)
+				this->cache(id, resource);
+			this->pendingLoads.erase(Key(id, std::type_index(typeid(T))));
+		}
+
+		if (error)
+			pending.promise.set_exception(error);
+		else
+			pending.promise.set_value(resource);
 	}
 	
 public:
 
-	inline ResourceManager() {}
+	/// standard constructor, has to be called on the thread that will own the GL context
+	inline ResourceManager() : prunedSize(0), mainThread(std::this_thread::get_id()), finalizeQueued(0), 
+		loaders(nullptr), loaderThreadCount(0) {}
 		
 	/// destructor
 	virtual ~ResourceManager();
 
+	/** add a directory to look for resources in, indexing all files in it.
+	 * Directories added first are searched first
+	 * @param dir the directory
+	 */
 	inline void addResourceDir(const std::string& dir)
 	{
-		this->resourceDirs.push_back(dir);
+		this->index.addDirectory(dir);
+	}
+
+	/** scan the resource directories for added or removed files again. 
+	 * On Linux changes are followed automatically, so this isn't needed.
+	 * Elsewhere files added later are still found when first requested,
+	 * but removed files are only noticed after calling this
+	 */
+	inline void rescanResourceDirs()
+	{
+		this->index.rescan();
+	}
+
+	/** Set the number of threads used for asynchronous loads, has to
+	 * be called before the first call to getAsync
+	 * @param count number of threads, 0 for one less than the number of hardware threads
+	 */
+	inline void setLoaderThreadCount(int count)
+	{
+		MAGIC_THROW(this->loaders != nullptr, "Loader threads have already been started.");
+		this->loaderThreadCount = count;
+	}
+
+	/// get the number of threads used for asynchronous loads, 0 if not started yet
+	inline int getLoaderThreadCount() const
+	{
+		return this->loaders != nullptr ? this->loaders->getThreadCount() : 0;
+	}
+
+	/** Keep the binaries of loaded GpuPrograms in a directory, so later runs 
+	 * load them instead of compiling and linking the shaders again
+	 * @param dir the directory, "" to disable the cache
+	 */
+	inline void setProgramCacheDir(const std::string& dir)
+	{
+		this->programCache = dir != "" ? std::make_shared<ProgramCache>(dir) : nullptr;
+	}
+
+	/// get the cache of program binaries, null if disabled
+	inline std::shared_ptr<ProgramCache> getProgramCache() const
+	{
+		return this->programCache;
 	}
 		
 	/** Check if a resource exists, to be to avoid exceptions for optional resources
@@ -99,7 +456,8 @@ public:
 	 */
 	inline bool doesResourceExist(const std::string& path)
 	{
-		return (this->getFullPath(path) != "");
+		ResourceIndex::PathId id;
+		return (this->getFullPath(path, id) != "");
 	}
 		
 	/** get a resource
@@ -110,26 +468,219 @@ public:
 	inline std::shared_ptr<T> get(const std::string& path)
 	{
 		// check if resource is already loaded
-		auto it = resources.find(path);
-		if (it != resources.end() && !it->second.expired())
+		ResourceIndex::PathId id = this->index.find(path);
+		std::shared_ptr<T> loaded;
+		std::shared_ptr<PendingLoad<T>> pending;
+		if (id != ResourceIndex::INVALID_PATH)
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			loaded = this->findLoaded<T>(id);
+
+			// join a load getAsync already started instead of loading a second copy
+			auto it = this->pendingLoads.find(Key(id, std::type_index(typeid(T))));
+			if (loaded == nullptr && it != this->pendingLoads.end())
+			{
+				this->getCache(typeid(T)).stats.hits++;
+				pending = std::static_pointer_cast<PendingLoad<T>>(it->second);
+			}
+		}
+		if (pending != nullptr)
+		{
+			// only the main thread can finish the load, others wait for it to
+			if (std::this_thread::get_id() == this->mainThread)
+				return this->wait(pending->future);
+			return pending->future.get();
+		}
+		if (loaded != nullptr)
 		{
-			std::shared_ptr<Resource> ptr = std::shared_ptr<Resource>(it->second);
-			return std::dynamic_pointer_cast<T>(ptr);
+			this->releaseEvicted();
+			return loaded;
 		}
 		
 		// otherwise, create new resource
 
 		// make sure file exists
-		std::string fullPath = this->getFullPath(path);
+		std::string fullPath = this->getFullPath(path, id);
 		if (fullPath == "")
 			throw_ResourceNotFoundException(path);
 
-		// load resource
-		std::shared_ptr<T> resource = this->_get<T>(fullPath);
-		resources.insert(std::pair<std::string, std::weak_ptr<Resource>>(
-			path, std::weak_ptr<Resource>(std::dynamic_pointer_cast<Resource>(resource))));
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			this->getCache(typeid(T)).stats.misses++;
+		}
+
+		// load resource, with nothing to wait on the last step finishes right away
+		std::shared_ptr<T> resource;
+		bool finished = this->_decode<T>(fullPath, false)(resource);
+		MAGIC_ASSERT(finished);
+
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			this->cache(id, resource);
+		}
+		this->releaseEvicted();
 		return resource;
 	}
+
+	/** Start loading a resource on the loader threads. Decoding the file
+	 * happens on the loader threads, the GL calls (texture uploads, shader
+	 * compiles, etc.) happen on the main thread in finishLoads(). Loading
+	 * a resource that's already being loaded returns the same future
+	 * @param name the name of the resource including any extra path info
+	 * @return future that becomes ready once finishLoads() has finished the load
+	 */
+	template <class T>
+	inline std::shared_future<std::shared_ptr<T>> getAsync(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		TypeCache& typeCache = this->getCache(typeid(T));
+
+		ResourceIndex::PathId id = this->index.find(path);
+		if (id != ResourceIndex::INVALID_PATH)
+		{
+			std::shared_ptr<T> loaded = this->findLoaded<T>(id);
+			if (loaded != nullptr)
+				return makeReady(loaded);
+
+			auto it = this->pendingLoads.find(Key(id, std::type_index(typeid(T))));
+			if (it != this->pendingLoads.end())
+			{
+				typeCache.stats.hits++;
+				return std::static_pointer_cast<PendingLoad<T>>(it->second)->future;
+			}
+		}
+
+		// make sure file exists
+		std::string fullPath = this->getFullPath(path, id);
+		if (fullPath == "")
+			throw_ResourceNotFoundException(path);
+		typeCache.stats.misses++;
+		Key key(id, std::type_index(typeid(T)));
+
+		auto pending = std::make_shared<PendingLoad<T>>();
+		pending->future = pending->promise.get_future().share();
+		this->pendingLoads.insert(std::make_pair(key, pending));
+
+		this->startLoaders();
+		this->loaders->submit([this, id, fullPath, pending]()
+		{
+			this->decode<T>(id, fullPath, pending);
+		});
+		return pending->future;
+	}
+
+	/** Finish asynchronous loads whose loader thread work is done. Has
+	 * to be called regularly from the thread owning the GL context
+	 * @param maxTime time (in seconds) to spend before leaving the rest
+	 * for the next call, 0 for no limit. At least one load is finished
+	 * regardless
+	 * @return the number of loads finished
+	 */
+	int finishLoads(float maxTime = 0.0f);
+
+	/** Wait for an asynchronous load, finishing loads on this thread 
+	 * while waiting. Has to be called from the thread owning the GL context
+	 * @param future future returned by getAsync
+	 * @return the loaded resource
+	 */
+	template <class T>
+	inline std::shared_ptr<T> wait(const std::shared_future<std::shared_ptr<T>>& future)
+	{
+		while (!isReady(future))
+		{
+			std::unique_lock<std::mutex> lock(this->loadMutex);
+			int queued = this->finalizeQueued;
+			lock.unlock();
+
+			if (this->finishLoads() > 0)
+				continue;
+
+			// nothing could be finished yet, sleep until a loader thread queues more work
+			lock.lock();
+			this->finalizeAdded.wait_for(lock, std::chrono::milliseconds(1), 
+				[this, queued]() { return this->finalizeQueued != queued; });
+		}
+		return future.get();
+	}
+
+	/** Start loading a resource so it's already loaded when needed. The 
+	 * resource stays loaded as long as its type's cache has room for it
+	 * @param name the name of the resource including any extra path info
+	 */
+	template <class T>
+	inline void prefetch(const std::string& path)
+	{
+		this->getAsync<T>(path);
+	}
+
+	/** Get a resource and keep it loaded until unpinned, regardless of
+	 * the cache budget
+	 * @param name the name of the resource including any extra path info
+	 * @return handle to resource
+	 */
+	template <class T>
+	inline std::shared_ptr<T> pin(const std::string& path)
+	{
+		std::shared_ptr<T> resource = this->get<T>(path);
+		MAGIC_THROW(resource == nullptr, "Tried to pin a resource that failed to load.");
+
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			this->retain(Key(this->index.find(path), std::type_index(typeid(T))), resource, 
+				this->_size<T>(*resource), true);
+		}
+		this->releaseEvicted();
+		return resource;
+	}
+
+	/** Let a pinned resource be evicted from the cache again, it becomes
+	 * the most recently used resource of its type
+	 * @param name the name of the resource including any extra path info
+	 */
+	template <class T>
+	inline void unpin(const std::string& path)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			this->unpin(this->index.find(path), typeid(T));
+		}
+		this->releaseEvicted();
+	}
+
+	/** Set the size the cache of a type of resource is kept within. Pinned
+	 * resources don't count towards the budget. A budget of 0 keeps 
+	 * resources loaded only while they're used
+	 * @param bytes budget (in bytes)
+	 */
+	template <class T>
+	inline void setCacheBudget(size_t bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->loadMutex);
+			TypeCache& typeCache = this->getCache(typeid(T));
+			typeCache.stats.budget = bytes;
+			this->evict(typeCache);
+		}
+		this->releaseEvicted();
+	}
+
+	/// get the counters and sizes of the cache of a type of resource
+	template <class T>
+	inline CacheStats getCacheStats()
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		return this->getCache(typeid(T)).stats;
+	}
+
+	/// drop every unpinned resource from the caches, they stay loaded only while used
+	void clearCache();
+
+	/// get the number of asynchronous loads that haven't finished yet
+	inline int getPendingLoadCount()
+	{
+		std::lock_guard<std::mutex> lock(this->loadMutex);
+		return (int)this->pendingLoads.size();
+	}
 	
 };
 
@@ -159,6 +710,12 @@ inline std::shared_ptr<TextResource> ResourceManager::_get<TextResource>(const s
 	return std::make_shared<TextResource>(text);
 }
 
+template<>
+inline size_t ResourceManager::_size<TextResource>(const TextResource& text)
+{
+	return sizeof(TextResource) + strlen(text.getText()) + 1;
+}
+
 template<>
 inline std::shared_ptr<Image> ResourceManager::_get<Image>(const std::string& fullPath)
 {
@@ -168,6 +725,12 @@ inline std::shared_ptr<Image> ResourceManager::_get<Image>(const std::string& fu
 	return loader->getImage(fullPath);
 }
 
+template<>
+inline size_t ResourceManager::_size<Image>(const Image& image)
+{
+	return sizeof(Image) + image.getWidth() * image.getHeight() * image.getChannelCount();
+}
+
 template<>
 inline std::shared_ptr<FontResource> ResourceManager::_get<FontResource>(const std::string& fullPath)
 {
@@ -176,14 +739,50 @@ inline std::shared_ptr<FontResource> ResourceManager::_get<FontResource>(const s
 }
 
 template<>
-inline std::shared_ptr<Meshes> ResourceManager::_get<Meshes>(const std::string& fullPath)
+inline ResourceManager::Finalizer<FontResource>::Step ResourceManager::_decode<FontResource>(
+	const std::string& fullPath, bool /*async*/)
+{
+	// all fonts share one freetype library, which isn't thread-safe
+	return [this, fullPath](std::shared_ptr<FontResource>& font) -> bool
+	{
+		font = this->_get<FontResource>(fullPath);
+		return true;
+	};
+}
+
+template<>
+inline ResourceManager::Finalizer<Meshes>::Step ResourceManager::_decode<Meshes>(
+	const std::string& fullPath, bool async)
 {
 	std::string ext = fullPath.substr(fullPath.find_last_of(".")+1);
-	return MeshLoaders::getSingleton().get(ext)->getMeshes(fullPath);
+	auto meshes = MeshLoaders::getSingleton().get(ext)->getMeshes(fullPath);
+
+	return [meshes, async](std::shared_ptr<Meshes>& out) -> bool
+	{
+		// synchronous loads leave the upload to the first draw, asynchronous
+		// ones upload now so the first draw doesn't hitch
+		if (async)
+		{
+			for (auto& mesh : *meshes)
+				mesh->getVertexArray();
+		}
+		out = meshes;
+		return true;
+	};
+}
+
+template<>
+inline size_t ResourceManager::_size<Meshes>(const Meshes& meshes)
+{
+	size_t size = sizeof(Meshes);
+	for (auto& mesh : meshes)
+		size += sizeof(Mesh) + mesh->getDataSize();
+	return size;
 }
 
 template<>
-inline std::shared_ptr<Shader> ResourceManager::_get<Shader>(const std::string& fullPath)
+inline ResourceManager::Finalizer<Shader>::Step ResourceManager::_decode<Shader>(
+	const std::string& fullPath, bool /*async*/)
 {
 	auto text = this->_get<TextResource>(fullPath);
 	std::string ext = fullPath.substr(fullPath.find_last_of(".")+1);
@@ -195,7 +794,11 @@ inline std::shared_ptr<Shader> ResourceManager::_get<Shader>(const std::string&
 	else if (ext == "fp")
 		type = Shader::Type::FRAGMENT;
 
-	return std::make_shared<Shader>(text->getText(), type);
+	return [text, type](std::shared_ptr<Shader>& shader) -> bool
+	{
+		shader = std::make_shared<Shader>(text->getText(), type);
+		return true;
+	};
 }
 
 class ColorParser
@@ -244,11 +847,13 @@ public:
 };
 
 template<>
-inline std::shared_ptr<Texture> ResourceManager::_get<Texture>(const std::string& fullPath)
+inline ResourceManager::Finalizer<Texture>::Step ResourceManager::_decode<Texture>(
+	const std::string& fullPath, bool /*async*/)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
-	// TODO: check doc load error and throw exception
+	doc.LoadFile(fullPath.c_str());
+	if (doc.Error())
+		throw_MagicException("Failed to parse resource file");
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* textureNode = doc.FirstChildElement("Texture");
@@ -267,11 +872,19 @@ inline std::shared_ptr<Texture> ResourceManager::_get<Texture>(const std::string
 		image = std::make_shared<Image>(1, 1, color.getChannelCount(), color);
 	}
 
-	auto texture = std::make_shared<Texture>(*image);
-	
 	// TODO: parse wrap mode and other texture properties
 
-	return texture;
+	return [image](std::shared_ptr<Texture>& texture) -> bool
+	{
+		texture = std::make_shared<Texture>(*image);
+		return true;
+	};
+}
+
+template<>
+inline size_t ResourceManager::_size<Texture>(const Texture& texture)
+{
+	return sizeof(Texture) + texture.getDataSize();
 }
 
 
@@ -289,6 +902,7 @@ class GpuProgramParser
 		attributeMap.insert(std::make_pair("TEX_COORD_0", GpuProgram::AttributeType::TEX_COORD_0));
 		attributeMap.insert(std::make_pair("TANGENT", GpuProgram::AttributeType::TANGENT));
 		attributeMap.insert(std::make_pair("BINORMAL", GpuProgram::AttributeType::BINORMAL));
+		attributeMap.insert(std::make_pair("INSTANCE_MATRIX", GpuProgram::AttributeType::INSTANCE_MATRIX));
 
 		uniformMap.insert(std::make_pair("MODEL_MATRIX", GpuProgram::AutoUniformType::MODEL_MATRIX));
 		uniformMap.insert(std::make_pair("VIEW_MATRIX", GpuProgram::AutoUniformType::VIEW_MATRIX));
@@ -330,21 +944,27 @@ public:
 };
 
 template<>
-inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::string& fullPath)
+inline ResourceManager::Finalizer<GpuProgram>::Step ResourceManager::_decode<GpuProgram>(
+	const std::string& fullPath, bool async)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
-	// TODO: check doc load error and throw exception
+	doc.LoadFile(fullPath.c_str());
+	if (doc.Error())
+		throw_MagicException("Failed to parse resource file");
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* programNode = doc.FirstChildElement("GpuProgram");
 
-	auto vertexProgram = this->get<Shader>(programNode->FirstChildElement("vertexShader")->Attribute("ref"));
-	auto fragmentProgram = this->get<Shader>(programNode->FirstChildElement("fragmentShader")->Attribute("ref"));
+	auto vertexProgram = this->request<Shader>(programNode->FirstChildElement("vertexShader")->Attribute("ref"), async);
+	auto fragmentProgram = this->request<Shader>(programNode->FirstChildElement("fragmentShader")->Attribute("ref"), async);
 
-	auto program = std::make_shared<GpuProgram>(vertexProgram, fragmentProgram);
+	auto& parser = GpuProgramParser::getSingleton();
 
-	auto parser = GpuProgramParser::getSingleton();
+	// the program can only be made once its shaders are compiled, so 
+	// everything parsed is kept until then
+	std::vector<std::pair<std::string, GpuProgram::AttributeType>> attributes;
+	std::vector<std::pair<std::string, GpuProgram::AutoUniformType>> autoUniforms;
+	std::vector<std::pair<std::string, std::vector<float>>> namedUniforms;
 
 	auto attributeNode = programNode->FirstChildElement("attribute");
 	while (attributeNode != nullptr)
@@ -352,7 +972,7 @@ inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::
 		auto name = attributeNode->FirstChildElement("name")->GetText();
 		auto typeText = attributeNode->FirstChildElement("type")->GetText();
 		auto type = parser.parseAttributeType(typeText);
-		program->bindAttrib(name, type);
+		attributes.push_back(std::make_pair(std::string(name), type));
 
 		attributeNode = attributeNode->NextSiblingElement("attribute");
 	}
@@ -367,7 +987,7 @@ inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::
 		if (valueRef != nullptr)
 		{
 			auto value = parser.parseAutoUniformType(valueRef);
-			program->addAutoUniform(name, value);
+			autoUniforms.push_back(std::make_pair(std::string(name), value));
 		}
 		else
 		{
@@ -378,54 +998,88 @@ inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::
 				components.push_back(std::stof(componentNode->GetText()));
 				componentNode = componentNode->NextSiblingElement("c");
 			}
-
-			float* data = new float[components.size()];
-			for(unsigned int i=0; i < components.size(); i++)
-				data[i] = components[i];
-			program->addNamedUniform(name, VertexArray::FLOAT, components.size(), data);
-			delete[] data;
+			namedUniforms.push_back(std::make_pair(std::string(name), components));
 		}
 
 		uniformNode = uniformNode->NextSiblingElement("uniform");
 	}
 
-	program->link();
-	return program;
+	// asynchronous loads only start the link and come back for it once the driver
+	// is done, so all programs loaded together compile and link in parallel
+	auto linking = std::make_shared<std::shared_ptr<GpuProgram>>();
+	return [this, async, linking, vertexProgram, fragmentProgram, attributes, autoUniforms, namedUniforms]
+		(std::shared_ptr<GpuProgram>& out) -> bool
+	{
+		std::shared_ptr<GpuProgram>& program = *linking;
+		if (program == nullptr)
+		{
+			if (!isReady(vertexProgram) || !isReady(fragmentProgram))
+				return false;
+
+			program = std::make_shared<GpuProgram>(vertexProgram.get(), fragmentProgram.get());
+
+			for (auto& attribute : attributes)
+				program->bindAttrib(attribute.first.c_str(), attribute.second);
+
+			for (auto& uniform : autoUniforms)
+				program->addAutoUniform(uniform.first.c_str(), uniform.second);
+
+			for (auto& uniform : namedUniforms)
+				program->addNamedUniform(uniform.first.c_str(), VertexArray::FLOAT, uniform.second.size(), 
+					uniform.second.data());
+
+			program->startLink(this->programCache);
+		}
+
+		if (async && !program->isLinkComplete())
+			return false;
+
+		program->finishLink();
+		out = program;
+		return true;
+	};
 }
 
 
 template<>
-inline std::shared_ptr<Material> ResourceManager::_get<Material>(const std::string& fullPath)
+inline ResourceManager::Finalizer<Material>::Step ResourceManager::_decode<Material>(
+	const std::string& fullPath, bool async)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
-	// TODO: check doc load error and throw exception
+	doc.LoadFile(fullPath.c_str());
+	if (doc.Error())
+		throw_MagicException("Failed to parse resource file");
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* programNode = doc.FirstChildElement("Material");
 
 	auto gpuProgramRef = programNode->FirstChildElement("gpuProgram")->Attribute("ref");
-	auto gpuProgram = this->get<GpuProgram>(gpuProgramRef);
+	auto gpuProgram = this->request<GpuProgram>(gpuProgramRef, async);
 
 	auto textureRef = programNode->FirstChildElement("texture")->Attribute("ref");
-	auto texture = this->get<Texture>(textureRef);
+	auto texture = this->request<Texture>(textureRef, async);
 
     auto normalMapNode = programNode->FirstChildElement("normalMap");
-    std::shared_ptr<Texture> normalMap = nullptr;
+    std::shared_future<std::shared_ptr<Texture>> normalMap = makeReady<Texture>(nullptr);
     if (normalMapNode != nullptr)
     {
-        normalMap = this->get<Texture>(normalMapNode->Attribute("ref"));
+        normalMap = this->request<Texture>(normalMapNode->Attribute("ref"), async);
     }
 
-	auto material = std::make_shared<Material>();
-	MaterialBuilder builder;
-	builder.begin(material.get());
-	builder.setGpuProgram(gpuProgram);
-	builder.setTexture(texture);
-    builder.setNormalMap(normalMap);
-	builder.end();
-
-	return material;
+	return [gpuProgram, texture, normalMap](std::shared_ptr<Material>& material) -> bool
+	{
+		if (!isReady(gpuProgram) || !isReady(texture) || !isReady(normalMap))
+			return false;
+
+		material = std::make_shared<Material>();
+		MaterialBuilder builder;
+		builder.begin(material.get());
+		builder.setGpuProgram(gpuProgram.get());
+		builder.setTexture(texture.get());
+		builder.setNormalMap(normalMap.get());
+		builder.end();
+		return true;
+	};
 }
 
 
@@ -433,8 +1087,9 @@ template<>
 inline std::shared_ptr<CollisionShape> ResourceManager::_get<CollisionShape>(const std::string& fullPath)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
-	// TODO: check doc load error and throw exception
+	doc.LoadFile(fullPath.c_str());
+	if (doc.Error())
+		throw_MagicException("Failed to parse resource file");
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* shapeNode = doc.FirstChildElement("CollisionShape");
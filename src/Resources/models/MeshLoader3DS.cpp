@@ -62,7 +62,9 @@ std::shared_ptr<Meshes> MeshLoader3DS::getMeshes(const std::string& path) const
         bb.calculateNormals();
         bb.calculateTangents();
         
-        // end current mesh
+        // end current mesh, packed as loaded models make up most vertex memory,
+        // falling back to floats for whatever formats the driver can't read
+        bb.setPacking(Mesh::PACK_ALL & Mesh::getSupportedPacking());
 		meshes->push_back(bb.build());
 	}
 
@@ -0,0 +1,484 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for MeshLoaderBaked class
+ *
+ * @file MeshLoaderBaked.cpp
+ * @author Andrew Keating
+ */
+
+#include "MeshLoaderBaked.h"
+#include <CollisionShapes/TriangleMeshCollisionShape.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Magic3D
+{
+
+/// alignment (in bytes) of each block of data in a baked file, enough for the BVH
+#define BAKED_ALIGNMENT 16
+
+/// layout of an attribute as stored in a baked file
+struct BakedAttribute
+{
+	uint32_t type;
+	uint32_t dataType;
+	uint32_t components;
+	uint32_t offset;
+	uint32_t normalized;
+};
+
+/// description of a single mesh in a baked file
+struct BakedMesh
+{
+	uint32_t primitive;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	/// offset (in bytes) of the interleaved vertex data from the start of the file
+	uint32_t vertexOffset;
+	/// UNSIGNED_SHORT or UNSIGNED_INT, 0 if the mesh is not indexed
+	uint32_t indexType;
+	uint32_t indexCount;
+	/// offset (in bytes) of the index data from the start of the file
+	uint32_t indexOffset;
+	uint32_t attributeCount;
+	BakedAttribute attributes[MeshLoaderBaked::MAX_ATTRIBUTES];
+	float boundsMin[3];
+	float boundsMax[3];
+	float boundsCenter[3];
+	float boundsRadius;
+};
+
+/// start of a baked file, directly followed by a BakedMesh for each mesh
+struct BakedHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t meshCount;
+	/// number of triangles the collision BVH was built over
+	uint32_t triangleCount;
+	/// offset (in bytes) of the serialized BVH from the start of the file, 0 if there is none
+	uint32_t bvhOffset;
+	uint32_t bvhSize;
+	/// size (in bytes) of the whole file
+	uint32_t fileSize;
+	uint32_t reserved;
+};
+
+static const char BAKED_MAGIC[4] = { 'M', '3', 'D', 'B' };
+
+/** A file mapped into memory copy on write, so the parts that are changed
+ * in place, like the deserialized BVH, are copied while the rest stays
+ * shared with the file cache
+ */
+class MappedFile
+{
+	void* data;
+
+	size_t size;
+
+#ifdef _WIN32
+	HANDLE file;
+
+	HANDLE mapping;
+#endif
+
+public:
+	MappedFile(const std::string& path);
+
+	~MappedFile();
+
+	inline char* getData() const
+	{
+		return (char*)this->data;
+	}
+
+	inline size_t getSize() const
+	{
+		return this->size;
+	}
+};
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path): data(NULL), size(0), mapping(NULL)
+{
+	this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (this->file == INVALID_HANDLE_VALUE)
+		throw_MagicException("Could not open baked mesh file");
+
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(this->file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		this->size = (size_t)fileSize.QuadPart;
+		this->mapping = CreateFileMappingA(this->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (this->mapping != NULL)
+			this->data = MapViewOfFile(this->mapping, FILE_MAP_COPY, 0, 0, 0);
+	}
+
+	if (this->data == NULL)
+	{
+		if (this->mapping != NULL)
+			CloseHandle(this->mapping);
+		CloseHandle(this->file);
+		throw_MagicException("Could not map baked mesh file");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(this->data);
+	CloseHandle(this->mapping);
+	CloseHandle(this->file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path): data(NULL), size(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw_MagicException("Could not open baked mesh file");
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		this->size = (size_t)info.st_size;
+		this->data = mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (this->data == MAP_FAILED)
+			this->data = NULL;
+	}
+
+	// the mapping stays valid after the file is closed
+	close(fd);
+	if (this->data == NULL)
+		throw_MagicException("Could not map baked mesh file");
+
+	// everything is read once straight through on upload, so start reading ahead now
+	madvise(this->data, this->size, MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(this->data, this->size);
+}
+
+#endif
+
+/// throw if a baked file fails a check, these stay on even if magic throws are disabled
+static inline void checkBaked(bool ok, const char* msg)
+{
+	if (!ok)
+		throw_MagicException(msg);
+}
+
+/// check that a block of a baked file lies within it and is aligned
+static inline void checkBlock(uint64_t offset, uint64_t size, size_t fileSize)
+{
+	checkBaked(offset % BAKED_ALIGNMENT == 0, "Baked mesh file has a misaligned block");
+	checkBaked(offset + size <= fileSize, "Baked mesh file is truncated");
+}
+
+/// whether a stored primitive is one of VertexArray::Primitives
+static bool isBakedPrimitive(uint32_t primitive)
+{
+	switch (primitive)
+	{
+		case VertexArray::POINTS:
+		case VertexArray::LINE_STRIP:
+		case VertexArray::LINE_LOOP:
+		case VertexArray::LINES:
+		case VertexArray::LINE_STRIP_ADJACENCY:
+		case VertexArray::LINES_ADJACENCY:
+		case VertexArray::TRIANGLE_STRIP:
+		case VertexArray::TRIANGLE_FAN:
+		case VertexArray::TRIANGLES:
+		case VertexArray::TRIANGLE_STRIP_ADJACENCY:
+		case VertexArray::TRIANGLES_ADJACENCY:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/// whether a stored data type is one of VertexArray::DataTypes a mesh attribute can use
+static bool isBakedDataType(uint32_t dataType)
+{
+	switch (dataType)
+	{
+		case VertexArray::BYTE:
+		case VertexArray::UNSIGNED_BYTE:
+		case VertexArray::SHORT:
+		case VertexArray::UNSIGNED_SHORT:
+		case VertexArray::INT:
+		case VertexArray::UNSIGNED_INT:
+		case VertexArray::HALF_FLOAT:
+		case VertexArray::FLOAT:
+		case VertexArray::DOUBLE:
+		case VertexArray::INT_2_10_10_10_REV:
+			return true;
+		default:
+			return false;
+	}
+}
+
+std::shared_ptr<Meshes> MeshLoaderBaked::getMeshes(const std::string& path) const
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+	char* data = file->getData();
+
+	checkBaked(file->getSize() >= sizeof(BakedHeader), "Baked mesh file is truncated");
+	const BakedHeader* header = (const BakedHeader*)data;
+	checkBaked(memcmp(header->magic, BAKED_MAGIC, sizeof(BAKED_MAGIC)) == 0, "Not a baked mesh file");
+	checkBaked(header->version == VERSION, "Baked mesh file has an unsupported version or byte order");
+	checkBaked(header->fileSize == file->getSize(), "Baked mesh file is truncated");
+	checkBlock(sizeof(BakedHeader), (uint64_t)header->meshCount * sizeof(BakedMesh), file->getSize());
+
+	std::shared_ptr<Meshes> meshes = std::make_shared<Meshes>();
+	// triangles TriangleMeshCollisionShape adds for the meshes, one per three elements
+	uint64_t triangleCount = 0;
+	const BakedMesh* baked = (const BakedMesh*)(data + sizeof(BakedHeader));
+	for (unsigned int i = 0; i < header->meshCount; i++)
+	{
+		const BakedMesh& b = baked[i];
+		checkBaked(b.attributeCount > 0 && b.attributeCount <= MAX_ATTRIBUTES, 
+			"Baked mesh has an invalid attribute count");
+		checkBaked(isBakedPrimitive(b.primitive), "Baked mesh has an invalid primitive");
+		checkBaked(b.vertexCount <= 0x7FFFFFFF, "Baked mesh has an invalid vertex count");
+		checkBlock(b.vertexOffset, (uint64_t)b.vertexCount * b.vertexStride, file->getSize());
+
+		// the mesh points into the mapping, which it keeps alive
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+		mesh->externalData = file;
+		mesh->vertexData = data + b.vertexOffset;
+		mesh->vertexCount = b.vertexCount;
+		mesh->vertexStride = b.vertexStride;
+		mesh->primitive = (VertexArray::Primitives)b.primitive;
+
+		mesh->attributeCount = b.attributeCount;
+		mesh->attributeData = new Mesh::AttributeData[b.attributeCount];
+		for (unsigned int j = 0; j < b.attributeCount; j++)
+		{
+			checkBaked(b.attributes[j].type < GpuProgram::INSTANCE_MATRIX, 
+				"Baked mesh has an invalid attribute type");
+			checkBaked(isBakedDataType(b.attributes[j].dataType), 
+				"Baked mesh has an invalid attribute data type");
+			checkBaked(b.attributes[j].components >= 1 && b.attributes[j].components <= 4,
+				"Baked mesh has an invalid attribute component count");
+			checkBaked(b.attributes[j].offset < b.vertexStride, 
+				"Baked mesh has an attribute outside its vertices");
+
+			Mesh::AttributeData& attr = mesh->attributeData[j];
+			attr.type = (GpuProgram::AttributeType)b.attributes[j].type;
+			attr.dataType = (VertexArray::DataTypes)b.attributes[j].dataType;
+			attr.components = b.attributes[j].components;
+			attr.offset = b.attributes[j].offset;
+			attr.normalized = b.attributes[j].normalized != 0;
+			checkBaked((uint64_t)attr.offset + attr.getSize() <= b.vertexStride, 
+				"Baked mesh has an attribute outside its vertices");
+		}
+
+		if (b.indexType != 0)
+		{
+			checkBaked(b.indexType == VertexArray::UNSIGNED_SHORT || b.indexType == VertexArray::UNSIGNED_INT,
+				"Baked mesh has an invalid index type");
+			uint64_t dataLen = (uint64_t)b.indexCount * VertexArray::getDataTypeSize((VertexArray::DataTypes)b.indexType);
+			checkBlock(b.indexOffset, dataLen, file->getSize());
+
+			mesh->indexData = new Mesh::IndexData();
+			mesh->indexData->ownsData = false;
+			mesh->indexData->type = (VertexArray::DataTypes)b.indexType;
+			mesh->indexData->count = b.indexCount;
+			mesh->indexData->dataLen = (int)dataLen;
+			mesh->indexData->data = data + b.indexOffset;
+
+			// an index past the vertices would read outside them when drawn or added to the collision shape
+			for (unsigned int j = 0; j < b.indexCount; j++)
+				checkBaked(mesh->indexData->get(j) < b.vertexCount, "Baked mesh has an index outside its vertices");
+		}
+		triangleCount += (mesh->getElementCount() + 2) / 3;
+
+		// the bounds were computed when baking, so the vertices aren't touched until upload
+		Scalar min[3], max[3], center[3];
+		for (int j = 0; j < 3; j++)
+		{
+			min[j] = b.boundsMin[j];
+			max[j] = b.boundsMax[j];
+			center[j] = b.boundsCenter[j];
+		}
+		mesh->bounds = Bounds(min, max, center, b.boundsRadius);
+
+		meshes->push_back(mesh);
+	}
+
+	if (header->bvhOffset != 0)
+	{
+		checkBlock(header->bvhOffset, header->bvhSize, file->getSize());
+		btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(data + header->bvhOffset, 
+			header->bvhSize, false);
+		checkBaked(bvh != NULL, "Baked mesh file has an invalid collision BVH");
+		checkBaked(header->triangleCount == triangleCount, 
+			"Baked mesh file has a collision BVH built over different triangles");
+
+		// the leaves index into the triangles, all in the single part the shape adds
+		checkBaked(bvh->isQuantized(), "Baked mesh file has an invalid collision BVH");
+		const auto& nodes = bvh->getQuantizedNodeArray();
+		for (int i = 0; i < nodes.size(); i++)
+		{
+			if (nodes[i].isLeafNode())
+				checkBaked(nodes[i].getPartId() == 0 && (uint64_t)nodes[i].getTriangleIndex() < triangleCount,
+					"Baked mesh file has a collision BVH built over different triangles");
+		}
+		meshes->setCollisionBvh(bvh, file, header->triangleCount);
+	}
+
+	return meshes;
+}
+
+/// offset of the next aligned block after some data
+static inline uint32_t alignBlock(size_t offset)
+{
+	return (uint32_t)((offset + BAKED_ALIGNMENT - 1) & ~(size_t)(BAKED_ALIGNMENT - 1));
+}
+
+void MeshLoaderBaked::save(Meshes& meshes, const std::string& path, bool withBvh)
+{
+	BakedHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BAKED_MAGIC, sizeof(BAKED_MAGIC));
+	header.version = VERSION;
+	header.meshCount = (uint32_t)meshes.size();
+
+	// lay out the meshes, then the data blocks, each aligned
+	std::vector<BakedMesh> baked(meshes.size());
+	size_t offset = sizeof(BakedHeader) + sizeof(BakedMesh) * meshes.size();
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& mesh = *meshes[i];
+		BakedMesh& b = baked[i];
+		memset(&b, 0, sizeof(b));
+		if (mesh.getAttributeCount() > MAX_ATTRIBUTES)
+			throw_MagicException("Mesh has too many attributes to bake");
+
+		b.primitive = mesh.getPrimitive();
+		b.vertexCount = mesh.getVertexCount();
+		b.vertexStride = mesh.getVertexSize();
+		b.attributeCount = mesh.getAttributeCount();
+		for (int j = 0; j < mesh.getAttributeCount(); j++)
+		{
+			const Mesh::AttributeData& attr = mesh.getAttribute(j);
+			b.attributes[j].type = attr.type;
+			b.attributes[j].dataType = attr.dataType;
+			b.attributes[j].components = attr.components;
+			b.attributes[j].offset = attr.offset;
+			b.attributes[j].normalized = attr.normalized ? 1 : 0;
+		}
+
+		b.vertexOffset = alignBlock(offset);
+		offset = b.vertexOffset + (size_t)b.vertexCount * b.vertexStride;
+		if (mesh.isIndexed())
+		{
+			b.indexType = mesh.getIndexType();
+			b.indexCount = mesh.getElementCount();
+			b.indexOffset = alignBlock(offset);
+			offset = b.indexOffset + mesh.getIndexDataSize();
+		}
+
+		const Bounds& bounds = mesh.getBounds();
+		Point3 min = bounds.getMin(), max = bounds.getMax(), center = bounds.getCenter();
+		Scalar minData[] = { min.x(), min.y(), min.z() };
+		Scalar maxData[] = { max.x(), max.y(), max.z() };
+		Scalar centerData[] = { center.x(), center.y(), center.z() };
+		for (int j = 0; j < 3; j++)
+		{
+			b.boundsMin[j] = (float)minData[j];
+			b.boundsMax[j] = (float)maxData[j];
+			b.boundsCenter[j] = (float)centerData[j];
+		}
+		b.boundsRadius = (float)bounds.getRadius();
+	}
+
+	// build the BVH the same way TriangleMeshCollisionShape does, so it matches 
+	// the triangles the shape adds when the file is loaded
+	std::shared_ptr<void> bvhData;
+	if (withBvh)
+	{
+		TriangleMeshCollisionShape shape(meshes);
+		btOptimizedBvh* bvh = shape.getOptimizedBvh();
+		header.triangleCount = shape.getTriangleCount();
+		header.bvhSize = bvh->calculateSerializeBufferSize();
+		header.bvhOffset = alignBlock(offset);
+		offset = header.bvhOffset + header.bvhSize;
+
+		// serializing needs an aligned buffer too
+		bvhData = std::shared_ptr<void>(btAlignedAlloc(header.bvhSize, BAKED_ALIGNMENT), 
+			[](void* data) { btAlignedFree(data); });
+		if (!bvh->serializeInPlace(bvhData.get(), header.bvhSize, false))
+			throw_MagicException("Could not serialize collision BVH");
+	}
+	header.fileSize = (uint32_t)offset;
+	if (header.fileSize != offset)
+		throw_MagicException("Meshes are too large to bake");
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		throw_MagicException("Could not open baked mesh file for writing");
+
+	// write each block, padding up to its offset
+	size_t written = 0;
+	bool ok = true;
+	auto writeBlock = [&](size_t blockOffset, const void* block, size_t size)
+	{
+		static const char padding[BAKED_ALIGNMENT] = { 0 };
+		if (blockOffset > written)
+			ok = ok && fwrite(padding, 1, blockOffset - written, file) == blockOffset - written;
+		ok = ok && (size == 0 || fwrite(block, 1, size, file) == size);
+		written = blockOffset + size;
+	};
+	writeBlock(0, &header, sizeof(header));
+	writeBlock(written, baked.data(), sizeof(BakedMesh) * baked.size());
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& mesh = *meshes[i];
+		writeBlock(baked[i].vertexOffset, mesh.getVertexData(), (size_t)baked[i].vertexCount * baked[i].vertexStride);
+		if (mesh.isIndexed())
+			writeBlock(baked[i].indexOffset, mesh.getIndexData(), mesh.getIndexDataSize());
+	}
+	if (withBvh)
+		writeBlock(header.bvhOffset, bvhData.get(), header.bvhSize);
+
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		throw_MagicException("Could not write baked mesh file");
+}
+
+
+};
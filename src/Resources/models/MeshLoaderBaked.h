@@ -0,0 +1,67 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MeshLoaderBaked class
+ *
+ * @file MeshLoaderBaked.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MESH_LOADER_BAKED_H
+#define MAGIC3D_MESH_LOADER_BAKED_H
+
+#include "../MeshLoader.h"
+#include "../../Exceptions/MagicException.h"
+
+namespace Magic3D
+{
+
+/** Loads meshes baked ahead of time into a binary file that holds the
+ * interleaved vertex and index data exactly as it is uploaded, the bounds
+ * of each mesh and optionally the collision BVH of all of them. The file is
+ * mapped into memory and the meshes point straight into the mapping, so
+ * nothing is parsed or copied before the data goes to graphics memory.
+ *
+ * Files are written in the byte order of the machine baking them, and are
+ * rejected when loaded on a machine with a different one.
+ */
+class MeshLoaderBaked : public MeshLoader
+{
+public:
+	/// current version of the baked format
+	static const unsigned int VERSION = 1;
+
+	/// most attributes a baked mesh can have
+	static const int MAX_ATTRIBUTES = 16;
+
+	virtual std::shared_ptr<Meshes> getMeshes(const std::string& path) const;
+
+	/** bake meshes into a file
+	 * @param meshes the meshes to bake
+	 * @param path the path of the file to write
+	 * @param withBvh whether to build and store the collision BVH of the meshes
+	 */
+	static void save(Meshes& meshes, const std::string& path, bool withBvh = true);
+};
+
+};
+
+
+
+
+#endif
@@ -38,19 +38,27 @@ const int GpuProgram::attributeTypeCompCount[ MAX_ATTRIBUTE_TYPES ] =
     2, // texcoord5
     2, // texcoord6
     2, // texcoord7
-    3, // tangent
-    3  // binormal
+    4, // tangent
+    3, // binormal
+    16 // instance matrix
 };
 
 
-GpuProgram::GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader)
+GpuProgram::GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader):
+    vertexShader(vertexShader), fragmentShader(fragmentShader)
 {   
-    // create new program and attach compiled shaders
+    // create new program, the shaders are compiled and attached at link
+    // unless the program is loaded from a cache
 	programId = glCreateProgram();
-    glAttachShader(programId, vertexShader->id);
-    glAttachShader(programId, fragmentShader->id);
     
     nextIndex = 0;
+    linked = false;
+    instanced = false;
+    frameBlock = false;
+    drawBlock = false;
+    cacheKey = 0;
+    fromCache = false;
+    shadersAttached = false;
 }
 
 /// destructor
@@ -67,8 +75,120 @@ void GpuProgram::use()
 {
     // set opengl to use this shader
     glUseProgram(this->programId);
-    if (glGetError() != GL_NO_ERROR)
-        throw_MagicException("Could not use shader program");
+    MAGIC_GL_CHECK("Could not use shader program");
+}
+
+bool GpuProgram::hasParallelCompile()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        supported = GLEW_KHR_parallel_shader_compile ? 1 : 0;
+        if (supported)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    return supported != 0;
+}
+
+void GpuProgram::startLink(const std::shared_ptr<ProgramCache>& cache)
+{
+    this->linked = false;
+    this->fromCache = false;
+    this->cache = cache;
+
+    // attribute bindings are part of the binary, so they're part of the key
+    if (cache != nullptr)
+    {
+        this->cacheKey = cache->getKey(this->vertexShader->getSource(), this->fragmentShader->getSource(),
+            this->attributeBindings);
+        this->fromCache = cache->load(this->programId, this->cacheKey);
+        if (this->fromCache)
+        {
+            this->cache = nullptr;
+            return;
+        }
+    }
+
+    // enable parallel compiles before the first compile
+    GpuProgram::hasParallelCompile();
+    if (!this->shadersAttached)
+    {
+        this->vertexShader->compile();
+        this->fragmentShader->compile();
+        glAttachShader(this->programId, this->vertexShader->id);
+        glAttachShader(this->programId, this->fragmentShader->id);
+        this->shadersAttached = true;
+    }
+
+    // link the compiled shader program, keeping the binary around to save if there's a cache
+    if (cache != nullptr && cache->isSupported())
+        glProgramParameteri(this->programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(this->programId);
+}
+
+bool GpuProgram::isLinkComplete()
+{
+    if (this->fromCache || !GpuProgram::hasParallelCompile())
+        return true;
+
+    GLint complete = GL_TRUE;
+    glGetProgramiv(this->programId, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != GL_FALSE;
+}
+
+void GpuProgram::finishLink()
+{
+    if (!this->fromCache)
+    {
+        // check for link errors, reporting a shader's compile error if that's the cause
+        GLint ret;
+        glGetProgramiv(this->programId, GL_LINK_STATUS, &ret);
+        if (ret == GL_FALSE)
+        {
+            this->vertexShader->checkCompile();
+            this->fragmentShader->checkCompile();
+            throw_ShaderCompileException("Shader Program failed to link");
+        }
+
+        if (this->cache != nullptr)
+            this->cache->save(this->programId, this->cacheKey);
+        this->cache = nullptr;
+    }
+
+    // uniform locations only change at link, so look them all up once now
+    this->linked = true;
+    this->resolveUniforms();
+    this->bindUniformBlocks();
+}
+
+void GpuProgram::resolveUniforms()
+{
+    this->uniformHandles.clear();
+
+    for (auto u : this->autoUniforms)
+    {
+        u->handle = this->getUniformHandle(u->varName.c_str());
+        if (u->type == NORMAL_MAP)
+            u->auxHandle = this->getUniformHandle("normalMapping");
+    }
+
+    for (auto u : this->namedUniforms)
+        u->handle = this->getUniformHandle(u->varName.c_str());
+}
+
+void GpuProgram::bindUniformBlocks()
+{
+    GLuint index = glGetUniformBlockIndex(this->programId, "FrameData"); // openGL 3.1
+    this->frameBlock = index != GL_INVALID_INDEX;
+    if (this->frameBlock)
+        glUniformBlockBinding(this->programId, index, FRAME_BLOCK_BINDING);
+
+    index = glGetUniformBlockIndex(this->programId, "DrawData");
+    this->drawBlock = index != GL_INVALID_INDEX;
+    if (this->drawBlock)
+        glUniformBlockBinding(this->programId, index, DRAW_BLOCK_BINDING);
+
+    MAGIC_GL_CHECK("Failed to bind uniform blocks");
 }
 
 
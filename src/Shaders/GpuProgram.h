@@ -40,8 +40,10 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "../Graphics/Texture.h"
 #include "../Exceptions/ShaderCompileException.h"
 #include "../Util/magic_throw.h"
+#include "../Util/magic_gl_check.h"
 #include <Graphics\VertexArray.h>
 #include "Shader.h"
+#include "ProgramCache.h"
 
 
 namespace Magic3D
@@ -73,11 +75,18 @@ public:
         TEX_COORD_5,    // vec2 "texcoord5"
         TEX_COORD_6,    // vec2 "texcoord6"
         TEX_COORD_7,    // vec2 "texcoord7"
-        TANGENT,        // vec3 "tangent"
+        TANGENT,        // vec4 "tangent", w is the sign of the bitangent
         BINORMAL,       // vec3 "binormal"
+        INSTANCE_MATRIX,// mat4 "instanceMatrix", per instance rather than per vertex
         MAX_ATTRIBUTE_TYPES
     };
 
+    /** first attribute location of the instance matrix. The matrix takes four
+     * locations, one per column, so it shares the locations of TEX_COORD_4 to 
+     * TEX_COORD_7 to stay within the 16 attributes all hardware supports
+     */
+    static const int INSTANCE_MATRIX_LOCATION = TEX_COORD_4;
+
 	enum AutoUniformType
     {
         MODEL_MATRIX,                   // mat4
@@ -106,6 +115,21 @@ public:
 	/// number of components for shader variables for each of the auto-bound attribute types
     static const int attributeTypeCompCount[ MAX_ATTRIBUTE_TYPES ];
 
+    /// handle to a uniform of a linked program, -1 if the uniform isn't present
+    typedef GLint UniformHandle;
+
+    /// uniform block binding of the "FrameData" block, see FrameUniforms
+    static const int FRAME_BLOCK_BINDING = 0;
+
+    /// uniform block binding of the "DrawData" block, see DrawUniforms
+    static const int DRAW_BLOCK_BINDING = 1;
+
+    /// get the attribute location an attribute type is bound to
+    static inline int getAttributeLocation(AttributeType type)
+    {
+        return type == INSTANCE_MATRIX ? INSTANCE_MATRIX_LOCATION : (int)type;
+    }
+
 protected:
 	friend class World;
 
@@ -113,16 +137,22 @@ protected:
     {
 		std::string varName;
         AutoUniformType type;
+        /// handle of the uniform, resolved at link
+        UniformHandle handle;
+        /// handle of a second uniform some types also set, such as "normalMapping" for NORMAL_MAP
+        UniformHandle auxHandle;
         
-        inline AutoUniform() {}
+        inline AutoUniform(): handle(-1), auxHandle(-1) {}
 
         inline AutoUniform(const AutoUniform& u): varName(u.varName), 
-			type(u.type) {}
+			type(u.type), handle(u.handle), auxHandle(u.auxHandle) {}
 
         inline void set(const AutoUniform& u)
         {
             this->type = u.type;
 			this->varName = u.varName;
+			this->handle = u.handle;
+			this->auxHandle = u.auxHandle;
         }
     };
     
@@ -133,8 +163,10 @@ protected:
         VertexArray::DataTypes datatype;
         int comp_count;
         void* data;
+        /// handle of the uniform, resolved at link
+        UniformHandle handle;
         
-        inline NamedUniform(): comp_count(0), data(NULL) {}
+        inline NamedUniform(): comp_count(0), data(NULL), handle(-1) {}
 
         inline ~NamedUniform()
         {
@@ -148,6 +180,40 @@ protected:
     /// next index to use for arribute bind
     int nextIndex;
 
+    /// whether the program has been linked
+    bool linked;
+
+    /// whether the program reads a per instance model matrix
+    bool instanced;
+
+    /// whether the program declares the FrameData and DrawData uniform blocks
+    bool frameBlock;
+    bool drawBlock;
+
+    /// name and location of each bound attribute, part of the program's cache key
+    std::vector<std::pair<std::string, int>> attributeBindings;
+
+    /// cache the program is being linked with, null if none. Kept alive until the link finishes
+    std::shared_ptr<ProgramCache> cache;
+
+    /// key of the program in the cache
+    ProgramCache::Key cacheKey;
+
+    /// whether the program was loaded from a cached binary rather than linked from source
+    bool fromCache;
+
+    /// whether the shaders have been attached to the program
+    bool shadersAttached;
+
+    /// handles of uniforms looked up by name since the last link
+    std::unordered_map<std::string, UniformHandle> uniformHandles;
+
+    /// resolve the handles of all auto and named uniforms
+    void resolveUniforms();
+
+    /// point the program's shared uniform blocks at their bindings
+    void bindUniformBlocks();
+
 	std::vector<std::shared_ptr<AutoUniform>> autoUniforms;
 
 	std::vector<std::shared_ptr<NamedUniform>> namedUniforms;
@@ -156,7 +222,9 @@ protected:
 	std::shared_ptr<Shader> fragmentShader;
     
 	/// default constructor
-	inline GpuProgram() { /* intentionally left blank */ }
+	inline GpuProgram(): linked(false), instanced(false), frameBlock(false), drawBlock(false),
+		cacheKey(0), fromCache(false), shadersAttached(false)
+	{ /* intentionally left blank */ }
 
 public:
 	GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader);
@@ -171,11 +239,20 @@ public:
 	
 	inline void bindAttrib(const char* name, AttributeType type)
 	{
-	    glBindAttribLocation(programId, (int)type, name);
+	    glBindAttribLocation(programId, getAttributeLocation(type), name);
 	    
 	    MAGIC_THROW( glGetError() != GL_NO_ERROR, "Failed to bind attribute." );
 	    
+	    this->attributeBindings.push_back(std::make_pair(std::string(name), getAttributeLocation(type)));
 	    nextIndex++;
+	    if (type == INSTANCE_MATRIX)
+	        this->instanced = true;
+	}
+
+	/// check if the program reads a per instance model matrix, and so can draw instanced
+	inline bool isInstanced() const
+	{
+		return this->instanced;
 	}
 
 	void addAutoUniform(const char* varName, AutoUniformType type)
@@ -184,6 +261,8 @@ public:
 		u->varName = varName;
 		u->type = type;
 		this->autoUniforms.push_back(u);
+		if (this->linked)
+			this->resolveUniforms();
 	}
 
 	std::vector<std::shared_ptr<AutoUniform>> getAutoUniforms()
@@ -201,6 +280,8 @@ public:
 		u->data = new char[VertexArray::getDataTypeSize(datatype)*comp_count];
 		memcpy(u->data, data, VertexArray::getDataTypeSize(datatype)*comp_count);
 		this->namedUniforms.push_back(u);
+		if (this->linked)
+			this->resolveUniforms();
 	}
 
 	std::vector<std::shared_ptr<NamedUniform>> getNamedUniforms()
@@ -208,121 +289,195 @@ public:
 		return this->namedUniforms;
 	}
 	
-	inline void link()
+	/** link the program, waiting for it to finish
+	 * @param cache cache to load the program's binary from, or to save it
+	 * to when linked from source, null to always link from source
+	 */
+	inline void link(const std::shared_ptr<ProgramCache>& cache = nullptr)
 	{
-	    GLint ret;
-	    
-	    // link the compiled shader program
-        glLinkProgram(programId);
-        
-        // check for link errors
-        glGetProgramiv(programId, GL_LINK_STATUS, &ret);
-        if(ret == GL_FALSE)
-        {
-            glDeleteProgram(programId);
-            throw_ShaderCompileException("Shader Program failed to link");
-        }
+	    this->startLink(cache);
+	    this->finishLink();
+	}
+
+	/** start linking the program, loading it from the cache if it has the
+	 * program's binary or else compiling the shaders and linking from source.
+	 * With parallel shader compiles the driver does this in the background, 
+	 * so many programs can be started before finishing any of them
+	 * @param cache cache to load the program's binary from, or to save it
+	 * to when linked from source, null to always link from source
+	 */
+	void startLink(const std::shared_ptr<ProgramCache>& cache = nullptr);
+
+	/** check if the link started by startLink is done, so finishLink won't
+	 * wait. Always true without parallel shader compiles
+	 */
+	bool isLinkComplete();
+
+	/// finish the link started by startLink, waiting for it if needed
+	void finishLink();
+
+	/// check if the program was loaded from a cached binary rather than linked from source
+	inline bool isFromCache() const
+	{
+		return this->fromCache;
+	}
+
+	/** check if the driver compiles and links in the background, enabling it
+	 * with as many threads as the driver likes the first time
+	 */
+	static bool hasParallelCompile();
+
+	/// check if the program reads per frame data from the FrameData uniform block
+	inline bool usesFrameBlock() const
+	{
+		return this->frameBlock;
+	}
+
+	/// check if the program reads per object data from the DrawData uniform block
+	inline bool usesDrawBlock() const
+	{
+		return this->drawBlock;
+	}
+
+	/** get the handle of a uniform, for use with the handle based setters. 
+	 * Handles are cached, so only the first look up of a name queries gl
+	 * @param name the name of the uniform in the shader
+	 * @return handle to the uniform, -1 if not present in the program
+	 */
+	inline UniformHandle getUniformHandle(const char* name)
+	{
+		auto it = this->uniformHandles.find(name);
+		if (it != this->uniformHandles.end())
+			return it->second;
+
+		UniformHandle handle = glGetUniformLocation(this->programId, name);
+		this->uniformHandles.insert(std::make_pair(std::string(name), handle));
+		return handle;
 	}
 
     
-    inline void setUniformfv( const char* name, int components, const Scalar* values, int count = 1 )
+    inline void setUniformfv( UniformHandle handle, int components, const Scalar* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 1: glUniform1fv(id, count, values); break;
-            case 2: glUniform2fv(id, count, values); break;
-            case 3: glUniform3fv(id, count, values); break;
-            case 4: glUniform4fv(id, count, values); break;
+            case 1: glUniform1fv(handle, count, values); break;
+            case 2: glUniform2fv(handle, count, values); break;
+            case 3: glUniform3fv(handle, count, values); break;
+            case 4: glUniform4fv(handle, count, values); break;
             default:
                 throw_MagicException("Attempt to set uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1 )
+    inline void setUniformf( UniformHandle handle, const Scalar v1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform1f( id, v1);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform1f( handle, v1);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2 )
+    inline void setUniformf( UniformHandle handle, const Scalar v1, const Scalar v2 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform2f( id, v1, v2);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform2f( handle, v1, v2);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3 )
+    inline void setUniformf( UniformHandle handle, const Scalar v1, const Scalar v2, const Scalar v3 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform3f( id, v1, v2, v3);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform3f( handle, v1, v2, v3);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3, Scalar v4 )
+    inline void setUniformf( UniformHandle handle, const Scalar v1, const Scalar v2, const Scalar v3, Scalar v4 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform4f( id, v1, v2, v3, v4);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform4f( handle, v1, v2, v3, v4);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformiv( const char* name, int components, const int* values, int count = 1 )
+    inline void setUniformiv( UniformHandle handle, int components, const int* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 1: glUniform1iv(id, count, values); break;
-            case 2: glUniform2iv(id, count, values); break;
-            case 3: glUniform3iv(id, count, values); break;
-            case 4: glUniform4iv(id, count, values); break;
+            case 1: glUniform1iv(handle, count, values); break;
+            case 2: glUniform2iv(handle, count, values); break;
+            case 3: glUniform3iv(handle, count, values); break;
+            case 4: glUniform4iv(handle, count, values); break;
             default:
                 throw_MagicException("Attempt to set uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind integer uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind integer uniform for shader");
     }
     
-    inline void setUniformMatrix( const char* name, int components, const Scalar* values, int count = 1 )
+    inline void setUniformMatrix( UniformHandle handle, int components, const Scalar* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 2: glUniformMatrix2fv(id, count, GL_FALSE, values); break;
-            case 3: glUniformMatrix3fv(id, count, GL_FALSE, values); break;
-            case 4: glUniformMatrix4fv(id, count, GL_FALSE, values); break;
+            case 2: glUniformMatrix2fv(handle, count, GL_FALSE, values); break;
+            case 3: glUniformMatrix3fv(handle, count, GL_FALSE, values); break;
+            case 4: glUniformMatrix4fv(handle, count, GL_FALSE, values); break;
             default:
                 throw_MagicException("Attempt to set matrix uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind matrix uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind matrix uniform for shader");
     }
     
-    inline void setTexture( const char* name, Texture* tex, int index)
+    inline void setTexture( UniformHandle handle, Texture* tex, int index)
     {
         glActiveTexture(GL_TEXTURE0 + index);
         tex->bind();
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform1i( id, index );
+        MAGIC_THROW( handle < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform1i( handle, index );
+        MAGIC_GL_CHECK("Could not bind texture uniform for shader");
+    }
     
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind texture uniform for shader");
+    // name based setters, these look up the (cached) handle on every call
+
+    inline void setUniformfv( const char* name, int components, const Scalar* values, int count = 1 )
+    {
+        this->setUniformfv(this->getUniformHandle(name), components, values, count);
     }
     
+    inline void setUniformf( const char* name, const Scalar v1 )
+    {
+        this->setUniformf(this->getUniformHandle(name), v1);
+    }
+    
+    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2 )
+    {
+        this->setUniformf(this->getUniformHandle(name), v1, v2);
+    }
+    
+    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3 )
+    {
+        this->setUniformf(this->getUniformHandle(name), v1, v2, v3);
+    }
+    
+    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3, Scalar v4 )
+    {
+        this->setUniformf(this->getUniformHandle(name), v1, v2, v3, v4);
+    }
+    
+    inline void setUniformiv( const char* name, int components, const int* values, int count = 1 )
+    {
+        this->setUniformiv(this->getUniformHandle(name), components, values, count);
+    }
+    
+    inline void setUniformMatrix( const char* name, int components, const Scalar* values, int count = 1 )
+    {
+        this->setUniformMatrix(this->getUniformHandle(name), components, values, count);
+    }
+    
+    inline void setTexture( const char* name, Texture* tex, int index)
+    {
+        this->setTexture(this->getUniformHandle(name), tex, index);
+    }
 	
 
 };
@@ -0,0 +1,230 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ProgramCache class
+ *
+ * @file ProgramCache.cpp
+ * @author Andrew Keating
+ */
+
+#include "ProgramCache.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace Magic3D
+{
+
+/// version of the cache file layout, bumped to invalidate older caches
+#define PROGRAM_CACHE_VERSION 1
+
+/// start of a cached binary file, directly followed by the binary
+struct CachedProgramHeader
+{
+    char magic[4];
+    uint32_t version;
+    ProgramCache::Key key;
+    /// format of the binary, from glGetProgramBinary
+    uint32_t format;
+    /// length (in bytes) of the binary
+    uint32_t length;
+};
+
+static const char CACHED_PROGRAM_MAGIC[4] = { 'M', '3', 'D', 'P' };
+
+/// add bytes to a 64-bit FNV-1a hash
+static inline ProgramCache::Key hashBytes(ProgramCache::Key hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/// add a string and its length to a hash, so the strings hashed can't run into each other
+static inline ProgramCache::Key hashString(ProgramCache::Key hash, const char* text)
+{
+    uint32_t length = text != NULL ? (uint32_t)strlen(text) : 0;
+    hash = hashBytes(hash, &length, sizeof(length));
+    return hashBytes(hash, text, length);
+}
+
+ProgramCache::ProgramCache(const std::string& directory): directory(directory), checked(false), 
+    supported(false), driverHash(0)
+{
+    /* intentionally left blank */
+}
+
+void ProgramCache::checkSupport()
+{
+    this->checked = true;
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    this->supported = formats > 0;
+
+    // binaries only load on the driver that made them, so the driver is part of every key
+    this->driverHash = 14695981039346656037ull;
+    this->driverHash = hashString(this->driverHash, (const char*)glGetString(GL_VENDOR));
+    this->driverHash = hashString(this->driverHash, (const char*)glGetString(GL_RENDERER));
+    this->driverHash = hashString(this->driverHash, (const char*)glGetString(GL_VERSION));
+    this->driverHash = hashString(this->driverHash, (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
+}
+
+bool ProgramCache::isSupported()
+{
+    if (!this->checked)
+        this->checkSupport();
+    return this->supported;
+}
+
+std::string ProgramCache::getFilePath(Key key) const
+{
+    char name[32];
+    sprintf(name, "%016llx.bin", (unsigned long long)key);
+    return this->directory + "/" + name;
+}
+
+ProgramCache::Key ProgramCache::getKey(const std::string& vertexSource, const std::string& fragmentSource,
+    const std::vector<std::pair<std::string, int>>& attributes)
+{
+    if (!this->checked)
+        this->checkSupport();
+
+    Key key = this->driverHash;
+    key = hashString(key, vertexSource.c_str());
+    key = hashString(key, fragmentSource.c_str());
+    for (auto& attribute : attributes)
+    {
+        int32_t location = attribute.second;
+        key = hashString(key, attribute.first.c_str());
+        key = hashBytes(key, &location, sizeof(location));
+    }
+    return key;
+}
+
+bool ProgramCache::load(GLuint program, Key key)
+{
+    if (!this->isSupported())
+        return false;
+
+    std::string path = this->getFilePath(key);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        this->stats.misses++;
+        return false;
+    }
+
+    // a file that doesn't match, such as one cut short while being written, is a miss
+    CachedProgramHeader header;
+    std::vector<char> binary;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, CACHED_PROGRAM_MAGIC, sizeof(CACHED_PROGRAM_MAGIC)) == 0 &&
+        header.version == PROGRAM_CACHE_VERSION && header.key == key && header.length > 0;
+    if (valid)
+    {
+        binary.resize(header.length);
+        valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!valid)
+    {
+        this->stats.misses++;
+        return false;
+    }
+
+    // drivers may refuse binaries of older versions of themselves, leaving the program unlinked
+    glProgramBinary(program, header.format, binary.data(), header.length);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE)
+    {
+        while (glGetError() != GL_NO_ERROR) {}
+        remove(path.c_str());
+        this->stats.rejected++;
+        return false;
+    }
+
+    this->stats.hits++;
+    return true;
+}
+
+void ProgramCache::save(GLuint program, Key key)
+{
+    if (!this->isSupported())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    CachedProgramHeader header;
+    memcpy(header.magic, CACHED_PROGRAM_MAGIC, sizeof(CACHED_PROGRAM_MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+    header.format = format;
+    header.length = written;
+
+#ifdef _WIN32
+    CreateDirectoryA(this->directory.c_str(), NULL);
+#else
+    mkdir(this->directory.c_str(), 0755);
+#endif
+
+    // the cache is only an optimization, so failing to write is left for the next run to retry.
+    // Writing to a temporary file first keeps a cut short file from ever having the real name
+    std::string path = this->getFilePath(key);
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL)
+        return;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && 
+        fwrite(binary.data(), 1, written, file) == (size_t)written;
+    ok = fclose(file) == 0 && ok;
+
+    remove(path.c_str());
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return;
+    }
+    this->stats.saved++;
+}
+
+
+};
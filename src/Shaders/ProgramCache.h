@@ -0,0 +1,147 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ProgramCache class
+ *
+ * @file ProgramCache.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_PROGRAM_CACHE_H
+#define MAGIC3D_PROGRAM_CACHE_H
+
+// include opengl
+#ifdef _WIN32
+#include <gl/glew.h>
+#include <gl/gl.h>
+#else
+#include <glew.h>
+#include <gl.h>
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace Magic3D
+{
+
+/** Persistent cache of linked program binaries in a directory, so programs 
+ * linked on an earlier run are loaded with glProgramBinary instead of being 
+ * compiled and linked from source. Binaries are keyed by a hash of the shader 
+ * sources, the attribute bindings and the driver, and a binary the driver 
+ * rejects is left for the program to link from source and replace.
+ *
+ * Has to be used from the thread owning the GL context.
+ */
+class ProgramCache
+{
+public:
+    /// key of a program in the cache
+    typedef uint64_t Key;
+
+    /// counts of what happened to programs looked up in the cache
+    struct Stats
+    {
+        /// programs loaded from a cached binary
+        int hits;
+        /// programs with no cached binary
+        int misses;
+        /// cached binaries the driver refused, such as after a driver update
+        int rejected;
+        /// binaries written to the cache
+        int saved;
+
+        inline Stats(): hits(0), misses(0), rejected(0), saved(0) {}
+    };
+
+private:
+    /// directory the binaries are stored in
+    std::string directory;
+
+    /// whether support has been checked yet, which needs the GL context
+    bool checked;
+
+    /// whether the driver can save and load program binaries
+    bool supported;
+
+    /// hash of the vendor, renderer and version strings of the driver
+    Key driverHash;
+
+    Stats stats;
+
+    /// check if the driver supports program binaries, the first time it's needed
+    void checkSupport();
+
+    /// get the file a binary is stored in
+    std::string getFilePath(Key key) const;
+
+public:
+    /** Constructor
+     * @param directory the directory to store binaries in, created when the 
+     * first binary is saved
+     */
+    ProgramCache(const std::string& directory);
+
+    /// check if the driver can save and load program binaries
+    bool isSupported();
+
+    /** get the key of a program
+     * @param vertexSource the source of the vertex shader
+     * @param fragmentSource the source of the fragment shader
+     * @param attributes the name and location of each bound attribute, in the order bound
+     * @return the key, hashed with the driver so binaries of other drivers never match
+     */
+    Key getKey(const std::string& vertexSource, const std::string& fragmentSource,
+        const std::vector<std::pair<std::string, int>>& attributes);
+
+    /** load a program from its cached binary
+     * @param program the program to load into, with nothing linked yet
+     * @param key the key of the program
+     * @return true if the program was loaded and is linked, false if there
+     * was no usable binary and the program has to be linked from source
+     */
+    bool load(GLuint program, Key key);
+
+    /** save the binary of a program linked from source. The program should
+     * have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+     * @param program the linked program
+     * @param key the key of the program
+     */
+    void save(GLuint program, Key key);
+
+    /// get counts of what happened to programs looked up in the cache
+    inline const Stats& getStats() const
+    {
+        return this->stats;
+    }
+
+    /// get the directory binaries are stored in
+    inline const std::string& getDirectory() const
+    {
+        return this->directory;
+    }
+};
+
+};
+
+
+
+
+#endif
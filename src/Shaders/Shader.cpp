@@ -26,28 +26,49 @@ namespace Magic3D
 {
 
 
-Shader::Shader( const char* shaderText, Shader::Type type)
+Shader::Shader( const char* shaderText, Shader::Type type): id(0), source(shaderText), type(type)
 {
+    /* intentionally left blank */
+}
+
+Shader::~Shader()
+{
+    if (id != 0)
+        glDeleteShader(id);
+}
+
+void Shader::compile()
+{
+    if (id != 0)
+        return;
+
     id = glCreateShader((GLenum)type);
 	
     // Load shader text
-	GLchar* shaderListing[1];
-	shaderListing[0] = (GLchar*)shaderText;
-	glShaderSource(id, 1, (const GLchar**)shaderListing, nullptr);
+	const GLchar* shaderListing[1];
+	shaderListing[0] = (const GLchar*)source.c_str();
+	glShaderSource(id, 1, shaderListing, nullptr);
    
     // Compile shader
     glCompileShader(id);
-    
-    // Check for compile errors
-	GLint ret;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &ret);
-    if(ret == GL_FALSE)
-        throw_ShaderCompileException("Shader failed to compile");
 }
 
-Shader::~Shader()
+void Shader::checkCompile()
 {
-    glDeleteShader(id);
+    this->compile();
+
+    // Check for compile errors, waiting for the compile to finish
+	GLint ret;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &ret);
+    if(ret == GL_FALSE)
+    {
+        GLint length = 0;
+        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+        std::string log(length > 0 ? length : 1, '\0');
+        if (length > 0)
+            glGetShaderInfoLog(id, length, nullptr, &log[0]);
+        throw_ShaderCompileException(("Shader failed to compile: " + std::string(log.c_str())).c_str());
+    }
 }
 
 
@@ -29,6 +29,8 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <gl.h>
 #endif
 
+#include <string>
+
 
 namespace Magic3D
 {
@@ -51,17 +53,48 @@ public:
 protected:
 	friend class GpuProgram;
 
-    /// id of the shader
+    /// id of the shader, 0 until compiled
     GLuint id;
 
+	/// source text of the shader
+	std::string source;
+
+	Type type;
+
 	/// default constructor
-	inline Shader() { /* intentionally left blank */ }
+	inline Shader(): id(0) { /* intentionally left blank */ }
 
 public:
+	/** Constructor. Compiling is left until a program using the shader is
+	 * linked from source, so shaders of programs loaded from a ProgramCache
+	 * are never compiled
+	 * @param shaderText the source text of the shader
+	 * @param type the type of shader
+	 */
     Shader(const char* shaderText, Type type);
     
 	virtual ~Shader();
 
+	/** start compiling the shader, if not already started. With parallel
+	 * shader compiles the driver compiles in the background, so the result
+	 * is only checked by checkCompile()
+	 */
+	void compile();
+
+	/// compile the shader if needed and throw a ShaderCompileException if it failed
+	void checkCompile();
+
+	/// get the source text of the shader
+	inline const std::string& getSource() const
+	{
+		return this->source;
+	}
+
+	inline Type getType() const
+	{
+		return this->type;
+	}
+
 };
 
 	
@@ -0,0 +1,81 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for uniform block layouts
+ *
+ * @file UniformBlocks.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_UNIFORM_BLOCKS_H
+#define MAGIC3D_UNIFORM_BLOCKS_H
+
+#ifdef _WIN32
+#include <gl/glew.h>
+#include <gl/gl.h>
+#else
+#include <glew.h>
+#include <gl.h>
+#endif
+
+namespace Magic3D
+{
+
+/** std140 layout of the "FrameData" uniform block, set once per frame and
+ * shared by all programs declaring the block:
+ *
+ *   layout(std140) uniform FrameData
+ *   {
+ *       mat4 viewMatrix;
+ *       mat4 projectionMatrix;
+ *       mat4 viewProjectionMatrix;
+ *       mat4 flatProjectionMatrix;
+ *       vec4 lightPosition;
+ *   };
+ */
+struct FrameUniforms
+{
+    GLfloat view[16];
+    GLfloat projection[16];
+    GLfloat viewProjection[16];
+    GLfloat flatProjection[16];
+    GLfloat lightPosition[4];
+};
+
+/** std140 layout of the "DrawData" uniform block, holding the matrices of
+ * a single object. A mat3 is laid out as three vec4 columns:
+ *
+ *   layout(std140) uniform DrawData
+ *   {
+ *       mat4 modelMatrix;
+ *       mat4 modelViewMatrix;
+ *       mat4 modelViewProjectionMatrix;
+ *       mat3 normalMatrix;
+ *   };
+ */
+struct DrawUniforms
+{
+    GLfloat model[16];
+    GLfloat modelView[16];
+    GLfloat modelViewProjection[16];
+    GLfloat normal[12];
+};
+
+};
+
+#endif
@@ -149,35 +149,45 @@ public:
 
 class TangentAttr
 {
-    Vector3 data;
+    /// the tangent, with the sign of the bitangent in w
+    Vector4 data;
 public:
 
     static const GpuProgram::AttributeType type = GpuProgram::AttributeType::TANGENT;
 
-    inline TangentAttr() {}
+    inline TangentAttr() : data(0.0f, 0.0f, 0.0f, 1.0f) {}
 
     inline TangentAttr(const Vector3& vec) : data(vec) {}
 
-    inline TangentAttr(Scalar x, Scalar y, Scalar z) : data(x, y, z) {}
+    inline TangentAttr(const Vector4& vec) : data(vec) {}
+
+    inline TangentAttr(Scalar x, Scalar y, Scalar z) : data(x, y, z, 1.0f) {}
+
+    inline TangentAttr(Scalar x, Scalar y, Scalar z, Scalar sign) : data(x, y, z, sign) {}
 
-    inline void tangent(Scalar x, Scalar y, Scalar z)
+    /** set the tangent
+     * @param sign the sign of the bitangent, which is cross(normal, tangent) * sign.
+     *      -1 where the texture is mirrored
+     */
+    inline void tangent(Scalar x, Scalar y, Scalar z, Scalar sign = 1.0f)
     {
-        data = Vector3(x, y, z);
+        data = Vector4(x, y, z, sign);
     }
 
-    inline void tangent(const Vector3& vec)
+    inline void tangent(const Vector3& vec, Scalar sign = 1.0f)
     {
-        data = vec;
+        this->tangent(vec.x(), vec.y(), vec.z(), sign);
     }
 
-    inline Vector3& tangent()
+    inline Vector3 tangent() const
     {
-        return data;
+        return Vector3(data.x(), data.y(), data.z());
     }
 
-    inline const Vector3& tangent() const
+    /// get the sign of the bitangent, which is cross(normal, tangent) * sign
+    inline Scalar bitangentSign() const
     {
-        return data;
+        return data.w();
     }
 
     inline const Scalar* getData() const
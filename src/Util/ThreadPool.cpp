@@ -0,0 +1,91 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ThreadPool class
+ *
+ * @file ThreadPool.cpp
+ * @author Andrew Keating
+ */
+
+#include "ThreadPool.h"
+
+namespace Magic3D
+{
+
+ThreadPool::ThreadPool(int threadCount) : exiting(false)
+{
+	// leave a hardware thread for the thread submitting the work
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+	if (threadCount < 1)
+		threadCount = 1;
+
+	for (int i = 0; i < threadCount; i++)
+		this->threads.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->exiting = true;
+		this->tasks.clear();
+	}
+	this->wake.notify_all();
+
+	for (auto& thread : this->threads)
+		thread.join();
+}
+
+void ThreadPool::submit(const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->tasks.push_back(task);
+	}
+	this->wake.notify_one();
+}
+
+int ThreadPool::getQueuedCount()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return (int)this->tasks.size();
+}
+
+void ThreadPool::run()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			while (!this->exiting && this->tasks.empty())
+				this->wake.wait(lock);
+			if (this->exiting)
+				return;
+
+			task = this->tasks.front();
+			this->tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+};
@@ -0,0 +1,86 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ThreadPool class
+ *
+ * @file ThreadPool.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_THREAD_POOL_H
+#define MAGIC3D_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Magic3D
+{
+
+/** A fixed set of worker threads running submitted tasks in the order
+ * they were submitted. Tasks must handle their own exceptions, one 
+ * escaping a task ends the program like on any other thread.
+ */
+class ThreadPool
+{
+private:
+	/// the worker threads
+	std::vector<std::thread> threads;
+
+	/// tasks waiting for a free worker
+	std::deque<std::function<void()>> tasks;
+
+	/// guards the task queue and exit flag
+	std::mutex mutex;
+
+	/// signals workers that a task was queued or that they should exit
+	std::condition_variable wake;
+
+	/// set when the pool is destroyed
+	bool exiting;
+
+	/// loop run by each worker thread
+	void run();
+
+public:
+	/** Standard Constructor
+	 * @param threadCount number of worker threads, 0 for one less than the number of hardware threads
+	 */
+	ThreadPool(int threadCount = 0);
+
+	/// destructor, drops tasks not yet started and waits for running ones to finish
+	~ThreadPool();
+
+	/// queue a task to be run on one of the workers
+	void submit(const std::function<void()>& task);
+
+	/// get the number of tasks waiting for a free worker
+	int getQueuedCount();
+
+	inline int getThreadCount() const
+	{
+		return (int)this->threads.size();
+	}
+};
+
+};
+
+#endif
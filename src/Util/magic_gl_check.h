@@ -0,0 +1,47 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for the magic gl error checks, glGetError checks
+ * made after gl calls in the render loop. As glGetError can stall
+ * the driver, the checks are only done in debug builds or when
+ * MAGIC3D_DEBUG_GL_ERRORS is defined, and do nothing otherwise.
+ *
+ * @file magic_gl_check.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MAGIC_GL_CHECK_H
+#define MAGIC3D_MAGIC_GL_CHECK_H
+
+
+// If gl error checks are enabled, throw if gl has an error recorded
+#if defined( MAGIC3D_DEBUG_GL_ERRORS ) || defined( _DEBUG )
+#include "../Exceptions/MagicException.h"
+
+#define MAGIC_GL_CHECK(msg) \
+    { if (glGetError() != GL_NO_ERROR) { throw_MagicException(msg); } }
+
+
+// Otherwise, they do nothing at all
+#else
+#define MAGIC_GL_CHECK(msg) {}
+
+#endif
+
+
+#endif
@@ -0,0 +1,253 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ObjectBVH class
+ *
+ * @file ObjectBVH.cpp
+ * @author Andrew Keating
+ */
+
+#include <World/ObjectBVH.h>
+#include <algorithm>
+#include <float.h>
+
+namespace Magic3D
+{
+
+void ObjectBVH::add(Object* object, Material* material, const Point3& center, Scalar radius)
+{
+    Item item;
+    item.object = object;
+    item.material = material;
+    item.center[0] = center.x();
+    item.center[1] = center.y();
+    item.center[2] = center.z();
+    item.radius = radius;
+    this->items.push_back(item);
+    this->dirty = true;
+}
+
+bool ObjectBVH::remove(Object* object)
+{
+    for (unsigned int i = 0; i < this->items.size(); i++)
+    {
+        if (this->items[i].object == object)
+        {
+            this->items[i] = this->items.back();
+            this->items.pop_back();
+            this->dirty = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ObjectBVH::updateBounds(Object* object, const Point3& center, Scalar radius)
+{
+    if (this->dirty)
+        this->rebuild();
+
+    auto it = this->itemIndices.find(object);
+    MAGIC_THROW(it == this->itemIndices.end(), "Tried to update the bounds of an object not in the BVH.");
+
+    Item& item = this->items[it->second];
+    item.center[0] = center.x();
+    item.center[1] = center.y();
+    item.center[2] = center.z();
+    item.radius = radius;
+    this->spheres.set(it->second, item.center[0], item.center[1], item.center[2], radius);
+    this->needsRefit = true;
+}
+
+void ObjectBVH::clear()
+{
+    this->items.clear();
+    this->nodes.clear();
+    this->itemIndices.clear();
+    this->spheres.clear();
+    this->dirty = false;
+    this->needsRefit = false;
+}
+
+void ObjectBVH::rebuild()
+{
+    this->nodes.clear();
+    this->nodes.reserve(this->items.size() / MAX_LEAF_ITEMS * 2 + 1);
+    if (!this->items.empty())
+        this->build(0, this->items.size());
+
+    // building reorders items
+    this->itemIndices.clear();
+    this->spheres.clear();
+    this->spheres.reserve(this->items.size());
+    for (unsigned int i = 0; i < this->items.size(); i++)
+    {
+        const Item& item = this->items[i];
+        this->itemIndices[item.object] = i;
+        this->spheres.add(item.center[0], item.center[1], item.center[2], item.radius);
+    }
+
+    this->dirty = false;
+    this->needsRefit = false;
+}
+
+int ObjectBVH::build(int start, int end)
+{
+    int index = this->nodes.size();
+    this->nodes.push_back(Node());
+    Node node;
+    node.start = start;
+    node.count = end - start;
+    node.right = -1;
+    node.lastPlane = 0;
+
+    // bounds of the items, and of their centers to pick the split axis
+    Scalar centerMin[3], centerMax[3];
+    for (int a = 0; a < 3; a++)
+    {
+        node.min[a] = centerMin[a] = FLT_MAX;
+        node.max[a] = centerMax[a] = -FLT_MAX;
+    }
+    for (int i = start; i < end; i++)
+    {
+        const Item& item = this->items[i];
+        for (int a = 0; a < 3; a++)
+        {
+            node.min[a] = std::min(node.min[a], item.center[a] - item.radius);
+            node.max[a] = std::max(node.max[a], item.center[a] + item.radius);
+            centerMin[a] = std::min(centerMin[a], item.center[a]);
+            centerMax[a] = std::max(centerMax[a], item.center[a]);
+        }
+    }
+
+    if (node.count > MAX_LEAF_ITEMS)
+    {
+        // split at the median along the axis the centers spread the most over
+        int axis = 0;
+        for (int a = 1; a < 3; a++)
+        {
+            if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+                axis = a;
+        }
+
+        int mid = start + node.count / 2;
+        std::nth_element(this->items.begin() + start, this->items.begin() + mid,
+            this->items.begin() + end, [axis](const Item& a, const Item& b) -> bool {
+                return a.center[axis] < b.center[axis];
+            });
+
+        this->build(start, mid);
+        node.right = this->build(mid, end);
+    }
+
+    this->nodes[index] = node;
+    return index;
+}
+
+void ObjectBVH::refit()
+{
+    if (this->dirty)
+        this->rebuild();
+    else if (!this->nodes.empty())
+        this->refitNode(0);
+    this->needsRefit = false;
+}
+
+void ObjectBVH::refitNode(int index)
+{
+    Node& node = this->nodes[index];
+    if (node.right < 0)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            node.min[a] = FLT_MAX;
+            node.max[a] = -FLT_MAX;
+        }
+        for (int i = node.start; i < node.start + node.count; i++)
+        {
+            const Item& item = this->items[i];
+            for (int a = 0; a < 3; a++)
+            {
+                node.min[a] = std::min(node.min[a], item.center[a] - item.radius);
+                node.max[a] = std::max(node.max[a], item.center[a] + item.radius);
+            }
+        }
+        return;
+    }
+
+    this->refitNode(index + 1);
+    this->refitNode(node.right);
+    const Node& left = this->nodes[index + 1];
+    const Node& right = this->nodes[node.right];
+    for (int a = 0; a < 3; a++)
+    {
+        node.min[a] = std::min(left.min[a], right.min[a]);
+        node.max[a] = std::max(left.max[a], right.max[a]);
+    }
+}
+
+void ObjectBVH::cull(const ViewFrustum& frustum, std::vector<const Item*>& visible)
+{
+    if (this->dirty)
+        this->rebuild();
+    else if (this->needsRefit)
+        this->refit();
+
+    this->nodesTested = 0;
+    if (!this->nodes.empty())
+        this->cullNode(0, frustum, ViewFrustum::ALL_PLANES, visible);
+}
+
+void ObjectBVH::cullNode(int index, const ViewFrustum& frustum, unsigned int planeMask,
+    std::vector<const Item*>& visible)
+{
+    Node& node = this->nodes[index];
+    this->nodesTested++;
+
+    // children only test the planes their parent straddles
+    ViewFrustum::Result result = frustum.boxTest(node.min, node.max, planeMask, node.lastPlane);
+    if (result == ViewFrustum::OUTSIDE)
+        return;
+
+    // everything under a node fully inside is visible
+    if (result == ViewFrustum::INSIDE)
+    {
+        for (int i = node.start; i < node.start + node.count; i++)
+            visible.push_back(&this->items[i]);
+        return;
+    }
+
+    if (node.right < 0)
+    {
+        uint32_t mask;
+        frustum.spheresInFrustum(this->spheres, node.start, node.count, &mask);
+        for (int i = 0; i < node.count; i++)
+        {
+            if (mask & (1u << i))
+                visible.push_back(&this->items[node.start + i]);
+        }
+        return;
+    }
+
+    this->cullNode(index + 1, frustum, planeMask, visible);
+    this->cullNode(node.right, frustum, planeMask, visible);
+}
+
+
+};
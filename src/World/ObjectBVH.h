@@ -0,0 +1,172 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ObjectBVH class
+ *
+ * @file ObjectBVH.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_OBJECT_BVH_H
+#define MAGIC3D_OBJECT_BVH_H
+
+#include "../Math/MathTypes.h"
+#include "../Cameras/ViewFrustum.h"
+#include "../Util/magic_throw.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+class Object;
+class Material;
+
+/** Bounding volume hierarchy over the bounding spheres of objects, used 
+ * to frustum cull static scenery without testing every object. The tree
+ * is rebuilt lazily the next time it is culled after objects are added or
+ * removed, and refit when only the bounds of objects change.
+ */
+class ObjectBVH
+{
+public:
+    /// an object in the hierarchy
+    struct Item
+    {
+        Object* object;
+        Material* material;
+        Scalar center[3];
+        Scalar radius;
+    };
+
+    /// maximum number of items in a leaf node, leaves are culled in one batch
+    static const int MAX_LEAF_ITEMS = 8;
+
+private:
+    /// a node of the tree, the left child of an inner node directly follows it
+    struct Node
+    {
+        Scalar min[3];
+        Scalar max[3];
+        /// first item in the subtree
+        int start;
+        /// number of items in the subtree
+        int count;
+        /// index of the right child, -1 for leaves
+        int right;
+        /// plane that last rejected the node, tested first next time
+        int lastPlane;
+    };
+
+    std::vector<Item> items;
+
+    std::vector<Node> nodes;
+
+    /// bounds of the items, in the same order, for batch culling leaves
+    SphereArray spheres;
+
+    /// index of each object's item, valid while the tree is built
+    std::unordered_map<Object*, int> itemIndices;
+
+    /// whether items were added or removed since the last build
+    bool dirty;
+
+    /// whether item bounds changed since the last build or refit
+    bool needsRefit;
+
+    /// number of nodes tested by the last cull
+    int nodesTested;
+
+    /** build the subtree over a range of items
+     * @param start the first item
+     * @param end one past the last item
+     * @return the index of the root of the subtree
+     */
+    int build(int start, int end);
+
+    /// recompute the bounds of a subtree from its items
+    void refitNode(int node);
+
+    void cullNode(int node, const ViewFrustum& frustum, unsigned int planeMask, 
+        std::vector<const Item*>& visible);
+
+public:
+    /// standard constructor
+    inline ObjectBVH(): dirty(false), needsRefit(false), nodesTested(0) {}
+
+    /** add an object to the hierarchy
+     * @param object the object
+     * @param material the material the object is drawn with
+     * @param center the center of the object's bounding sphere
+     * @param radius the radius of the object's bounding sphere
+     */
+    void add(Object* object, Material* material, const Point3& center, Scalar radius);
+
+    /** remove an object from the hierarchy
+     * @param object the object to remove
+     * @return true if the object was found and removed
+     */
+    bool remove(Object* object);
+
+    /** change the bounds of an object already in the hierarchy
+     * @param object the object
+     * @param center the new center of the object's bounding sphere
+     * @param radius the new radius of the object's bounding sphere
+     */
+    void updateBounds(Object* object, const Point3& center, Scalar radius);
+
+    /// remove all objects
+    void clear();
+
+    /// rebuild the tree from scratch
+    void rebuild();
+
+    /// recompute node bounds in place, for when objects have moved but not by much
+    void refit();
+
+    /** get the items whose bounding spheres intersect the view frustum
+     * @param frustum the view frustum
+     * @param visible vector the visible items are appended to
+     */
+    void cull(const ViewFrustum& frustum, std::vector<const Item*>& visible);
+
+    /// get the number of objects in the hierarchy
+    inline unsigned int size() const
+    {
+        return this->items.size();
+    }
+
+    /// get the number of nodes in the tree
+    inline unsigned int getNodeCount() const
+    {
+        return this->nodes.size();
+    }
+
+    /// get the number of nodes tested by the last cull
+    inline int getNodesTested() const
+    {
+        return this->nodesTested;
+    }
+};
+
+
+};
+
+
+#endif
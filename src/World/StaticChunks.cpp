@@ -0,0 +1,168 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for StaticChunks class
+ *
+ * @file StaticChunks.cpp
+ * @author Andrew Keating
+ */
+
+#include <World/StaticChunks.h>
+#include <algorithm>
+#include <math.h>
+
+namespace Magic3D
+{
+
+StaticChunks::~StaticChunks()
+{
+    for (auto& it : this->chunks)
+        delete it.second;
+}
+
+StaticChunks::Chunk* StaticChunks::getChunk(Object* object, Material* material)
+{
+    Key key;
+    key.material = material;
+    Point3 center = object->getWorldBounds().getCenter();
+    key.cell[0] = (int)floor(center.x() / this->cellSize);
+    key.cell[1] = (int)floor(center.y() / this->cellSize);
+    key.cell[2] = (int)floor(center.z() / this->cellSize);
+
+    auto it = this->chunks.find(key);
+    if (it != this->chunks.end())
+        return it->second;
+
+    Chunk* chunk = new Chunk();
+    chunk->material = material;
+    for (int i = 0; i < 3; i++)
+        chunk->cell[i] = key.cell[i];
+    chunk->dirty = false;
+    this->chunks.insert(std::make_pair(key, chunk));
+    return chunk;
+}
+
+void StaticChunks::markDirty(Chunk* chunk)
+{
+    if (chunk->dirty)
+        return;
+    chunk->dirty = true;
+    this->dirtyChunks.push_back(chunk);
+}
+
+void StaticChunks::add(Object* object, Material* material)
+{
+    MAGIC_THROW(this->contains(object), "Tried to add an object to the static chunks twice.");
+
+    Chunk* chunk = this->getChunk(object, material);
+    chunk->objects.push_back(object);
+    this->objectChunks.insert(std::make_pair(object, chunk));
+    this->markDirty(chunk);
+}
+
+void StaticChunks::remove(Object* object)
+{
+    auto it = this->objectChunks.find(object);
+    if (it == this->objectChunks.end())
+        return;
+
+    Chunk* chunk = it->second;
+    chunk->objects.erase(std::find(chunk->objects.begin(), chunk->objects.end(), object));
+    this->objectChunks.erase(it);
+    this->markDirty(chunk);
+}
+
+void StaticChunks::update(Object* object)
+{
+    auto it = this->objectChunks.find(object);
+    if (it == this->objectChunks.end())
+        return;
+
+    Material* material = it->second->material;
+    this->remove(object);
+    this->add(object, material);
+}
+
+void StaticChunks::bake(Chunk& chunk)
+{
+    chunk.baked = nullptr;
+    chunk.dirty = false;
+    if (chunk.objects.empty())
+        return;
+
+    // static meshes are drawn as they are, so their vertices are joined without transforming them
+    std::vector<std::shared_ptr<Mesh>> meshes;
+    for (Object* object : chunk.objects)
+    {
+        for (auto& mesh : *object->getModel()->getMeshes())
+            meshes.push_back(mesh);
+    }
+
+    auto baked = std::make_shared<Meshes>();
+    std::vector<bool> used(meshes.size(), false);
+    std::vector<const Mesh*> group;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (used[i])
+            continue;
+
+        // strips and fans can't be joined, draw them as they are
+        if (!Mesh::isListPrimitive(meshes[i]->getPrimitive()))
+        {
+            used[i] = true;
+            baked->push_back(meshes[i]);
+            continue;
+        }
+
+        // gather the following meshes with the same layout, up to the vertex limit
+        group.clear();
+        int vertexCount = 0;
+        for (unsigned int j = i; j < meshes.size(); j++)
+        {
+            if (used[j] || !meshes[i]->hasSameLayout(*meshes[j]))
+                continue;
+            if (!group.empty() && vertexCount + meshes[j]->getVertexCount() > MAX_CHUNK_VERTICES)
+                continue;
+            used[j] = true;
+            group.push_back(meshes[j].get());
+            vertexCount += meshes[j]->getVertexCount();
+        }
+        baked->push_back(Mesh::merge(group));
+    }
+
+    auto model = std::make_shared<Model>(baked, chunk.objects[0]->getModel()->getMaterial());
+    chunk.baked = std::make_shared<Object>(model);
+}
+
+void StaticChunks::finishBaking()
+{
+    for (auto it = this->chunks.begin(); it != this->chunks.end();)
+    {
+        if (it->second->objects.empty() && !it->second->dirty)
+        {
+            delete it->second;
+            it = this->chunks.erase(it);
+        }
+        else
+            ++it;
+    }
+    this->dirtyChunks.clear();
+}
+
+};
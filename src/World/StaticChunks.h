@@ -0,0 +1,156 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for StaticChunks class
+ *
+ * @file StaticChunks.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_STATIC_CHUNKS_H
+#define MAGIC3D_STATIC_CHUNKS_H
+
+#include "../Math/MathTypes.h"
+#include "../Objects/Object.h"
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+class Material;
+
+/** Bakes static scenery into a few large meshes. Static objects are
+ * grouped into chunks by material and by the cell of a uniform grid their
+ * bounds are centered in, and the meshes of each chunk are joined into 
+ * combined meshes held by a single baked object. The baked object is 
+ * culled and drawn in place of the objects of the chunk, so each chunk
+ * costs one draw per vertex layout rather than one per object. Chunks are 
+ * rebaked lazily, only when objects in them are added, removed or updated.
+ */
+class StaticChunks
+{
+public:
+    /// static objects sharing a material and a cell
+    struct Chunk
+    {
+        Material* material;
+        int cell[3];
+        std::vector<Object*> objects;
+        /// object drawing the joined meshes of the chunk, null until baked or when empty
+        std::shared_ptr<Object> baked;
+        /// whether objects changed since the chunk was last baked
+        bool dirty;
+    };
+
+    /// most vertices in a joined mesh, so it can use 16 bit indices
+    static const int MAX_CHUNK_VERTICES = 0xFFFF;
+
+private:
+    struct Key
+    {
+        Material* material;
+        int cell[3];
+
+        inline bool operator==(const Key& key) const
+        {
+            return this->material == key.material && this->cell[0] == key.cell[0] &&
+                this->cell[1] == key.cell[1] && this->cell[2] == key.cell[2];
+        }
+    };
+
+    struct KeyHash
+    {
+        inline size_t operator()(const Key& key) const
+        {
+            size_t hash = std::hash<Material*>()(key.material);
+            for (int i = 0; i < 3; i++)
+                hash = hash * 31 + (size_t)key.cell[i];
+            return hash;
+        }
+    };
+
+    std::unordered_map<Key, Chunk*, KeyHash> chunks;
+
+    /// the chunk each object is in
+    std::unordered_map<Object*, Chunk*> objectChunks;
+
+    /// chunks to rebake
+    std::vector<Chunk*> dirtyChunks;
+
+    /// size of a cell of the grid
+    Scalar cellSize;
+
+    /// get the chunk an object belongs in, creating it if needed
+    Chunk* getChunk(Object* object, Material* material);
+
+    /// mark a chunk to be rebaked
+    void markDirty(Chunk* chunk);
+
+public:
+    /** Standard Constructor
+     * @param cellSize size of a cell of the grid objects are grouped by
+     */
+    inline StaticChunks(Scalar cellSize = 50.0f): cellSize(cellSize) {}
+
+    /// destructor
+    ~StaticChunks();
+
+    /// add a static object to the chunk of its material and cell
+    void add(Object* object, Material* material);
+
+    /// remove a static object from its chunk
+    void remove(Object* object);
+
+    /// move an object to another chunk if its bounds moved cells, and rebake its chunk
+    void update(Object* object);
+
+    inline bool contains(Object* object) const
+    {
+        return this->objectChunks.find(object) != this->objectChunks.end();
+    }
+
+    /// get the chunks changed since they were last baked
+    inline const std::vector<Chunk*>& getDirtyChunks() const
+    {
+        return this->dirtyChunks;
+    }
+
+    /// join the meshes of the objects in a chunk into a new baked object
+    void bake(Chunk& chunk);
+
+    /// delete chunks left empty and clear the list of dirty chunks, call after baking them
+    void finishBaking();
+
+    /// get the number of chunks
+    inline int getChunkCount() const
+    {
+        return this->chunks.size();
+    }
+
+    inline Scalar getCellSize() const
+    {
+        return this->cellSize;
+    }
+};
+
+};
+
+#endif
@@ -19,6 +19,9 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
 #include <World/World.h>
 #include <Cameras/FPCamera.h>
@@ -30,28 +33,241 @@ namespace Magic3D
 
 void World::stepPhysics()
 {
-    // step physics
-    if ( physicsStepTime > 0.0f )
+    StopWatch timer;
+
+    // gather the real time since physics last ran
+    float elapsed = this->physicsTimer.getElapsedTime();
+    this->physicsTimer.reset();
+    if (!this->physicsTimerStarted)
+    {
+        this->physicsTimerStarted = true;
+        elapsed = 0.0f;
+    }
+
+    if ( physicsStepTime <= 0.0f || physicsStepsPerFrame <= 0 )
+    {
+        // paused, draw objects where they are
+        this->physicsAccumulator = 0.0f;
+        this->physicsInterpolation = 1.0f;
+        this->pendingInterpolation = 1.0f;
+        this->pendingStats.physicsSteps = 0;
+        this->pendingStats.physicsTime = timer.getElapsedTime();
+        return;
+    }
+
+    // consume the elapsed time in fixed steps, so the simulation does not
+    // depend on the frame rate
+    this->physicsAccumulator += elapsed;
+    int steps = 0;
+    if (this->physicsThreaded)
+    {
+        // the steps run on the physics thread while the frame is drawn
+        while (this->physicsAccumulator >= physicsStepTime && steps < physicsStepsPerFrame)
+        {
+            this->physicsAccumulator -= physicsStepTime;
+            steps++;
+        }
+        std::vector<Object*>& objects = this->objects;
+        if (steps > 0)
+        {
+            physics.stepSimulationAsync(physicsStepTime, steps, [&objects]{
+                for (Object* object : objects)
+                    object->motionState.beginStep();
+            });
+        }
+    }
+    else
+    {
+        while (this->physicsAccumulator >= physicsStepTime && steps < physicsStepsPerFrame)
+        {
+            for (Object* object : this->objects)
+                object->savePreviousPosition();
+            physics.stepSimulation(physicsStepTime, 1, physicsStepTime);
+            this->physicsAccumulator -= physicsStepTime;
+            steps++;
+        }
+    }
+
+    // when steps take longer than the time they simulate, drop the time
+    // that could not be caught up instead of falling further behind
+    this->pendingStats.droppedTime = 0.0f;
+    if (this->physicsAccumulator >= physicsStepTime)
+    {
+        float kept = std::fmod(this->physicsAccumulator, physicsStepTime);
+        this->pendingStats.droppedTime = this->physicsAccumulator - kept;
+        this->physicsAccumulator = kept;
+    }
+
+    float interpolation = this->physicsAccumulator / physicsStepTime;
+    this->pendingStats.physicsSteps = steps;
+    if (this->physicsThreaded)
+    {
+        this->pendingInterpolation = interpolation;
+        return;
+    }
+    this->physicsInterpolation = interpolation;
+    this->pendingStats.physicsTime = timer.getElapsedTime();
+}
+
+
+void World::setPhysicsThreaded(bool threaded)
+{
+    if (threaded == this->physicsThreaded)
+        return;
+
+    // finish any steps in flight and bring in objects queued for them
+    if (this->physicsThreaded)
+        this->swapPhysicsBuffers();
+    this->physicsThreaded = threaded;
+    for (Object* object : this->objects)
+        object->motionState.setBuffered(threaded);
+}
+
+
+void World::swapPhysicsBuffers()
+{
+    // physics is idle from here until the next stepPhysics
+    this->physics.waitForSimulation();
+    if (this->pendingStats.physicsSteps > 0)
+        this->pendingStats.physicsTime = this->physics.getAsyncStepTime();
+
+    for (Object* object : this->objects)
+        object->swapPhysicsBuffers();
+    this->physicsInterpolation = this->pendingInterpolation;
+
+    std::lock_guard<std::mutex> lock(this->objectQueueMutex);
+    for (auto& queued : this->queuedObjects)
     {
-        static float normalStepSize = 1.0f/60.0f;
-        int subSteps = (int) (physicsStepTime / normalStepSize);
-        if (subSteps < 1 )
-            subSteps = 1;
-        
-        for (int i=0; i < physicsStepsPerFrame; i++)
-            physics.stepSimulation(physicsStepTime, subSteps);
+        Object* object = queued.first;
+        if (queued.second && this->insertObject(object))
+        {
+            object->motionState.setBuffered(true);
+            this->physics.addBody(*object);
+        }
+        else if (!queued.second && this->eraseObject(object))
+        {
+            object->motionState.setBuffered(false);
+            this->physics.removeBody(*object);
+        }
     }
+    this->queuedObjects.clear();
+}
+
+
+void World::endFrame()
+{
+    // physics results computed during the frame become visible next frame
+    if (this->physicsThreaded)
+        this->swapPhysicsBuffers();
+
+    float frameTime = 1.0f/((float)fps);
+    float busyTime = frameTimer.getElapsedTime();
+
+    // sleep through most of the remaining time, the scheduler may wake 
+    // us late so the last moments are spent yielding instead
+    static const float SLEEP_MARGIN = 0.002f;
+    float remaining = frameTime - busyTime;
+    if (remaining > SLEEP_MARGIN)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(
+            (long long) ((remaining - SLEEP_MARGIN) * 1000000.0f)));
+    }
+    while (frameTimer.getElapsedTime() < frameTime)
+        std::this_thread::yield();
+
+    float totalTime = frameTimer.getElapsedTime();
+    actualFPS = (int) (1.0f / totalTime);
+
+    this->pendingStats.frameTime = totalTime;
+    this->pendingStats.renderTime = this->renderTimeElapsed;
+    this->pendingStats.idleTime = totalTime - busyTime;
+    this->pendingStats.budgetUsed = busyTime / frameTime;
+    this->frameStats = this->pendingStats;
 }
   
 
-void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
-    const Matrix4& viewMatrix, const Matrix4& projectionMatrix, bool wireframe)
+void World::updateFrameUniforms(const Matrix4& view, const Matrix4& projection)
+{
+    this->frameView = view;
+    this->frameProjection = projection;
+    this->frameViewProjection.multiply(projection, view);
+    this->frameFlatProjection.createOrthographicMatrix(0, (Scalar)this->graphics.getDisplayWidth(),
+        0, (Scalar)this->graphics.getDisplayHeight(), -1.0, 1.0);
+
+    FrameUniforms& u = this->frameUniforms;
+    std::copy(view.getArray(), view.getArray() + 16, u.view);
+    std::copy(projection.getArray(), projection.getArray() + 16, u.projection);
+    std::copy(this->frameViewProjection.getArray(), this->frameViewProjection.getArray() + 16, u.viewProjection);
+    std::copy(this->frameFlatProjection.getArray(), this->frameFlatProjection.getArray() + 16, u.flatProjection);
+    if (this->light != NULL)
+    {
+        const Point3& location = this->light->getLocation();
+        u.lightPosition[0] = location.x();
+        u.lightPosition[1] = location.y();
+        u.lightPosition[2] = location.z();
+    }
+    else
+        u.lightPosition[0] = u.lightPosition[1] = u.lightPosition[2] = 0.0f;
+    u.lightPosition[3] = 1.0f;
+
+    StreamBuffer::Allocation frame = this->frameStream->write(&u, sizeof(FrameUniforms), this->uniformAlignment);
+    this->graphics.getStateCache().bindUniformBuffer(GpuProgram::FRAME_BLOCK_BINDING, 
+        *frame.buffer, frame.offset, sizeof(FrameUniforms));
+}
+
+int World::addDrawUniforms(const Matrix4& model)
+{
+    int entry = this->drawUniformData.size() / this->drawUniformStride;
+    this->drawUniformData.resize(this->drawUniformData.size() + this->drawUniformStride);
+    DrawUniforms& u = *(DrawUniforms*)&this->drawUniformData[entry * this->drawUniformStride];
+
+    Matrix4 modelView;
+    Matrix4 modelViewProjection;
+    Matrix3 normal;
+    modelView.multiply(this->frameView, model);
+    modelViewProjection.multiply(this->frameViewProjection, model);
+    modelView.extractRotation(normal);
+
+    std::copy(model.getArray(), model.getArray() + 16, u.model);
+    std::copy(modelView.getArray(), modelView.getArray() + 16, u.modelView);
+    std::copy(modelViewProjection.getArray(), modelViewProjection.getArray() + 16, u.modelViewProjection);
+    for (int column = 0; column < 3; column++)
+    {
+        std::copy(normal.getArray() + column * 3, normal.getArray() + column * 3 + 3, &u.normal[column * 4]);
+        u.normal[column * 4 + 3] = 0.0f;
+    }
+    return entry;
+}
+
+void World::uploadDrawUniforms()
+{
+    this->drawUniformAllocation = this->frameStream->write(&this->drawUniformData[0], 
+        this->drawUniformData.size() * sizeof(GLfloat), this->uniformAlignment);
+}
+
+void World::setupMaterial(Material& material, int drawUniforms, bool wireframe)
 {
     auto gpuProgram = material.gpuProgram;
     MAGIC_ASSERT(gpuProgram != nullptr);
 
+    GLStateCache& state = this->graphics.getStateCache();
+
     // 'use' gpuProgram
-    gpuProgram->use();
+    state.useProgram(gpuProgram->programId);
+
+    // the object's matrices, computed once per frame
+    const DrawUniforms& draw = *(const DrawUniforms*)&this->drawUniformData[drawUniforms * this->drawUniformStride];
+    if (gpuProgram->usesDrawBlock())
+    {
+        state.bindUniformBuffer(GpuProgram::DRAW_BLOCK_BINDING, *this->drawUniformAllocation.buffer,
+            this->drawUniformAllocation.offset + drawUniforms * this->drawUniformStride * sizeof(GLfloat), 
+            sizeof(DrawUniforms));
+    }
+
+    // instanced programs read the model matrix as an attribute, give it a 
+    // constant value for draws that are not instanced
+    if (gpuProgram->isInstanced())
+        VertexArray::setConstantMatrix(GpuProgram::INSTANCE_MATRIX_LOCATION, draw.model);
 
     // set named uniforms
     for (unsigned int i = 0; i < gpuProgram->namedUniforms.size(); i++)
@@ -60,10 +276,10 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
         switch (u.datatype)
         {
         case VertexArray::FLOAT:
-            gpuProgram->setUniformfv(u.varName.c_str(), u.comp_count, (const float*)u.data);
+            gpuProgram->setUniformfv(u.handle, u.comp_count, (const float*)u.data);
             break;
         case VertexArray::INT:
-            gpuProgram->setUniformiv(u.varName.c_str(), u.comp_count, (const int*)u.data);
+            gpuProgram->setUniformiv(u.handle, u.comp_count, (const int*)u.data);
             break;
         default:
             throw_MagicException("Unsupported Auto Uniform datatype.");
@@ -72,9 +288,7 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
     }
 
     // set auto uniforms
-    Matrix4 temp4m;
-    Matrix4 temp4m2;
-    Matrix3 temp3m;
+    GLfloat normal[9];
     Point3 tempp3;
     for (unsigned int i = 0; i < gpuProgram->autoUniforms.size(); i++)
     {
@@ -82,105 +296,104 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
         switch (u.type)
         {
         case GpuProgram::MODEL_MATRIX:                   // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, modelMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, draw.model);
             break;
         case GpuProgram::VIEW_MATRIX:                    // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, viewMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, this->frameUniforms.view);
             break;
         case GpuProgram::PROJECTION_MATRIX:              // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, projectionMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, this->frameUniforms.projection);
             break;
-
-            // TODO: stop multiplying these matrices for every individual mesh
         case GpuProgram::MODEL_VIEW_MATRIX:              // mat4
-            temp4m.multiply(viewMatrix, modelMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, draw.modelView);
             break;
         case GpuProgram::VIEW_PROJECTION_MATRIX:         // mat4
-            temp4m.multiply(projectionMatrix, viewMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, this->frameUniforms.viewProjection);
             break;
         case GpuProgram::MODEL_PROJECTION_MATRIX:        // mat4
-            temp4m.multiply(projectionMatrix, modelMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            {
+                // rarely used, so not kept per draw
+                Matrix4 model;
+                Matrix4 modelProjection;
+                for (int i = 0; i < 16; i++)
+                    model.set(i / 4, i % 4, draw.model[i]);
+                modelProjection.multiply(this->frameProjection, model);
+                gpuProgram->setUniformMatrix(u.handle, 4, modelProjection.getArray());
+            }
             break;
         case GpuProgram::MODEL_VIEW_PROJECTION_MATRIX:   // mat4
-            temp4m.multiply(viewMatrix, modelMatrix);
-            temp4m2.multiply(projectionMatrix, temp4m);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m2.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, draw.modelViewProjection);
             break;
         case GpuProgram::NORMAL_MATRIX:                  // mat3
-            temp4m.multiply(viewMatrix, modelMatrix);
-            temp4m.extractRotation(temp3m);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 3, temp3m.getArray());
+            for (int column = 0; column < 3; column++)
+                std::copy(&draw.normal[column * 4], &draw.normal[column * 4 + 3], &normal[column * 3]);
+            gpuProgram->setUniformMatrix(u.handle, 3, normal);
             break;
 
         case GpuProgram::FPS:                            // int
-            gpuProgram->setUniformiv(u.varName.c_str(), 1, &this->actualFPS);
+            gpuProgram->setUniformiv(u.handle, 1, &this->actualFPS);
             break;
         case GpuProgram::TEXTURE0:                       // sampler2D
             MAGIC_THROW(material.textures[0] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
             if (this->useTextures)
-                gpuProgram->setTexture(u.varName.c_str(), material.textures[0].get(), 0);
+                setTextureUniform(*gpuProgram, u.handle, material.textures[0].get(), 0);
             else
-                gpuProgram->setTexture(u.varName.c_str(), fallbackTexture.get(), 0);
+                setTextureUniform(*gpuProgram, u.handle, fallbackTexture.get(), 0);
             break;
         case GpuProgram::TEXTURE1:                       // sampler2D
             MAGIC_THROW(material.textures[1] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[1].get(), 1);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[1].get(), 1);
             break;
         case GpuProgram::TEXTURE2:                       // sampler2D
             MAGIC_THROW(material.textures[2] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[2].get(), 2);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[2].get(), 2);
             break;
         case GpuProgram::TEXTURE3:                       // sampler2D
             MAGIC_THROW(material.textures[3] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[3].get(), 3);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[3].get(), 3);
             break;
         case GpuProgram::TEXTURE4:                       // sampler2D
             MAGIC_THROW(material.textures[4] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[4].get(), 4);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[4].get(), 4);
             break;
         case GpuProgram::TEXTURE5:                       // sampler2D
             MAGIC_THROW(material.textures[5] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[5].get(), 5);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[5].get(), 5);
             break;
         case GpuProgram::TEXTURE6:                       // sampler2D
             MAGIC_THROW(material.textures[6] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[6].get(), 6);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[6].get(), 6);
             break;
         case GpuProgram::TEXTURE7:                       // sampler2D
             MAGIC_THROW(material.textures[7] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
-            gpuProgram->setTexture(u.varName.c_str(), material.textures[7].get(), 7);
+            setTextureUniform(*gpuProgram, u.handle, material.textures[7].get(), 7);
             break;
         case GpuProgram::LIGHT_LOCATION:                 // vec3
             MAGIC_THROW(light == NULL, "Material has the light location "
                 "auto-bound uniform set, but no light is set for the world.");
             tempp3 = light->getLocation();// .transform(viewMatrix);
-            gpuProgram->setUniformf(u.varName.c_str(), tempp3.x(),
+            gpuProgram->setUniformf(u.handle, tempp3.x(),
                 tempp3.y(), tempp3.z());
             break;
         case GpuProgram::FLAT_PROJECTION:   // mat4
-            temp4m.createOrthographicMatrix(0, (Scalar)this->graphics.getDisplayWidth(),
-                0, (Scalar)this->graphics.getDisplayHeight(), -1.0, 1.0);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.handle, 4, this->frameUniforms.flatProjection);
             break;
         case GpuProgram::NORMAL_MAP:                       // sampler2D
             if (material.normalMap != nullptr && this->useNormalMaps)
             {
-                gpuProgram->setTexture(u.varName.c_str(), material.normalMap.get(), 8);
-                gpuProgram->setUniformf("normalMapping", 1.0f);
+                setTextureUniform(*gpuProgram, u.handle, material.normalMap.get(), 8);
+                gpuProgram->setUniformf(u.auxHandle, 1.0f);
             }
             else
-                gpuProgram->setUniformf("normalMapping", 0.0f);
+                gpuProgram->setUniformf(u.auxHandle, 0.0f);
             break;
         default:
             MAGIC_ASSERT(false);
@@ -188,56 +401,209 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
         }
     }
 
+    // state is set through the cache for every material rather than torn 
+    // down after each one, so materials sharing state make no gl calls
+
     // check for a depth lie
     if (material.depthBufferLie)
     {
-        glPolygonOffset(material.depthBufferLie, 1.0f);
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        state.setPolygonOffset(material.depthBufferLie, 1.0f);
+        state.setCapability(GLStateCache::POLYGON_OFFSET_FILL, true);
     }
+    else
+        state.setCapability(GLStateCache::POLYGON_OFFSET_FILL, false);
 
     // disable depth buffer writes if mesh is transparent
-    if (material.transparent)
-        glDepthMask(GL_FALSE);
+    state.setDepthMask(!material.transparent);
 
     // setup wireframe if set to
     if (wireframe)
     {
-        glEnable(GL_BLEND);
-        glEnable(GL_LINE_SMOOTH);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDisable(GL_CULL_FACE);
+        state.setCapability(GLStateCache::BLEND, true);
+        state.setCapability(GLStateCache::LINE_SMOOTH, true);
+        state.setPolygonMode(GL_LINE);
+        state.setCapability(GLStateCache::CULL_FACE, false);
     }
 }
 
-void World::tearDownMaterial(Material& material, bool wireframe)
+void World::setTextureUniform(GpuProgram& gpuProgram, GpuProgram::UniformHandle handle,
+    Texture* texture, int unit)
 {
-    // disable depth lie if it was enabled
-    if (material.depthBufferLie)
-        glDisable(GL_POLYGON_OFFSET_FILL);
+    this->graphics.getStateCache().bindTexture(unit, *texture);
+    gpuProgram.setUniformiv(handle, 1, &unit);
+}
 
-    // re-enabled depth buffer write
-    if (material.transparent)
-        glDepthMask(GL_TRUE);
+void World::restoreRenderState(bool wireframe)
+{
+    GLStateCache& state = this->graphics.getStateCache();
+
+    // disable depth lie and re-enable depth buffer writes
+    state.setCapability(GLStateCache::POLYGON_OFFSET_FILL, false);
+    state.setDepthMask(true);
 
     // restore after wireframe
     if (wireframe)
     {
-        glDisable(GL_LINE_SMOOTH);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glEnable(GL_CULL_FACE);
+        state.setCapability(GLStateCache::LINE_SMOOTH, false);
+        state.setPolygonMode(GL_FILL);
+        state.setCapability(GLStateCache::CULL_FACE, true);
     }
 }
 
 void World::renderMesh(Mesh& mesh)
 {
     // draw mesh
-    mesh.getVertexArray().draw(mesh.getPrimitive(), mesh.getVertexCount());
-    vertexCount += mesh.getVertexCount();   
+    if (mesh.isIndexed())
+        mesh.getVertexArray().drawElements(mesh.getPrimitive(), mesh.getElementCount(), mesh.getIndexType());
+    else
+        mesh.getVertexArray().draw(mesh.getPrimitive(), mesh.getVertexCount());
+    vertexCount += mesh.getElementCount();   
+    drawCalls++;
+}
+
+/// order models by their meshes, so objects sharing meshes end up next to each other
+static inline bool meshesLess(const Meshes& a, const Meshes& b)
+{
+    if (a.size() != b.size())
+        return a.size() < b.size();
+    return !a.empty() && a.front().get() < b.front().get();
+}
+
+void World::buildDrawBatches()
+{
+    this->drawBatches.clear();
+    this->instanceData.clear();
+
+    // static and instanced draws all use the identity model matrix
+    Matrix4 identityMatrix;
+    this->drawUniformData.clear();
+    this->addDrawUniforms(identityMatrix);
+
+    unsigned int i = 0;
+    while (i < this->renderQueue.size())
+    {
+        const RenderQueue::Item& item = this->renderQueue[i];
+        if (item.isStatic)
+        {
+            this->drawBatches.push_back(DrawBatch(i++, 0, 0, 0));
+            continue;
+        }
+        if (!this->instancingEnabled || !item.material->gpuProgram->isInstanced())
+        {
+            Matrix4 model;
+            item.object->getInterpolatedTransform(this->physicsInterpolation, model);
+            this->drawBatches.push_back(DrawBatch(i++, 0, 0, this->addDrawUniforms(model)));
+            continue;
+        }
+
+        // the queue keeps items with the same material together, find the end of the run
+        this->instanceRun.clear();
+        for (; i < this->renderQueue.size(); i++)
+        {
+            const RenderQueue::Item& next = this->renderQueue[i];
+            if (next.isStatic || next.material != item.material)
+                break;
+            if (next.object->getModel()->getMeshes() != nullptr)
+                this->instanceRun.push_back(i);
+        }
+
+        // opaque objects can be drawn in any order, transparent ones only
+        // share a draw with their neighbours so they stay sorted back to front
+        const RenderQueue& queue = this->renderQueue;
+        if (!item.material->transparent)
+        {
+            std::stable_sort(this->instanceRun.begin(), this->instanceRun.end(), 
+                [&queue](unsigned int a, unsigned int b) {
+                    return meshesLess(*queue[a].object->getModel()->getMeshes(), 
+                        *queue[b].object->getModel()->getMeshes());
+                });
+        }
+
+        const Meshes* meshes = nullptr;
+        for (unsigned int index : this->instanceRun)
+        {
+            Object* object = this->renderQueue[index].object;
+            const Meshes* objectMeshes = object->getModel()->getMeshes().get();
+            if (meshes == nullptr || *meshes != *objectMeshes)
+            {
+                this->drawBatches.push_back(DrawBatch(index, this->instanceData.size() / 16, 0, 0));
+                meshes = objectMeshes;
+            }
+            this->drawBatches.back().instanceCount++;
+
+            Matrix4 model;
+            object->getInterpolatedTransform(this->physicsInterpolation, model);
+            this->instanceData.insert(this->instanceData.end(), model.getArray(), model.getArray() + 16);
+        }
+    }
+
+    this->uploadDrawUniforms();
+    if (this->instanceData.empty())
+        return;
+
+    // aligned to whole matrices, so instances can be indexed from the start of the buffer
+    this->instanceAllocation = this->frameStream->write(&this->instanceData[0], 
+        this->instanceData.size() * sizeof(GLfloat), sizeof(GLfloat) * 16);
 }
     
+void World::bakeStaticChunks()
+{
+    // swap the old baked object of each changed chunk for a new one
+    for (StaticChunks::Chunk* chunk : this->staticChunks.getDirtyChunks())
+    {
+        if (chunk->baked != nullptr)
+            this->removeStaticDrawable(chunk->baked.get());
+        this->staticChunks.bake(*chunk);
+        if (chunk->baked != nullptr)
+            this->addStaticDrawable(chunk->baked.get(), chunk->material);
+    }
+    this->staticChunks.finishBaking();
+}
+
+void World::queueVisibleObjects(ViewFrustum& viewFrustum, const Point3& eye, const Vector3& forward,
+    bool moving)
+{
+    this->cullObjects.clear();
+    this->cullSpheres.clear();
+    for (Object* o : this->objects)
+    {
+        if (o->moving != moving)
+            continue;
+
+        // world bounds are kept up to date by the object as it moves
+        const Bounds& bounds = o->getWorldBounds();
+        Point3 center = bounds.getCenter();
+        this->cullObjects.push_back(o);
+        this->cullSpheres.add(center.x(), center.y(), center.z(), bounds.getRadius());
+    }
+    this->cullMask.resize((this->cullObjects.size() + 31) / 32);
+    viewFrustum.spheresInFrustum(this->cullSpheres, 0, this->cullObjects.size(), 
+        this->cullMask.empty() ? nullptr : &this->cullMask[0]);
+
+    for (unsigned int i = 0; i < this->cullObjects.size(); i++)
+    {
+        if (!(this->cullMask[i >> 5] & (1u << (i & 31))))
+            continue;
+
+        Object* o = this->cullObjects[i];
+        Material* material = o->getModel()->getMaterial().get();
+        Scalar depth = forward.x() * (this->cullSpheres.x[i] - eye.x()) + 
+            forward.y() * (this->cullSpheres.y[i] - eye.y()) +
+            forward.z() * (this->cullSpheres.z[i] - eye.z());
+        this->renderQueue.add(RenderQueue::Item(o, material, false), material->transparent,
+            material->gpuProgram->programId, depth);
+    }
+}
+
 void World::renderObjects()
 {   
 	StopWatch timer;
+    VertexArray::resetBindCount();
+
+    // gl state may have been changed outside the world since the last frame
+    GLStateCache& state = this->graphics.getStateCache();
+    state.invalidate();
+    state.resetCallCounts();
 
     // ensure that we have a camera
     MAGIC_THROW(camera == NULL, "Tried to process a frame without a camera set." );
@@ -249,139 +615,170 @@ void World::renderObjects()
     Matrix4 view;
     camera->getPosition().getCameraMatrix(view);
     const Matrix4& projection = camera->getProjectionMatrix();
+    if (this->frameStream == nullptr)
+    {
+        // per draw entries must start on the uniform buffer offset alignment to be bound separately
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->uniformAlignment);
+        int size = sizeof(DrawUniforms);
+        size = (size + this->uniformAlignment - 1) / this->uniformAlignment * this->uniformAlignment;
+        this->drawUniformStride = size / sizeof(GLfloat);
+        this->frameStream.reset(new StreamBuffer(256 * 1024));
+    }
+    this->updateFrameUniforms(view, projection);
 
-	std::vector<Object*> sortedObjects;
-	sortedObjects.reserve(this->objects.size());
-	//sortedObjects.insert(sortedObjects.begin(), this->objects.begin(), this->objects.end());
-
-    // only render objects that exist in the view frustum of the camera
+    // only render objects that exist in the view frustum of the camera, 
+    // queueing them with their depth along the view direction
     auto viewFrustum = camera->getViewFrustum();
+    const Point3& eye = camera->getPosition().getLocation();
+    const Vector3& forward = camera->getPosition().getForwardVector();
+    this->renderQueue.setMaxDepth(viewFrustum.getFarDistance());
+
+    // objects physics left where they were keep their place in the queue,
+    // unless one of them changed or started or stopped moving, or the camera moved
+    bool restingValid = this->restingQueueValid && 
+        std::equal(view.getArray(), view.getArray() + 16, this->restingView.getArray()) &&
+        std::equal(projection.getArray(), projection.getArray() + 16, this->restingProjection.getArray());
+    this->restingObjectCount = 0;
     for (Object* o : this->objects)
     {
-        auto sphere = o->getModel()->getMeshes()->getBoundingSphere();
-        // TODO: add in bounding sphere offset for this to work correctly
-        auto loc = o->getPosition().getLocation();
-        if (viewFrustum.sphereInFrustum(Vector3(loc.x(), loc.y(), loc.z()), sphere.getRadius()))
-            sortedObjects.push_back(o);
+        if (o->moving)
+            restingValid = restingValid && !o->renderRetained;
         else
-            continue;
+        {
+            restingValid = restingValid && o->renderRetained && !o->renderDirty;
+            this->restingObjectCount++;
+        }
     }
 
-    std::vector<std::shared_ptr<Object>> sortedStaticObjects;
-    sortedStaticObjects.reserve(this->staticObjectCount);
-
-    // only render objects that exist in the view frustum of the camera
-    for (auto it : this->staticObjects)
+    if (restingValid)
+        this->renderQueue.clearUnretained();
+    else
     {
-        for (std::shared_ptr<Object> o : *it.second)
+        this->renderQueue.clear();
+        this->queueVisibleObjects(viewFrustum, eye, forward, false);
+        this->renderQueue.retain();
+        this->restingView = view;
+        this->restingProjection = projection;
+        this->restingQueueValid = true;
+        for (Object* o : this->objects)
         {
-            auto sphere = o->getModel()->getMeshes()->getBoundingSphere();
-            auto loc = sphere.getOffset();
-            if (viewFrustum.sphereInFrustum(Vector3(loc.x(), loc.y(), loc.z()), sphere.getRadius()))
-                sortedStaticObjects.push_back(o);
-            else
-                continue;
+            o->renderRetained = !o->moving;
+            if (!o->moving)
+                o->renderDirty = false;
         }
     }
+    this->queueVisibleObjects(viewFrustum, eye, forward, true);
 
-	Point3 loc = camera->getPosition().getLocation();
-	std::sort(sortedObjects.begin(), sortedObjects.end(), [&](Object* a, Object* b) -> bool {
-		auto aTrans = a->getModel()->getMaterial()->transparent;
-		auto bTrans = b->getModel()->getMaterial()->transparent;
-
-		// sort transparent objects to back
-		if (!aTrans && bTrans)
-			return true; // a should go before as it's not transparent
-		else if (aTrans && !bTrans)
-			return false; // b should go before as it's not transparent
-
-		// sort opaque objects from front to back, to take advantage of depth buffer
-		if (!aTrans)
-		{
-			return loc.distanceTo(a->getPosition().getLocation()) <
-				loc.distanceTo(b->getPosition().getLocation());
-		}
-		// sort transparent objects from back to front, to ensure rendering works
-		else
-		{
-			return loc.distanceTo(a->getPosition().getLocation()) >
-				loc.distanceTo(b->getPosition().getLocation());
-		}
-	});
+    this->bakeStaticChunks();
+    this->visibleStaticObjects.clear();
+    this->staticTree.cull(viewFrustum, this->visibleStaticObjects);
+    for (const ObjectBVH::Item* o : this->visibleStaticObjects)
+    {
+        Material* material = o->material;
+        Scalar depth = forward.x() * (o->center[0] - eye.x()) + forward.y() * (o->center[1] - eye.y()) +
+            forward.z() * (o->center[2] - eye.z());
+        this->renderQueue.add(RenderQueue::Item(o->object, material, true), material->transparent,
+            material->gpuProgram->programId, depth);
+    }
+
+    this->renderQueue.sort();
+    this->buildDrawBatches();
 
     vertexCount = 0;
+    drawCalls = 0;
 
-    // render static objects (aka scenery)
-    Matrix4 identityMatrix;
+    // render everything in the queue
     Material* material = nullptr;
-    for (auto ob : sortedStaticObjects)
+    bool materialStatic = false;
+    for (const DrawBatch& batch : this->drawBatches)
     {
-        if (material == nullptr || material != ob->getModel()->getMaterial().get())
+        const RenderQueue::Item& item = this->renderQueue[batch.item];
+        const std::shared_ptr<Meshes> meshes = item.object->getModel()->getMeshes();
+        if (meshes == nullptr)
+            continue;
+
+        if (item.isStatic)
         {
-            if (material != nullptr)
-                tearDownMaterial(*material, this->wireframeEnabled);
-            material = ob->getModel()->getMaterial().get();
-            setupMaterial(*material, identityMatrix, view, projection, this->wireframeEnabled);
-        }
+            // static objects share the identity model matrix, so the material
+            // only needs setting up when it changes
+            if (material != item.material || !materialStatic)
+                setupMaterial(*item.material, batch.drawUniforms, this->wireframeEnabled);
 
-        for (auto mesh : *ob->getModel()->getMeshes())
+            for (auto mesh : *meshes)
+            {
+                // pooled meshes draw from the pool's shared vertex array without rebinding
+                if (this->staticMeshes.contains(*mesh))
+                {
+                    this->staticMeshes.draw(*mesh);
+                    vertexCount += mesh->getElementCount();
+                    drawCalls++;
+                }
+                else
+                    renderMesh(*mesh);
+                if (showNormals)
+                    renderMesh(mesh->getVisibleNormals());
+            }
+        }
+        else if (batch.instanceCount > 0)
         {
-            renderMesh(*mesh);
-            if (showNormals)
-                renderMesh(mesh->getVisibleNormals());
+            // model matrices come from the instance buffer
+            setupMaterial(*item.material, batch.drawUniforms, this->wireframeEnabled);
+            for (const auto& mesh : *meshes)
+            {
+                mesh->drawInstanced(*this->instanceAllocation.buffer, 
+                    this->instanceAllocation.offset / (sizeof(GLfloat) * 16) + batch.firstInstance, 
+                    batch.instanceCount);
+                vertexCount += mesh->getElementCount() * batch.instanceCount;
+                drawCalls++;
+            }
         }
+        else
+        {
+            // the object's matrices were computed once for all its meshes
+            setupMaterial(*item.material, batch.drawUniforms, this->wireframeEnabled);
+            for (const auto& mesh : *meshes)
+            {
+                renderMesh(*mesh);
+                if (showNormals)
+                    renderMesh(mesh->getVisibleNormals());
+            }
+        }
+        material = item.material;
+        materialStatic = item.isStatic;
     }
-    if (material != nullptr)
-        tearDownMaterial(*material, this->wireframeEnabled);
-
-	// render all objects
-	std::vector<Object*>::iterator it = sortedObjects.begin();
-	Object* ob;
-	for(; it != sortedObjects.end(); it++)
-	{
-	    // get object and entity
-	    ob = (*it);
-	    
-		const std::shared_ptr<Meshes> meshes = ob->getModel()->getMeshes();
-		if (meshes == nullptr)
-			break;
-
-        // get mesh and material data
-		auto material = ob->getModel()->getMaterial();
-            
-        // get model/world matrix for object (same for all meshes in object)
-        Matrix4 model;
-        ob->getPosition().getTransformMatrix(model);
-        
-        setupMaterial(*material, model, view, projection, this->wireframeEnabled);
-		for(const std::shared_ptr<Mesh> mesh : *meshes)
-		{   
-            renderMesh(*mesh);
-            if (showNormals)
-                renderMesh(mesh->getVisibleNormals());
-		}
-        tearDownMaterial(*material, this->wireframeEnabled);
-	} // end of all objects
+    this->staticMeshes.finishDraws();
 
     // render bounding spheres, if requested
     if (this->showBoundingSpheres)
     {
-        for (auto it : this->staticObjects)
+        // stream the matrices of every dynamic object, after the identity entry
+        Matrix4 identityMatrix;
+        this->drawUniformData.clear();
+        this->addDrawUniforms(identityMatrix);
+        for (Object* ob : this->objects)
+        {
+            Matrix4 model;
+            ob->getInterpolatedTransform(this->physicsInterpolation, model);
+            this->addDrawUniforms(model);
+        }
+        this->uploadDrawUniforms();
+
+        for (auto& it : this->staticObjects)
         {
             auto material = it.first;
-            setupMaterial(*material, identityMatrix, view, projection, true);
+            setupMaterial(*material, 0, true);
             for (int i = 0; i < it.second->size(); i++)
             {
                 renderMesh(it.second->at(i)->getModel()->getMeshes()->getBoundingSphereMesh());
             }
-            tearDownMaterial(*material, true);
         }
 
-        std::set<Object*>::iterator it2 = this->objects.begin();
-        for (; it2 != this->objects.end(); it2++)
+        int drawUniforms = 1;
+        std::vector<Object*>::iterator it2 = this->objects.begin();
+        for (; it2 != this->objects.end(); it2++, drawUniforms++)
         {
             // get object and entity
-            ob = (*it2);
+            Object* ob = (*it2);
 
             const std::shared_ptr<Meshes> meshes = ob->getModel()->getMeshes();
             if (meshes == nullptr)
@@ -390,21 +787,22 @@ void World::renderObjects()
             // get mesh and material data
             auto material = ob->getModel()->getMaterial();
 
-            // get model/world matrix for object (same for all meshes in object)
-            Matrix4 model;
-            ob->getPosition().getTransformMatrix(model);
-
             // render bounding sphere
-            setupMaterial(*material, model, view, projection, true);
+            setupMaterial(*material, drawUniforms, true);
             renderMesh(meshes->getBoundingSphereMesh());
-            tearDownMaterial(*material, true);
         } // end of all objects
     }
 
+    restoreRenderState(this->wireframeEnabled || this->showBoundingSpheres);
+    this->frameStream->nextFrame();
+    this->glCallsIssued = state.getIssuedCallCount();
+    this->glCallsSkipped = state.getSkippedCallCount();
+
 	// Do the buffer Swap
     graphics.swapBuffers();
 
 	this->renderTimeElapsed = timer.getElapsedTime();
+    this->vertexArrayBinds = VertexArray::getBindCount();
 }
 
 
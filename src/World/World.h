@@ -27,12 +27,20 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../Cameras/Camera.h"
 #include "../Graphics/GraphicsSystem.h"
+#include "../Graphics/MeshPool.h"
+#include "../Graphics/RenderQueue.h"
+#include "../Graphics/StreamBuffer.h"
 #include "../Physics/PhysicsSystem.h"
 #include "../Objects/Object.h"
+#include "../Shaders/UniformBlocks.h"
 #include "../Time/StopWatch.h"
+#include "ObjectBVH.h"
+#include "StaticChunks.h"
 
 #include <set>
+#include <algorithm>
 #include <unordered_map>
+#include <mutex>
 
 
 namespace Magic3D
@@ -45,17 +53,126 @@ namespace Magic3D
  */
 class World
 {
+public:
+    /// timings of one frame, in seconds
+    struct FrameStats
+    {
+        /// time from startFrame to the end of endFrame
+        float frameTime;
+        /// time spent advancing physics
+        float physicsTime;
+        /// time spent drawing
+        float renderTime;
+        /// time spent waiting for the next frame in endFrame
+        float idleTime;
+        /// fraction of the target frame time used before waiting
+        float budgetUsed;
+        /// fixed physics steps taken
+        int physicsSteps;
+        /// real time dropped because physics could not keep up
+        float droppedTime;
+
+        inline FrameStats(): frameTime(0), physicsTime(0), renderTime(0), idleTime(0),
+            budgetUsed(0), physicsSteps(0), droppedTime(0) {}
+    };
+
+    /// default most fixed steps taken in one frame to catch up with real time
+    static const int MAX_CATCH_UP_STEPS = 4;
+
 private:
-    std::set<Object*> objects;
+    /// dynamic objects, densely packed, each knows its index
+    std::vector<Object*> objects;
 
     std::unordered_map<Material*, std::vector<std::shared_ptr<Object>>*> staticObjects;
     int staticObjectCount;
+
+    /// hierarchy over static objects, for culling them
+    ObjectBVH staticTree;
+
+    /// static objects found visible by the last cull
+    std::vector<const ObjectBVH::Item*> visibleStaticObjects;
+
+    /// dynamic objects and their bounds, gathered each frame to be culled in a batch
+    std::vector<Object*> cullObjects;
+    SphereArray cullSpheres;
+    std::vector<uint32_t> cullMask;
+
+    /// shared buffers holding the meshes of static objects
+    MeshPool staticMeshes;
+
+    bool poolStaticMeshes;
+
+    /// static objects baked into combined meshes per material and cell
+    StaticChunks staticChunks;
+
+    bool bakeStaticObjects;
+
+    /// the static and dynamic objects to draw this frame, in draw order.
+    /// Visible resting objects are retained in it while nothing about them
+    /// or the camera changes
+    RenderQueue renderQueue;
+
+    /// whether the retained items of the render queue are still right
+    bool restingQueueValid;
+
+    /// camera matrices the retained items were culled and keyed with
+    Matrix4 restingView;
+    Matrix4 restingProjection;
+
+    /// number of dynamic objects that did not move in the last physics step
+    int restingObjectCount;
+
+    /// a queued item to draw, or a run of queued objects sharing a model
+    /// drawn with one instanced call when instanceCount is not 0
+    struct DrawBatch
+    {
+        unsigned int item;
+        int firstInstance;
+        int instanceCount;
+        /// entry of the per draw uniforms holding the object's matrices
+        int drawUniforms;
+
+        inline DrawBatch(unsigned int item, int firstInstance, int instanceCount, int drawUniforms):
+            item(item), firstInstance(firstInstance), instanceCount(instanceCount), 
+            drawUniforms(drawUniforms) {}
+    };
+    std::vector<DrawBatch> drawBatches;
+    std::vector<unsigned int> instanceRun;
+
+    /// model matrices of all instanced objects this frame, streamed to the gpu once
+    std::vector<GLfloat> instanceData;
+    StreamBuffer::Allocation instanceAllocation;
+
+    bool instancingEnabled;
+
+    /// matrices shared by every draw in the frame
+    Matrix4 frameView;
+    Matrix4 frameProjection;
+    Matrix4 frameViewProjection;
+    Matrix4 frameFlatProjection;
+    FrameUniforms frameUniforms;
+
+    /// matrices of each distinct model matrix drawn, one DrawUniforms per 
+    /// entry padded to the uniform buffer offset alignment. The first entry
+    /// is the identity, used by static and instanced draws
+    std::vector<GLfloat> drawUniformData;
+    int drawUniformStride;
+    StreamBuffer::Allocation drawUniformAllocation;
+
+    /// uniform buffer offset alignment of the driver
+    int uniformAlignment;
+
+    /// ring of per frame data streamed to the gpu, created with the first frame
+    std::unique_ptr<StreamBuffer> frameStream;
     
     GraphicsSystem& graphics;
     
     PhysicsSystem& physics;
     
     StopWatch frameTimer;
+
+    /// time since physics was last advanced
+    StopWatch physicsTimer;
     
     int fps;
     
@@ -63,11 +180,73 @@ private:
     
     bool alignPStep2FPS;
     
+    /// most fixed steps taken in a single frame, time beyond that is dropped
     int physicsStepsPerFrame;
+
+    /// real time not yet simulated, always less than a step after stepPhysics
+    float physicsAccumulator;
+
+    /// fraction of a step the accumulator is into the next step, used to
+    /// blend object positions when drawing
+    float physicsInterpolation;
+
+    bool physicsTimerStarted;
+
+    /// whether physics steps on its own thread while the frame is drawn
+    bool physicsThreaded;
+
+    /// interpolation of the steps running on the physics thread, applied when they are swapped in
+    float pendingInterpolation;
+
+    /// objects added or removed while physics is threaded, applied at the swap point
+    std::mutex objectQueueMutex;
+    /// objects added (true) or removed (false), in order
+    std::vector<std::pair<Object*, bool>> queuedObjects;
+
+    void swapPhysicsBuffers();
+
+    /// put an object in the object array, false if it is already there
+    inline bool insertObject(Object* object)
+    {
+        if (object->worldIndex >= 0)
+            return false;
+        object->worldIndex = this->objects.size();
+        object->renderRetained = false;
+        this->objects.push_back(object);
+        this->restingQueueValid = false;
+        return true;
+    }
+
+    /// take an object out of the object array by moving the last one into its place
+    inline bool eraseObject(Object* object)
+    {
+        int index = object->worldIndex;
+        if (index < 0 || index >= (int)this->objects.size() || this->objects[index] != object)
+            return false;
+        Object* last = this->objects.back();
+        this->objects[index] = last;
+        last->worldIndex = index;
+        this->objects.pop_back();
+        object->worldIndex = -1;
+        this->restingQueueValid = false;
+        return true;
+    }
     
     int actualFPS;
 
+    /// timings of the last complete frame, and of the one in progress
+    FrameStats frameStats;
+    FrameStats pendingStats;
+
 	int vertexCount;
+
+    int vertexArrayBinds;
+
+    int glCallsIssued;
+
+    int glCallsSkipped;
+
+    int drawCalls;
     
     Camera* camera;
     
@@ -89,26 +268,75 @@ private:
 
     void renderMesh(Mesh& mesh);
 
-    void setupMaterial(Material& material, const Matrix4& modelMatrix,
-        const Matrix4& viewMatrix, const Matrix4& projectionMatrix, bool wireframe);
-    void tearDownMaterial(Material& material, bool wireframe);
+    void setupMaterial(Material& material, int drawUniforms, bool wireframe);
+    void setTextureUniform(GpuProgram& gpuProgram, GpuProgram::UniformHandle handle,
+        Texture* texture, int unit);
+    void restoreRenderState(bool wireframe);
+    void buildDrawBatches();
+
+    /// cull the dynamic objects that are moving, or the ones that are not, 
+    /// and add the visible ones to the render queue
+    void queueVisibleObjects(ViewFrustum& viewFrustum, const Point3& eye, const Vector3& forward,
+        bool moving);
+    void updateFrameUniforms(const Matrix4& view, const Matrix4& projection);
+    int addDrawUniforms(const Matrix4& model);
+    void uploadDrawUniforms();
+    void bakeStaticChunks();
+
+    /// start culling and drawing an object as static scenery
+    inline void addStaticDrawable(Object* object, Material* material)
+    {
+        const Bounds& bounds = object->getWorldBounds();
+        this->staticTree.add(object, material, bounds.getCenter(), bounds.getRadius());
+
+        if (this->poolStaticMeshes)
+        {
+            for (auto mesh : *object->getModel()->getMeshes())
+                this->staticMeshes.add(mesh);
+        }
+    }
+
+    /// stop culling and drawing an object as static scenery
+    inline void removeStaticDrawable(Object* object)
+    {
+        this->staticTree.remove(object);
+        for (auto mesh : *object->getModel()->getMeshes())
+        {
+            if (this->staticMeshes.contains(*mesh))
+                this->staticMeshes.remove(*mesh);
+        }
+    }
     
 public:
     inline World( GraphicsSystem* graphics, PhysicsSystem* physics):
-        graphics(*graphics), physics(*physics), fps(60), physicsStepTime(1.0f/60.0f),
-        alignPStep2FPS(true), physicsStepsPerFrame(1), actualFPS(0), vertexCount(0), camera(NULL),
-        light(NULL), wireframeEnabled(false), showBoundingSpheres(false), staticObjectCount(0),
-        showNormals(false), useNormalMaps(true), useTextures(true) 
+        staticObjectCount(0), poolStaticMeshes(true), bakeStaticObjects(true), restingQueueValid(false), 
+        restingObjectCount(0), instancingEnabled(VertexArray::isInstancingSupported()), drawUniformStride(0), 
+        uniformAlignment(0), graphics(*graphics), physics(*physics), fps(60), physicsStepTime(1.0f/60.0f),
+        alignPStep2FPS(true), physicsStepsPerFrame(MAX_CATCH_UP_STEPS), physicsAccumulator(0.0f), 
+        physicsInterpolation(1.0f), physicsTimerStarted(false), physicsThreaded(false), 
+        pendingInterpolation(1.0f), actualFPS(0), vertexCount(0), vertexArrayBinds(0), glCallsIssued(0), 
+        glCallsSkipped(0), drawCalls(0), camera(NULL), light(NULL), wireframeEnabled(false), 
+        showBoundingSpheres(false), showNormals(false), useNormalMaps(true), useTextures(true) 
     {
         Image fallbackImage(1, 1, 4, Color::WHITE);
         fallbackTexture = std::make_shared<Texture>(fallbackImage);
         fallbackTexture->setWrapMode(Texture::CLAMP_TO_EDGE);
     }
     
+	/** add a dynamic object to the world
+	 * @note while physics is threaded this may be called from any thread,
+	 * the object joins the world at the end of the frame
+	 */
 	inline void addObject(Object* object)
 	{
-		objects.insert(object);
-		physics.addBody(*object);
+		if (this->physicsThreaded)
+		{
+			std::lock_guard<std::mutex> lock(this->objectQueueMutex);
+			this->queuedObjects.push_back(std::make_pair(object, true));
+			return;
+		}
+		if (this->insertObject(object))
+			physics.addBody(*object);
 	}
 
     inline void addStaticObject(std::shared_ptr<Object> object)
@@ -124,16 +352,58 @@ public:
         else
             it->second->push_back(object);
         staticObjectCount++;
+
+        // baked objects are drawn through their chunk, baked lazily at the next frame
+        if (this->bakeStaticObjects)
+            this->staticChunks.add(object.get(), material);
+        else
+            this->addStaticDrawable(object.get(), material);
+    }
+   
+    inline void removeStaticObject(std::shared_ptr<Object> object)
+    {
+        auto it = this->staticObjects.find(object->getModel()->getMaterial().get());
+        if (it == this->staticObjects.end())
+            return;
+        auto found = std::find(it->second->begin(), it->second->end(), object);
+        if (found == it->second->end())
+            return;
+        it->second->erase(found);
+        staticObjectCount--;
+
+        if (this->staticChunks.contains(object.get()))
+            this->staticChunks.remove(object.get());
+        else
+            this->removeStaticDrawable(object.get());
+    }
+
+    /// update the culling bounds of a static object after moving it, or rebake its chunk
+    inline void updateStaticObject(std::shared_ptr<Object> object)
+    {
+        if (this->staticChunks.contains(object.get()))
+        {
+            this->staticChunks.update(object.get());
+            return;
+        }
+        const Bounds& bounds = object->getWorldBounds();
+        this->staticTree.updateBounds(object.get(), bounds.getCenter(), bounds.getRadius());
     }
    
+	/** remove a dynamic object from the world
+	 * @note while physics is threaded this may be called from any thread,
+	 * the object leaves the world at the end of the frame and must not be 
+	 * destroyed before then
+	 */
 	inline void removeObject(Object* object)
 	{
-		std::set<Object*>::iterator it = objects.find(object);
-		if ( it != objects.end() )
+		if (this->physicsThreaded)
 		{
-			objects.erase(it);
-			physics.removeBody(*object);
+			std::lock_guard<std::mutex> lock(this->objectQueueMutex);
+			this->queuedObjects.push_back(std::make_pair(object, false));
+			return;
 		}
+		if (this->eraseObject(object))
+			physics.removeBody(*object);
 	}
    
 	inline void setCamera(Camera* camera)
@@ -158,7 +428,7 @@ public:
 		this->alignPStep2FPS = align;
 		if (align)
 		{
-			this->physicsStepsPerFrame = 1;
+			this->physicsStepsPerFrame = MAX_CATCH_UP_STEPS;
 			physicsStepTime = 1.0f/((float)fps);
 		}
 	}
@@ -173,6 +443,9 @@ public:
 		this->physicsStepTime = time;
 	}
    
+	/** set the most fixed physics steps taken in one frame to catch up
+	 * with real time, 0 pauses physics
+	 */
 	inline void setPhysicsStepsPerFrame( int steps )
 	{
 		if (alignPStep2FPS)
@@ -197,23 +470,100 @@ public:
    
 	virtual void renderObjects();
    
-	inline void endFrame()
+	/** set whether physics steps on its own thread, overlapped with drawing.
+	 * Objects are drawn from the positions at the end of the previous
+	 * frame's steps, a frame behind, and physics results are swapped in 
+	 * by endFrame. Between endFrame and the next stepPhysics physics is
+	 * idle, and objects may be moved or pushed as usual
+	 */
+	void setPhysicsThreaded(bool threaded);
+
+	inline bool isPhysicsThreaded()
 	{
-		float frameTime = 1.0f/((float)fps);
-		while (frameTimer.getElapsedTime() < frameTime);
-		actualFPS = (int) (1.0f / frameTimer.getElapsedTime());
+		return this->physicsThreaded;
 	}
+
+	/// wait out the rest of the frame's time budget
+	void endFrame();
    
 	inline int getActualFPS()
 	{
 		return actualFPS;
 	}
 
+	/// get the timings of the last complete frame
+	inline const FrameStats& getFrameStats()
+	{
+		return this->frameStats;
+	}
+
 	inline int getVertexCount()
 	{
 		return vertexCount;
 	}
 
+    /// get the number of vertex array binds and unbinds in the last frame
+    inline int getVertexArrayBindCount()
+    {
+        return vertexArrayBinds;
+    }
+
+    /// get the number of gl state changes made in the last frame
+    inline int getGLCallsIssued()
+    {
+        return glCallsIssued;
+    }
+
+    /// get the number of redundant gl state changes skipped in the last frame
+    inline int getGLCallsSkipped()
+    {
+        return glCallsSkipped;
+    }
+
+    /// get the number of draw calls made in the last frame
+    inline int getDrawCallCount()
+    {
+        return drawCalls;
+    }
+
+    /// get the number of graphics buffers currently in existence
+    inline int getBufferCount()
+    {
+        return Buffer::getBufferCount();
+    }
+
+    /// set whether static objects added from now on share pooled buffers
+    inline void setStaticMeshPooling(bool pool)
+    {
+        this->poolStaticMeshes = pool;
+    }
+
+    /** set whether dynamic objects sharing a model and instanced material are drawn together.
+     * Stays off if the driver doesn't support instancing, those objects are drawn one at a time
+     */
+    inline void setInstancing(bool instancing)
+    {
+        this->instancingEnabled = instancing && VertexArray::isInstancingSupported();
+    }
+
+    /// set whether static objects added from now on are baked into combined meshes
+    inline void setStaticBaking(bool bake)
+    {
+        this->bakeStaticObjects = bake;
+    }
+
+    /// get the number of chunks static objects are baked into
+    inline int getStaticChunkCount()
+    {
+        return this->staticChunks.getChunkCount();
+    }
+
+    /// get the number of dynamic objects that did not move in the last physics step
+    inline int getRestingObjectCount()
+    {
+        return this->restingObjectCount;
+    }
+
 	inline int getObjectCount()
 	{
         return this->objects.size() + staticObjectCount;
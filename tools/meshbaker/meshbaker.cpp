@@ -0,0 +1,107 @@
+/* 
+Copyright (c) 2011 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Converts 3ds models into baked meshes, which load without any parsing
+ * or vertex processing. Usage: meshbaker input.3ds output.mesh [--no-bvh]
+ */
+
+#include <Graphics/GraphicsSystem.h>
+#include <Resources/MeshLoader.h>
+#include <Resources/models/MeshLoaderBaked.h>
+#include <CollisionShapes/TriangleMeshCollisionShape.h>
+#include <Time/StopWatch.h>
+using namespace Magic3D;
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    const char* input = NULL;
+    const char* output = NULL;
+    bool withBvh = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--no-bvh") == 0)
+            withBvh = false;
+        else if (input == NULL)
+            input = argv[i];
+        else if (output == NULL)
+            output = argv[i];
+    }
+    if (input == NULL || output == NULL)
+    {
+        fprintf(stderr, "usage: %s input.3ds output.mesh [--no-bvh]\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        // meshes keep their vertices in graphics memory buffers, so they need a context
+        GraphicsSystem graphics;
+        graphics.setDisplaySize(64, 64);
+        graphics.init();
+
+        StopWatch timer;
+        std::shared_ptr<Meshes> meshes = MeshLoaders::getSingleton().get("3ds")->getMeshes(input);
+        double loadTime = timer.getElapsedTime();
+
+        int vertices = 0, elements = 0;
+        for (auto mesh : *meshes)
+        {
+            vertices += mesh->getVertexCount();
+            elements += mesh->getElementCount();
+        }
+        printf("%s: %d meshes, %d vertices, %d elements\n", input, (int)meshes->size(), vertices, elements);
+
+        timer.reset();
+        MeshLoaderBaked::save(*meshes, output, withBvh);
+        printf("baked %s%s in %.3f s\n", output, withBvh ? " with collision BVH" : "", timer.getElapsedTime());
+
+        // compare loading both, including building the collision shape when the BVH was baked
+        timer.reset();
+        std::shared_ptr<Meshes> baked = MeshLoaders::getSingleton().get("mesh")->getMeshes(output);
+        double bakedTime = timer.getElapsedTime();
+        printf("load 3ds:   %8.3f ms\n", loadTime * 1000.0);
+        printf("load baked: %8.3f ms\n", bakedTime * 1000.0);
+
+        if (withBvh)
+        {
+            timer.reset();
+            TriangleMeshCollisionShape built(*meshes);
+            double builtTime = timer.getElapsedTime();
+
+            timer.reset();
+            TriangleMeshCollisionShape prebuilt(*baked);
+            double prebuiltTime = timer.getElapsedTime();
+            printf("collision shape, built BVH: %8.3f ms\n", builtTime * 1000.0);
+            printf("collision shape, baked BVH: %8.3f ms\n", prebuiltTime * 1000.0);
+        }
+
+        graphics.deinit();
+    }
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}